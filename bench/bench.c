@@ -0,0 +1,512 @@
+// BCT 自身开销的基准测试：生成合成目录树，并分别测量扫描、打印、建目录、排除判断、
+// 命令模板展开、日志吞吐和子进程启动的耗时
+// 结果以制表符分隔的固定格式输出到标准输出，便于在不同版本之间比较
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "file_utils.h"
+#include "platform_utils.h"
+#include "log_utils.h"
+#include "template_utils.h"
+#include "filter_utils.h"
+#include "scan_utils.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#define NULL_DEVICE "NUL"
+#define NOOP_COMMAND "cmd.exe /c exit 0"
+#else
+#include <time.h>
+#include <unistd.h>
+#define NULL_DEVICE "/dev/null"
+#define NOOP_COMMAND "true"
+#endif
+
+#define RESULT_FORMAT_VERSION 1
+#define MAX_ITERATIONS 100
+
+// 生成目录树的参数
+typedef struct GeneratorOptions {
+    int files;
+    int depth;
+    int fanout;
+    int nameLength;
+    int unicode;
+    unsigned long long seed;
+} GeneratorOptions;
+
+// 运行基准测试时共享的状态
+typedef struct BenchContext {
+    const char* treeRoot;
+    char workDir[MAX_PATH_LENGTH];      // 基准测试的输出目录（树根目录旁的 .bench 目录）
+    FileList list;                      // 预先扫描好的目录树
+    char** paths;                       // 所有文件的完整路径
+    int pathCount;
+    int spawnJobs;
+    int logMessages;
+    int iteration;
+} BenchContext;
+
+// 单个基准测试：执行一轮，返回处理的项目数
+typedef struct Benchmark {
+    const char* name;
+    long long (*run)(BenchContext* context);
+} Benchmark;
+
+// 辅助函数：高精度单调时钟，单位为纳秒
+static long long nowNs(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (long long)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+#endif
+}
+
+// 辅助函数：xorshift64 伪随机数，相同种子生成相同的目录树
+static unsigned long long nextRandom(unsigned long long* state) {
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+// 辅助函数：生成随机文件名（不含扩展名），unicode 为真时混入多字节 UTF-8 字符
+static void randomName(char* buffer, size_t bufferSize, int length, int unicode, unsigned long long* state) {
+    static const char* wideCharacters[] = { "\xc3\xa9", "\xc3\xbc", "\xc3\x9f", "\xe4\xb8\xad", "\xe6\x96\x87", "\xe6\x97\xa5", "\xd0\xb6", "\xc3\xb1", "\xf0\x9f\x98\x80" };
+    size_t position = 0;
+    
+    for (int i = 0; i < length; i++) {
+        unsigned long long value = nextRandom(state);
+        const char* piece;
+        char ascii[2];
+        if (unicode && value % 4 == 0) {
+            piece = wideCharacters[(value >> 8) % (sizeof(wideCharacters) / sizeof(wideCharacters[0]))];
+        } else {
+            ascii[0] = (char)('a' + (value >> 8) % 26);
+            ascii[1] = '\0';
+            piece = ascii;
+        }
+        
+        size_t pieceLength = strlen(piece);
+        if (position + pieceLength >= bufferSize) {
+            break;
+        }
+        memcpy(buffer + position, piece, pieceLength);
+        position += pieceLength;
+    }
+    buffer[position] = '\0';
+}
+
+// 辅助函数：递归创建子目录，并把所有目录路径加入 directories
+static int generateDirectories(const char* path, int depth, const GeneratorOptions* options, char*** directories, int* count, int* capacity, unsigned long long* state) {
+    if (*count == *capacity) {
+        *capacity = *capacity > 0 ? *capacity * 2 : 64;
+        char** grown = (char**)realloc(*directories, sizeof(char*) * *capacity);
+        if (grown == NULL) {
+            return -1;
+        }
+        *directories = grown;
+    }
+    (*directories)[(*count)++] = strdup(path);
+    
+    if (depth >= options->depth) {
+        return 0;
+    }
+    
+    for (int i = 0; i < options->fanout; i++) {
+        char name[256];
+        char child[MAX_PATH_LENGTH];
+        randomName(name, sizeof(name), options->nameLength, options->unicode, state);
+        snprintf(child, MAX_PATH_LENGTH, "%s%s%s_%d", path, PATH_SEPARATOR_STRING, name, i);
+        if (createDirectory(child) != 0 && errno != EEXIST) {
+            return -1;
+        }
+        if (generateDirectories(child, depth + 1, options, directories, count, capacity, state) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// 生成合成目录树：目录按深度和分支数创建，文件轮流分配到各个目录中（文件内容为空）
+static int generateTree(const char* root, const GeneratorOptions* options) {
+    static const char* extensions[] = { "txt", "dat", "log", "mp4", "jpg", "bak" };
+    unsigned long long state = options->seed != 0 ? options->seed : 1;
+    char** directories = NULL;
+    int directoryCount = 0;
+    int directoryCapacity = 0;
+    
+    if (createDirectoryPath(root) != 0 || generateDirectories(root, 0, options, &directories, &directoryCount, &directoryCapacity, &state) != 0) {
+        fprintf(stderr, "Error: Cannot create directories under %s\n", root);
+        return -1;
+    }
+    
+    int result = 0;
+    for (int i = 0; i < options->files; i++) {
+        char name[256];
+        char path[MAX_PATH_LENGTH];
+        randomName(name, sizeof(name), options->nameLength, options->unicode, &state);
+        const char* extension = extensions[nextRandom(&state) % (sizeof(extensions) / sizeof(extensions[0]))];
+        snprintf(path, MAX_PATH_LENGTH, "%s%s%s_%d.%s", directories[i % directoryCount], PATH_SEPARATOR_STRING, name, i, extension);
+        
+        FILE* file = openFile(path, "wb");
+        if (file == NULL) {
+            fprintf(stderr, "Error: Cannot create %s\n", path);
+            result = -1;
+            break;
+        }
+        fclose(file);
+    }
+    
+    printf("Generated %d files in %d directories under %s\n", options->files, directoryCount, root);
+    for (int i = 0; i < directoryCount; i++) {
+        free(directories[i]);
+    }
+    free(directories);
+    return result;
+}
+
+// 基准测试：完整扫描目录树
+static long long benchScan(BenchContext* context) {
+    FileList list;
+    initFileList(&list, context->treeRoot);
+    buildFileList(context->treeRoot, &list);
+    long long items = list.count;
+    freeFileList(&list);
+    return items;
+}
+
+// 基准测试：4 个线程并行扫描目录树（按目录先序合并）
+static long long benchScanParallel(BenchContext* context) {
+    FileList list;
+    initFileList(&list, context->treeRoot);
+    list.scanThreads = 4;
+    list.scanOrder = SCAN_ORDER_TREE;
+    scanDirectoryTree(context->treeRoot, &list);
+    long long items = list.count;
+    freeFileList(&list);
+    return items;
+}
+
+// 基准测试：打印文件树（标准输出已重定向到空设备）
+static long long benchPrintTree(BenchContext* context) {
+    printFileTree(&context->list);
+    return context->list.count;
+}
+
+// 基准测试：在新的输出目录中创建完整目录树
+static long long benchCreateTree(BenchContext* context) {
+    char outputDir[MAX_PATH_LENGTH];
+    int written = snprintf(outputDir, MAX_PATH_LENGTH, "%s%stree%d", context->workDir, PATH_SEPARATOR_STRING, context->iteration);
+    if (written < 0 || written >= MAX_PATH_LENGTH) {
+        fprintf(stderr, "Error: Output path too long under %s\n", context->workDir);
+        return 0;
+    }
+    createDirectoryPath(outputDir);
+    createDirectoryTree(&context->list, outputDir);
+    return context->list.directoryCount;
+}
+
+// 基准测试：过滤器求值（排除扩展名加一个文件名通配符）
+static long long benchExclude(BenchContext* context) {
+    FileFilter* filter = createFilter();
+    if (filter == NULL) {
+        return 0;
+    }
+    addExcludedExtensions(filter, "log bak tmp");
+    addIgnorePattern(filter, "*~");
+    
+    int excluded = 0;
+    for (int i = 0; i < context->pathCount; i++) {
+        const char* lastSeparator = strrchr(context->paths[i], PATH_SEPARATOR);
+        const char* name = (lastSeparator != NULL) ? lastSeparator + 1 : context->paths[i];
+        excluded += (evaluateFilter(filter, name, NULL, 0, 0) != FILTER_PROCESS);
+    }
+    freeFilter(filter);
+    return context->pathCount + (excluded < 0);
+}
+
+// 辅助函数：对所有文件展开一次命令模板
+static long long expandAll(BenchContext* context, int useShell) {
+    CommandTemplate commandTemplate;
+    if (compileTemplate("ffmpeg -y -i %i -vcodec libx264 \"%o.mp4\" -metadata title=%n", useShell, &commandTemplate) < 0) {
+        return 0;
+    }
+    
+    TemplateContext templateContext;
+    char buffer[MAX_COMMAND_LENGTH * 2];
+    size_t rootLength = strlen(context->treeRoot);
+    for (int i = 0; i < context->pathCount; i++) {
+        setTemplateContext(&templateContext, context->paths[i], rootLength, context->workDir);
+        expandTemplate(&commandTemplate, &templateContext, buffer, sizeof(buffer));
+    }
+    freeTemplate(&commandTemplate);
+    return context->pathCount;
+}
+
+// 基准测试：Shell 模式的模板展开
+static long long benchExpandShell(BenchContext* context) {
+    return expandAll(context, 1);
+}
+
+// 基准测试：直接执行模式的模板展开
+static long long benchExpandDirect(BenchContext* context) {
+    return expandAll(context, 0);
+}
+
+// 基准测试：日志吞吐
+static long long benchLog(BenchContext* context) {
+    for (int i = 0; i < context->logMessages; i++) {
+        logMessage(LOG_INFO, "Processing file %d/%d: %s", i, context->logMessages, context->paths[i % context->pathCount]);
+    }
+    return context->logMessages;
+}
+
+// 反复返回同一个文件的任务来源，用于测量子进程启动开销
+typedef struct RepeatSource {
+    JobSource base;
+    const char* path;
+    int remaining;
+    int total;
+} RepeatSource;
+
+// 辅助函数：取出下一个任务
+static int repeatSourceNext(JobSource* source, FileJob* job, int timeoutMs) {
+    RepeatSource* repeat = (RepeatSource*)source;
+    (void)timeoutMs;
+    if (repeat->remaining == 0) {
+        return 0;
+    }
+    repeat->remaining--;
+    snprintf(job->path, MAX_PATH_LENGTH, "%s", repeat->path);
+    job->size = 0;
+    job->mtime = 0;
+    return 1;
+}
+
+// 辅助函数：任务总数
+static int repeatSourceTotal(JobSource* source, int* complete) {
+    *complete = 1;
+    return ((RepeatSource*)source)->total;
+}
+
+// 辅助函数：任务来源不需要释放
+static void repeatSourceClose(JobSource* source) {
+    (void)source;
+}
+
+// 辅助函数：用空操作命令运行 spawnJobs 个任务
+static long long spawnAll(BenchContext* context, int maxJobs) {
+    RepeatSource source;
+    source.base.next = repeatSourceNext;
+    source.base.total = repeatSourceTotal;
+    source.base.close = repeatSourceClose;
+    source.base.finish = NULL;
+    source.base.rejected = 0;
+    source.path = context->paths[0];
+    source.remaining = context->spawnJobs;
+    source.total = context->spawnJobs;
+    
+    ProcessOptions options;
+    memset(&options, 0, sizeof(options));
+    options.inputPath = context->treeRoot;
+    options.outputPath = context->workDir;
+    options.command = NOOP_COMMAND;
+    options.maxJobs = maxJobs;
+    options.copyMode = COPY_AUTO;
+    processFiles(&source.base, &options);
+    return context->spawnJobs;
+}
+
+// 基准测试：逐个启动子进程
+static long long benchSpawnSerial(BenchContext* context) {
+    return spawnAll(context, 1);
+}
+
+// 基准测试：按处理器数并行启动子进程
+static long long benchSpawnParallel(BenchContext* context) {
+    return spawnAll(context, getProcessorCount());
+}
+
+static const Benchmark benchmarks[] = {
+    { "scan", benchScan },
+    { "scan_parallel", benchScanParallel },
+    { "print_tree", benchPrintTree },
+    { "create_tree", benchCreateTree },
+    { "exclude", benchExclude },
+    { "expand_shell", benchExpandShell },
+    { "expand_direct", benchExpandDirect },
+    { "log", benchLog },
+    { "spawn_serial", benchSpawnSerial },
+    { "spawn_parallel", benchSpawnParallel },
+};
+
+// 辅助函数：按耗时升序比较
+static int compareLongLong(const void* a, const void* b) {
+    long long left = *(const long long*)a;
+    long long right = *(const long long*)b;
+    return (left > right) - (left < right);
+}
+
+// 运行基准测试，filter 不为 NULL 时只运行名称包含该字符串的测试
+static int runBenchmarks(const char* root, int iterations, int spawnJobs, int logMessages, const char* filter) {
+    BenchContext context;
+    memset(&context, 0, sizeof(context));
+    context.treeRoot = root;
+    context.spawnJobs = spawnJobs;
+    context.logMessages = logMessages;
+    snprintf(context.workDir, MAX_PATH_LENGTH, "%s.bench", root);
+    if (createDirectoryPath(context.workDir) != 0) {
+        fprintf(stderr, "Error: Cannot create %s\n", context.workDir);
+        return 1;
+    }
+    
+    // 预先扫描一次，供打印、建目录、排除判断和模板展开使用
+    initFileList(&context.list, root);
+    if (buildFileList(root, &context.list) != 0 || context.list.fileCount == 0) {
+        fprintf(stderr, "Error: No files found under %s\n", root);
+        return 1;
+    }
+    context.paths = (char**)malloc(sizeof(char*) * context.list.fileCount);
+    for (int i = 0; i < context.list.count && context.paths != NULL; i++) {
+        if (!(context.list.entries[i].flags & FILE_ENTRY_DIRECTORY)) {
+            char path[MAX_PATH_LENGTH];
+            if (getEntryPath(&context.list, i, path, MAX_PATH_LENGTH) != NULL) {
+                context.paths[context.pathCount++] = strdup(path);
+            }
+        }
+    }
+    
+    // 结果写到原来的标准输出，被测函数的输出全部丢弃
+    FILE* results = fdopen(dup(fileno(stdout)), "w");
+    if (results == NULL || freopen(NULL_DEVICE, "w", stdout) == NULL) {
+        fprintf(stderr, "Error: Cannot redirect standard output\n");
+        return 1;
+    }
+    
+    fprintf(results, "# bct-bench format %d\n", RESULT_FORMAT_VERSION);
+    fprintf(results, "# tree\t%s\tfiles=%d\tdirectories=%d\n", root, context.list.fileCount, context.list.directoryCount);
+    fprintf(results, "benchmark\titems\titerations\tmin_ms\tmedian_ms\tns_per_item\n");
+    
+    for (int b = 0; b < (int)(sizeof(benchmarks) / sizeof(benchmarks[0])); b++) {
+        if (filter != NULL && strstr(benchmarks[b].name, filter) == NULL) {
+            continue;
+        }
+        
+        long long times[MAX_ITERATIONS];
+        long long items = 0;
+        for (int i = 0; i < iterations; i++) {
+            context.iteration = i;
+            long long start = nowNs();
+            items = benchmarks[b].run(&context);
+            times[i] = nowNs() - start;
+        }
+        qsort(times, iterations, sizeof(long long), compareLongLong);
+        
+        fprintf(results, "%s\t%lld\t%d\t%.3f\t%.3f\t%.1f\n", benchmarks[b].name, items, iterations,
+                times[0] / 1e6, times[iterations / 2] / 1e6, items > 0 ? (double)times[0] / items : 0.0);
+        fflush(results);
+    }
+    
+    fclose(results);
+    for (int i = 0; i < context.pathCount; i++) {
+        free(context.paths[i]);
+    }
+    free(context.paths);
+    freeFileList(&context.list);
+    return 0;
+}
+
+// 打印用法
+static void printUsage(const char* program) {
+    printf("Usage: %s generate DIR [--files N] [--depth D] [--fanout F] [--name-length L] [--unicode] [--seed S]\n", program);
+    printf("       %s run DIR [--iterations N] [--spawn-jobs N] [--log-messages N] [--filter NAME]\n", program);
+    printf("Results of 'run' are tab-separated lines: benchmark, items, iterations, min_ms, median_ms, ns_per_item\n");
+}
+
+// 辅助函数：读取数值选项的值，缺少值时返回 -1
+static long long numberOption(int argc, char* argv[], int* index) {
+    if (*index + 1 >= argc) {
+        return -1;
+    }
+    return strtoll(argv[++*index], NULL, 10);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    
+    const char* mode = argv[1];
+    const char* root = argv[2];
+    GeneratorOptions generator = { 10000, 4, 8, 12, 0, 1 };
+    int iterations = 5;
+    int spawnJobs = 200;
+    int logMessages = 100000;
+    const char* filter = NULL;
+    
+    for (int i = 3; i < argc; i++) {
+        const char* name = argv[i];
+        if (strcmp(name, "--unicode") == 0) {
+            generator.unicode = 1;
+            continue;
+        }
+        if (strcmp(name, "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+            continue;
+        }
+        
+        long long value = numberOption(argc, argv, &i);
+        if (strcmp(name, "--files") == 0) {
+            generator.files = (int)value;
+        } else if (strcmp(name, "--depth") == 0) {
+            generator.depth = (int)value;
+        } else if (strcmp(name, "--fanout") == 0) {
+            generator.fanout = (int)value;
+        } else if (strcmp(name, "--name-length") == 0) {
+            generator.nameLength = (int)value;
+        } else if (strcmp(name, "--seed") == 0) {
+            generator.seed = (unsigned long long)value;
+        } else if (strcmp(name, "--iterations") == 0) {
+            iterations = value > MAX_ITERATIONS ? MAX_ITERATIONS : (int)value;
+        } else if (strcmp(name, "--spawn-jobs") == 0) {
+            spawnJobs = (int)value;
+        } else if (strcmp(name, "--log-messages") == 0) {
+            logMessages = (int)value;
+        } else {
+            printf("Error: Unknown option %s\n", name);
+            printUsage(argv[0]);
+            return 1;
+        }
+        if (value < 1) {
+            printf("Error: %s expects a positive number\n", name);
+            return 1;
+        }
+    }
+    
+    if (strcmp(mode, "generate") == 0) {
+        return generateTree(root, &generator) == 0 ? 0 : 1;
+    }
+    if (strcmp(mode, "run") != 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    
+    // 日志照常写入当前目录的 bct.log，与实际运行时的开销一致
+    setLogFlushPolicy(LOG_FLUSH_ERRORS);
+    initLogging(LOG_OVERWRITE);
+    int result = runBenchmarks(root, iterations, spawnJobs, logMessages, filter);
+    closeLogging();
+    return result;
+}
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file_utils.h"
+#include "platform_utils.h"
+#include "log_utils.h"
+#include "capture_utils.h"
+
+// 单个任务的输出
+struct JobOutput {
+    char* ring;                 // 最近 CAPTURE_TAIL_BYTES 字节的输出
+    size_t start;               // 最早一个字节在环形缓冲区中的位置
+    size_t length;              // 环形缓冲区中的字节数
+    long long totalBytes;       // 任务输出的总字节数
+    FILE* file;                 // CAPTURE_ALL 模式下的日志文件，收到第一块输出时才创建
+    int fileFailed;             // 日志文件无法创建，之后不再重试
+    char relativePath[MAX_PATH_LENGTH];
+    char logPath[MAX_PATH_LENGTH];
+    JobOutput* nextFree;
+};
+
+// 输出捕获设置（只由 processFiles 所在的线程访问，无需加锁）
+struct OutputCapture {
+    CaptureMode mode;
+    char directory[MAX_PATH_LENGTH];
+    int errorTailLines;
+    JobOutput* freeList;        // 已结束任务的缓冲区，留给之后的任务复用
+};
+
+// 创建输出捕获设置，CAPTURE_NONE 时返回 NULL（子进程直接继承控制台）
+OutputCapture* createOutputCapture(CaptureMode mode, const char* directory, int errorTailLines) {
+    if (mode == CAPTURE_NONE) {
+        return NULL;
+    }
+    
+    OutputCapture* capture = (OutputCapture*)calloc(1, sizeof(OutputCapture));
+    if (capture == NULL) {
+        return NULL;
+    }
+    capture->mode = mode;
+    snprintf(capture->directory, sizeof(capture->directory), "%s", directory);
+    capture->errorTailLines = errorTailLines;
+    return capture;
+}
+
+// 开始记录一个任务的输出，relativePath 为输入文件相对于输入目录的路径（决定日志文件的位置）
+JobOutput* beginJobOutput(OutputCapture* capture, const char* relativePath) {
+    JobOutput* output = capture->freeList;
+    if (output != NULL) {
+        capture->freeList = output->nextFree;
+    } else {
+        output = (JobOutput*)calloc(1, sizeof(JobOutput));
+        if (output == NULL) {
+            return NULL;
+        }
+        output->ring = (char*)malloc(CAPTURE_TAIL_BYTES);
+        if (output->ring == NULL) {
+            free(output);
+            return NULL;
+        }
+    }
+    
+    while (*relativePath == '/' || *relativePath == '\\') {
+        relativePath++;
+    }
+    snprintf(output->relativePath, sizeof(output->relativePath), "%s", relativePath);
+    output->start = 0;
+    output->length = 0;
+    output->totalBytes = 0;
+    output->file = NULL;
+    output->fileFailed = 0;
+    output->logPath[0] = '\0';
+    output->nextFree = NULL;
+    return output;
+}
+
+// 辅助函数：在日志目录中按输入文件的相对路径创建日志文件（<目录>/<相对路径>.log）
+static FILE* openJobLog(OutputCapture* capture, JobOutput* output) {
+    int written = snprintf(output->logPath, sizeof(output->logPath), "%s%c%s.log", capture->directory, PATH_SEPARATOR, output->relativePath);
+    if (written < 0 || (size_t)written >= sizeof(output->logPath)) {
+        logMessage(LOG_WARNING, "Job log path too long for file: %s", output->relativePath);
+        output->logPath[0] = '\0';
+        return NULL;
+    }
+    
+    char parent[MAX_PATH_LENGTH];
+    memcpy(parent, output->logPath, (size_t)written + 1);
+    char* lastSeparator = strrchr(parent, PATH_SEPARATOR);
+    if (lastSeparator != NULL) {
+        *lastSeparator = '\0';
+        createDirectoryPath(parent);
+    }
+    
+    FILE* file = openFile(output->logPath, "wb");
+    if (file == NULL) {
+        logMessage(LOG_WARNING, "Cannot create job log: %s", output->logPath);
+        output->logPath[0] = '\0';
+    }
+    return file;
+}
+
+// 记录任务的一块输出：写入环形缓冲区，CAPTURE_ALL 模式下同时写入日志文件
+void appendJobOutput(OutputCapture* capture, JobOutput* output, const char* data, size_t length) {
+    output->totalBytes += (long long)length;
+    
+    if (capture->mode == CAPTURE_ALL && output->file == NULL && !output->fileFailed) {
+        output->file = openJobLog(capture, output);
+        output->fileFailed = (output->file == NULL);
+    }
+    if (output->file != NULL) {
+        fwrite(data, 1, length, output->file);
+    }
+    
+    // 只保留最后 CAPTURE_TAIL_BYTES 字节
+    if (length >= CAPTURE_TAIL_BYTES) {
+        memcpy(output->ring, data + length - CAPTURE_TAIL_BYTES, CAPTURE_TAIL_BYTES);
+        output->start = 0;
+        output->length = CAPTURE_TAIL_BYTES;
+        return;
+    }
+    for (size_t copied = 0; copied < length; ) {
+        size_t end = (output->start + output->length) % CAPTURE_TAIL_BYTES;
+        size_t chunk = CAPTURE_TAIL_BYTES - end;
+        if (chunk > length - copied) {
+            chunk = length - copied;
+        }
+        memcpy(output->ring + end, data + copied, chunk);
+        copied += chunk;
+        output->length += chunk;
+        if (output->length > CAPTURE_TAIL_BYTES) {
+            output->start = (output->start + output->length - CAPTURE_TAIL_BYTES) % CAPTURE_TAIL_BYTES;
+            output->length = CAPTURE_TAIL_BYTES;
+        }
+    }
+}
+
+// 辅助函数：环形缓冲区中第 index 个字节（从最早的字节算起）
+static char ringByte(const JobOutput* output, size_t index) {
+    return output->ring[(output->start + index) % CAPTURE_TAIL_BYTES];
+}
+
+// 取出任务输出的最后 errorTailLines 行（不超过 bufferSize - 1 字节），返回长度
+size_t getOutputTail(const OutputCapture* capture, const JobOutput* output, char* buffer, size_t bufferSize) {
+    buffer[0] = '\0';
+    if (capture->errorTailLines <= 0 || output->length == 0 || bufferSize < 2) {
+        return 0;
+    }
+    
+    // 忽略末尾的换行，再向前数出所需的行数
+    size_t end = output->length;
+    while (end > 0 && (ringByte(output, end - 1) == '\n' || ringByte(output, end - 1) == '\r')) {
+        end--;
+    }
+    size_t begin = end;
+    int lines = 0;
+    while (begin > 0 && end - begin < bufferSize - 1) {
+        if (ringByte(output, begin - 1) == '\n' && ++lines == capture->errorTailLines) {
+            break;
+        }
+        begin--;
+    }
+    
+    for (size_t i = begin; i < end; i++) {
+        buffer[i - begin] = ringByte(output, i);
+    }
+    buffer[end - begin] = '\0';
+    return end - begin;
+}
+
+// 结束一个任务的输出：CAPTURE_FAILED 模式下命令失败时把保留的输出写入日志文件
+// 返回日志文件路径（没有日志文件时返回 NULL），该路径在下一次调用 beginJobOutput 之前有效
+const char* endJobOutput(OutputCapture* capture, JobOutput* output, int failed) {
+    if (capture->mode == CAPTURE_FAILED && failed && output->length > 0) {
+        output->file = openJobLog(capture, output);
+        if (output->file != NULL) {
+            long long dropped = output->totalBytes - (long long)output->length;
+            if (dropped > 0) {
+                fprintf(output->file, "[... %lld earlier bytes not kept ...]\n", dropped);
+            }
+            size_t firstPart = CAPTURE_TAIL_BYTES - output->start;
+            if (firstPart > output->length) {
+                firstPart = output->length;
+            }
+            fwrite(output->ring + output->start, 1, firstPart, output->file);
+            fwrite(output->ring, 1, output->length - firstPart, output->file);
+        }
+    }
+    if (output->file != NULL) {
+        fclose(output->file);
+        output->file = NULL;
+    } else {
+        output->logPath[0] = '\0';
+    }
+    
+    output->nextFree = capture->freeList;
+    capture->freeList = output;
+    return output->logPath[0] != '\0' ? output->logPath : NULL;
+}
+
+// 释放输出捕获设置及所有缓冲区（所有任务都已结束）
+void freeOutputCapture(OutputCapture* capture) {
+    if (capture == NULL) {
+        return;
+    }
+    while (capture->freeList != NULL) {
+        JobOutput* output = capture->freeList;
+        capture->freeList = output->nextFree;
+        free(output->ring);
+        free(output);
+    }
+    free(capture);
+}
+
+// 解析输出捕获方式：none、failed 或 all，成功返回 0
+int parseCaptureMode(const char* text, CaptureMode* mode) {
+    if (strcmp(text, "none") == 0) {
+        *mode = CAPTURE_NONE;
+    } else if (strcmp(text, "failed") == 0) {
+        *mode = CAPTURE_FAILED;
+    } else if (strcmp(text, "all") == 0) {
+        *mode = CAPTURE_ALL;
+    } else {
+        return -1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#ifndef CAPTURE_UTILS_H
+#define CAPTURE_UTILS_H
+
+#include <stddef.h>
+
+// 一次运行中的输出捕获设置和可复用的任务缓冲区
+typedef struct OutputCapture OutputCapture;
+
+// 单个任务的输出：最近输出的环形缓冲区，以及 CAPTURE_ALL 模式下的日志文件
+typedef struct JobOutput JobOutput;
+
+// 默认值
+#define DEFAULT_JOB_LOG_DIRECTORY "bct_logs"
+#define DEFAULT_ERROR_TAIL_LINES 20
+
+// 每个任务在内存中保留的最近输出（字节）
+#define CAPTURE_TAIL_BYTES (64 * 1024)
+
+// 函数声明
+OutputCapture* createOutputCapture(CaptureMode mode, const char* directory, int errorTailLines);
+JobOutput* beginJobOutput(OutputCapture* capture, const char* relativePath);
+void appendJobOutput(OutputCapture* capture, JobOutput* output, const char* data, size_t length);
+size_t getOutputTail(const OutputCapture* capture, const JobOutput* output, char* buffer, size_t bufferSize);
+const char* endJobOutput(OutputCapture* capture, JobOutput* output, int failed);
+void freeOutputCapture(OutputCapture* capture);
+int parseCaptureMode(const char* text, CaptureMode* mode);
+
+#endif
\ No newline at end of file
@@ -2,288 +2,2216 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
-#include <ctype.h>
+#include <limits.h>
 #include "file_utils.h"
 #include "platform_utils.h"
 #include "log_utils.h"
+#include "queue_utils.h"
+#include "manifest_utils.h"
+#include "template_utils.h"
+#include "report_utils.h"
+#include "filter_utils.h"
+#include "scan_utils.h"
+#include "sched_utils.h"
+#include "capture_utils.h"
+#include "progress_utils.h"
+#include "watch_utils.h"
+#include "path_utils.h"
 
 #ifdef _WIN32
 #include <windows.h>
 #endif
 
-// 获取不带扩展名的文件名
-char* getFileNameWithoutExtension(const char* path) {
-    static char result[MAX_PATH_LENGTH];
-    char* lastBackslash = strrchr(path, '\\');
-    char* filename = (lastBackslash != NULL) ? lastBackslash + 1 : (char*)path;
+// 初始化空的文件表
+void initFileList(FileList* list, const char* root) {
+    memset(list, 0, sizeof(FileList));
+    snprintf(list->root, MAX_PATH_LENGTH, "%s", root);
+}
+
+// 辅助函数：对将要加入的文件或目录求值过滤器，返回 FILTER_* 结果
+// 只有存在需要匹配路径的模式时才拼接相对路径（相对路径不含开头的分隔符）
+static FilterResult filterNewEntry(const FileList* list, int parent, const char* name, size_t nameLength, unsigned int flags, long long size, long long mtime) {
+    char nameBuffer[MAX_PATH_LENGTH];
+    char pathBuffer[MAX_PATH_LENGTH];
+    const char* relativePath = NULL;
     
-    strcpy(result, filename);
+    if (nameLength >= sizeof(nameBuffer)) {
+        return FILTER_PROCESS;
+    }
+    memcpy(nameBuffer, name, nameLength);
+    nameBuffer[nameLength] = '\0';
     
-    // 移除扩展名
-    char* lastDot = strrchr(result, '.');
-    if (lastDot != NULL) {
-        *lastDot = '\0';
+    if (filterNeedsPath(list->filter)) {
+        size_t parentLength = 0;
+        if (parent >= 0) {
+            if (getEntryRelativePath(list, parent, pathBuffer, sizeof(pathBuffer)) == NULL) {
+                return FILTER_PROCESS;
+            }
+            parentLength = strlen(pathBuffer);
+        }
+        if (parentLength + 1 + nameLength + 1 > sizeof(pathBuffer)) {
+            return FILTER_PROCESS;
+        }
+        pathBuffer[parentLength] = PATH_SEPARATOR;
+        memcpy(pathBuffer + parentLength + 1, nameBuffer, nameLength + 1);
+        relativePath = pathBuffer + 1;
     }
     
-    return result;
+    if (flags & FILE_ENTRY_DIRECTORY) {
+        int depth = parent >= 0 ? list->entries[parent].depth + 1 : 0;
+        return evaluateDirectory(list->filter, nameBuffer, relativePath, depth);
+    }
+    return evaluateFilter(list->filter, nameBuffer, relativePath, size, mtime);
 }
 
-// 获取文件扩展名（小写）
-char* getFileExtension(const char* path) {
-    static char result[16] = {0};
-    char* lastDot = strrchr(path, '.');
+// 向文件表末尾追加一项，返回其下标（失败返回 -1，文件被过滤器跳过时返回 FILE_ENTRY_FILTERED）
+int addFileEntry(FileList* list, int parent, const char* name, size_t nameLength, unsigned int flags, long long size, long long mtime) {
+    if (nameLength > 0xFFFF) {
+        logMessage(LOG_ERROR, "File name too long: %.*s", (int)nameLength, name);
+        return -1;
+    }
     
-    if (lastDot != NULL) {
-        strncpy(result, lastDot + 1, 15);
-        result[15] = '\0';
-        
-        // 转换为小写
-        for (int i = 0; result[i]; i++) {
-            result[i] = tolower(result[i]);
+    // 加入之前求值过滤器：被跳过的文件不占用表项，被剪枝的目录不会被打开
+    if (list->filter != NULL) {
+        FilterResult result = filterNewEntry(list, parent, name, nameLength, flags, size, mtime);
+        if (result == FILTER_SKIP) {
+            return FILE_ENTRY_FILTERED;
+        }
+        if (result == FILTER_EXCLUDE) {
+            flags |= FILE_ENTRY_EXCLUDED;
+        }
+    }
+    
+    // 表项数组按倍数扩容，保持连续存放
+    if (list->count == list->capacity) {
+        int newCapacity = list->capacity > 0 ? list->capacity * 2 : 1024;
+        FileEntry* newEntries = (FileEntry*)realloc(list->entries, sizeof(FileEntry) * (size_t)newCapacity);
+        if (newEntries == NULL) {
+            logMessage(LOG_ERROR, "Out of memory while building file list: %.*s", (int)nameLength, name);
+            return -1;
+        }
+        list->entries = newEntries;
+        list->capacity = newCapacity;
+    }
+    
+    // 名称追加到字符串池中
+    if (list->namesLength + nameLength + 1 > list->namesCapacity) {
+        size_t newCapacity = list->namesCapacity > 0 ? list->namesCapacity * 2 : 65536;
+        while (newCapacity < list->namesLength + nameLength + 1) {
+            newCapacity *= 2;
+        }
+        char* newNames = (char*)realloc(list->names, newCapacity);
+        if (newNames == NULL) {
+            logMessage(LOG_ERROR, "Out of memory while building file list: %.*s", (int)nameLength, name);
+            return -1;
         }
+        list->names = newNames;
+        list->namesCapacity = newCapacity;
+    }
+    
+    FileEntry* entry = &list->entries[list->count];
+    entry->size = size;
+    entry->mtime = mtime;
+    entry->parent = parent;
+    entry->nameOffset = (unsigned int)list->namesLength;
+    entry->nameLength = (unsigned short)nameLength;
+    entry->depth = (unsigned short)(parent >= 0 ? list->entries[parent].depth + 1 : 0);
+    entry->flags = flags;
+    
+    memcpy(list->names + list->namesLength, name, nameLength);
+    list->names[list->namesLength + nameLength] = '\0';
+    list->namesLength += nameLength + 1;
+    
+    if (flags & FILE_ENTRY_DIRECTORY) {
+        list->directoryCount++;
     } else {
-        result[0] = '\0';
+        list->fileCount++;
     }
     
-    return result;
+    int index = list->count++;
+    if (list->onEntryAdded != NULL && list->onEntryAdded(list, index, list->userData) != 0) {
+        return -1;
+    }
+    return index;
 }
 
-// 检查文件是否应该被排除
-int shouldExcludeFile(const char* filename, const char* excludeExtensions) {
-    if (excludeExtensions == NULL || excludeExtensions[0] == '\0') {
-        return 0;
+// 获取表项的名称（不含目录部分）
+const char* getEntryName(const FileList* list, int index) {
+    return list->names + list->entries[index].nameOffset;
+}
+
+// 获取表项相对根目录的路径（以路径分隔符开头），缓冲区不足时返回 NULL
+char* getEntryRelativePath(const FileList* list, int index, char* buffer, size_t bufferSize) {
+    // 先沿父目录链计算总长度，再从末尾向前填充，无需额外的栈空间
+    size_t length = 0;
+    for (int current = index; current >= 0; current = list->entries[current].parent) {
+        length += list->entries[current].nameLength + 1;
     }
-    
-    char* ext = getFileExtension(filename);
-    if (ext[0] == '\0') {
-        return 0;
+    if (length + 1 > bufferSize) {
+        return NULL;
     }
     
-    // 复制排除扩展名字符串以便处理
-    char exts[MAX_EXTENSIONS_LENGTH];
-    strncpy(exts, excludeExtensions, MAX_EXTENSIONS_LENGTH - 1);
-    exts[MAX_EXTENSIONS_LENGTH - 1] = '\0';
-    
-    // 转换为小写
-    for (int i = 0; exts[i]; i++) {
-        exts[i] = tolower(exts[i]);
+    buffer[length] = '\0';
+    for (int current = index; current >= 0; current = list->entries[current].parent) {
+        const FileEntry* entry = &list->entries[current];
+        length -= entry->nameLength;
+        memcpy(buffer + length, list->names + entry->nameOffset, entry->nameLength);
+        buffer[--length] = PATH_SEPARATOR;
+    }
+    return buffer;
+}
+
+// 获取表项的完整路径，缓冲区不足时返回 NULL
+char* getEntryPath(const FileList* list, int index, char* buffer, size_t bufferSize) {
+    size_t rootLength = strlen(list->root);
+    if (rootLength >= bufferSize) {
+        return NULL;
     }
     
-    // 检查扩展名是否在排除列表中
-    char* token = strtok(exts, " ,;");
-    while (token != NULL) {
-        // 移除可能的前导点
-        if (token[0] == '.') {
-            token++;
+    memcpy(buffer, list->root, rootLength);
+    if (getEntryRelativePath(list, index, buffer + rootLength, bufferSize - rootLength) == NULL) {
+        return NULL;
+    }
+    return buffer;
+}
+
+// 根据扫描结果打印文件树
+void printFileTree(const FileList* list) {
+    for (int i = 0; i < list->count; i++) {
+        const FileEntry* entry = &list->entries[i];
+        
+        // 缩进
+        for (int level = 0; level < entry->depth; level++) {
+            printf("  ");
         }
         
-        if (strcmp(ext, token) == 0) {
-            return 1;
+        if (entry->flags & FILE_ENTRY_DIRECTORY) {
+            printf("[%s]" PATH_SEPARATOR_STRING "\n", getEntryName(list, i));
+        } else {
+            printf("%s\n", getEntryName(list, i));
+        }
+    }
+}
+
+// 根据扫描结果在输出目录中创建目录树
+void createDirectoryTree(const FileList* list, const char* outputPath) {
+    size_t outputLength = strlen(outputPath);
+    if (outputLength >= MAX_PATH_LENGTH) {
+        return;
+    }
+    
+    char outputDir[MAX_PATH_LENGTH];
+    memcpy(outputDir, outputPath, outputLength);
+    
+    // 先序排列保证父目录总是先于子目录创建
+    for (int i = 0; i < list->count; i++) {
+        if (!(list->entries[i].flags & FILE_ENTRY_DIRECTORY)) {
+            continue;
         }
         
-        token = strtok(NULL, " ,;");
+        if (getEntryRelativePath(list, i, outputDir + outputLength, MAX_PATH_LENGTH - outputLength) == NULL) {
+            logMessage(LOG_WARNING, "Output path too long for directory: %s", getEntryName(list, i));
+            continue;
+        }
+        if (createDirectory(outputDir) != 0 && errno != EEXIST) {
+            logMessage(LOG_WARNING, "Cannot create directory %s", outputDir);
+        }
+    }
+}
+
+// 创建目录及其所有不存在的上级目录，成功（或已存在）返回 0
+// 用 getFileInfo 判断是否存在，避免把上级目录不存在的情况记录为错误
+int createDirectoryPath(const char* path) {
+    if (getFileInfo(path, NULL, NULL) == 0) {
+        return 0;
     }
     
+    char buffer[MAX_PATH_LENGTH];
+    snprintf(buffer, MAX_PATH_LENGTH, "%s", path);
+    size_t length = strlen(buffer);
+    for (size_t i = 1; i <= length; i++) {
+        if (buffer[i] != '/' && buffer[i] != '\\' && buffer[i] != '\0') {
+            continue;
+        }
+        char saved = buffer[i];
+        buffer[i] = '\0';
+        if (getFileInfo(buffer, NULL, NULL) != 0 && createDirectory(buffer) != 0 && getFileInfo(buffer, NULL, NULL) != 0) {
+            return -1;
+        }
+        buffer[i] = saved;
+    }
     return 0;
 }
 
+// 计算字符串的 64 位 FNV-1a 哈希
+unsigned long long hashString(const char* text) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (const unsigned char* p = (const unsigned char*)text; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
 // 计算文件列表中非目录文件的数量
-int countFiles(FileEntry* list) {
-    int count = 0;
-    FileEntry* current = list;
+int countFiles(const FileList* list) {
+    return list->fileCount;
+}
+
+// 正在运行的任务
+typedef struct RunningJob {
+    char inputPath[MAX_PATH_LENGTH];
+    char command[MAX_COMMAND_LENGTH * 2];   // 完整命令行（Shell 模式执行，直接执行模式仅用于日志）
+    char argBuffer[MAX_COMMAND_LENGTH * 2]; // 直接执行模式下以 '\0' 分隔的参数
+    int argCount;
+    char outputFile[MAX_PATH_LENGTH];       // 由模板中 %o 所在参数推断出的输出文件（无法推断时为空）
+    long long size;
+    long long mtime;
+    long long startTime;                    // 启动时间（单调时钟，毫秒）
+    int placement;                          // 绑定的 CPU 组（未绑定时为 -1）
+    JobOutput* output;                      // 捕获的输出（未捕获时为 NULL）
+    int attempt;                            // 第几次尝试（从 1 开始）
+    long long lastActivity;                 // 最近一次有输出的时间（用于检测卡住）
+    long long lastOutputSize;               // 上次检查时输出文件的大小（-1 表示尚不存在）
+    long long lastStallCheck;               // 上次检查输出文件的时间
+    long long killTime;                     // 因超时或卡住发出结束请求的时间（0 表示未结束）
+    int killForced;                         // 宽限期已过，已强制结束
+    long long retryAt;                      // 等待重试时再次启动的时间
+    struct BatchFile* files;                // 批处理任务包含的文件（单文件任务为 NULL，由任务持有）
+    int fileCount;
+    char* batchCommand;                     // 批处理任务的命令行（堆上分配，单文件任务为 NULL）
+    char* batchArguments;                   // 批处理任务在直接执行模式下以 '\0' 分隔的参数
+} RunningJob;
+
+// 批处理任务中的一个文件
+typedef struct BatchFile {
+    char inputPath[MAX_PATH_LENGTH];
+    long long size;
+    long long mtime;
+} BatchFile;
+
+// 正在收集文件的批处理：同一输出目录中的文件合并，达到数量或命令行长度上限时启动
+typedef struct OpenBatch {
+    BatchFile* files;           // 容量为 batchSize，启动时连同文件一起交给任务
+    int count;
+    size_t commandLength;       // 加入这些文件后命令行长度的估计值（不会偏小）
+    TemplateContext context;    // 第一个文件的展开上下文：%I 以外的占位符都取第一个文件的值
+    long long lastAdded;        // 最近一次加入文件的序号，同时收集的批处理过多时先启动最久未加入文件的
+} OpenBatch;
+
+// 同时收集文件的批处理个数上限：扫描按先序遍历，子目录穿插在父目录的文件之间，
+// 每个目录保留自己的批处理，父目录的文件就不会因进入子目录而被拆开
+#define MAX_OPEN_BATCHES 32
+
+// 直接执行模式下单条命令的最大参数个数
+#define MAX_COMMAND_ARGS 256
+
+// 任务因超时或卡住被结束时记录的退出码（与 GNU timeout 一致）
+#define JOB_TIMEOUT_EXIT_CODE 124
+// 请求结束进程树后等待其自行退出的时间，超过后强制结束
+#define KILL_GRACE_MS 3000
+// 检查输出文件是否增长的间隔
+#define STALL_CHECK_INTERVAL_MS 1000
+// 重试等待时间的上限
+#define MAX_RETRY_DELAY_MS 60000
+
+// 辅助函数：增量模式下判断文件是否可以跳过
+// 能推断出输出文件时还要求输出文件存在
+static int isJobUpToDate(const Manifest* manifest, const RunningJob* job, const ProcessOptions* options) {
+    const char* relativePath = job->inputPath + strlen(options->inputPath);
+    if (!isManifestUpToDate(manifest, relativePath, job->size, job->mtime, hashString(job->command))) {
+        return 0;
+    }
+    if (job->outputFile[0] != '\0' && getFileInfo(job->outputFile, NULL, NULL) != 0) {
+        return 0;
+    }
+    return 1;
+}
+
+// 辅助函数：生成直接执行模式下用于日志显示的命令行，含空白的参数加上引号
+static void formatCommandLine(const char* arguments, int argCount, char* buffer, size_t bufferSize) {
+    size_t commandLength = 0;
+    const char* current = arguments;
+    buffer[0] = '\0';
+    for (int i = 0; i < argCount; i++) {
+        const char* format = (current[0] == '\0' || strpbrk(current, " \t") != NULL) ? "%s\"%s\"" : "%s%s";
+        int written = snprintf(buffer + commandLength, bufferSize - commandLength, format, i > 0 ? " " : "", current);
+        if (written > 0 && commandLength + (size_t)written < bufferSize) {
+            commandLength += (size_t)written;
+        }
+        current += strlen(current) + 1;
+    }
+}
+
+// 根据预编译的命令模板构建单个文件的最终命令
+// Shell 模式下生成完整命令行；直接执行模式下生成以 '\0' 分隔的参数，同时生成用于日志显示的命令行
+// 成功返回 0，路径或命令过长返回 -1
+static int buildCommand(const CommandTemplate* commandTemplate, const ProcessOptions* options, TemplateContext* context, RunningJob* job) {
+    job->argCount = 0;
+    job->command[0] = '\0';
+    job->outputFile[0] = '\0';
+    job->files = NULL;
+    job->fileCount = 0;
+    job->batchCommand = NULL;
+    job->batchArguments = NULL;
+    
+    if (setTemplateContext(context, job->inputPath, strlen(options->inputPath), options->outputPath) != 0) {
+        logMessage(LOG_ERROR, "Output path too long for file: %s", job->inputPath);
+        return -1;
+    }
+    
+    // 推断输出文件（例如 %o.mp4），供增量模式和运行报告使用
+    if (!expandOutputPath(commandTemplate, context, job->outputFile, sizeof(job->outputFile))) {
+        job->outputFile[0] = '\0';
+    }
     
-    while (current != NULL) {
-        if (!current->is_directory) {
-            count++;
+    if (options->useShell) {
+        if (expandTemplate(commandTemplate, context, job->command, sizeof(job->command)) < 0) {
+            logMessage(LOG_ERROR, "Command too long for file: %s", job->inputPath);
+            return -1;
         }
-        current = current->next;
+        return 0;
     }
     
-    return count;
+    if (expandTemplate(commandTemplate, context, job->argBuffer, sizeof(job->argBuffer)) < 0) {
+        logMessage(LOG_ERROR, "Command too long for file: %s", job->inputPath);
+        return -1;
+    }
+    job->argCount = commandTemplate->argumentCount;
+    formatCommandLine(job->argBuffer, job->argCount, job->command, sizeof(job->command));
+    return 0;
 }
 
-// 处理文件
-void processFiles(FileEntry* fileList, const char* inputPath, const char* outputPath, const char* command, int copyOnError, const char* excludeExtensions) {
-    // 首先创建完整的目录树
-    createDirectoryTree(inputPath, outputPath);
+// 为单个文件生成命令但不执行，得到清单中记录的命令哈希值和推断的输出文件（无法推断时为空字符串）
+// 供协调者在分发任务前判断文件是否为最新，并在工作者汇报成功后记录清单；命令无法生成时返回 -1
+int describeJob(const CommandTemplate* commandTemplate, const ProcessOptions* options, const FileJob* file, unsigned long long* commandHash, char* outputFile, size_t outputFileSize) {
+    RunningJob job;
+    TemplateContext context;
+    strcpy(job.inputPath, file->path);
+    job.size = file->size;
+    job.mtime = file->mtime;
+    int result = buildCommand(commandTemplate, options, &context, &job);
+    *commandHash = (result == 0) ? hashString(job.command) : 0;
+    snprintf(outputFile, outputFileSize, "%s", result == 0 ? job.outputFile : "");
+    return result;
+}
+
+// 辅助函数：任务的完整命令行（批处理任务的命令行存放在堆上）
+static const char* getJobCommand(const RunningJob* job) {
+    return (job->batchCommand != NULL) ? job->batchCommand : job->command;
+}
+
+// 辅助函数：释放批处理任务持有的文件列表和命令行
+static void releaseJob(RunningJob* job) {
+    free(job->files);
+    free(job->batchCommand);
+    free(job->batchArguments);
+    job->files = NULL;
+    job->fileCount = 0;
+    job->batchCommand = NULL;
+    job->batchArguments = NULL;
+}
+
+// 辅助函数：启动任务对应的子进程
+// 设置了超时或卡住检测时子进程放入新的进程组，以便结束其创建的所有进程
+static int startJob(RunningJob* job, const ProcessOptions* options, ProcessHandle* handle) {
+    unsigned int startFlags = 0;
+    if (job->output != NULL) {
+        startFlags |= START_CAPTURE_OUTPUT;
+    }
+    if (options->timeoutMs > 0 || options->stallTimeoutMs > 0) {
+        startFlags |= START_NEW_GROUP;
+    }
     
-    // 计算总文件数和当前处理进度
-    int totalFiles = countFiles(fileList);
-    int processedFiles = 0;
-    int excludedFiles = 0;
+    if (options->useShell) {
+        return startCommand(getJobCommand(job), handle, startFlags);
+    }
     
-    FileEntry* current = fileList;
+    if (job->argCount == 0) {
+        logMessage(LOG_ERROR, "Empty command for file: %s", job->inputPath);
+        return -1;
+    }
     
-    while (current != NULL) {
-        if (!current->is_directory) {
-            processedFiles++;
-            
-            // 检查文件是否应该被排除
-            if (shouldExcludeFile(current->path, excludeExtensions)) {
-                excludedFiles++;
-                printf("Excluding file %d/%d: %s (extension excluded)\n", processedFiles, totalFiles, current->path);
-                logMessage(LOG_INFO, "Excluding file %d/%d: %s (extension excluded)", processedFiles, totalFiles, current->path);
-                
-                // 如果启用了复制功能，复制被排除的文件
-                if (copyOnError) {
-                    // 计算相对路径
-                    const char* relativePath = current->path + strlen(inputPath);
-                    
-                    // 构建目标文件路径
-                    char targetPath[MAX_PATH_LENGTH];
-                    snprintf(targetPath, MAX_PATH_LENGTH, "%s%s", outputPath, relativePath);
-                    
-                    printf("Copying excluded file: %s -> %s\n", current->path, targetPath);
-                    logMessage(LOG_INFO, "Copying excluded file: %s -> %s", current->path, targetPath);
-                    
-                    // 复制源文件到目标路径
-                    if (!copyFileWithPath(current->path, targetPath)) {
-                        printf("Copying excluded file failed\n");
-                        logMessage(LOG_ERROR, "Copying excluded file failed");
-                    } else {
-                        printf("Excluded file copied successfully\n");
-                        logMessage(LOG_INFO, "Excluded file copied successfully");
-                    }
-                }
-                
-                // 更新进度显示
-                printf("Progress: %d/%d files processed (%d excluded)\n\n", processedFiles - excludedFiles, totalFiles - excludedFiles, excludedFiles);
-                logMessage(LOG_INFO, "Progress: %d/%d files processed (%d excluded)", processedFiles - excludedFiles, totalFiles - excludedFiles, excludedFiles);
-                
-                current = current->next;
-                continue;
+    // 参数以 '\0' 分隔存放在 argBuffer（批处理时为 batchArguments）中，启动前再组装 argv
+    // 批处理的参数个数取决于文件数，超出栈上数组时临时分配
+    char* stackArgv[MAX_COMMAND_ARGS + 1];
+    char** argv = stackArgv;
+    if (job->argCount > MAX_COMMAND_ARGS) {
+        argv = (char**)malloc(sizeof(char*) * (size_t)(job->argCount + 1));
+        if (argv == NULL) {
+            logMessage(LOG_ERROR, "Out of memory while starting command for file: %s", job->inputPath);
+            return -1;
+        }
+    }
+    char* current = (job->batchArguments != NULL) ? job->batchArguments : job->argBuffer;
+    for (int i = 0; i < job->argCount; i++) {
+        argv[i] = current;
+        current += strlen(current) + 1;
+    }
+    argv[job->argCount] = NULL;
+    int result = startProcess(argv, handle, startFlags);
+    if (argv != stackArgv) {
+        free(argv);
+    }
+    return result;
+}
+
+// 辅助函数：单文件任务的展开命令占用的字节数（含结尾的 '\0'）
+static size_t singleCommandLength(const RunningJob* job, int useShell) {
+    if (useShell) {
+        return strlen(job->command) + 1;
+    }
+    size_t length = 0;
+    const char* current = job->argBuffer;
+    for (int i = 0; i < job->argCount; i++) {
+        size_t argumentLength = strlen(current) + 1;
+        length += argumentLength;
+        current += argumentLength;
+    }
+    return length;
+}
+
+// 辅助函数：把已生成单文件命令的任务加入正在收集的批处理，fileContext 为该文件的展开上下文
+// 返回 0 表示已加入；1 表示与当前批处理的输出目录不同，或会超出文件数、命令行长度上限，调用方应先启动当前批处理；内存不足返回 -1
+static int addToBatch(OpenBatch* batch, const RunningJob* job, const TemplateContext* fileContext, const CommandTemplate* commandTemplate, const ProcessOptions* options) {
+    if (batch->count > 0) {
+        // 只有输出目录相同的文件才能合并，%d 和 %o 才能对整批文件都成立
+        if (strcmp(batch->context.outputDir, fileContext->outputDir) != 0) {
+            return 1;
+        }
+        size_t itemLength = measureInputItem(commandTemplate, &batch->context, job->inputPath);
+        if (batch->count >= options->batchSize || batch->commandLength + itemLength > (size_t)options->maxCommandLength) {
+            return 1;
+        }
+        batch->commandLength += itemLength;
+    } else {
+        if (batch->files == NULL) {
+            batch->files = (BatchFile*)malloc(sizeof(BatchFile) * (size_t)options->batchSize);
+            if (batch->files == NULL) {
+                logMessage(LOG_ERROR, "Out of memory while collecting batch: %s", job->inputPath);
+                return -1;
             }
-            
-            // 更新进度显示
-            printf("Processing file %d/%d: %s\n", processedFiles - excludedFiles, totalFiles - excludedFiles, current->path);
-            logMessage(LOG_INFO, "Processing file %d/%d: %s", processedFiles - excludedFiles, totalFiles - excludedFiles, current->path);
-            
-            // 计算相对路径
-            const char* relativePath = current->path + strlen(inputPath);
-            
-            // 获取输出目录路径
-            char outputDir[MAX_PATH_LENGTH];
-            snprintf(outputDir, MAX_PATH_LENGTH, "%s%s", outputPath, relativePath);
-            
-            // 移除文件名，只保留目录部分
-            char* lastBackslash = strrchr(outputDir, '\\');
-            if (lastBackslash != NULL) {
-                *lastBackslash = '\0';
+        }
+        batch->commandLength = singleCommandLength(job, options->useShell);
+    }
+    
+    BatchFile* file = &batch->files[batch->count++];
+    strcpy(file->inputPath, job->inputPath);
+    file->size = job->size;
+    file->mtime = job->mtime;
+    
+    // 上下文中的值指向第一个文件的路径，文件列表在批处理启动前不会移动
+    if (batch->count == 1) {
+        setTemplateContext(&batch->context, batch->files[0].inputPath, strlen(options->inputPath), options->outputPath);
+    }
+    return 0;
+}
+
+// 辅助函数：查找输出目录相同、正在收集文件的批处理；没有时返回一个空的批处理，全部都在收集文件时返回 NULL
+static OpenBatch* findBatch(OpenBatch* batches, const char* outputDir) {
+    OpenBatch* empty = NULL;
+    for (int i = 0; i < MAX_OPEN_BATCHES; i++) {
+        if (batches[i].count == 0) {
+            if (empty == NULL) {
+                empty = &batches[i];
             }
-            
-            // 获取不带扩展名的文件名
-            char* filenameWithoutExt = getFileNameWithoutExtension(current->path);
-            
-            // 构建命令
-            char finalCommand[MAX_COMMAND_LENGTH * 2];
-            char escapedInputPath[MAX_PATH_LENGTH * 2];
-            char escapedOutputDir[MAX_PATH_LENGTH * 2];
-            
-            // 转义路径中的空格和特殊字符
-            strcpy(escapedInputPath, "\"");
-            strcat(escapedInputPath, current->path);
-            strcat(escapedInputPath, "\"");
-            
-            strcpy(escapedOutputDir, "\"");
-            strcat(escapedOutputDir, outputDir);
-            strcat(escapedOutputDir, "\\");
-            strcat(escapedOutputDir, filenameWithoutExt);
-            strcat(escapedOutputDir, "\"");
-            
-            // 替换命令中的占位符
-            strcpy(finalCommand, command);
-            
-            // 替换 %i 占位符
-            char* inputPlaceholder = strstr(finalCommand, "%i");
-            if (inputPlaceholder != NULL) {
-                size_t prefixLen = inputPlaceholder - finalCommand;
-                char prefix[MAX_COMMAND_LENGTH];
-                strncpy(prefix, finalCommand, prefixLen);
-                prefix[prefixLen] = '\0';
-                
-                size_t suffixLen = strlen(inputPlaceholder + 2);
-                char suffix[MAX_COMMAND_LENGTH];
-                strcpy(suffix, inputPlaceholder + 2);
-                
-                snprintf(finalCommand, MAX_COMMAND_LENGTH * 2, "%s%s%s", prefix, escapedInputPath, suffix);
+        } else if (strcmp(batches[i].context.outputDir, outputDir) == 0) {
+            return &batches[i];
+        }
+    }
+    return empty;
+}
+
+// 辅助函数：选出应启动的批处理：已满的优先；anyBatch 为真时也可以选最久未加入文件的未满批处理；没有时返回 NULL
+static OpenBatch* pickBatch(OpenBatch* batches, int batchSize, int anyBatch) {
+    OpenBatch* oldest = NULL;
+    for (int i = 0; i < MAX_OPEN_BATCHES; i++) {
+        if (batches[i].count >= batchSize) {
+            return &batches[i];
+        }
+        if (batches[i].count > 0 && (oldest == NULL || batches[i].lastAdded < oldest->lastAdded)) {
+            oldest = &batches[i];
+        }
+    }
+    return anyBatch ? oldest : NULL;
+}
+
+// 辅助函数：把收集好的批处理移入任务槽并生成命令，批处理随之清空
+// 只有一个文件时生成普通的单文件任务；返回 -1 表示命令无法生成（文件列表仍交给任务，由调用方按失败处理）
+static int buildBatchJob(OpenBatch* batch, const CommandTemplate* commandTemplate, const ProcessOptions* options, RunningJob* job) {
+    int count = batch->count;
+    batch->count = 0;
+    job->output = NULL;
+    job->placement = -1;
+    
+    if (count == 1) {
+        TemplateContext context;
+        strcpy(job->inputPath, batch->files[0].inputPath);
+        job->size = batch->files[0].size;
+        job->mtime = batch->files[0].mtime;
+        return buildCommand(commandTemplate, options, &context, job);
+    }
+    
+    job->argCount = 0;
+    job->command[0] = '\0';
+    job->outputFile[0] = '\0';
+    job->files = batch->files;
+    job->fileCount = count;
+    job->batchCommand = NULL;
+    job->batchArguments = NULL;
+    batch->files = NULL;
+    
+    strcpy(job->inputPath, job->files[0].inputPath);
+    job->size = 0;
+    job->mtime = 0;
+    for (int i = 0; i < count; i++) {
+        job->size += job->files[i].size;
+    }
+    
+    // 估计长度不会偏小，留出少量余量后一次展开即可
+    size_t capacity = batch->commandLength + 16;
+    const char** inputs = (const char**)malloc(sizeof(const char*) * (size_t)count);
+    char* buffer = (char*)malloc(capacity);
+    if (inputs == NULL || buffer == NULL) {
+        logMessage(LOG_ERROR, "Out of memory while building batch command: %s", job->inputPath);
+        free(inputs);
+        free(buffer);
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        inputs[i] = job->files[i].inputPath;
+    }
+    batch->context.inputs = inputs;
+    batch->context.inputCount = count;
+    int length = expandTemplate(commandTemplate, &batch->context, buffer, capacity);
+    batch->context.inputs = NULL;
+    batch->context.inputCount = 0;
+    free(inputs);
+    if (length < 0) {
+        logMessage(LOG_ERROR, "Batch command too long for %d files starting at: %s", count, job->inputPath);
+        free(buffer);
+        return -1;
+    }
+    
+    if (options->useShell) {
+        job->batchCommand = buffer;
+        return 0;
+    }
+    
+    // 直接执行模式：含 %I 的参数已按文件重复，参数个数随文件数变化
+    job->batchArguments = buffer;
+    for (int i = 0; i < length; i++) {
+        job->argCount += (buffer[i] == '\0');
+    }
+    size_t displaySize = (size_t)length * 3 + 1;
+    job->batchCommand = (char*)malloc(displaySize);
+    if (job->batchCommand == NULL) {
+        logMessage(LOG_ERROR, "Out of memory while building batch command: %s", job->inputPath);
+        return -1;
+    }
+    formatCommandLine(buffer, job->argCount, job->batchCommand, displaySize);
+    return 0;
+}
+
+// 解析复制方式名称（auto/copy/reflink/hardlink/symlink），成功返回 0
+int parseCopyMode(const char* text, CopyMode* mode) {
+    static const char* names[] = { "auto", "copy", "reflink", "hardlink", "symlink" };
+    for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+        if (strcmp(text, names[i]) == 0) {
+            *mode = (CopyMode)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// 后台复制任务
+typedef struct CopyTask {
+    char source[MAX_PATH_LENGTH];
+    char destination[MAX_PATH_LENGTH];
+    int excluded;           // 1 表示被排除的文件，0 表示命令失败后复制的源文件
+} CopyTask;
+
+#define COPY_QUEUE_CAPACITY 1024
+#define MAX_COPY_WORKERS 4
+
+// 后台复制线程池：原样复制的文件交给这些线程处理，主循环不会被大文件阻塞
+typedef struct CopyWorkers {
+    BoundedQueue* queue;
+    PlatformThread* threads[MAX_COPY_WORKERS];
+    int threadCount;
+    CopyMode mode;
+    int verbose;            // 在控制台输出每个成功复制的文件
+    PlatformMutex* mutex;   // 保护以下计数
+    int copied;
+    int failed;
+} CopyWorkers;
+
+// 辅助函数：执行一个复制任务并输出结果
+static void runCopyTask(CopyWorkers* workers, const CopyTask* task) {
+    int success = copyFileWithPath(task->source, task->destination, workers->mode);
+    if (task->excluded) {
+        if (success) {
+            if (workers->verbose) {
+                printAboveProgress("Excluded file copied successfully: %s\n", task->destination);
             }
-            
-            // 替换 %o 占位符
-            char* outputPlaceholder = strstr(finalCommand, "%o");
-            if (outputPlaceholder != NULL) {
-                size_t prefixLen = outputPlaceholder - finalCommand;
-                char prefix[MAX_COMMAND_LENGTH];
-                strncpy(prefix, finalCommand, prefixLen);
-                prefix[prefixLen] = '\0';
-                
-                size_t suffixLen = strlen(outputPlaceholder + 2);
-                char suffix[MAX_COMMAND_LENGTH];
-                strcpy(suffix, outputPlaceholder + 2);
-                
-                snprintf(finalCommand, MAX_COMMAND_LENGTH * 2, "%s%s%s", prefix, escapedOutputDir, suffix);
+            logMessage(LOG_INFO, "Excluded file copied successfully: %s", task->destination);
+        } else {
+            printAboveProgress("Copying excluded file failed: %s\n", task->source);
+            logMessage(LOG_ERROR, "Copying excluded file failed: %s", task->source);
+        }
+    } else {
+        if (success) {
+            if (workers->verbose) {
+                printAboveProgress("Source file copied successfully: %s\n", task->destination);
             }
-            
-            printf("Executing: %s\n", finalCommand);
-            logMessage(LOG_INFO, "Executing: %s", finalCommand);
-            
-            // 执行命令
-            int result;
-            
-            #ifdef _WIN32
-            // 在Windows上，使用宽字符API执行命令以确保UTF-8路径正确传递
-            wchar_t wcommand[MAX_COMMAND_LENGTH * 2];
-            int wlen = MultiByteToWideChar(CP_UTF8, 0, finalCommand, -1, wcommand, MAX_COMMAND_LENGTH * 2);
-            if (wlen > 0) {
-                result = _wsystem(wcommand);
-            } else {
-                result = system(finalCommand);
+            logMessage(LOG_INFO, "Source file copied successfully: %s", task->destination);
+        } else {
+            printAboveProgress("Copying source file also failed: %s\n", task->source);
+            logMessage(LOG_ERROR, "Copying source file also failed: %s", task->source);
+        }
+    }
+    
+    if (workers->mutex != NULL) {
+        lockMutex(workers->mutex);
+    }
+    if (success) {
+        workers->copied++;
+    } else {
+        workers->failed++;
+    }
+    if (workers->mutex != NULL) {
+        unlockMutex(workers->mutex);
+    }
+}
+
+// 辅助函数：复制线程主函数，取出任务直到队列关闭
+static void copyWorkerMain(void* argument) {
+    CopyWorkers* workers = (CopyWorkers*)argument;
+    void* item;
+    while (queuePop(workers->queue, &item, -1) > 0) {
+        runCopyTask(workers, (CopyTask*)item);
+        free(item);
+    }
+}
+
+// 辅助函数：启动复制线程池，无法创建线程时返回的线程池以同步方式复制
+static CopyWorkers* startCopyWorkers(CopyMode mode, int threadCount, int verbose) {
+    CopyWorkers* workers = (CopyWorkers*)calloc(1, sizeof(CopyWorkers));
+    if (workers == NULL) {
+        return NULL;
+    }
+    workers->mode = mode;
+    workers->verbose = verbose;
+    workers->mutex = createMutex();
+    workers->queue = createQueue(COPY_QUEUE_CAPACITY);
+    if (workers->mutex == NULL || workers->queue == NULL) {
+        return workers;
+    }
+    
+    if (threadCount > MAX_COPY_WORKERS) {
+        threadCount = MAX_COPY_WORKERS;
+    }
+    for (int i = 0; i < threadCount; i++) {
+        workers->threads[workers->threadCount] = startThread(copyWorkerMain, workers);
+        if (workers->threads[workers->threadCount] != NULL) {
+            workers->threadCount++;
+        }
+    }
+    return workers;
+}
+
+// 辅助函数：提交复制任务，队列已满时等待；没有复制线程时直接复制
+static void queueCopy(CopyWorkers* workers, const char* source, const char* destination, int excluded) {
+    CopyTask* task = (CopyTask*)malloc(sizeof(CopyTask));
+    if (task == NULL) {
+        logMessage(LOG_ERROR, "Out of memory while copying %s", source);
+        return;
+    }
+    snprintf(task->source, MAX_PATH_LENGTH, "%s", source);
+    snprintf(task->destination, MAX_PATH_LENGTH, "%s", destination);
+    task->excluded = excluded;
+    
+    if (workers->threadCount == 0 || queuePush(workers->queue, task) != 0) {
+        runCopyTask(workers, task);
+        free(task);
+    }
+}
+
+// 辅助函数：等待所有复制任务完成并释放线程池
+static void finishCopyWorkers(CopyWorkers* workers) {
+    if (workers->queue != NULL) {
+        closeQueue(workers->queue);
+    }
+    for (int i = 0; i < workers->threadCount; i++) {
+        joinThread(workers->threads[i]);
+    }
+    
+    if (workers->copied + workers->failed > 0) {
+        printf("%d files copied unchanged (%d failed)\n", workers->copied, workers->failed);
+        logMessage(LOG_INFO, "%d files copied unchanged (%d failed)", workers->copied, workers->failed);
+    }
+    
+    if (workers->queue != NULL) {
+        destroyQueue(workers->queue);
+    }
+    if (workers->mutex != NULL) {
+        destroyMutex(workers->mutex);
+    }
+    free(workers);
+}
+
+// 一次运行中各任务共享的状态
+typedef struct RunContext {
+    const ProcessOptions* options;
+    Manifest* manifest;         // 增量模式的清单（未启用时为 NULL）
+    CopyWorkers* copyWorkers;   // 后台复制线程（未启用复制时为 NULL）
+    RunReport* report;          // 运行报告（未启用时为 NULL）
+    OutputCapture* capture;     // 子进程输出的捕获设置（子进程继承控制台时为 NULL）
+    CpuPlacement* placement;    // 子进程的 CPU 绑定（未启用时为 NULL）
+    RunningJob* jobs;           // 运行中的任务，与 waitForAnyCommand 的句柄数组一一对应
+    const CommandTemplate* commandTemplate; // 用于为批处理中的文件逐个生成命令
+    JobSource* source;          // 任务来源，任务最终结束时通知其 finish（协调者模式下向协调者汇报结果）
+    ProgressCounts* progress;   // 进度计数，批处理中无法单独生成命令的文件在拆分或记录结果时直接计为失败
+} RunContext;
+
+// 等待重试的失败任务（数量通常很少，线性查找即可）
+typedef struct RetryList {
+    RunningJob* jobs;
+    int count;
+    int capacity;
+} RetryList;
+
+static void finishBatch(const RunningJob* job, int result, const ProcessStats* stats, const RunContext* run);
+
+// 处理已结束的任务：记录结果，并在需要时复制源文件
+// stats 为 NULL 表示任务未能启动；retrying 为真时任务稍后重试，只记录这次失败
+static void finishJob(const RunningJob* job, int result, const ProcessStats* stats, const RunContext* run, int retrying) {
+    const ProcessOptions* options = run->options;
+    if (job->files != NULL) {
+        finishBatch(job, result, stats, run);
+        return;
+    }
+    
+    if (run->report != NULL && !retrying) {
+        const char* relativePath = job->inputPath + strlen(options->inputPath);
+        while (*relativePath == '/' || *relativePath == '\\') {
+            relativePath++;
+        }
+        long long outputBytes = 0;
+        if (result == 0 && job->outputFile[0] != '\0') {
+            getFileInfo(job->outputFile, &outputBytes, NULL);
+        }
+        long long wallTimeMs = stats != NULL ? getMonotonicTime() - job->startTime : 0;
+        if (addJobRecord(run->report, relativePath, result, job->size, outputBytes, wallTimeMs, stats) != 0) {
+            logMessage(LOG_ERROR, "Out of memory while recording job: %s", job->inputPath);
+        }
+    }
+    
+    int verbose = (options->verbosity == VERBOSITY_VERBOSE);
+    if (result != 0 && retrying) {
+        printAboveProgress("Error: Command execution failed (code: %d, attempt %d of %d), will retry: %s\n", result, job->attempt, options->retries + 1, job->inputPath);
+        logMessage(LOG_WARNING, "Command execution failed (code: %d, attempt %d of %d), will retry: %s", result, job->attempt, options->retries + 1, job->inputPath);
+    } else if (result != 0) {
+        printAboveProgress("Error: Command execution failed (code: %d): %s\n", result, job->inputPath);
+        logMessage(LOG_ERROR, "Command execution failed (code: %d): %s", result, job->inputPath);
+    }
+    
+    if (result != 0) {        
+        // 捕获了输出时把最后几行附在 error.log 的错误记录之后
+        char tail[2048];
+        tail[0] = '\0';
+        if (job->output != NULL) {
+            getOutputTail(run->capture, job->output, tail, sizeof(tail));
+        }
+        logCommandError(getJobCommand(job), job->inputPath, result, job->attempt, options->retries + 1, tail);
+        
+        // 如果启用了命令失败时复制源文件的功能
+        if (options->copyOnError && !retrying) {
+            if (verbose) {
+                printf("Attempting to copy source file...\n");
             }
-            #else
-            result = system(finalCommand);
-            #endif
+            logMessage(LOG_INFO, "Attempting to copy source file");
             
-            if (result != 0) {
-                printf("Error: Command execution failed (code: %d)\n", result);
-                logMessage(LOG_ERROR, "Command execution failed (code: %d)", result);
-                logCommandError(finalCommand, current->path, result);
-                
-                // 如果启用了命令失败时复制源文件的功能
-                if (copyOnError) {
-                    printf("Attempting to copy source file...\n");
-                    logMessage(LOG_INFO, "Attempting to copy source file");
-                    
-                    // 构建目标文件路径
-                    char targetPath[MAX_PATH_LENGTH];
-                    snprintf(targetPath, MAX_PATH_LENGTH, "%s%s", outputPath, relativePath);
-                    
-                    // 复制源文件到目标路径
-                    if (!copyFileWithPath(current->path, targetPath)) {
-                        printf("Copying source file also failed\n");
-                        logMessage(LOG_ERROR, "Copying source file also failed");
-                    } else {
-                        logMessage(LOG_INFO, "Source file copied successfully");
-                    }
-                }
-            } else {
-                printf("Command executed successfully\n");
-                logMessage(LOG_INFO, "Command executed successfully");
-            }
+            // 构建目标文件路径
+            const char* relativePath = job->inputPath + strlen(options->inputPath);
+            char targetPath[MAX_PATH_LENGTH];
+            snprintf(targetPath, MAX_PATH_LENGTH, "%s%s", options->outputPath, relativePath);
             
-            // 更新进度显示
-            printf("Progress: %d/%d files processed (%d excluded)\n\n", processedFiles - excludedFiles, totalFiles - excludedFiles, excludedFiles);
-            logMessage(LOG_INFO, "Progress: %d/%d files processed (%d excluded)", processedFiles - excludedFiles, totalFiles - excludedFiles, excludedFiles);
+            // 复制源文件到目标路径（由后台复制线程完成）
+            queueCopy(run->copyWorkers, job->inputPath, targetPath, 0);
+        }
+    } else {
+        if (verbose) {
+            printf("Command executed successfully: %s\n", job->inputPath);
         }
+        logMessage(LOG_INFO, "Command executed successfully: %s", job->inputPath);
         
-        current = current->next;
+        // 增量模式下记录成功的文件，下次运行时可以跳过
+        if (run->manifest != NULL) {
+            recordManifestEntry(run->manifest, job->inputPath + strlen(options->inputPath), job->size, job->mtime, hashString(job->command));
+        }
+    }
+    
+    if (job->output != NULL) {
+        const char* logPath = endJobOutput(run->capture, job->output, result != 0);
+        // 重试时日志文件会被下一次尝试覆盖，只提示最后一次
+        if (logPath != NULL && result != 0 && !retrying) {
+            printAboveProgress("Command output saved to %s\n", logPath);
+            logMessage(LOG_INFO, "Command output saved to %s", logPath);
+        }
+    }
+    
+    // 最终结果交给任务来源（工作者模式下汇报给协调者）
+    if (run->source->finish != NULL && !retrying) {
+        run->source->finish(run->source, job->inputPath, result);
     }
 }
 
-// 释放文件列表内存
-void freeFileList(FileEntry* list) {
-    FileEntry* current = list;
-    while (current != NULL) {
-        FileEntry* next = current->next;
-        free(current);
-        current = next;
+// 辅助函数：为批处理中的一个文件生成单独处理时的任务（用于逐个记录结果，或批处理失败后逐个重新运行）
+static int makeSingleJob(const BatchFile* file, const RunContext* run, RunningJob* single) {
+    TemplateContext context;
+    strcpy(single->inputPath, file->inputPath);
+    single->size = file->size;
+    single->mtime = file->mtime;
+    single->output = NULL;
+    single->placement = -1;
+    single->attempt = 1;
+    single->killTime = 0;
+    single->killForced = 0;
+    return buildCommand(run->commandTemplate, run->options, &context, single);
+}
+
+// 辅助函数：批处理中的文件无法单独生成命令：按命令无法生成的失败记录结果（写入 error.log），不重试
+static void failSingleJob(RunningJob* single, const RunContext* run) {
+    single->startTime = getMonotonicTime();
+    finishJob(single, -1, NULL, run, 0);
+}
+
+// 辅助函数：批处理最终结束：逐个文件记录结果（运行时间和 CPU 时间按文件数平均分摊），再处理整批的输出
+// 清单中记录的是单独处理该文件时的命令，因此是否批处理不影响增量模式的判断
+static void finishBatch(const RunningJob* job, int result, const ProcessStats* stats, const RunContext* run) {
+    long long now = getMonotonicTime();
+    long long share = (now - job->startTime) / job->fileCount;
+    ProcessStats fileStats;
+    if (stats != NULL) {
+        fileStats = *stats;
+        fileStats.userTimeMs /= job->fileCount;
+        fileStats.systemTimeMs /= job->fileCount;
     }
+    
+    for (int i = 0; i < job->fileCount; i++) {
+        RunningJob single;
+        if (makeSingleJob(&job->files[i], run, &single) != 0) {
+            // 调用方按整批的结果计数，批处理成功时这个文件另计为失败
+            if (result == 0) {
+                run->progress->failed++;
+            }
+            failSingleJob(&single, run);
+            continue;
+        }
+        single.startTime = now - share;
+        single.attempt = job->attempt;
+        finishJob(&single, result, stats != NULL ? &fileStats : NULL, run, 0);
+    }
+    
+    if (job->output != NULL) {
+        const char* logPath = endJobOutput(run->capture, job->output, result != 0);
+        if (logPath != NULL && result != 0) {
+            printAboveProgress("Command output saved to %s\n", logPath);
+            logMessage(LOG_INFO, "Command output saved to %s", logPath);
+        }
+    }
+}
+
+// 辅助函数：批处理失败后把其中的文件逐个放入重试列表立即重新运行，以便确定是哪个文件失败并按文件复制源文件
+// 内存不足时返回 -1（不拆分）
+static int splitBatch(const RunningJob* job, const RunContext* run, RetryList* retries) {
+    int needed = retries->count + job->fileCount;
+    if (needed > retries->capacity) {
+        int capacity = retries->capacity * 2 > needed ? retries->capacity * 2 : needed;
+        RunningJob* grown = (RunningJob*)realloc(retries->jobs, sizeof(RunningJob) * (size_t)capacity);
+        if (grown == NULL) {
+            logMessage(LOG_ERROR, "Out of memory while splitting failed batch: %s", job->inputPath);
+            return -1;
+        }
+        retries->jobs = grown;
+        retries->capacity = capacity;
+    }
+    
+    long long now = getMonotonicTime();
+    for (int i = 0; i < job->fileCount; i++) {
+        RunningJob* single = &retries->jobs[retries->count];
+        if (makeSingleJob(&job->files[i], run, single) != 0) {
+            // 不放入重试列表，直接作为最终失败结束
+            run->progress->completed++;
+            run->progress->failed++;
+            failSingleJob(single, run);
+            continue;
+        }
+        single->retryAt = now;
+        retries->count++;
+    }
+    return 0;
+}
+
+// 辅助函数：waitForAnyCommand 读到子进程输出时调用，交给对应任务的输出缓冲区
+static void onJobOutput(void* userData, int index, const char* data, size_t length) {
+    RunContext* run = (RunContext*)userData;
+    RunningJob* job = &run->jobs[index];
+    job->lastActivity = getMonotonicTime();
+    if (job->output != NULL) {
+        appendJobOutput(run->capture, job->output, data, length);
+    }
+}
+
+// 辅助函数：启动任务的一次尝试（首次运行或重试），失败返回 -1
+static int launchAttempt(RunningJob* job, ProcessHandle* handle, const RunContext* run) {
+    job->startTime = getMonotonicTime();
+    job->lastActivity = job->startTime;
+    job->lastOutputSize = -1;
+    job->lastStallCheck = job->startTime;
+    job->killTime = 0;
+    job->killForced = 0;
+    job->placement = run->placement != NULL ? acquirePlacement(run->placement) : -1;
+    job->output = run->capture != NULL ? beginJobOutput(run->capture, job->inputPath + strlen(run->options->inputPath)) : NULL;
+    
+    // 子进程启动时已继承绑定，随即恢复调度线程自己的亲和性，避免它与子进程挤在同一组 CPU 上
+    int started = startJob(job, run->options, handle);
+    if (job->placement >= 0) {
+        setChildAffinity(NULL, 0);
+    }
+    return started != 0 ? -1 : 0;
+}
+
+// 辅助函数：一次尝试结束（或未能启动）：失败且还有重试次数时放入重试列表，否则记录最终结果
+// 失败的批处理不整体重试，而是拆成单个文件重新运行（各文件再按重试次数重试）
+// 返回最终结束的文件数，0 表示稍后重试
+static int endAttempt(RunningJob* job, int result, const ProcessStats* stats, const RunContext* run, RetryList* retries) {
+    const ProcessOptions* options = run->options;
+    if (run->placement != NULL) {
+        releasePlacement(run->placement, job->placement);
+    }
+    
+    if (job->files != NULL) {
+        int fileCount = job->fileCount;
+        if (result != 0 && splitBatch(job, run, retries) == 0) {
+            if (options->verbosity == VERBOSITY_VERBOSE) {
+                printf("Batch of %d files failed (code: %d), running them one by one: %s ...\n", fileCount, result, job->inputPath);
+            }
+            logMessage(LOG_WARNING, "Batch of %d files failed (code: %d), running them one by one: %s ...", fileCount, result, job->inputPath);
+            if (job->output != NULL) {
+                endJobOutput(run->capture, job->output, 0);
+            }
+            releaseJob(job);
+            return 0;
+        }
+        finishJob(job, result, stats, run, 0);
+        releaseJob(job);
+        return fileCount;
+    }
+    
+    // 重试前确保重试列表有空间，之后加入时不会失败
+    int retrying = (result != 0 && job->attempt <= options->retries);
+    if (retrying && retries->count == retries->capacity) {
+        int capacity = retries->capacity > 0 ? retries->capacity * 2 : 8;
+        RunningJob* grown = (RunningJob*)realloc(retries->jobs, sizeof(RunningJob) * (size_t)capacity);
+        if (grown == NULL) {
+            logMessage(LOG_ERROR, "Out of memory while scheduling retry: %s", job->inputPath);
+            retrying = 0;
+        } else {
+            retries->jobs = grown;
+            retries->capacity = capacity;
+        }
+    }
+    
+    finishJob(job, result, stats, run, retrying);
+    if (!retrying) {
+        return 1;
+    }
+    
+    // 指数退避：retryDelayMs、2 倍、4 倍……不超过 MAX_RETRY_DELAY_MS
+    long long delay = options->retryDelayMs;
+    for (int i = 1; i < job->attempt && delay < MAX_RETRY_DELAY_MS; i++) {
+        delay *= 2;
+    }
+    if (delay > MAX_RETRY_DELAY_MS) {
+        delay = MAX_RETRY_DELAY_MS;
+    }
+    
+    RunningJob* pending = &retries->jobs[retries->count++];
+    *pending = *job;
+    pending->attempt++;
+    pending->output = NULL;
+    pending->retryAt = getMonotonicTime() + delay;
+    logMessage(LOG_INFO, "Retrying in %lld ms: %s", delay, job->inputPath);
+    return 0;
+}
+
+// 辅助函数：启动收集好的批处理，返回 1 表示任务已在运行；未能启动时记录结果并返回 0
+static int launchBatch(OpenBatch* batch, RunningJob* job, ProcessHandle* handle, const RunContext* run, RetryList* retries, ProgressCounts* progress) {
+    int count = batch->count;
+    int built = buildBatchJob(batch, run->commandTemplate, run->options, job);
+    int verbose = (run->options->verbosity == VERBOSITY_VERBOSE);
+    job->attempt = 1;
+    
+    // 只有一个文件时命令无法生成不重试，与未批处理时相同
+    if (built != 0 && job->files == NULL) {
+        job->startTime = getMonotonicTime();
+        progress->completed++;
+        progress->failed++;
+        finishJob(job, -1, NULL, run, 0);
+        return 0;
+    }
+    
+    if (built == 0) {
+        if (count > 1) {
+            if (verbose) {
+                printf("Executing (%d files): %s\n", count, getJobCommand(job));
+            }
+            logMessage(LOG_INFO, "Executing (%d files): %s", count, getJobCommand(job));
+        } else {
+            if (verbose) {
+                printf("Executing: %s\n", job->command);
+            }
+            logMessage(LOG_INFO, "Executing: %s", job->command);
+        }
+        if (launchAttempt(job, handle, run) == 0) {
+            return 1;
+        }
+    } else {
+        job->startTime = getMonotonicTime();
+    }
+    
+    int finished = endAttempt(job, -1, NULL, run, retries);
+    progress->completed += finished;
+    progress->failed += finished;
+    return 0;
+}
+
+// 辅助函数：取出一个已到重试时间的任务，没有时返回 0
+static int takeReadyRetry(RetryList* retries, long long now, RunningJob* job) {
+    for (int i = 0; i < retries->count; i++) {
+        if (retries->jobs[i].retryAt <= now) {
+            *job = retries->jobs[i];
+            retries->jobs[i] = retries->jobs[--retries->count];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 辅助函数：距最早的重试还有多少毫秒（没有等待重试的任务时返回 -1）
+static int nextRetryDelay(const RetryList* retries, long long now) {
+    long long earliest = LLONG_MAX;
+    for (int i = 0; i < retries->count; i++) {
+        if (retries->jobs[i].retryAt < earliest) {
+            earliest = retries->jobs[i].retryAt;
+        }
+    }
+    if (earliest == LLONG_MAX) {
+        return -1;
+    }
+    return earliest <= now ? 0 : (int)(earliest - now);
+}
+
+// 辅助函数：取两个等待时间中较短的一个（-1 表示无限等待）
+static int shorterTimeout(int first, int second) {
+    if (first < 0) {
+        return second;
+    }
+    if (second < 0) {
+        return first;
+    }
+    return first < second ? first : second;
+}
+
+// 辅助函数：结束超过运行时间或长时间没有输出的任务（先请求结束，宽限期后强制结束）
+// 返回距下一次需要检查的毫秒数（-1 表示没有需要定时检查的任务）
+static int checkJobDeadlines(RunningJob* jobs, ProcessHandle* handles, int count, const ProcessOptions* options, long long now) {
+    if (options->timeoutMs <= 0 && options->stallTimeoutMs <= 0) {
+        return -1;
+    }
+    
+    long long next = LLONG_MAX;
+    for (int i = 0; i < count; i++) {
+        RunningJob* job = &jobs[i];
+        if (job->killTime != 0) {
+            if (!job->killForced && now - job->killTime >= KILL_GRACE_MS) {
+                logMessage(LOG_WARNING, "Command did not exit after %d ms, killing it: %s", KILL_GRACE_MS, job->inputPath);
+                terminateProcessTree(&handles[i], 1);
+                job->killForced = 1;
+            } else if (!job->killForced && job->killTime + KILL_GRACE_MS < next) {
+                next = job->killTime + KILL_GRACE_MS;
+            }
+            continue;
+        }
+        
+        // 批处理的运行时间上限按文件数放大，--timeout 始终是单个文件的上限
+        int timedOut = 0;
+        int stalled = 0;
+        long long timeoutMs = options->timeoutMs * (job->fileCount > 0 ? job->fileCount : 1);
+        if (options->timeoutMs > 0) {
+            if (now - job->startTime >= timeoutMs) {
+                timedOut = 1;
+            } else if (job->startTime + timeoutMs < next) {
+                next = job->startTime + timeoutMs;
+            }
+        }
+        
+        // 没有捕获输出（或工具只写输出文件）时以输出文件的增长作为进展
+        if (!timedOut && options->stallTimeoutMs > 0) {
+            if (job->outputFile[0] != '\0' && now - job->lastStallCheck >= STALL_CHECK_INTERVAL_MS) {
+                long long size = 0;
+                job->lastStallCheck = now;
+                if (getFileInfo(job->outputFile, &size, NULL) == 0 && size != job->lastOutputSize) {
+                    job->lastOutputSize = size;
+                    job->lastActivity = now;
+                }
+            }
+            if (now - job->lastActivity >= options->stallTimeoutMs) {
+                stalled = 1;
+            } else {
+                long long check = job->lastActivity + options->stallTimeoutMs;
+                if (job->outputFile[0] != '\0' && job->lastStallCheck + STALL_CHECK_INTERVAL_MS < check) {
+                    check = job->lastStallCheck + STALL_CHECK_INTERVAL_MS;
+                }
+                if (check < next) {
+                    next = check;
+                }
+            }
+        }
+        
+        if (timedOut) {
+            printAboveProgress("Error: Command timed out after %lld ms, terminating: %s\n", timeoutMs, job->inputPath);
+            logMessage(LOG_ERROR, "Command timed out after %lld ms, terminating process tree: %s", timeoutMs, job->inputPath);
+        } else if (stalled) {
+            printAboveProgress("Error: Command made no progress for %lld ms, terminating: %s\n", options->stallTimeoutMs, job->inputPath);
+            logMessage(LOG_ERROR, "Command made no progress for %lld ms, terminating process tree: %s", options->stallTimeoutMs, job->inputPath);
+        }
+        if (timedOut || stalled) {
+            terminateProcessTree(&handles[i], 0);
+            job->killTime = now;
+            if (now + KILL_GRACE_MS < next) {
+                next = now + KILL_GRACE_MS;
+            }
+        }
+    }
+    
+    if (next == LLONG_MAX) {
+        return -1;
+    }
+    return next <= now ? 0 : (int)(next - now);
+}
+
+// 辅助函数：格式化文件总数，扫描未结束时标注为“目前已发现”
+static void formatTotal(char* buffer, size_t bufferSize, int total, int complete) {
+    if (complete) {
+        snprintf(buffer, bufferSize, "%d", total);
+    } else {
+        snprintf(buffer, bufferSize, "%d+ (discovered so far)", total);
+    }
+}
+
+// 辅助函数：记录进度，详细模式下同时打印（其他模式由状态行显示）
+static void reportProgress(JobSource* source, const ProgressCounts* progress, int verbose) {
+    int complete = 0;
+    int totalFiles = source->total(source, &complete);
+    char totalText[64];
+    formatTotal(totalText, sizeof(totalText), totalFiles - progress->excluded - progress->upToDate, complete);
+    
+    if (progress->upToDate > 0) {
+        if (verbose) {
+            printf("Progress: %d/%s files processed (%d excluded, %d up to date)\n\n", progress->completed, totalText, progress->excluded, progress->upToDate);
+        }
+        logMessage(LOG_INFO, "Progress: %d/%s files processed (%d excluded, %d up to date)", progress->completed, totalText, progress->excluded, progress->upToDate);
+    } else {
+        if (verbose) {
+            printf("Progress: %d/%s files processed (%d excluded)\n\n", progress->completed, totalText, progress->excluded);
+        }
+        logMessage(LOG_INFO, "Progress: %d/%s files processed (%d excluded)", progress->completed, totalText, progress->excluded);
+    }
+}
+
+// 辅助函数：刷新状态行（距上次绘制不足刷新间隔时不输出）
+static void refreshStatus(JobSource* source, ProgressCounts* progress, int runningJobs) {
+    progress->running = runningJobs;
+    progress->total = source->total(source, &progress->totalComplete);
+    updateProgress(progress, 0);
+}
+
+// 处理文件
+// 任务从 source 中逐个取出：来源可以是完整的扫描结果，也可以是仍在进行的流式扫描
+// 返回最终失败的文件数，无法开始处理时返回 -1
+int processFiles(JobSource* source, const ProcessOptions* options) {
+    int maxJobs = options->maxJobs;
+    if (maxJobs < 1) {
+        maxJobs = 1;
+    } else if (maxJobs > MAX_PARALLEL_JOBS) {
+        maxJobs = MAX_PARALLEL_JOBS;
+    }
+    
+    // 运行中的任务与其进程句柄分别存放，便于一次等待所有句柄
+    RunningJob* jobs = (RunningJob*)malloc(sizeof(RunningJob) * maxJobs);
+    ProcessHandle* handles = (ProcessHandle*)malloc(sizeof(ProcessHandle) * maxJobs);
+    if (jobs == NULL || handles == NULL) {
+        printf("Error: Out of memory\n");
+        logMessage(LOG_ERROR, "Cannot allocate job table for %d jobs", maxJobs);
+        free(jobs);
+        free(handles);
+        return -1;
+    }
+    int runningJobs = 0;
+    
+    // 当前处理进度
+    // 任务可能乱序结束，因此启动计数与完成计数分开统计
+    int visitedFiles = 0;
+    int startedFiles = 0;
+    ProgressCounts progress;
+    memset(&progress, 0, sizeof(progress));
+    int verbose = (options->verbosity == VERBOSITY_VERBOSE);
+    int exhausted = 0;
+    RetryList retries;
+    memset(&retries, 0, sizeof(retries));
+    
+    // 命令模板只编译一次，之后每个文件单次遍历展开
+    CommandTemplate commandTemplate;
+    if (compileTemplate(options->command, options->useShell, &commandTemplate) < 0 || commandTemplate.argumentCount > MAX_COMMAND_ARGS) {
+        printf("Error: Command template has too many arguments or is too long\n");
+        logMessage(LOG_ERROR, "Cannot compile command template: %s", options->command);
+        freeTemplate(&commandTemplate);
+        free(jobs);
+        free(handles);
+        return -1;
+    }
+    TemplateContext context;
+    
+    // 增量模式：读取输出目录中的清单
+    Manifest* manifest = NULL;
+    if (options->incremental) {
+        manifest = openManifest(options->outputPath);
+        if (manifest == NULL) {
+            logMessage(LOG_ERROR, "Cannot open manifest, incremental mode disabled");
+        }
+    }
+    
+    // 原样复制文件时使用后台复制线程，与命令执行并行进行
+    CopyWorkers* copyWorkers = NULL;
+    if (options->copyOnError) {
+        copyWorkers = startCopyWorkers(options->copyMode, maxJobs, options->verbosity == VERBOSITY_VERBOSE);
+        if (copyWorkers == NULL) {
+            printf("Error: Out of memory\n");
+            logMessage(LOG_ERROR, "Cannot start copy workers");
+            closeManifest(manifest);
+            freeTemplate(&commandTemplate);
+            free(jobs);
+            free(handles);
+            return -1;
+        }
+    }
+    
+    // 需要运行报告时收集每个任务的耗时和资源使用情况
+    RunReport* report = NULL;
+    if (options->reportPath != NULL) {
+        report = createReport();
+        if (report == NULL) {
+            logMessage(LOG_ERROR, "Cannot create run report, report disabled");
+        }
+    }
+    
+    // 捕获子进程输出，避免并行任务的输出在控制台上交错，也让控制台输出不拖慢子进程
+    OutputCapture* capture = createOutputCapture(options->captureMode, options->jobLogDirectory, options->errorTailLines);
+    if (capture == NULL && options->captureMode != CAPTURE_NONE) {
+        logMessage(LOG_ERROR, "Cannot allocate output capture, commands write to the console");
+    }
+    
+    RunContext run;
+    run.options = options;
+    run.manifest = manifest;
+    run.copyWorkers = copyWorkers;
+    run.report = report;
+    run.capture = capture;
+    run.placement = NULL;
+    run.jobs = jobs;
+    run.commandTemplate = &commandTemplate;
+    run.source = source;
+    run.progress = &progress;
+    
+    // 调度：自适应并发、子进程优先级和 CPU 绑定
+    AdaptiveLimit* adaptive = NULL;
+    if (options->adaptive) {
+        adaptive = createAdaptiveLimit(maxJobs, options->memoryPerJobKb, options->verbosity);
+        if (adaptive == NULL) {
+            logMessage(LOG_ERROR, "Cannot create adaptive scheduler, running up to %d jobs", maxJobs);
+        }
+    }
+    if (options->niceness != 0) {
+        setChildPriority(options->niceness);
+    }
+    CpuPlacement* placement = createCpuPlacement(options->pinMode);
+    run.placement = placement;
+    int jobLimit = maxJobs;
+    
+    // 普通模式下显示单行状态；没有事件时等到下次应重绘状态行时醒来，以更新速率和剩余时间
+    startProgress(options->verbosity);
+    
+    // 批处理：命令含 %I 时把同一目录中的多个文件合并到一条命令中，每个输出目录各收集一个批处理
+    int batching = (commandTemplate.hasInputList && options->batchSize > 1);
+    OpenBatch batches[MAX_OPEN_BATCHES];
+    memset(batches, 0, sizeof(batches));
+    int openBatches = 0;
+    long long batchedFiles = 0;
+    int flushBatch = 0;
+    if (batching) {
+        if (verbose) {
+            printf("Batching up to %d files per command (command line limit %lld bytes)\n", options->batchSize, options->maxCommandLength);
+        }
+        logMessage(LOG_INFO, "Batching up to %d files per command (command line limit %lld bytes)", options->batchSize, options->maxCommandLength);
+    }
+    
+    while (!exhausted || runningJobs > 0 || retries.count > 0 || openBatches > 0) {
+        refreshStatus(source, &progress, runningJobs);
+        int idleTimeout = getProgressTimeout();
+        if (adaptive != NULL) {
+            jobLimit = updateAdaptiveLimit(adaptive, runningJobs);
+        }
+        
+        // 结束超时或卡住的任务，并记下下一次需要检查的时间
+        long long now = getMonotonicTime();
+        int deadlineTimeout = checkJobDeadlines(jobs, handles, runningJobs, options, now);
+        
+        // 到了重试时间的任务优先于新文件启动
+        if (runningJobs < jobLimit && takeReadyRetry(&retries, now, &jobs[runningJobs])) {
+            RunningJob* job = &jobs[runningJobs];
+            if (job->attempt == 1) {
+                logMessage(LOG_INFO, "Running file separately after its batch failed: %s", job->inputPath);
+            } else {
+                logMessage(LOG_INFO, "Retrying (attempt %d of %d): %s", job->attempt, options->retries + 1, job->inputPath);
+            }
+            if (launchAttempt(job, &handles[runningJobs], &run) != 0) {
+                int finished = endAttempt(job, -1, NULL, &run, &retries);
+                if (finished > 0) {
+                    progress.completed += finished;
+                    progress.failed += finished;
+                    reportProgress(source, &progress, verbose);
+                }
+            } else {
+                runningJobs++;
+            }
+            continue;
+        }
+        int retryTimeout = nextRetryDelay(&retries, now);
+        
+        // 批处理已满时启动；没有更多文件或暂时没有新文件且没有任务在运行时，依次启动未满的批处理
+        OpenBatch* ready = (openBatches > 0 && runningJobs < jobLimit) ? pickBatch(batches, options->batchSize, exhausted || flushBatch) : NULL;
+        if (ready != NULL) {
+            flushBatch = 0;
+            openBatches--;
+            if (launchBatch(ready, &jobs[runningJobs], &handles[runningJobs], &run, &retries, &progress)) {
+                runningJobs++;
+            } else {
+                reportProgress(source, &progress, verbose);
+            }
+            continue;
+        }
+        
+        if (!exhausted && runningJobs < jobLimit) {
+            // 有任务在运行时不在这里等待：暂无新任务时到下面的 waitForAnyCommand 中阻塞，任务来源取得新任务后会唤醒它
+            // 没有任务在运行而批处理未启动时只短暂等待新任务，之后启动未满的批处理
+            FileJob file;
+            int result = source->next(source, &file, runningJobs > 0 ? 0 : (openBatches > 0 ? 10 : shorterTimeout(idleTimeout, retryTimeout)));
+            if (result == 0) {
+                exhausted = 1;
+                continue;
+            }
+            if (result < 0 && runningJobs == 0) {
+                flushBatch = 1;
+            }
+            
+            if (result > 0) {
+                visitedFiles++;
+                
+                int complete = 0;
+                int totalFiles = source->total(source, &complete);
+                char totalText[64];
+                
+                // 检查文件是否应该被排除（扫描时已由过滤器标记）
+                if (file.excluded) {
+                    progress.excluded++;
+                    formatTotal(totalText, sizeof(totalText), totalFiles, complete);
+                    if (verbose) {
+                        printf("Excluding file %d/%s: %s (extension excluded)\n", visitedFiles, totalText, file.path);
+                    }
+                    logMessage(LOG_INFO, "Excluding file %d/%s: %s (extension excluded)", visitedFiles, totalText, file.path);
+                    
+                    // 如果启用了复制功能，复制被排除的文件
+                    if (options->copyOnError) {
+                        // 计算相对路径
+                        const char* relativePath = file.path + strlen(options->inputPath);
+                        
+                        // 构建目标文件路径
+                        char targetPath[MAX_PATH_LENGTH];
+                        snprintf(targetPath, MAX_PATH_LENGTH, "%s%s", options->outputPath, relativePath);
+                        
+                        if (verbose) {
+                            printf("Copying excluded file: %s -> %s\n", file.path, targetPath);
+                        }
+                        logMessage(LOG_INFO, "Copying excluded file: %s -> %s", file.path, targetPath);
+                        
+                        // 复制源文件到目标路径（由后台复制线程完成，不阻塞命令的启动）
+                        queueCopy(copyWorkers, file.path, targetPath, 1);
+                    }
+                    
+                    // 更新进度显示
+                    reportProgress(source, &progress, verbose);
+                    continue;
+                }
+                
+                RunningJob* job = &jobs[runningJobs];
+                strcpy(job->inputPath, file.path);
+                job->size = file.size;
+                job->mtime = file.mtime;
+                int built = buildCommand(&commandTemplate, options, &context, job);
+                
+                // 增量模式：输入和命令均未变化且输出存在时跳过
+                if (built == 0 && manifest != NULL && isJobUpToDate(manifest, job, options)) {
+                    progress.upToDate++;
+                    if (verbose) {
+                        printf("Skipping up-to-date file: %s\n", file.path);
+                    }
+                    logMessage(LOG_INFO, "Skipping up-to-date file: %s", file.path);
+                    continue;
+                }
+                
+                startedFiles++;
+                
+                // 更新进度显示
+                formatTotal(totalText, sizeof(totalText), totalFiles - progress.excluded - progress.upToDate, complete);
+                if (verbose) {
+                    printf("Processing file %d/%s: %s\n", startedFiles, totalText, file.path);
+                }
+                logMessage(LOG_INFO, "Processing file %d/%s: %s", startedFiles, totalText, file.path);
+                
+                // 批处理：加入同一输出目录的批处理，放不下时先启动它；
+                // 新的输出目录没有空闲的批处理时，先启动最久未加入文件的批处理腾出位置
+                if (batching && built == 0) {
+                    RunningJob candidate = *job;
+                    OpenBatch* target = findBatch(batches, context.outputDir);
+                    if (target == NULL) {
+                        target = pickBatch(batches, options->batchSize, 1);
+                    }
+                    int added = addToBatch(target, &candidate, &context, &commandTemplate, options);
+                    if (added > 0) {
+                        openBatches--;
+                        if (launchBatch(target, job, &handles[runningJobs], &run, &retries, &progress)) {
+                            runningJobs++;
+                        }
+                        added = addToBatch(target, &candidate, &context, &commandTemplate, options);
+                    }
+                    if (added == 0) {
+                        if (target->count == 1) {
+                            openBatches++;
+                        }
+                        target->lastAdded = ++batchedFiles;
+                    } else {
+                        candidate.output = NULL;
+                        candidate.startTime = getMonotonicTime();
+                        candidate.attempt = 1;
+                        progress.completed++;
+                        progress.failed++;
+                        finishJob(&candidate, -1, NULL, &run, 0);
+                        reportProgress(source, &progress, verbose);
+                    }
+                    continue;
+                }
+                
+                if (verbose) {
+                    printf("Executing: %s\n", job->command);
+                }
+                logMessage(LOG_INFO, "Executing: %s", job->command);
+                
+                // 启动命令，不等待其结束；命令无法生成时不重试
+                job->attempt = 1;
+                if (built != 0) {
+                    job->output = NULL;
+                    job->startTime = getMonotonicTime();
+                    progress.completed++;
+                    progress.failed++;
+                    finishJob(job, -1, NULL, &run, 0);
+                    reportProgress(source, &progress, verbose);
+                } else if (launchAttempt(job, &handles[runningJobs], &run) != 0) {
+                    int finished = endAttempt(job, -1, NULL, &run, &retries);
+                    if (finished > 0) {
+                        progress.completed += finished;
+                        progress.failed += finished;
+                        reportProgress(source, &progress, verbose);
+                    }
+                } else {
+                    runningJobs++;
+                }
+                continue;
+            }
+        }
+        
+        if (runningJobs == 0) {
+            // 只剩等待重试的任务时休眠到最早的重试时间
+            if (exhausted && retryTimeout > 0) {
+                sleepMilliseconds(shorterTimeout(retryTimeout, idleTimeout));
+            }
+            continue;
+        }
+        
+        // 等待任务结束；任务槽未满时任务来源取得新任务也会唤醒（返回 PROCESS_WAIT_TIMEOUT）
+        // 自适应模式下等待不超过一个采样间隔，以便负载下降后及时增加并发
+        int waitTimeout = (adaptive != NULL && !exhausted) ? ADAPTIVE_INTERVAL_MS : idleTimeout;
+        waitTimeout = shorterTimeout(waitTimeout, deadlineTimeout);
+        if (runningJobs < jobLimit) {
+            waitTimeout = shorterTimeout(waitTimeout, retryTimeout);
+        }
+        int exitCode = 0;
+        ProcessStats stats;
+        int index = waitForAnyCommand(handles, runningJobs, &exitCode, &stats, waitTimeout, capture != NULL ? onJobOutput : NULL, &run);
+        if (index == PROCESS_WAIT_TIMEOUT) {
+            continue;
+        }
+        if (index < 0) {
+            break;
+        }
+        
+        // 因超时或卡住而被结束的任务统一记为 JOB_TIMEOUT_EXIT_CODE
+        if (jobs[index].killTime != 0) {
+            exitCode = JOB_TIMEOUT_EXIT_CODE;
+        }
+        if (adaptive != NULL) {
+            noteJobMemory(adaptive, stats.peakMemoryKb);
+        }
+        int finished = endAttempt(&jobs[index], exitCode, &stats, &run, &retries);
+        if (finished > 0) {
+            progress.completed += finished;
+            progress.completedBytes += jobs[index].size;
+            if (exitCode != 0) {
+                progress.failed += finished;
+            }
+        }
+        
+        // 用最后一个任务填补空出的槽位
+        runningJobs--;
+        if (index != runningJobs) {
+            jobs[index] = jobs[runningJobs];
+            handles[index] = handles[runningJobs];
+        }
+        
+        // 更新进度显示
+        reportProgress(source, &progress, verbose);
+    }
+    
+    // 异常退出时释放仍在运行或等待启动的批处理
+    for (int i = 0; i < runningJobs; i++) {
+        releaseJob(&jobs[i]);
+    }
+    for (int i = 0; i < MAX_OPEN_BATCHES; i++) {
+        free(batches[i].files);
+    }
+    
+    refreshStatus(source, &progress, runningJobs);
+    finishProgress(&progress);
+    freeAdaptiveLimit(adaptive);
+    freeCpuPlacement(placement);
+    freeOutputCapture(capture);
+    free(retries.jobs);
+    
+    if (progress.upToDate > 0) {
+        printf("%d up-to-date files skipped\n", progress.upToDate);
+        logMessage(LOG_INFO, "%d up-to-date files skipped", progress.upToDate);
+    }
+    
+    if (copyWorkers != NULL) {
+        finishCopyWorkers(copyWorkers);
+    }
+    
+    if (report != NULL) {
+        if (writeReport(report, options->reportPath, options->reportSlowest, progress.excluded, progress.upToDate) == 0) {
+            printf("Run report written to %s\n", options->reportPath);
+            logMessage(LOG_INFO, "Run report written to %s", options->reportPath);
+        } else {
+            printf("Error: Cannot write run report to %s\n", options->reportPath);
+        }
+        freeReport(report);
+    }
+    closeManifest(manifest);
+    freeTemplate(&commandTemplate);
+    free(jobs);
+    free(handles);
+    return progress.failed;
+}
+
+// 基于完整扫描结果的任务来源
+typedef struct FileListSource {
+    JobSource base;
+    const FileList* list;
+    int* sequence;              // 启动顺序（文件项下标，由来源持有），为 NULL 时按扫描顺序
+    int sequenceCount;
+    int next;
+} FileListSource;
+
+// 辅助函数：按启动顺序（默认为扫描顺序）取出下一个文件
+static int fileListSourceNext(JobSource* source, FileJob* job, int timeoutMs) {
+    FileListSource* listSource = (FileListSource*)source;
+    const FileList* list = listSource->list;
+    int end = listSource->sequence != NULL ? listSource->sequenceCount : list->count;
+    (void)timeoutMs;
+    
+    while (listSource->next < end) {
+        int index = listSource->next++;
+        if (listSource->sequence != NULL) {
+            index = listSource->sequence[index];
+        }
+        if (list->entries[index].flags & FILE_ENTRY_DIRECTORY) {
+            continue;
+        }
+        
+        // 按需拼接完整路径
+        if (getEntryPath(list, index, job->path, MAX_PATH_LENGTH) == NULL) {
+            logMessage(LOG_ERROR, "Path too long, skipping: %s", getEntryName(list, index));
+            continue;
+        }
+        job->size = list->entries[index].size;
+        job->mtime = list->entries[index].mtime;
+        job->excluded = (list->entries[index].flags & FILE_ENTRY_EXCLUDED) != 0;
+        return 1;
+    }
+    return 0;
+}
+
+// 辅助函数：扫描已完成，总数即文件表中的文件数
+static int fileListSourceTotal(JobSource* source, int* complete) {
+    *complete = 1;
+    return countFiles(((FileListSource*)source)->list);
+}
+
+// 辅助函数：释放任务来源（文件表由调用方管理）
+static void fileListSourceClose(JobSource* source) {
+    free(((FileListSource*)source)->sequence);
+    free(source);
+}
+
+// 创建基于完整扫描结果的任务来源，sequence 为启动顺序（由 buildJobSequence 生成，来源接管其所有权），可为 NULL
+JobSource* createFileListSource(const FileList* list, int* sequence, int sequenceCount) {
+    FileListSource* source = (FileListSource*)calloc(1, sizeof(FileListSource));
+    if (source == NULL) {
+        free(sequence);
+        return NULL;
+    }
+    
+    source->base.next = fileListSourceNext;
+    source->base.total = fileListSourceTotal;
+    source->base.close = fileListSourceClose;
+    source->base.finish = NULL;
+    source->base.rejected = 0;
+    source->list = list;
+    source->sequence = sequence;
+    source->sequenceCount = sequenceCount;
+    return &source->base;
+}
+
+// 流式任务来源：后台线程一边扫描（或读取文件列表）一边把文件放入有界队列，processFiles 同时从队列中取出执行
+typedef struct StreamSource {
+    JobSource base;
+    FileList list;              // 仅由扫描线程访问
+    char outputPath[MAX_PATH_LENGTH];
+    FILE* listFile;             // 文件列表模式下读取的列表（扫描模式下为 NULL）
+    int nullSeparated;          // 列表以 '\0' 分隔，否则以换行分隔
+    char lastDirectory[MAX_PATH_LENGTH];    // 最近创建的输出目录，避免重复创建
+    BoundedQueue* queue;
+    PlatformThread* thread;
+    DirectoryWatcher* watcher;  // 监视模式下的目录监视器（其他模式为 NULL）
+    PendingChanges* pending;    // 监视模式下等待写入稳定的文件，仅由后台线程访问
+    int settleMs;
+    PlatformMutex* mutex;       // 保护下面的计数和标志
+    int discoveredFiles;
+    int complete;
+    int stopping;               // 任务来源正在关闭，监视线程应当退出
+} StreamSource;
+
+// 流式扫描时队列中最多积压的任务数
+#define STREAM_QUEUE_CAPACITY 4096
+
+// 监视线程没有事件时检查停止请求的间隔（毫秒）
+#define WATCH_POLL_INTERVAL_MS 200
+
+// 辅助函数：扫描线程每发现一项就调用一次
+// 目录按先序出现，因此在其中的文件入队之前，对应的输出目录已经创建好
+static int streamSourceOnEntry(const FileList* list, int index, void* userData) {
+    StreamSource* source = (StreamSource*)userData;
+    const FileEntry* entry = &list->entries[index];
+    
+    // 只有监视模式安装了中断处理，按下 Ctrl+C 后不再继续初始扫描
+    if (interruptRequested()) {
+        return -1;
+    }
+    
+    if (entry->flags & FILE_ENTRY_DIRECTORY) {
+        char outputDir[MAX_PATH_LENGTH];
+        size_t outputLength = strlen(source->outputPath);
+        memcpy(outputDir, source->outputPath, outputLength);
+        if (getEntryRelativePath(list, index, outputDir + outputLength, MAX_PATH_LENGTH - outputLength) == NULL) {
+            logMessage(LOG_WARNING, "Output path too long for directory: %s", getEntryName(list, index));
+            return 0;
+        }
+        if (createDirectory(outputDir) != 0 && errno != EEXIST) {
+            logMessage(LOG_WARNING, "Cannot create directory %s", outputDir);
+        }
+        return 0;
+    }
+    
+    FileJob* job = (FileJob*)malloc(sizeof(FileJob));
+    if (job == NULL) {
+        logMessage(LOG_ERROR, "Out of memory while queueing file: %s", getEntryName(list, index));
+        return -1;
+    }
+    if (getEntryPath(list, index, job->path, MAX_PATH_LENGTH) == NULL) {
+        logMessage(LOG_ERROR, "Path too long, skipping: %s", getEntryName(list, index));
+        free(job);
+        return 0;
+    }
+    job->size = entry->size;
+    job->mtime = entry->mtime;
+    job->excluded = (entry->flags & FILE_ENTRY_EXCLUDED) != 0;
+    
+    lockMutex(source->mutex);
+    source->discoveredFiles++;
+    unlockMutex(source->mutex);
+    
+    // 队列已满时在此阻塞，扫描速度自然受执行速度约束；队列被关闭时停止扫描
+    if (queuePush(source->queue, job) != 0) {
+        free(job);
+        return -1;
+    }
+    return 0;
+}
+
+// 辅助函数：扫描线程入口
+static void streamSourceScan(void* argument) {
+    StreamSource* source = (StreamSource*)argument;
+    
+    scanDirectoryTree(source->list.root, &source->list);
+    
+    lockMutex(source->mutex);
+    source->complete = 1;
+    unlockMutex(source->mutex);
+    
+    logMessage(LOG_INFO, "Scan completed: %d files, %d directories", source->list.fileCount, source->list.directoryCount);
+    closeQueue(source->queue);
+}
+
+// 辅助函数：跳过文件列表中无法处理的一项；列表模式下计入被拒绝的项数（监视模式下文件在稳定前被删除是正常情况）
+static int rejectListedFile(StreamSource* source, FileJob* job) {
+    if (source->listFile != NULL) {
+        source->base.rejected++;
+    }
+    free(job);
+    return 0;
+}
+
+// 辅助函数：把文件列表中的一项放入队列
+// 列表中的路径可以是输入目录下的完整路径，也可以是相对输入目录的路径；绝对路径和含 ".." 的路径一律拒绝，保证输出不会写到输出目录之外
+static int queueListedFile(StreamSource* source, const char* name) {
+    const char* root = source->list.root;
+    size_t rootLength = strlen(root);
+    
+    FileJob* job = (FileJob*)malloc(sizeof(FileJob));
+    if (job == NULL) {
+        logMessage(LOG_ERROR, "Out of memory while queueing file: %s", name);
+        return -1;
+    }
+    
+    int written;
+    if (strncmp(name, root, rootLength) == 0 && (name[rootLength] == '/' || name[rootLength] == '\\')) {
+        written = snprintf(job->path, MAX_PATH_LENGTH, "%s", name);
+    } else if (isAbsolutePath(name)) {
+        logMessage(LOG_WARNING, "Listed file is outside the input directory, skipping: %s", name);
+        return rejectListedFile(source, job);
+    } else {
+        while (name[0] == '.' && (name[1] == '/' || name[1] == '\\')) {
+            name += 2;
+        }
+        written = snprintf(job->path, MAX_PATH_LENGTH, "%s%s%s", root, PATH_SEPARATOR_STRING, name);
+    }
+    if (written < 0 || written >= MAX_PATH_LENGTH) {
+        logMessage(LOG_ERROR, "Path too long, skipping: %s", name);
+        return rejectListedFile(source, job);
+    }
+    if (hasParentComponent(job->path + rootLength + 1)) {
+        logMessage(LOG_WARNING, "Listed file is outside the input directory, skipping: %s", name);
+        return rejectListedFile(source, job);
+    }
+    
+    if (getFileInfo(job->path, &job->size, &job->mtime) != 0) {
+        logMessage(LOG_WARNING, "Listed file does not exist, skipping: %s", job->path);
+        return rejectListedFile(source, job);
+    }
+    
+    job->excluded = 0;
+    if (source->list.filter != NULL) {
+        const char* relativePath = job->path + rootLength + 1;
+        const char* lastSeparator = strrchr(relativePath, PATH_SEPARATOR);
+        const char* fileName = (lastSeparator != NULL) ? lastSeparator + 1 : relativePath;
+        if (isPathPruned(source->list.filter, relativePath)) {
+            free(job);
+            return 0;
+        }
+        FilterResult result = evaluateFilter(source->list.filter, fileName, relativePath, job->size, job->mtime);
+        if (result == FILTER_SKIP) {
+            free(job);
+            return 0;
+        }
+        job->excluded = (result == FILTER_EXCLUDE);
+    }
+    
+    // 列表不保证目录先于文件出现，因此按需创建文件所在的输出目录
+    char outputDir[MAX_PATH_LENGTH];
+    snprintf(outputDir, MAX_PATH_LENGTH, "%s%s", source->outputPath, job->path + rootLength);
+    char* lastSeparator = strrchr(outputDir, PATH_SEPARATOR);
+    if (lastSeparator != NULL) {
+        *lastSeparator = '\0';
+    }
+    if (strcmp(outputDir, source->lastDirectory) != 0) {
+        if (createDirectoryPath(outputDir) != 0) {
+            logMessage(LOG_WARNING, "Cannot create directory %s", outputDir);
+        }
+        snprintf(source->lastDirectory, MAX_PATH_LENGTH, "%s", outputDir);
+    }
+    
+    lockMutex(source->mutex);
+    source->discoveredFiles++;
+    unlockMutex(source->mutex);
+    
+    if (queuePush(source->queue, job) != 0) {
+        free(job);
+        return -1;
+    }
+    return 0;
+}
+
+// 辅助函数：读取文件列表的线程入口
+static void filesFromRead(void* argument) {
+    StreamSource* source = (StreamSource*)argument;
+    int separator = source->nullSeparated ? '\0' : '\n';
+    char line[MAX_PATH_LENGTH];
+    size_t length = 0;
+    int overlong = 0;
+    
+    for (;;) {
+        int c = getc(source->listFile);
+        if (c != EOF && c != separator) {
+            if (length + 1 < sizeof(line)) {
+                line[length++] = (char)c;
+            } else {
+                overlong = 1;
+            }
+            continue;
+        }
+        
+        // 换行分隔时去掉 Windows 换行符中的 '\r'
+        if (!source->nullSeparated && length > 0 && line[length - 1] == '\r') {
+            length--;
+        }
+        line[length] = '\0';
+        if (overlong) {
+            logMessage(LOG_ERROR, "Path too long in file list, skipping: %.64s...", line);
+            source->base.rejected++;
+        } else if (length > 0 && queueListedFile(source, line) != 0) {
+            break;
+        }
+        length = 0;
+        overlong = 0;
+        
+        if (c == EOF) {
+            break;
+        }
+    }
+    
+    lockMutex(source->mutex);
+    source->complete = 1;
+    int total = source->discoveredFiles;
+    unlockMutex(source->mutex);
+    
+    logMessage(LOG_INFO, "File list read: %d files", total);
+    closeQueue(source->queue);
+}
+
+// 辅助函数：监视器报告的事件：文件事件合并到等待集合中，被剪枝的目录不加入监视
+static int watchSourceOnEvent(void* userData, const char* relativePath, int event) {
+    StreamSource* source = (StreamSource*)userData;
+    
+    if (event == WATCH_DIRECTORY_ADDED) {
+        if (source->list.filter == NULL) {
+            return 0;
+        }
+        const char* lastSeparator = strrchr(relativePath, PATH_SEPARATOR);
+        const char* name = (lastSeparator != NULL) ? lastSeparator + 1 : relativePath;
+        int depth = 0;
+        for (const char* p = relativePath; *p; p++) {
+            depth += (*p == PATH_SEPARATOR);
+        }
+        return evaluateDirectory(source->list.filter, name, relativePath, depth) == FILTER_SKIP;
+    }
+    
+    if (event == WATCH_FILE_REMOVED) {
+        forgetChange(source->pending, relativePath);
+    } else if (recordChange(source->pending, relativePath, event == WATCH_FILE_CLOSED, getMonotonicTime()) != 0) {
+        logMessage(LOG_ERROR, "Out of memory while recording change: %s", relativePath);
+    }
+    return 0;
+}
+
+// 辅助函数：写入已稳定的文件按文件列表的方式入队（同样的过滤、输出目录和排除规则）
+static int queueSettledFile(void* userData, const char* relativePath) {
+    StreamSource* source = (StreamSource*)userData;
+    char path[MAX_PATH_LENGTH];
+    int written = snprintf(path, MAX_PATH_LENGTH, "%s%s%s", source->list.root, PATH_SEPARATOR_STRING, relativePath);
+    if (written < 0 || written >= MAX_PATH_LENGTH) {
+        logMessage(LOG_ERROR, "Path too long, skipping: %s", relativePath);
+        return 0;
+    }
+    
+    // 稳定之前又被删除的文件（删除事件可能晚于这次检查）直接忽略
+    if (getFileInfo(path, NULL, NULL) != 0) {
+        return 0;
+    }
+    return queueListedFile(source, path) != 0;
+}
+
+// 辅助函数：监视线程入口
+// 先扫描一遍处理已有的文件（监视在创建任务来源时已经注册，扫描期间的变更不会遗漏），之后只处理监视到的变更
+static void watchSourceRun(void* argument) {
+    StreamSource* source = (StreamSource*)argument;
+    
+    scanDirectoryTree(source->list.root, &source->list);
+    logMessage(LOG_INFO, "Initial scan completed: %d files, %d directories; watching for changes", source->list.fileCount, source->list.directoryCount);
+    
+    while (!interruptRequested()) {
+        lockMutex(source->mutex);
+        int stopping = source->stopping;
+        unlockMutex(source->mutex);
+        if (stopping) {
+            break;
+        }
+        
+        // 等到下一个文件可能稳定为止，但不超过检查停止请求的间隔
+        int timeoutMs = nextSettleDelay(source->pending, getMonotonicTime(), source->settleMs);
+        if (timeoutMs < 0 || timeoutMs > WATCH_POLL_INTERVAL_MS) {
+            timeoutMs = WATCH_POLL_INTERVAL_MS;
+        }
+        if (readWatchEvents(source->watcher, timeoutMs) < 0) {
+            break;
+        }
+        
+        // 同一时刻稳定下来的文件作为一批入队
+        int batch = takeSettledChanges(source->pending, getMonotonicTime(), source->settleMs, queueSettledFile, source);
+        if (batch > 0) {
+            logMessage(LOG_INFO, "Queued %d changed file%s, %d still settling", batch, batch == 1 ? "" : "s", getPendingCount(source->pending));
+        }
+    }
+    
+    if (interruptRequested()) {
+        logMessage(LOG_INFO, "Watch stopped by interrupt, %d pending changes dropped", getPendingCount(source->pending));
+    }
+    lockMutex(source->mutex);
+    source->complete = 1;
+    unlockMutex(source->mutex);
+    closeQueue(source->queue);
+}
+
+// 辅助函数：从队列中取出下一个文件
+static int streamSourceNext(JobSource* source, FileJob* job, int timeoutMs) {
+    StreamSource* streamSource = (StreamSource*)source;
+    void* item = NULL;
+    
+    int result = queuePop(streamSource->queue, &item, timeoutMs);
+    if (result > 0) {
+        *job = *(FileJob*)item;
+        free(item);
+    }
+    return result;
+}
+
+// 辅助函数：目前已发现的文件数
+static int streamSourceTotal(JobSource* source, int* complete) {
+    StreamSource* streamSource = (StreamSource*)source;
+    
+    lockMutex(streamSource->mutex);
+    int total = streamSource->discoveredFiles;
+    *complete = streamSource->complete;
+    unlockMutex(streamSource->mutex);
+    return total;
+}
+
+// 辅助函数：停止扫描线程并释放资源
+static void streamSourceClose(JobSource* source) {
+    StreamSource* streamSource = (StreamSource*)source;
+    
+    // 关闭队列让仍在入队的扫描线程退出（监视线程在下一次检查时退出），再丢弃尚未处理的任务
+    lockMutex(streamSource->mutex);
+    streamSource->stopping = 1;
+    unlockMutex(streamSource->mutex);
+    closeQueue(streamSource->queue);
+    joinThread(streamSource->thread);
+    
+    void* item = NULL;
+    while (queuePop(streamSource->queue, &item, 0) > 0) {
+        free(item);
+    }
+    
+    destroyQueue(streamSource->queue);
+    destroyMutex(streamSource->mutex);
+    freeDirectoryWatcher(streamSource->watcher);
+    freePendingChanges(streamSource->pending);
+    freeFileList(&streamSource->list);
+    if (streamSource->listFile != NULL && streamSource->listFile != stdin) {
+        fclose(streamSource->listFile);
+    }
+    free(streamSource);
+}
+
+// 辅助函数：分配流式任务来源（尚未启动后台线程）
+static StreamSource* allocateStreamSource(const char* inputPath, const char* outputPath) {
+    StreamSource* source = (StreamSource*)calloc(1, sizeof(StreamSource));
+    if (source == NULL) {
+        return NULL;
+    }
+    
+    source->base.next = streamSourceNext;
+    source->base.total = streamSourceTotal;
+    source->base.close = streamSourceClose;
+    source->base.finish = NULL;
+    source->base.rejected = 0;
+    initFileList(&source->list, inputPath);
+    snprintf(source->outputPath, MAX_PATH_LENGTH, "%s", outputPath);
+    
+    source->queue = createQueue(STREAM_QUEUE_CAPACITY);
+    source->mutex = createMutex();
+    if (source->queue == NULL || source->mutex == NULL) {
+        destroyQueue(source->queue);
+        destroyMutex(source->mutex);
+        free(source);
+        return NULL;
+    }
+    return source;
+}
+
+// 辅助函数：启动后台线程，失败时释放任务来源
+static JobSource* startStreamSource(StreamSource* source, ThreadFunction function) {
+    source->thread = startThread(function, source);
+    if (source->thread == NULL) {
+        destroyQueue(source->queue);
+        destroyMutex(source->mutex);
+        freeDirectoryWatcher(source->watcher);
+        freePendingChanges(source->pending);
+        if (source->listFile != NULL && source->listFile != stdin) {
+            fclose(source->listFile);
+        }
+        free(source);
+        return NULL;
+    }
+    return &source->base;
+}
+
+// 创建流式任务来源并立即开始扫描
+// settings 提供输入目录和扫描设置（过滤器、扫描线程数和合并顺序），其本身不会被填充
+JobSource* createStreamSource(const FileList* settings, const char* outputPath) {
+    StreamSource* source = allocateStreamSource(settings->root, outputPath);
+    if (source == NULL) {
+        return NULL;
+    }
+    
+    source->list.filter = settings->filter;
+    source->list.scanThreads = settings->scanThreads;
+    source->list.scanOrder = settings->scanOrder;
+    source->list.indexPath = settings->indexPath;
+    source->list.rescan = settings->rescan;
+    source->list.statIndexedFiles = settings->statIndexedFiles;
+    source->list.onEntryAdded = streamSourceOnEntry;
+    source->list.userData = source;
+    return startStreamSource(source, streamSourceScan);
+}
+
+// 创建读取文件列表的任务来源，不扫描输入目录
+// listPath 为 "-" 时从标准输入读取；nullSeparated 为真时列表以 '\0' 分隔（如 find -print0）
+JobSource* createFilesFromSource(const char* inputPath, const char* outputPath, const char* listPath, int nullSeparated, const FileFilter* filter) {
+    FILE* listFile = (strcmp(listPath, "-") == 0) ? stdin : openFile(listPath, "rb");
+    if (listFile == NULL) {
+        logMessage(LOG_ERROR, "Cannot open file list: %s", listPath);
+        return NULL;
+    }
+    
+    StreamSource* source = allocateStreamSource(inputPath, outputPath);
+    if (source == NULL) {
+        if (listFile != stdin) {
+            fclose(listFile);
+        }
+        return NULL;
+    }
+    
+    source->listFile = listFile;
+    source->nullSeparated = nullSeparated;
+    source->list.filter = filter;
+    return startStreamSource(source, filesFromRead);
+}
+
+// 创建监视输入目录的任务来源：先处理已有的文件，之后持续处理新出现和被修改的文件，直到收到中断请求
+// 文件在写入方关闭后 settleMs 毫秒内没有新的事件才入队；settings 的用法与 createStreamSource 相同
+JobSource* createWatchSource(const FileList* settings, const char* outputPath, int settleMs) {
+    StreamSource* source = allocateStreamSource(settings->root, outputPath);
+    if (source == NULL) {
+        return NULL;
+    }
+    
+    source->list.filter = settings->filter;
+    source->list.scanThreads = settings->scanThreads;
+    source->list.scanOrder = settings->scanOrder;
+    source->list.indexPath = settings->indexPath;
+    source->list.rescan = settings->rescan;
+    source->list.statIndexedFiles = settings->statIndexedFiles;
+    source->list.onEntryAdded = streamSourceOnEntry;
+    source->list.userData = source;
+    source->settleMs = settleMs;
+    
+    unsigned int traversalFlags = (settings->filter != NULL) ? getTraversalFlags(settings->filter) : 0;
+    source->pending = createPendingChanges();
+    if (source->pending != NULL) {
+        source->watcher = createDirectoryWatcher(settings->root, traversalFlags, watchSourceOnEvent, source);
+    }
+    if (source->watcher == NULL) {
+        freePendingChanges(source->pending);
+        destroyQueue(source->queue);
+        destroyMutex(source->mutex);
+        free(source);
+        return NULL;
+    }
+    return startStreamSource(source, watchSourceRun);
+}
+
+// 扫描之后才确定排除扩展名时（交互模式下在扫描后输入），按过滤器补充标记被排除的文件
+void markExcludedEntries(FileList* list, const FileFilter* filter) {
+    for (int i = 0; i < list->count; i++) {
+        FileEntry* entry = &list->entries[i];
+        if (!(entry->flags & FILE_ENTRY_DIRECTORY) && isExcludedExtension(filter, getEntryName(list, i))) {
+            entry->flags |= FILE_ENTRY_EXCLUDED;
+        }
+    }
+}
+
+// 释放文件列表内存
+void freeFileList(FileList* list) {
+    free(list->entries);
+    free(list->names);
+    list->entries = NULL;
+    list->names = NULL;
+    list->count = 0;
+    list->capacity = 0;
+    list->namesLength = 0;
+    list->namesCapacity = 0;
+    list->fileCount = 0;
+    list->directoryCount = 0;
 }
\ No newline at end of file
@@ -4,26 +4,174 @@
 #define MAX_PATH_LENGTH 1024
 #define MAX_COMMAND_LENGTH 2048
 #define MAX_EXTENSIONS_LENGTH 256
+#define MAX_PARALLEL_JOBS 256
+
+// 批处理（命令模板含 %I）的默认设置：每次调用最多处理的文件数和命令行的最大长度
+// Windows 上 CreateProcess 的命令行不能超过 32767 个字符，经 cmd.exe 执行时不能超过 8191 个字符；
+// POSIX 上与 xargs 的默认值相同，远低于 ARG_MAX
+#define DEFAULT_BATCH_SIZE 100
+#ifdef _WIN32
+#define DEFAULT_MAX_COMMAND_LENGTH 32000
+#define DEFAULT_MAX_SHELL_COMMAND_LENGTH 8000
+#else
+#define DEFAULT_MAX_COMMAND_LENGTH (128 * 1024)
+#define DEFAULT_MAX_SHELL_COMMAND_LENGTH (128 * 1024)
+#endif
+
+// 文件表项标志
+#define FILE_ENTRY_DIRECTORY 0x01
+#define FILE_ENTRY_EXCLUDED 0x02    // 命中排除扩展名：不执行命令，按需原样复制
+
+// addFileEntry 的返回值：文件被过滤器跳过，未加入文件表
+#define FILE_ENTRY_FILTERED (-2)
+
+struct FileFilter;
+struct CommandTemplate;
+
+// 并行扫描时结果合并到文件表的顺序
+typedef enum {
+    SCAN_ORDER_COMPLETION,  // 按目录列举完成的顺序合并（父目录总在子目录之前），最先得到文件
+    SCAN_ORDER_TREE         // 按目录先序合并，与单线程扫描的顺序完全一致
+} ScanOrder;
 
 // 结构体用于存储文件信息
+// 路径不直接保存，而是以（父目录下标，名称片段）的形式存入字符串池，需要时再拼接
 typedef struct FileEntry {
-    char path[MAX_PATH_LENGTH];
-    int is_directory;
-    struct FileEntry* next;
+    long long size;             // 文件大小（字节），目录为 0
+    long long mtime;            // 最后修改时间（Unix 纪元起的纳秒数）
+    int parent;                 // 父目录在表中的下标，顶层为 -1
+    unsigned int nameOffset;    // 名称在字符串池中的偏移
+    unsigned short nameLength;  // 名称长度（字节，不含结尾的 '\0'）
+    unsigned short depth;       // 相对输入目录的层级（顶层为 0）
+    unsigned int flags;         // FILE_ENTRY_* 标志
 } FileEntry;
 
+// 一次扫描得到的文件表，表项连续存放并按目录先序（父目录在前）排列
+typedef struct FileList {
+    char root[MAX_PATH_LENGTH]; // 扫描的根目录
+    FileEntry* entries;
+    int count;
+    int capacity;
+    char* names;                // 字符串池，每个名称以 '\0' 结尾
+    size_t namesLength;
+    size_t namesCapacity;
+    int fileCount;
+    int directoryCount;
+    // 可选：扫描时对每个文件求值的过滤器（NULL 表示不过滤）
+    const struct FileFilter* filter;
+    int scanThreads;            // 扫描线程数，大于 1 时并行列举目录（见 scanDirectoryTree）
+    ScanOrder scanOrder;        // 并行扫描结果的合并顺序
+    const char* indexPath;      // 可选：扫描索引文件，只重新列举修改时间变化的目录（NULL 表示不使用，见 scanWithIndex）
+    int rescan;                 // 忽略已有的扫描索引，完整扫描后重写
+    int statIndexedFiles;       // 使用扫描索引时仍逐个获取沿用目录中文件的大小和修改时间（增量模式需要准确的值）
+    // 可选：每添加一项后调用，返回非 0 时停止扫描
+    int (*onEntryAdded)(const struct FileList* list, int index, void* userData);
+    void* userData;
+} FileList;
+
+// 单个待处理文件
+typedef struct FileJob {
+    char path[MAX_PATH_LENGTH];
+    long long size;
+    long long mtime;
+    int excluded;           // 命中排除扩展名，原样复制而不执行命令
+} FileJob;
+
+// 任务来源：processFiles 从中依次取出待处理文件
+typedef struct JobSource {
+    // 取出下一个任务：返回 1 表示取到任务，0 表示没有更多任务，-1 表示超时内暂无任务
+    int (*next)(struct JobSource* source, FileJob* job, int timeoutMs);
+    // 目前已知的文件总数；*complete 为 0 表示仍在发现中
+    int (*total)(struct JobSource* source, int* complete);
+    // 释放任务来源
+    void (*close)(struct JobSource* source);
+    // 可选（可为 NULL）：任务最终结束（不再重试）时调用，result 为命令的退出码
+    void (*finish)(struct JobSource* source, const char* path, int result);
+    // 文件列表中被拒绝的项数（不存在、路径过长或位于输入目录之外），取完所有任务之后读取
+    int rejected;
+} JobSource;
+
+// 原样复制文件（被排除的文件、命令失败后的源文件）时使用的方式
+typedef enum {
+    COPY_AUTO,              // 依次尝试 reflink、内核态复制和用户态复制
+    COPY_FULL,              // 总是复制数据（不使用 reflink）
+    COPY_REFLINK,           // 只使用 reflink（写时复制），文件系统不支持时失败
+    COPY_HARDLINK,          // 创建硬链接，失败时退回到复制
+    COPY_SYMLINK            // 创建指向源文件的符号链接，失败时退回到复制
+} CopyMode;
+
+// 子进程的 CPU 绑定方式
+typedef enum {
+    PIN_NONE,               // 不绑定
+    PIN_CORES,              // 按核心轮流绑定，每个任务一个核心
+    PIN_NUMA                // 按 NUMA 节点轮流绑定，任务可以使用节点上的所有核心
+} PinMode;
+
+// 子进程标准输出和标准错误的处理方式
+typedef enum {
+    CAPTURE_NONE,           // 子进程直接继承控制台
+    CAPTURE_FAILED,         // 在内存中保留最近的输出，只在命令失败时写入日志文件
+    CAPTURE_ALL             // 每个任务的全部输出写入各自的日志文件
+} CaptureMode;
+
+// 控制台输出的详细程度（日志不受影响）
+typedef enum {
+    VERBOSITY_QUIET,        // 只输出错误和汇总
+    VERBOSITY_NORMAL,       // 单行状态（默认）
+    VERBOSITY_VERBOSE       // 逐个文件输出处理过程
+} Verbosity;
+
+// 文件处理选项
+typedef struct ProcessOptions {
+    const char* inputPath;
+    const char* outputPath;
+    const char* command;
+    int copyOnError;
+    int maxJobs;            // 同时运行的最大子进程数
+    int incremental;        // 跳过清单中记录为最新且输出已存在的文件
+    int useShell;           // 通过 Shell 执行命令（支持管道和重定向），否则直接启动程序
+    CopyMode copyMode;      // 原样复制文件的方式
+    const char* reportPath; // JSON 运行报告的输出路径（NULL 表示不生成）
+    int reportSlowest;      // 报告中列出的最慢任务数
+    int adaptive;           // 根据系统负载和可用内存在 1 到 maxJobs 之间调整并发数
+    long long memoryPerJobKb;   // 自适应模式下每个任务的内存预算（0 表示按已完成任务的峰值估算）
+    int niceness;           // 子进程的 nice 值（0 表示不调整）
+    PinMode pinMode;        // 子进程的 CPU 绑定方式
+    CaptureMode captureMode;    // 子进程输出的处理方式
+    const char* jobLogDirectory;    // 任务日志目录（按输入目录结构存放）
+    int errorTailLines;     // 命令失败时写入 error.log 的输出行数（0 表示不写入）
+    Verbosity verbosity;    // 控制台输出的详细程度，逐个文件的信息在非详细模式下只写入日志
+    long long timeoutMs;    // 单个任务的最长运行时间，超时后结束其整个进程树（0 表示不限制）
+    long long stallTimeoutMs;   // 任务在这段时间内没有任何输出（捕获的输出或输出文件增长）时视为卡住并结束（0 表示不检测）
+    int retries;            // 失败任务的最多重试次数
+    long long retryDelayMs; // 第一次重试前的等待时间，之后每次加倍
+    int batchSize;          // 命令模板含 %I 时每次调用最多处理的文件数（1 表示逐个处理）
+    long long maxCommandLength; // 批处理命令行的最大长度（字节）
+} ProcessOptions;
+
 // 通用函数声明
-void printFileTree(const char* path, int depth);
-FileEntry* buildFileList(const char* path, FileEntry* list);
-void freeFileList(FileEntry* list);
-void processFiles(FileEntry* fileList, const char* inputPath, const char* outputPath, const char* command, int copyOnError, const char* excludeExtensions);
-void createDirectoryTree(const char* inputPath, const char* outputPath);
-char* getFileNameWithoutExtension(const char* path);
-char* getFileExtension(const char* path);
-int copyFileWithPath(const char* source, const char* destination);
-int shouldExcludeFile(const char* filename, const char* excludeExtensions);
+void printFileTree(const FileList* list);
+int buildFileList(const char* path, FileList* list);
+void initFileList(FileList* list, const char* root);
+int addFileEntry(FileList* list, int parent, const char* name, size_t nameLength, unsigned int flags, long long size, long long mtime);
+const char* getEntryName(const FileList* list, int index);
+char* getEntryPath(const FileList* list, int index, char* buffer, size_t bufferSize);
+char* getEntryRelativePath(const FileList* list, int index, char* buffer, size_t bufferSize);
+void freeFileList(FileList* list);
+int processFiles(JobSource* source, const ProcessOptions* options);
+int describeJob(const struct CommandTemplate* commandTemplate, const ProcessOptions* options, const FileJob* file, unsigned long long* commandHash, char* outputFile, size_t outputFileSize);
+JobSource* createFileListSource(const FileList* list, int* sequence, int sequenceCount);
+JobSource* createStreamSource(const FileList* settings, const char* outputPath);
+JobSource* createFilesFromSource(const char* inputPath, const char* outputPath, const char* listPath, int nullSeparated, const struct FileFilter* filter);
+JobSource* createWatchSource(const FileList* settings, const char* outputPath, int settleMs);
+void markExcludedEntries(FileList* list, const struct FileFilter* filter);
+void createDirectoryTree(const FileList* list, const char* outputPath);
+int createDirectoryPath(const char* path);
+int copyFileWithPath(const char* source, const char* destination, CopyMode mode);
+int parseCopyMode(const char* text, CopyMode* mode);
+unsigned long long hashString(const char* text);
 
 // 新增函数声明
-int countFiles(FileEntry* list);
+int countFiles(const FileList* list);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,609 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <limits.h>
+#include "file_utils.h"
+#include "platform_utils.h"
+#include "filter_utils.h"
+
+// 扩展名哈希集合的一个槽位
+typedef struct ExtensionSlot {
+    unsigned long long hash;
+    unsigned int offset;        // 扩展名在字符串池中的偏移
+    unsigned int length;        // 0 表示空槽位
+} ExtensionSlot;
+
+// 扩展名哈希集合（开放寻址），扩展名统一存为小写，查找时忽略大小写
+typedef struct ExtensionSet {
+    ExtensionSlot* slots;
+    size_t capacity;            // 2 的幂
+    size_t count;
+    char* pool;
+    size_t poolLength;
+    size_t poolCapacity;
+} ExtensionSet;
+
+// 预处理后的通配符模式
+typedef struct GlobPattern {
+    char* text;
+    int matchPath;              // 含路径分隔符时匹配相对路径，否则只匹配文件名
+    int literal;                // 不含通配符时直接比较
+} GlobPattern;
+
+// 一组模式：形如 *.ext 的模式放入扩展名集合，其余逐个匹配
+typedef struct PatternList {
+    ExtensionSet extensions;
+    GlobPattern* patterns;
+    int count;
+    int capacity;
+} PatternList;
+
+struct FileFilter {
+    ExtensionSet excludedExtensions;    // 旧的按扩展名排除（原样复制）
+    PatternList includes;               // 非空时文件必须匹配其中之一
+    PatternList ignores;                // 匹配其中之一的文件被忽略
+    PatternList prunes;                 // 匹配其中之一的目录不进入
+    int maxDepth;                       // 只处理相对输入目录不超过该层数的文件（0 表示不限制）
+    unsigned int traversalFlags;        // TRAVERSE_* 标志
+    long long minSize;
+    long long maxSize;
+    long long newerThan;
+    long long olderThan;
+    int shardIndex;                     // 只保留相对路径哈希值除以 shardCount 余 shardIndex 的文件
+    int shardCount;                     // 分片数（0 或 1 表示不分片）
+    int needsPath;
+};
+
+// 辅助函数：判断字符是否为路径分隔符（两种分隔符都接受）
+static int isSeparator(char c) {
+    return c == '/' || c == '\\';
+}
+
+// 辅助函数：忽略大小写的 FNV-1a 哈希
+static unsigned long long hashLower(const char* text, size_t length) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)tolower((unsigned char)text[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// 辅助函数：用于分片的相对路径哈希（FNV-1a），两种分隔符按 '/' 计算，保证各平台上的实例得到相同的分片
+static unsigned long long hashShardPath(const char* relativePath) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (const unsigned char* p = (const unsigned char*)relativePath; *p; p++) {
+        hash ^= (*p == '\\') ? '/' : *p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// 辅助函数：在集合中查找扩展名，返回所在槽位或应插入的空槽位
+static ExtensionSlot* findExtensionSlot(const ExtensionSet* set, const char* extension, size_t length, unsigned long long hash) {
+    size_t mask = set->capacity - 1;
+    for (size_t i = (size_t)hash & mask; ; i = (i + 1) & mask) {
+        ExtensionSlot* slot = &set->slots[i];
+        if (slot->length == 0) {
+            return slot;
+        }
+        if (slot->hash == hash && slot->length == length) {
+            const char* stored = set->pool + slot->offset;
+            size_t j = 0;
+            while (j < length && stored[j] == (char)tolower((unsigned char)extension[j])) {
+                j++;
+            }
+            if (j == length) {
+                return slot;
+            }
+        }
+    }
+}
+
+// 辅助函数：向集合中加入扩展名（负载超过一半时扩容）
+static int addExtension(ExtensionSet* set, const char* extension, size_t length) {
+    if (length == 0) {
+        return 0;
+    }
+    
+    if ((set->count + 1) * 2 > set->capacity) {
+        size_t capacity = set->capacity > 0 ? set->capacity * 2 : 64;
+        ExtensionSlot* slots = (ExtensionSlot*)calloc(capacity, sizeof(ExtensionSlot));
+        if (slots == NULL) {
+            return -1;
+        }
+        ExtensionSet grown = *set;
+        grown.slots = slots;
+        grown.capacity = capacity;
+        for (size_t i = 0; i < set->capacity; i++) {
+            if (set->slots[i].length != 0) {
+                *findExtensionSlot(&grown, set->pool + set->slots[i].offset, set->slots[i].length, set->slots[i].hash) = set->slots[i];
+            }
+        }
+        free(set->slots);
+        *set = grown;
+    }
+    
+    unsigned long long hash = hashLower(extension, length);
+    ExtensionSlot* slot = findExtensionSlot(set, extension, length, hash);
+    if (slot->length != 0) {
+        return 0;
+    }
+    
+    if (set->poolLength + length > set->poolCapacity) {
+        size_t capacity = set->poolCapacity > 0 ? set->poolCapacity * 2 : 1024;
+        while (capacity < set->poolLength + length) {
+            capacity *= 2;
+        }
+        char* pool = (char*)realloc(set->pool, capacity);
+        if (pool == NULL) {
+            return -1;
+        }
+        set->pool = pool;
+        set->poolCapacity = capacity;
+    }
+    
+    for (size_t i = 0; i < length; i++) {
+        set->pool[set->poolLength + i] = (char)tolower((unsigned char)extension[i]);
+    }
+    slot->hash = hash;
+    slot->offset = (unsigned int)set->poolLength;
+    slot->length = (unsigned int)length;
+    set->poolLength += length;
+    set->count++;
+    return 0;
+}
+
+// 辅助函数：文件名的扩展名是否在集合中（以点开头的文件名不视为有扩展名）
+static int containsExtensionOf(const ExtensionSet* set, const char* name) {
+    if (set->count == 0) {
+        return 0;
+    }
+    const char* lastDot = strrchr(name, '.');
+    if (lastDot == NULL || lastDot == name || lastDot[1] == '\0') {
+        return 0;
+    }
+    
+    const char* extension = lastDot + 1;
+    size_t length = strlen(extension);
+    return findExtensionSlot(set, extension, length, hashLower(extension, length))->length != 0;
+}
+
+// 辅助函数：释放扩展名集合
+static void freeExtensionSet(ExtensionSet* set) {
+    free(set->slots);
+    free(set->pool);
+    memset(set, 0, sizeof(ExtensionSet));
+}
+
+// 辅助函数：匹配字符类 [abc]、[a-z]、[!a-z]，*pattern 指向 '['
+// 匹配返回 1，不匹配返回 0，没有闭合的 ']' 时返回 -1（调用方把 '[' 当作普通字符）
+static int matchCharacterClass(const char** pattern, char c) {
+    const char* p = *pattern + 1;
+    int negated = (*p == '!' || *p == '^');
+    if (negated) {
+        p++;
+    }
+    
+    int matched = 0;
+    int first = 1;
+    unsigned char lower = (unsigned char)tolower((unsigned char)c);
+    while (*p != '\0' && (*p != ']' || first)) {
+        unsigned char start = (unsigned char)tolower((unsigned char)*p);
+        unsigned char end = start;
+        if (p[1] == '-' && p[2] != '\0' && p[2] != ']') {
+            end = (unsigned char)tolower((unsigned char)p[2]);
+            p += 2;
+        }
+        if (lower >= start && lower <= end) {
+            matched = 1;
+        }
+        p++;
+        first = 0;
+    }
+    if (*p != ']') {
+        return -1;
+    }
+    
+    *pattern = p + 1;
+    return matched != negated;
+}
+
+// 辅助函数：通配符匹配（忽略大小写）
+// * 匹配不含路径分隔符的任意字符串，** 可跨越目录，? 匹配单个非分隔符字符
+static int globMatch(const char* pattern, const char* text) {
+    while (*pattern != '\0') {
+        if (*pattern == '*') {
+            int crossSeparators = (pattern[1] == '*');
+            while (*pattern == '*') {
+                pattern++;
+            }
+            // "**/" 也可以匹配零级目录
+            if (crossSeparators && isSeparator(*pattern) && globMatch(pattern + 1, text)) {
+                return 1;
+            }
+            for (;; text++) {
+                if (globMatch(pattern, text)) {
+                    return 1;
+                }
+                if (*text == '\0' || (!crossSeparators && isSeparator(*text))) {
+                    return 0;
+                }
+            }
+        }
+        
+        if (*text == '\0') {
+            return 0;
+        }
+        
+        if (*pattern == '?') {
+            if (isSeparator(*text)) {
+                return 0;
+            }
+        } else if (*pattern == '[') {
+            const char* next = pattern;
+            int result = matchCharacterClass(&next, *text);
+            if (result == 0) {
+                return 0;
+            }
+            if (result > 0) {
+                pattern = next;
+                text++;
+                continue;
+            }
+            if (*text != '[') {
+                return 0;
+            }
+        } else if (isSeparator(*pattern)) {
+            if (!isSeparator(*text)) {
+                return 0;
+            }
+        } else if (tolower((unsigned char)*pattern) != tolower((unsigned char)*text)) {
+            return 0;
+        }
+        pattern++;
+        text++;
+    }
+    return *text == '\0';
+}
+
+// 辅助函数：不含通配符的模式直接比较（忽略大小写，两种分隔符视为相同）
+static int literalMatch(const char* pattern, const char* text) {
+    while (*pattern != '\0' && *text != '\0') {
+        if (isSeparator(*pattern) ? !isSeparator(*text) : tolower((unsigned char)*pattern) != tolower((unsigned char)*text)) {
+            return 0;
+        }
+        pattern++;
+        text++;
+    }
+    return *pattern == *text;
+}
+
+// 辅助函数：字符串是否不含通配符
+static int isLiteralPattern(const char* pattern) {
+    return strpbrk(pattern, "*?[") == NULL;
+}
+
+// 辅助函数：编译并加入一个模式
+static int addPattern(FileFilter* filter, PatternList* list, const char* pattern) {
+    // 去掉开头的 "./"
+    while (pattern[0] == '.' && isSeparator(pattern[1])) {
+        pattern += 2;
+    }
+    if (pattern[0] == '\0') {
+        return -1;
+    }
+    
+    // *.ext 形式放入扩展名集合，查找为 O(1)
+    if (pattern[0] == '*' && pattern[1] == '.' && pattern[2] != '\0' && isLiteralPattern(pattern + 2) && strchr(pattern + 2, '.') == NULL && strpbrk(pattern + 2, "/\\") == NULL) {
+        return addExtension(&list->extensions, pattern + 2, strlen(pattern + 2));
+    }
+    
+    if (list->count == list->capacity) {
+        int capacity = list->capacity > 0 ? list->capacity * 2 : 8;
+        GlobPattern* patterns = (GlobPattern*)realloc(list->patterns, sizeof(GlobPattern) * capacity);
+        if (patterns == NULL) {
+            return -1;
+        }
+        list->patterns = patterns;
+        list->capacity = capacity;
+    }
+    
+    GlobPattern* glob = &list->patterns[list->count];
+    glob->text = (char*)malloc(strlen(pattern) + 1);
+    if (glob->text == NULL) {
+        return -1;
+    }
+    strcpy(glob->text, pattern);
+    glob->matchPath = (strpbrk(pattern, "/\\") != NULL);
+    glob->literal = isLiteralPattern(pattern);
+    if (glob->matchPath) {
+        filter->needsPath = 1;
+    }
+    list->count++;
+    return 0;
+}
+
+// 辅助函数：文件是否匹配一组模式中的任意一个
+static int matchPatternList(const PatternList* list, const char* name, const char* relativePath) {
+    if (containsExtensionOf(&list->extensions, name)) {
+        return 1;
+    }
+    
+    for (int i = 0; i < list->count; i++) {
+        const GlobPattern* glob = &list->patterns[i];
+        const char* text = glob->matchPath ? relativePath : name;
+        if (text == NULL) {
+            continue;
+        }
+        if (glob->literal ? literalMatch(glob->text, text) : globMatch(glob->text, text)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 辅助函数：释放一组模式
+static void freePatternList(PatternList* list) {
+    for (int i = 0; i < list->count; i++) {
+        free(list->patterns[i].text);
+    }
+    free(list->patterns);
+    freeExtensionSet(&list->extensions);
+    memset(list, 0, sizeof(PatternList));
+}
+
+// 创建空的过滤器（不过滤任何文件）
+FileFilter* createFilter(void) {
+    FileFilter* filter = (FileFilter*)calloc(1, sizeof(FileFilter));
+    if (filter == NULL) {
+        return NULL;
+    }
+    filter->minSize = LLONG_MIN;
+    filter->maxSize = LLONG_MAX;
+    filter->newerThan = LLONG_MIN;
+    filter->olderThan = LLONG_MAX;
+    return filter;
+}
+
+// 加入以空格、逗号或分号分隔的排除扩展名（可带前导点），成功返回 0
+int addExcludedExtensions(FileFilter* filter, const char* extensions) {
+    const char* p = extensions;
+    while (*p != '\0') {
+        p += strspn(p, " ,;");
+        if (*p == '.') {
+            p++;
+        }
+        size_t length = strcspn(p, " ,;");
+        if (addExtension(&filter->excludedExtensions, p, length) != 0) {
+            return -1;
+        }
+        p += length;
+    }
+    return 0;
+}
+
+// 加入包含模式：存在包含模式时，只处理匹配其中之一的文件
+int addIncludePattern(FileFilter* filter, const char* pattern) {
+    return addPattern(filter, &filter->includes, pattern);
+}
+
+// 加入忽略模式：匹配的文件不进入任务列表
+int addIgnorePattern(FileFilter* filter, const char* pattern) {
+    return addPattern(filter, &filter->ignores, pattern);
+}
+
+// 设置文件大小范围（字节，小于 0 表示不限制）
+void setSizeRange(FileFilter* filter, long long minSize, long long maxSize) {
+    filter->minSize = minSize >= 0 ? minSize : LLONG_MIN;
+    filter->maxSize = maxSize >= 0 ? maxSize : LLONG_MAX;
+}
+
+// 设置修改时间范围：只保留 newerThan <= mtime < olderThan 的文件（Unix 纪元起的纳秒数，LLONG_MIN/LLONG_MAX 表示不限制）
+void setModifiedRange(FileFilter* filter, long long newerThan, long long olderThan) {
+    filter->newerThan = newerThan;
+    filter->olderThan = olderThan;
+}
+
+// 加入剪枝模式：匹配的目录（名称或相对路径）不会被打开，其下的文件和子目录都不进入文件表
+int addPrunePattern(FileFilter* filter, const char* pattern) {
+    // 去掉结尾的分隔符，".git/" 与 ".git" 等价
+    char buffer[MAX_PATH_LENGTH];
+    size_t length = strlen(pattern);
+    while (length > 1 && isSeparator(pattern[length - 1])) {
+        length--;
+    }
+    if (length >= sizeof(buffer)) {
+        return -1;
+    }
+    memcpy(buffer, pattern, length);
+    buffer[length] = '\0';
+    return addPattern(filter, &filter->prunes, buffer);
+}
+
+// 设置最大深度：1 表示只处理输入目录下直接包含的文件（0 表示不限制）
+void setMaxDepth(FileFilter* filter, int maxDepth) {
+    filter->maxDepth = maxDepth > 0 ? maxDepth : 0;
+}
+
+// 设置分片：只处理相对路径的哈希值落在第 shardIndex 片（从 0 开始，共 shardCount 片）的文件
+// 分配只取决于相对路径，多个实例各自扫描同一目录树时互不重叠，合起来覆盖全部文件
+void setShard(FileFilter* filter, int shardIndex, int shardCount) {
+    filter->shardIndex = shardIndex;
+    filter->shardCount = shardCount;
+    if (shardCount > 1) {
+        filter->needsPath = 1;
+    }
+}
+
+// 设置遍历选项（TRAVERSE_* 标志）
+void setTraversalFlags(FileFilter* filter, unsigned int flags) {
+    filter->traversalFlags = flags;
+}
+
+// 获取遍历选项
+unsigned int getTraversalFlags(const FileFilter* filter) {
+    return filter->traversalFlags;
+}
+
+// 是否有模式需要匹配相对路径（否则求值时可以不拼接路径）
+int filterNeedsPath(const FileFilter* filter) {
+    return filter->needsPath;
+}
+
+// 对单个文件求值
+// relativePath 为相对输入目录的路径（不含开头的分隔符），filterNeedsPath 为 0 时可以传 NULL
+FilterResult evaluateFilter(const FileFilter* filter, const char* name, const char* relativePath, long long size, long long mtime) {
+    if (size < filter->minSize || size > filter->maxSize) {
+        return FILTER_SKIP;
+    }
+    if (mtime < filter->newerThan || mtime >= filter->olderThan) {
+        return FILTER_SKIP;
+    }
+    if ((filter->includes.count > 0 || filter->includes.extensions.count > 0) && !matchPatternList(&filter->includes, name, relativePath)) {
+        return FILTER_SKIP;
+    }
+    if ((filter->ignores.count > 0 || filter->ignores.extensions.count > 0) && matchPatternList(&filter->ignores, name, relativePath)) {
+        return FILTER_SKIP;
+    }
+    if (filter->shardCount > 1 && hashShardPath(relativePath != NULL ? relativePath : name) % (unsigned long long)filter->shardCount != (unsigned long long)filter->shardIndex) {
+        return FILTER_SKIP;
+    }
+    if (containsExtensionOf(&filter->excludedExtensions, name)) {
+        return FILTER_EXCLUDE;
+    }
+    return FILTER_PROCESS;
+}
+
+// 对目录求值：返回 FILTER_SKIP 时不进入该目录
+// depth 为目录自身的层级（输入目录下直接包含的目录为 0），其中的文件位于 depth + 1 层
+FilterResult evaluateDirectory(const FileFilter* filter, const char* name, const char* relativePath, int depth) {
+    if (filter->maxDepth > 0 && depth + 1 >= filter->maxDepth) {
+        return FILTER_SKIP;
+    }
+    if ((filter->prunes.count > 0 || filter->prunes.extensions.count > 0) && matchPatternList(&filter->prunes, name, relativePath)) {
+        return FILTER_SKIP;
+    }
+    return FILTER_PROCESS;
+}
+
+// 文件列表中给出的文件是否位于被剪枝的目录中或超出最大深度（逐级检查其所在的各级目录）
+int isPathPruned(const FileFilter* filter, const char* relativePath) {
+    if (filter->maxDepth == 0 && filter->prunes.count == 0 && filter->prunes.extensions.count == 0) {
+        return 0;
+    }
+    
+    char prefix[MAX_PATH_LENGTH];
+    char name[MAX_PATH_LENGTH];
+    size_t length = strlen(relativePath);
+    if (length >= sizeof(prefix)) {
+        return 0;
+    }
+    memcpy(prefix, relativePath, length + 1);
+    
+    int depth = 0;
+    size_t start = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (!isSeparator(prefix[i])) {
+            continue;
+        }
+        memcpy(name, prefix + start, i - start);
+        name[i - start] = '\0';
+        prefix[i] = '\0';
+        FilterResult result = evaluateDirectory(filter, name, prefix, depth);
+        prefix[i] = relativePath[i];
+        if (result == FILTER_SKIP) {
+            return 1;
+        }
+        depth++;
+        start = i + 1;
+    }
+    return 0;
+}
+
+// 文件名的扩展名是否在排除列表中
+int isExcludedExtension(const FileFilter* filter, const char* name) {
+    return containsExtensionOf(&filter->excludedExtensions, name);
+}
+
+// 解析文件大小，支持 K/M/G/T 后缀（1024 进制，可带 B 或 iB），成功返回 0
+int parseSizeValue(const char* text, long long* size) {
+    char* end = NULL;
+    double value = strtod(text, &end);
+    if (end == text || value < 0) {
+        return -1;
+    }
+    
+    double multiplier = 1;
+    switch (toupper((unsigned char)*end)) {
+        case 'K': multiplier = 1024.0; end++; break;
+        case 'M': multiplier = 1024.0 * 1024; end++; break;
+        case 'G': multiplier = 1024.0 * 1024 * 1024; end++; break;
+        case 'T': multiplier = 1024.0 * 1024 * 1024 * 1024; end++; break;
+        default: break;
+    }
+    if (*end == 'i') {
+        end++;
+    }
+    if (*end == 'B' || *end == 'b') {
+        end++;
+    }
+    if (*end != '\0') {
+        return -1;
+    }
+    
+    *size = (long long)(value * multiplier);
+    return 0;
+}
+
+// 解析时间：@Unix 时间戳、本地时间 YYYY-MM-DD[ HH:MM[:SS]]，或已存在文件的路径（取其修改时间），成功返回 0
+// 结果与文件的修改时间一样以纳秒表示
+int parseTimeValue(const char* text, long long* time) {
+    if (text[0] == '@') {
+        char* end = NULL;
+        long long value = strtoll(text + 1, &end, 10);
+        if (end == text + 1 || *end != '\0') {
+            return -1;
+        }
+        *time = value * NANOSECONDS_PER_SECOND;
+        return 0;
+    }
+    
+    struct tm local;
+    memset(&local, 0, sizeof(local));
+    char separator = ' ';
+    int fields = sscanf(text, "%d-%d-%d%c%d:%d:%d", &local.tm_year, &local.tm_mon, &local.tm_mday, &separator, &local.tm_hour, &local.tm_min, &local.tm_sec);
+    if (fields == 3 || ((fields == 6 || fields == 7) && (separator == ' ' || separator == 'T'))) {
+        local.tm_year -= 1900;
+        local.tm_mon -= 1;
+        local.tm_isdst = -1;
+        time_t value = mktime(&local);
+        if (value == (time_t)-1) {
+            return -1;
+        }
+        *time = (long long)value * NANOSECONDS_PER_SECOND;
+        return 0;
+    }
+    
+    // 参照文件（类似 find -newer）
+    long long mtime;
+    if (getFileInfo(text, NULL, &mtime) == 0) {
+        *time = mtime;
+        return 0;
+    }
+    return -1;
+}
+
+// 释放过滤器
+void freeFilter(FileFilter* filter) {
+    if (filter == NULL) {
+        return;
+    }
+    freeExtensionSet(&filter->excludedExtensions);
+    freePatternList(&filter->includes);
+    freePatternList(&filter->ignores);
+    freePatternList(&filter->prunes);
+    free(filter);
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef FILTER_UTILS_H
+#define FILTER_UTILS_H
+
+// 文件过滤器：启动时编译一次，扫描时对每个文件求值
+// 编译完成后只读，可以在多个扫描线程中同时使用
+typedef struct FileFilter FileFilter;
+
+// 过滤结果
+typedef enum {
+    FILTER_PROCESS,     // 正常处理
+    FILTER_EXCLUDE,     // 命中排除扩展名：不执行命令，启用复制时原样复制到输出目录
+    FILTER_SKIP         // 不满足包含/忽略规则或大小、时间条件：不进入任务列表
+} FilterResult;
+
+// 遍历选项标志
+#define TRAVERSE_ONE_FILE_SYSTEM 0x01   // 不进入挂载在其他文件系统上的目录
+#define TRAVERSE_NO_FOLLOW 0x02         // 不进入符号链接、目录联接等重解析点指向的目录
+
+// 函数声明
+FileFilter* createFilter(void);
+int addExcludedExtensions(FileFilter* filter, const char* extensions);
+int addIncludePattern(FileFilter* filter, const char* pattern);
+int addIgnorePattern(FileFilter* filter, const char* pattern);
+void setSizeRange(FileFilter* filter, long long minSize, long long maxSize);
+void setModifiedRange(FileFilter* filter, long long newerThan, long long olderThan);
+int addPrunePattern(FileFilter* filter, const char* pattern);
+void setMaxDepth(FileFilter* filter, int maxDepth);
+void setShard(FileFilter* filter, int shardIndex, int shardCount);
+void setTraversalFlags(FileFilter* filter, unsigned int flags);
+unsigned int getTraversalFlags(const FileFilter* filter);
+int filterNeedsPath(const FileFilter* filter);
+FilterResult evaluateFilter(const FileFilter* filter, const char* name, const char* relativePath, long long size, long long mtime);
+FilterResult evaluateDirectory(const FileFilter* filter, const char* name, const char* relativePath, int depth);
+int isPathPruned(const FileFilter* filter, const char* relativePath);
+int isExcludedExtension(const FileFilter* filter, const char* name);
+int parseSizeValue(const char* text, long long* size);
+int parseTimeValue(const char* text, long long* time);
+void freeFilter(FileFilter* filter);
+
+#endif
\ No newline at end of file
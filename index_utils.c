@@ -0,0 +1,409 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "file_utils.h"
+#include "platform_utils.h"
+#include "log_utils.h"
+#include "filter_utils.h"
+#include "index_utils.h"
+
+#define SCAN_INDEX_MAGIC "BCTSCAN"
+
+// 索引文件头，其后依次是目录表、表项表和字符串池（按本机字节序存放，映射后直接使用）
+typedef struct IndexHeader {
+    char magic[8];
+    unsigned int version;
+    unsigned int traversalFlags;    // 扫描时的 TRAVERSE_* 标志，与本次不同时索引作废
+    unsigned long long rootHash;    // 输入目录路径的哈希，与本次不同时索引作废
+    long long scanTime;             // 扫描开始的时间（Unix 纪元起的纳秒数，只精确到秒，向下取整）
+    unsigned int directoryCount;
+    unsigned int entryCount;
+    unsigned long long namesLength;
+} IndexHeader;
+
+// 一个已列举的目录，其中的项在表项表中连续存放（下标 0 为输入目录）
+typedef struct IndexDirectory {
+    long long mtime;                // 列举时目录的修改时间（-1 表示未知，下次一定重新列举）
+    unsigned int firstEntry;
+    unsigned int entryCount;
+} IndexDirectory;
+
+// 目录中的一项：保存列举得到的全部内容而不经过滤器，改变过滤条件后索引仍然可用
+typedef struct IndexEntry {
+    long long size;
+    long long mtime;
+    unsigned int nameOffset;
+    unsigned short nameLength;
+    unsigned short flags;           // 只保存 FILE_ENTRY_DIRECTORY
+    int directory;                  // 子目录在目录表中的下标（-1 表示不是目录或未列举），总是大于所属目录的下标
+    unsigned int reserved;
+} IndexEntry;
+
+// 本次扫描逐步建立的新索引
+typedef struct IndexBuilder {
+    IndexDirectory* directories;
+    int directoryCount;
+    int directoryCapacity;
+    IndexEntry* entries;
+    int entryCount;
+    int entryCapacity;
+    char* names;
+    size_t namesLength;
+    size_t namesCapacity;
+} IndexBuilder;
+
+// 一次使用索引的扫描
+typedef struct IndexScan {
+    FileList* list;
+    unsigned int traversalFlags;
+    unsigned long long fileSystem;
+    const IndexHeader* header;      // 上次的索引（没有或已作废时为 NULL）
+    const IndexDirectory* oldDirectories;
+    const IndexEntry* oldEntries;
+    const char* oldNames;
+    IndexBuilder builder;
+    int reusedDirectories;          // 直接沿用索引内容的目录数
+    int listedDirectories;          // 重新列举的目录数
+    int failed;                     // 内存不足或扫描被 onEntryAdded 停止，结果不完整，不写入索引
+} IndexScan;
+
+// 辅助函数：向新索引追加一个目录，返回其下标（内存不足返回 -1）
+static int addIndexDirectory(IndexBuilder* builder, long long mtime) {
+    if (builder->directoryCount == builder->directoryCapacity) {
+        int capacity = builder->directoryCapacity > 0 ? builder->directoryCapacity * 2 : 256;
+        IndexDirectory* directories = (IndexDirectory*)realloc(builder->directories, sizeof(IndexDirectory) * (size_t)capacity);
+        if (directories == NULL) {
+            return -1;
+        }
+        builder->directories = directories;
+        builder->directoryCapacity = capacity;
+    }
+    
+    IndexDirectory* directory = &builder->directories[builder->directoryCount];
+    directory->mtime = mtime;
+    directory->firstEntry = (unsigned int)builder->entryCount;
+    directory->entryCount = 0;
+    return builder->directoryCount++;
+}
+
+// 辅助函数：向新索引追加一项，成功返回 0
+static int addIndexEntry(IndexBuilder* builder, const char* name, size_t nameLength, unsigned int flags, long long size, long long mtime) {
+    if (builder->entryCount == builder->entryCapacity) {
+        int capacity = builder->entryCapacity > 0 ? builder->entryCapacity * 2 : 1024;
+        IndexEntry* entries = (IndexEntry*)realloc(builder->entries, sizeof(IndexEntry) * (size_t)capacity);
+        if (entries == NULL) {
+            return -1;
+        }
+        builder->entries = entries;
+        builder->entryCapacity = capacity;
+    }
+    if (builder->namesLength + nameLength + 1 > builder->namesCapacity) {
+        size_t capacity = builder->namesCapacity > 0 ? builder->namesCapacity * 2 : 65536;
+        while (capacity < builder->namesLength + nameLength + 1) {
+            capacity *= 2;
+        }
+        char* names = (char*)realloc(builder->names, capacity);
+        if (names == NULL) {
+            return -1;
+        }
+        builder->names = names;
+        builder->namesCapacity = capacity;
+    }
+    
+    IndexEntry* entry = &builder->entries[builder->entryCount++];
+    memset(entry, 0, sizeof(IndexEntry));
+    entry->size = size;
+    entry->mtime = mtime;
+    entry->nameOffset = (unsigned int)builder->namesLength;
+    entry->nameLength = (unsigned short)nameLength;
+    entry->flags = (unsigned short)(flags & FILE_ENTRY_DIRECTORY);
+    entry->directory = -1;
+    memcpy(builder->names + builder->namesLength, name, nameLength);
+    builder->names[builder->namesLength + nameLength] = '\0';
+    builder->namesLength += nameLength + 1;
+    return 0;
+}
+
+// 辅助函数：释放新索引
+static void freeIndexBuilder(IndexBuilder* builder) {
+    free(builder->directories);
+    free(builder->entries);
+    free(builder->names);
+}
+
+// 辅助函数：enumerateDirectory 的回调，把列举到的一项追加到新索引
+static int collectIndexEntry(void* userData, const char* name, unsigned int flags, long long size, long long mtime) {
+    IndexScan* scan = (IndexScan*)userData;
+    size_t nameLength = strlen(name);
+    if (nameLength > 0xFFFF) {
+        logMessage(LOG_ERROR, "File name too long: %s", name);
+        return 0;
+    }
+    if (addIndexEntry(&scan->builder, name, nameLength, flags, size, mtime) != 0) {
+        logMessage(LOG_ERROR, "Out of memory while scanning: %s", name);
+        scan->failed = 1;
+        return -1;
+    }
+    return 0;
+}
+
+// 辅助函数：检查映射的索引文件头，与本次扫描匹配且各部分大小与文件一致时返回 1
+static int loadScanIndex(IndexScan* scan, const char* root, const void* data, size_t size) {
+    const IndexHeader* header = (const IndexHeader*)data;
+    if (size < sizeof(IndexHeader) || memcmp(header->magic, SCAN_INDEX_MAGIC, sizeof(SCAN_INDEX_MAGIC)) != 0 || header->version != SCAN_INDEX_VERSION) {
+        return 0;
+    }
+    if (header->traversalFlags != scan->traversalFlags || header->rootHash != hashString(root) || header->directoryCount == 0) {
+        return 0;
+    }
+    
+    unsigned long long tables = sizeof(IndexHeader) + (unsigned long long)header->directoryCount * sizeof(IndexDirectory) + (unsigned long long)header->entryCount * sizeof(IndexEntry);
+    if (tables > size || header->namesLength != size - tables) {
+        return 0;
+    }
+    
+    scan->header = header;
+    scan->oldDirectories = (const IndexDirectory*)(header + 1);
+    scan->oldEntries = (const IndexEntry*)(scan->oldDirectories + header->directoryCount);
+    scan->oldNames = (const char*)(scan->oldEntries + header->entryCount);
+    return 1;
+}
+
+// 辅助函数：检查索引中一个目录的各项（只在用到时检查，损坏的部分按未索引处理）
+static int isValidOldDirectory(const IndexScan* scan, int oldDirectory) {
+    const IndexHeader* header = scan->header;
+    const IndexDirectory* directory = &scan->oldDirectories[oldDirectory];
+    if ((unsigned long long)directory->firstEntry + directory->entryCount > header->entryCount) {
+        return 0;
+    }
+    
+    for (unsigned int i = 0; i < directory->entryCount; i++) {
+        const IndexEntry* entry = &scan->oldEntries[directory->firstEntry + i];
+        if (entry->nameLength == 0 || (unsigned long long)entry->nameOffset + entry->nameLength >= header->namesLength || scan->oldNames[entry->nameOffset + entry->nameLength] != '\0') {
+            return 0;
+        }
+        if (entry->directory != -1 && (entry->directory <= oldDirectory || (unsigned int)entry->directory >= header->directoryCount)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 辅助函数：在索引的目录中查找同名子目录，返回其在目录表中的下标（-1 表示没有）
+// 多数文件系统每次列举的顺序相同，从上次找到的位置之后开始查找
+static int findOldDirectory(const IndexScan* scan, int oldDirectory, const char* name, size_t nameLength, unsigned int* cursor) {
+    const IndexDirectory* directory = &scan->oldDirectories[oldDirectory];
+    for (unsigned int n = 0; n < directory->entryCount; n++) {
+        unsigned int i = (*cursor + n) % directory->entryCount;
+        const IndexEntry* entry = &scan->oldEntries[directory->firstEntry + i];
+        if (entry->nameLength == nameLength && (entry->flags & FILE_ENTRY_DIRECTORY) && memcmp(scan->oldNames + entry->nameOffset, name, nameLength) == 0) {
+            *cursor = i + 1;
+            return entry->directory;
+        }
+    }
+    return -1;
+}
+
+// 辅助函数：沿用索引中的一项；list->statIndexedFiles 时重新获取文件的大小和修改时间（原地改写不改变目录的修改时间）
+// 获取失败时保留索引中的值；成功返回 0，内存不足返回 -1
+static int reuseIndexEntry(IndexScan* scan, char* path, size_t pathLength, const IndexEntry* entry) {
+    const char* name = scan->oldNames + entry->nameOffset;
+    long long size = entry->size;
+    long long mtime = entry->mtime;
+    
+    size_t childLength = pathLength + 1 + entry->nameLength;
+    if (scan->list->statIndexedFiles && !(entry->flags & FILE_ENTRY_DIRECTORY) && childLength < MAX_PATH_LENGTH) {
+        path[pathLength] = PATH_SEPARATOR;
+        memcpy(path + pathLength + 1, name, entry->nameLength);
+        path[childLength] = '\0';
+        if (getFileInfo(path, &size, &mtime) != 0) {
+            size = entry->size;
+            mtime = entry->mtime;
+        }
+        path[pathLength] = '\0';
+    }
+    return addIndexEntry(&scan->builder, name, entry->nameLength, entry->flags, size, mtime);
+}
+
+// 辅助函数：扫描一个目录（path 为 MAX_PATH_LENGTH 的缓冲区，递归时在其后追加子目录名）
+// 目录修改时间与索引中相同时沿用索引中的项，否则重新列举；各项按目录先序加入文件表，与单线程扫描的顺序一致
+// 返回该目录在新索引中的下标，失败返回 -1
+static int scanIndexedDirectory(IndexScan* scan, char* path, size_t pathLength, int parentIndex, int oldDirectory, long long mtime) {
+    IndexBuilder* builder = &scan->builder;
+    int directory = addIndexDirectory(builder, mtime);
+    if (directory < 0) {
+        logMessage(LOG_ERROR, "Out of memory while scanning: %s", path);
+        scan->failed = 1;
+        return -1;
+    }
+    if (oldDirectory >= 0 && !isValidOldDirectory(scan, oldDirectory)) {
+        logMessage(LOG_WARNING, "Scan index entry is damaged, listing again: %s", path);
+        oldDirectory = -1;
+    }
+    
+    // 同一秒内晚于列举发生的修改不改变目录的修改时间，因此只沿用早于上次扫描开始时间的目录
+    const IndexDirectory* old = (oldDirectory >= 0) ? &scan->oldDirectories[oldDirectory] : NULL;
+    int reuse = (old != NULL && mtime >= 0 && old->mtime == mtime && mtime < scan->header->scanTime);
+    if (reuse) {
+        for (unsigned int i = 0; i < old->entryCount; i++) {
+            if (reuseIndexEntry(scan, path, pathLength, &scan->oldEntries[old->firstEntry + i]) != 0) {
+                logMessage(LOG_ERROR, "Out of memory while scanning: %s", path);
+                scan->failed = 1;
+                return -1;
+            }
+        }
+        scan->reusedDirectories++;
+    } else {
+        if (enumerateDirectory(path, scan->traversalFlags, scan->fileSystem, collectIndexEntry, scan) != 0) {
+            builder->directories[directory].mtime = -1;
+        }
+        if (scan->failed) {
+            return -1;
+        }
+        scan->listedDirectories++;
+    }
+    
+    int first = (int)builder->directories[directory].firstEntry;
+    int count = builder->entryCount - first;
+    builder->directories[directory].entryCount = (unsigned int)count;
+    
+    // 递归时新索引的数组可能被重新分配，因此每次都按下标取表项
+    unsigned int cursor = 0;
+    for (int i = 0; i < count; i++) {
+        const IndexEntry* entry = &builder->entries[first + i];
+        const char* name = builder->names + entry->nameOffset;
+        size_t nameLength = entry->nameLength;
+        unsigned int flags = entry->flags;
+        long long entryMtime = entry->mtime;
+        
+        // 子目录的修改时间总是重新获取（POSIX 上按 d_type 列举的目录不含修改时间）
+        size_t childLength = pathLength + 1 + nameLength;
+        int tooLong = (childLength >= MAX_PATH_LENGTH);
+        if ((flags & FILE_ENTRY_DIRECTORY) && !tooLong) {
+            path[pathLength] = PATH_SEPARATOR;
+            memcpy(path + pathLength + 1, name, nameLength);
+            path[childLength] = '\0';
+            if (getFileInfo(path, NULL, &entryMtime) != 0) {
+                entryMtime = -1;
+            }
+        }
+        
+        int index = addFileEntry(scan->list, parentIndex, name, nameLength, flags, entry->size, entryMtime >= 0 ? entryMtime : 0);
+        if (index == FILE_ENTRY_FILTERED || !(flags & FILE_ENTRY_DIRECTORY)) {
+            path[pathLength] = '\0';
+            continue;
+        }
+        if (index < 0) {
+            scan->failed = 1;
+            return -1;
+        }
+        if (tooLong) {
+            logMessage(LOG_WARNING, "Path too long for building file list: %s%c%.*s", path, PATH_SEPARATOR, (int)nameLength, name);
+            continue;
+        }
+        
+        int oldChild = -1;
+        if (reuse) {
+            oldChild = scan->oldEntries[old->firstEntry + i].directory;
+        } else if (old != NULL) {
+            oldChild = findOldDirectory(scan, oldDirectory, name, nameLength, &cursor);
+        }
+        int child = scanIndexedDirectory(scan, path, childLength, index, oldChild, entryMtime);
+        path[pathLength] = '\0';
+        if (child < 0) {
+            return -1;
+        }
+        builder->entries[first + i].directory = child;
+    }
+    return directory;
+}
+
+// 辅助函数：把新索引写入临时文件后替换原文件，避免中断时留下不完整的索引
+static int writeScanIndex(const IndexScan* scan, const char* indexPath, const char* root, long long scanTime) {
+    char temporaryPath[MAX_PATH_LENGTH];
+    int written = snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", indexPath);
+    if (written < 0 || written >= (int)sizeof(temporaryPath)) {
+        logMessage(LOG_ERROR, "Path too long for the scan index: %s", indexPath);
+        return -1;
+    }
+    
+    // 索引保存在输出目录中，第一次运行时输出目录可能还不存在
+    char directory[MAX_PATH_LENGTH];
+    snprintf(directory, sizeof(directory), "%s", indexPath);
+    char* separator = strrchr(directory, PATH_SEPARATOR);
+    if (separator != NULL && separator != directory) {
+        *separator = '\0';
+        createDirectoryPath(directory);
+    }
+    
+    FILE* file = openFile(temporaryPath, "wb");
+    if (file == NULL) {
+        logMessage(LOG_ERROR, "Cannot write the scan index: %s", temporaryPath);
+        return -1;
+    }
+    
+    const IndexBuilder* builder = &scan->builder;
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SCAN_INDEX_MAGIC, sizeof(SCAN_INDEX_MAGIC));
+    header.version = SCAN_INDEX_VERSION;
+    header.traversalFlags = scan->traversalFlags;
+    header.rootHash = hashString(root);
+    header.scanTime = scanTime;
+    header.directoryCount = (unsigned int)builder->directoryCount;
+    header.entryCount = (unsigned int)builder->entryCount;
+    header.namesLength = builder->namesLength;
+    
+    int failed = (fwrite(&header, sizeof(header), 1, file) != 1);
+    failed |= (fwrite(builder->directories, sizeof(IndexDirectory), (size_t)builder->directoryCount, file) != (size_t)builder->directoryCount);
+    failed |= (fwrite(builder->entries, sizeof(IndexEntry), (size_t)builder->entryCount, file) != (size_t)builder->entryCount);
+    failed |= (fwrite(builder->names, 1, builder->namesLength, file) != builder->namesLength);
+    failed |= (fclose(file) != 0);
+    if (failed) {
+        logMessage(LOG_ERROR, "Cannot write the scan index: %s", temporaryPath);
+        remove(temporaryPath);
+        return -1;
+    }
+    return replaceFile(temporaryPath, indexPath);
+}
+
+// 使用扫描索引扫描输入目录并填充文件表（list->indexPath 为索引文件路径）
+// 每个目录只 stat 一次：修改时间与索引中相同的目录直接沿用映射的索引内容，其余目录重新列举；扫描完整结束后重写索引
+// 目录的修改时间只在其中的项增删或改名时变化，原地改写的文件的大小和修改时间在重新列举所在目录（或 list->rescan）之前不会更新
+// 增量模式依赖文件的大小和修改时间，因此 list->statIndexedFiles 时沿用目录中的文件仍逐个重新获取
+int scanWithIndex(const char* path, FileList* list) {
+    if (!pathExists(path)) {
+        return -1;
+    }
+    
+    IndexScan scan;
+    memset(&scan, 0, sizeof(scan));
+    scan.list = list;
+    scan.traversalFlags = (list->filter != NULL) ? getTraversalFlags(list->filter) : 0;
+    scan.fileSystem = getFileSystemId(path);
+    long long scanTime = (long long)time(NULL) * NANOSECONDS_PER_SECOND;
+    
+    const void* data = NULL;
+    size_t size = 0;
+    MappedFile* mapped = list->rescan ? NULL : mapFile(list->indexPath, &data, &size);
+    if (mapped != NULL && !loadScanIndex(&scan, path, data, size)) {
+        logMessage(LOG_WARNING, "Scan index %s was made for another input folder or version, scanning the whole tree", list->indexPath);
+    }
+    
+    char directoryPath[MAX_PATH_LENGTH];
+    int written = snprintf(directoryPath, sizeof(directoryPath), "%s", path);
+    long long mtime = -1;
+    if (written < 0 || written >= (int)sizeof(directoryPath) || getFileInfo(path, NULL, &mtime) != 0) {
+        mtime = -1;
+    }
+    scanIndexedDirectory(&scan, directoryPath, strlen(directoryPath), -1, (scan.header != NULL) ? 0 : -1, mtime);
+    unmapFile(mapped);
+    
+    if (!scan.failed) {
+        writeScanIndex(&scan, list->indexPath, path, scanTime);
+    }
+    logMessage(LOG_INFO, "Scan with index: %d folders unchanged, %d listed again; %d files, %d directories", scan.reusedDirectories, scan.listedDirectories, list->fileCount, list->directoryCount);
+    freeIndexBuilder(&scan.builder);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#ifndef INDEX_UTILS_H
+#define INDEX_UTILS_H
+
+// 扫描索引：上次扫描得到的目录树（各项的大小、修改时间以及每个目录列举时的修改时间）
+// 保存在输出目录中，下次扫描时直接映射，只重新列举修改时间变化的目录
+#define SCAN_INDEX_FILE_NAME ".bct_scan_index"
+#define SCAN_INDEX_VERSION 1
+
+// 函数声明
+int scanWithIndex(const char* path, FileList* list);
+
+#endif
\ No newline at end of file
@@ -1,53 +1,270 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdarg.h>
 #include <time.h>
 #include <string.h>
+#include "file_utils.h"
+#include "platform_utils.h"
 #include "log_utils.h"
 
-static FILE* logFile = NULL;
-static FILE* errorLogFile = NULL;
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+#define LOG_BUFFER_SIZE (64 * 1024)     // 每个写入缓冲区的大小
+#define LOG_LINE_SIZE 4096              // 单条消息格式化后的最大长度
+#define LOG_FLUSH_INTERVAL_MS 200       // 批量写入的最长间隔
+
+// 日志输出流：消息先追加到前台缓冲区，后台线程交换两个缓冲区后整块写入文件
+typedef struct LogStream {
+    FILE* file;
+    char* buffers[2];
+    size_t length;          // 前台缓冲区已用长度
+    int active;             // 前台缓冲区下标
+} LogStream;
+
+static LogStream logStream;
+static LogStream errorStream;
+static LogLevel minimumLevel = LOG_INFO;
+static LogFlushPolicy flushPolicy = LOG_FLUSH_ERRORS;
+
+// 以下状态由 logMutex 保护
+static PlatformMutex* logMutex = NULL;
+static PlatformCondition* writerCondition = NULL;   // 唤醒后台写入线程
+static PlatformCondition* writtenCondition = NULL;  // 通知等待写入完成的线程
+static PlatformThread* writerThread = NULL;
+static int stopping = 0;
+static unsigned long long requestedFlush = 0;       // 已请求的写入序号
+static unsigned long long completedFlush = 0;       // 已完成的写入序号
+
+// 每个线程独立的格式化缓冲区和时间戳缓存，格式化时无需加锁
+static THREAD_LOCAL char lineBuffer[LOG_LINE_SIZE];
+static THREAD_LOCAL time_t cachedSecond = 0;
+static THREAD_LOCAL char cachedTimestamp[32];
+
+// 设置最低记录级别，低于该级别的消息直接丢弃
+void setLogLevel(LogLevel level) {
+    minimumLevel = level;
+}
+
+// 设置写入策略
+void setLogFlushPolicy(LogFlushPolicy policy) {
+    flushPolicy = policy;
+}
+
+// 解析日志级别名称（info/warning/error），成功返回 0
+int parseLogLevel(const char* text, LogLevel* level) {
+    if (strcmp(text, "info") == 0) {
+        *level = LOG_INFO;
+    } else if (strcmp(text, "warning") == 0) {
+        *level = LOG_WARNING;
+    } else if (strcmp(text, "error") == 0) {
+        *level = LOG_ERROR;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// 解析写入策略名称（always/error/batched），成功返回 0
+int parseLogFlushPolicy(const char* text, LogFlushPolicy* policy) {
+    if (strcmp(text, "always") == 0) {
+        *policy = LOG_FLUSH_ALWAYS;
+    } else if (strcmp(text, "error") == 0) {
+        *policy = LOG_FLUSH_ERRORS;
+    } else if (strcmp(text, "batched") == 0) {
+        *policy = LOG_FLUSH_BATCHED;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// 辅助函数：获取当前时间字符串，同一秒内复用上次格式化的结果
+static const char* getTimestamp(void) {
+    time_t now = time(NULL);
+    if (now != cachedSecond || cachedTimestamp[0] == '\0') {
+        struct tm local;
+#ifdef _WIN32
+        localtime_s(&local, &now);
+#else
+        localtime_r(&now, &local);
+#endif
+        strftime(cachedTimestamp, sizeof(cachedTimestamp), "%Y-%m-%d %H:%M:%S", &local);
+        cachedSecond = now;
+    }
+    return cachedTimestamp;
+}
+
+// 辅助函数：交换输出流的前后台缓冲区，返回待写入的数据（调用方持有锁）
+static const char* takeStreamBuffer(LogStream* stream, size_t* length) {
+    const char* data = stream->buffers[stream->active];
+    *length = stream->length;
+    stream->active ^= 1;
+    stream->length = 0;
+    return data;
+}
+
+// 辅助函数：把数据写入文件（调用方不持有锁）
+static void writeStreamData(LogStream* stream, const char* data, size_t length) {
+    if (length > 0) {
+        fwrite(data, 1, length, stream->file);
+        fflush(stream->file);
+    }
+}
+
+// 后台写入线程：定时或按请求交换缓冲区，在锁外整块写入
+static void writerMain(void* argument) {
+    (void)argument;
+    lockMutex(logMutex);
+    for (;;) {
+        if (!stopping && requestedFlush == completedFlush) {
+            waitCondition(writerCondition, logMutex, LOG_FLUSH_INTERVAL_MS);
+        }
+        
+        unsigned long long target = requestedFlush;
+        int finished = stopping;
+        size_t logLength;
+        size_t errorLength;
+        const char* logData = takeStreamBuffer(&logStream, &logLength);
+        const char* errorData = takeStreamBuffer(&errorStream, &errorLength);
+        unlockMutex(logMutex);
+        
+        writeStreamData(&logStream, logData, logLength);
+        writeStreamData(&errorStream, errorData, errorLength);
+        
+        lockMutex(logMutex);
+        completedFlush = target;
+        broadcastCondition(writtenCondition);
+        if (finished && logStream.length == 0 && errorStream.length == 0) {
+            break;
+        }
+    }
+    unlockMutex(logMutex);
+}
+
+// 辅助函数：把一条已格式化的消息交给输出流
+// waitForWrite 为真时等待后台线程写入完成后才返回；没有后台线程时直接写入
+static void submitLine(LogStream* stream, const char* line, size_t length, int waitForWrite) {
+    if (stream->file == NULL) {
+        return;
+    }
+    
+    if (writerThread == NULL) {
+        if (logMutex != NULL) {
+            lockMutex(logMutex);
+        }
+        fwrite(line, 1, length, stream->file);
+        if (waitForWrite) {
+            fflush(stream->file);
+        }
+        if (logMutex != NULL) {
+            unlockMutex(logMutex);
+        }
+        return;
+    }
+    
+    lockMutex(logMutex);
+    
+    // 前台缓冲区已满时请求写入并等待缓冲区交换
+    while (stream->length + length > LOG_BUFFER_SIZE) {
+        unsigned long long target = ++requestedFlush;
+        signalCondition(writerCondition);
+        while (completedFlush < target) {
+            waitCondition(writtenCondition, logMutex, -1);
+        }
+    }
+    memcpy(stream->buffers[stream->active] + stream->length, line, length);
+    stream->length += length;
+    
+    if (waitForWrite) {
+        unsigned long long target = ++requestedFlush;
+        signalCondition(writerCondition);
+        while (completedFlush < target) {
+            waitCondition(writtenCondition, logMutex, -1);
+        }
+    } else if (stream->length > LOG_BUFFER_SIZE / 2) {
+        // 超过一半时提前唤醒后台线程，减少写入方等待
+        if (requestedFlush == completedFlush) {
+            requestedFlush++;
+        }
+        signalCondition(writerCondition);
+    }
+    unlockMutex(logMutex);
+}
+
+// 辅助函数：判断某个级别的消息是否需要立即写入
+static int shouldWriteImmediately(LogLevel level) {
+    return flushPolicy == LOG_FLUSH_ALWAYS || (flushPolicy == LOG_FLUSH_ERRORS && level == LOG_ERROR);
+}
+
+// 辅助函数：打开输出流并分配缓冲区
+static void openStream(LogStream* stream, const char* path, const char* mode) {
+    memset(stream, 0, sizeof(LogStream));
+    stream->file = fopen(path, mode);
+    if (stream->file == NULL) {
+        return;
+    }
+    stream->buffers[0] = (char*)malloc(LOG_BUFFER_SIZE);
+    stream->buffers[1] = (char*)malloc(LOG_BUFFER_SIZE);
+    if (stream->buffers[0] == NULL || stream->buffers[1] == NULL) {
+        free(stream->buffers[0]);
+        free(stream->buffers[1]);
+        fclose(stream->file);
+        memset(stream, 0, sizeof(LogStream));
+    }
+}
+
+// 辅助函数：关闭输出流并释放缓冲区
+static void closeStream(LogStream* stream) {
+    if (stream->file != NULL) {
+        fclose(stream->file);
+    }
+    free(stream->buffers[0]);
+    free(stream->buffers[1]);
+    memset(stream, 0, sizeof(LogStream));
+}
 
 // 初始化日志系统
 void initLogging(LogMode mode) {
     const char* modeStr = (mode == LOG_OVERWRITE) ? "w" : "a";
     
     // 打开运行日志文件
-    logFile = fopen("bct.log", modeStr);
-    if (logFile == NULL) {
+    openStream(&logStream, "bct.log", modeStr);
+    if (logStream.file == NULL) {
         printf("Warning: Cannot open log file bct.log\n");
     }
     
     // 打开错误日志文件
-    errorLogFile = fopen("error.log", modeStr);
-    if (errorLogFile == NULL) {
+    openStream(&errorStream, "error.log", modeStr);
+    if (errorStream.file == NULL) {
         printf("Warning: Cannot open error log file error.log\n");
     }
     
-    // 写入日志头
-    if (logFile != NULL) {
-        time_t now = time(NULL);
-        char timeStr[64];
-        strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", localtime(&now));
-        fprintf(logFile, "=== BCT Log Started at %s ===\n", timeStr);
-        fflush(logFile);
+    // 启动后台写入线程，失败时退回到直接写入
+    stopping = 0;
+    requestedFlush = 0;
+    completedFlush = 0;
+    logMutex = createMutex();
+    writerCondition = createCondition();
+    writtenCondition = createCondition();
+    if (logMutex != NULL && writerCondition != NULL && writtenCondition != NULL) {
+        writerThread = startThread(writerMain, NULL);
     }
     
-    if (errorLogFile != NULL) {
-        time_t now = time(NULL);
-        char timeStr[64];
-        strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", localtime(&now));
-        fprintf(errorLogFile, "=== BCT Error Log Started at %s ===\n", timeStr);
-        fflush(errorLogFile);
-    }
+    // 写入日志头
+    char header[128];
+    int length = snprintf(header, sizeof(header), "=== BCT Log Started at %s ===\n", getTimestamp());
+    submitLine(&logStream, header, (size_t)length, 1);
+    length = snprintf(header, sizeof(header), "=== BCT Error Log Started at %s ===\n", getTimestamp());
+    submitLine(&errorStream, header, (size_t)length, 1);
 }
 
 // 记录日志消息
 void logMessage(LogLevel level, const char* format, ...) {
-    if (logFile == NULL) return;
-    
-    time_t now = time(NULL);
-    char timeStr[64];
-    strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", localtime(&now));
+    if (logStream.file == NULL || level < minimumLevel) return;
     
     const char* levelStr;
     switch (level) {
@@ -57,48 +274,76 @@ void logMessage(LogLevel level, const char* format, ...) {
         default: levelStr = "UNKNOWN"; break;
     }
     
-    fprintf(logFile, "[%s] [%s] ", timeStr, levelStr);
+    // 在线程自己的缓冲区中格式化，末尾保留换行符的位置
+    int length = snprintf(lineBuffer, LOG_LINE_SIZE, "[%s] [%s] ", getTimestamp(), levelStr);
     
     va_list args;
     va_start(args, format);
-    vfprintf(logFile, format, args);
+    int written = vsnprintf(lineBuffer + length, LOG_LINE_SIZE - length - 1, format, args);
     va_end(args);
     
-    fprintf(logFile, "\n");
-    fflush(logFile);
+    if (written > 0) {
+        length += (written < LOG_LINE_SIZE - length - 1) ? written : LOG_LINE_SIZE - length - 2;
+    }
+    lineBuffer[length++] = '\n';
+    submitLine(&logStream, lineBuffer, (size_t)length, shouldWriteImmediately(level));
 }
 
-// 记录命令错误
-void logCommandError(const char* command, const char* filename, int errorCode) {
-    if (errorLogFile == NULL) return;
+// 记录命令错误（不受最低级别限制），output 为命令最后的输出（可为 NULL），附在错误记录之后
+// 启用重试时（maxAttempts 大于 1）每次尝试各记录一条，并注明是第几次尝试
+void logCommandError(const char* command, const char* filename, int errorCode, int attempt, int maxAttempts, const char* output) {
+    if (errorStream.file == NULL) return;
     
-    time_t now = time(NULL);
-    char timeStr[64];
-    strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", localtime(&now));
+    char attemptText[64] = "";
+    if (maxAttempts > 1) {
+        snprintf(attemptText, sizeof(attemptText), "Attempt: %d of %d\n", attempt, maxAttempts);
+    }
     
-    fprintf(errorLogFile, "[%s] Command failed: %s\n", timeStr, command);
-    fprintf(errorLogFile, "File: %s\n", filename);
-    fprintf(errorLogFile, "Error code: %d\n\n", errorCode);
-    fflush(errorLogFile);
+    int length;
+    if (output != NULL && output[0] != '\0') {
+        length = snprintf(lineBuffer, LOG_LINE_SIZE, "[%s] Command failed: %s\nFile: %s\nError code: %d\n%sOutput (last lines):\n%s\n\n", getTimestamp(), command, filename, errorCode, attemptText, output);
+    } else {
+        length = snprintf(lineBuffer, LOG_LINE_SIZE, "[%s] Command failed: %s\nFile: %s\nError code: %d\n%s\n", getTimestamp(), command, filename, errorCode, attemptText);
+    }
+    if (length < 0) {
+        return;
+    }
+    if (length >= LOG_LINE_SIZE) {
+        length = LOG_LINE_SIZE - 1;
+    }
+    submitLine(&errorStream, lineBuffer, (size_t)length, shouldWriteImmediately(LOG_ERROR));
 }
 
-// 关闭日志系统
+// 关闭日志系统：写入日志尾，等待后台线程写完所有缓冲数据
 void closeLogging() {
-    if (logFile != NULL) {
-        time_t now = time(NULL);
-        char timeStr[64];
-        strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", localtime(&now));
-        fprintf(logFile, "=== BCT Log Ended at %s ===\n\n", timeStr);
-        fclose(logFile);
-        logFile = NULL;
-    }
-    
-    if (errorLogFile != NULL) {
-        time_t now = time(NULL);
-        char timeStr[64];
-        strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", localtime(&now));
-        fprintf(errorLogFile, "=== BCT Error Log Ended at %s ===\n\n", timeStr);
-        fclose(errorLogFile);
-        errorLogFile = NULL;
+    char footer[128];
+    int length = snprintf(footer, sizeof(footer), "=== BCT Log Ended at %s ===\n\n", getTimestamp());
+    submitLine(&logStream, footer, (size_t)length, 0);
+    length = snprintf(footer, sizeof(footer), "=== BCT Error Log Ended at %s ===\n\n", getTimestamp());
+    submitLine(&errorStream, footer, (size_t)length, 0);
+    
+    if (writerThread != NULL) {
+        lockMutex(logMutex);
+        stopping = 1;
+        signalCondition(writerCondition);
+        unlockMutex(logMutex);
+        joinThread(writerThread);
+        writerThread = NULL;
+    }
+    
+    closeStream(&logStream);
+    closeStream(&errorStream);
+    
+    if (writtenCondition != NULL) {
+        destroyCondition(writtenCondition);
+        writtenCondition = NULL;
+    }
+    if (writerCondition != NULL) {
+        destroyCondition(writerCondition);
+        writerCondition = NULL;
+    }
+    if (logMutex != NULL) {
+        destroyMutex(logMutex);
+        logMutex = NULL;
     }
 }
\ No newline at end of file
@@ -16,10 +16,21 @@ typedef enum {
     LOG_APPEND
 } LogMode;
 
+// 日志写入策略：日志由后台线程批量写入，以下策略决定哪些消息需要等待写入完成后才返回
+typedef enum {
+    LOG_FLUSH_ALWAYS,       // 每条消息都立即写入
+    LOG_FLUSH_ERRORS,       // 错误立即写入，其余批量写入（默认）
+    LOG_FLUSH_BATCHED       // 全部批量写入
+} LogFlushPolicy;
+
 // 函数声明
+void setLogLevel(LogLevel level);
+void setLogFlushPolicy(LogFlushPolicy policy);
+int parseLogLevel(const char* text, LogLevel* level);
+int parseLogFlushPolicy(const char* text, LogFlushPolicy* policy);
 void initLogging(LogMode mode);
 void logMessage(LogLevel level, const char* format, ...);
-void logCommandError(const char* command, const char* filename, int errorCode);
+void logCommandError(const char* command, const char* filename, int errorCode, int attempt, int maxAttempts, const char* output);
 void closeLogging();
 
 #endif
\ No newline at end of file
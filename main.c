@@ -2,135 +2,942 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
 #include "file_utils.h"
 #include "platform_utils.h"
 #include "log_utils.h"
+#include "template_utils.h"
+#include "report_utils.h"
+#include "filter_utils.h"
+#include "scan_utils.h"
+#include "sched_utils.h"
+#include "order_utils.h"
+#include "capture_utils.h"
+#include "watch_utils.h"
+#include "remote_utils.h"
+#include "index_utils.h"
+#include "path_utils.h"
 
 #ifdef _WIN32
 #include <windows.h>
 #endif
 
-int main() {
+// 打印命令行用法
+static void printUsage(const char* program) {
+    printf("Usage: %s [options]\n", program);
+    printf("Values not given as options are asked for interactively.\n");
+    printf("  --input DIR         Folder to process\n");
+    printf("  --output DIR        Output folder\n");
+    printf("  --command CMD       Processing command (see the placeholders in the interactive prompt)\n");
+    printf("  --exclude EXTS      File extensions to exclude, separated by spaces or commas\n");
+    printf("  --include GLOB      Only process files matching GLOB (repeatable; e.g. *.mp4, raw/**/*.wav)\n");
+    printf("  --ignore GLOB       Leave files matching GLOB out entirely (repeatable)\n");
+    printf("  --min-size SIZE     Skip files smaller than SIZE (suffixes K, M, G, T)\n");
+    printf("  --max-size SIZE     Skip files larger than SIZE\n");
+    printf("  --newer-than TIME   Skip files modified before TIME (YYYY-MM-DD[ HH:MM[:SS]], @epoch or a reference file)\n");
+    printf("  --older-than TIME   Skip files modified at or after TIME\n");
+    printf("  --prune PATTERN     Do not descend into directories matching PATTERN (repeatable; e.g. .git, cache, proxy/*)\n");
+    printf("  --max-depth N       Only process files up to N levels below the input folder\n");
+    printf("  --one-file-system   Do not descend into directories on other file systems (mount points)\n");
+    printf("  --no-follow         Do not descend into symbolic links, junctions or other reparse points\n");
+    printf("  --scan-threads N    List directories with N threads in parallel (helps on network shares; default: 1)\n");
+    printf("  --scan-order O      With --scan-threads: completion (fastest) or tree (same order as a single-threaded scan)\n");
+    printf("  --scan-index        Keep an index of the input tree in the output folder and only list folders changed since the last run\n");
+    printf("                      (files rewritten in place keep their old size and time until their folder changes;\n");
+    printf("                      with --incremental every file in an unchanged folder is still checked, which costs one stat per file)\n");
+    printf("  --rescan            List every folder again and rewrite the scan index (implies --scan-index)\n");
+    printf("  --copy-on-error     Copy the source file to the output folder when the command fails\n");
+    printf("  --log-mode M        overwrite or append to existing log files (default: append)\n");
+    printf("  --files-from F      Process the files listed in F (- for stdin) instead of scanning the input folder\n");
+    printf("  -0, --null          File list entries are separated by NUL instead of newlines\n");
+    printf("  -j, --jobs N        Run up to N commands in parallel (default: number of CPUs)\n");
+    printf("  --adaptive          Vary the number of parallel jobs (up to -j) with system load and free memory\n");
+    printf("  --mem-per-job SIZE  Memory budget per job for --adaptive (implies --adaptive; default: largest peak seen so far)\n");
+    printf("  --nice N            Run commands with niceness N (-20 to 19; positive values yield to other programs)\n");
+    printf("  --pin MODE          Pin commands round-robin to CPUs: none, cores or numa (default: none)\n");
+    printf("  --order O           Job start order: scan, largest (biggest inputs first) or history (slowest in --history first)\n");
+    printf("  --weights LIST      Cost weights by extension for --order largest, e.g. mp4=10,mov=8,jpg=0.1 (others: 1)\n");
+    printf("  --history FILE      --report file of a previous run, used by --order history\n");
+    printf("  --capture MODE      Command output: failed (keep the last output, save it for failed commands), all or none (default: failed)\n");
+    printf("  --job-logs DIR      Folder for captured command output, one .log per input file (default: %s)\n", DEFAULT_JOB_LOG_DIRECTORY);
+    printf("  --error-tail N      Last N output lines added to error.log for failed commands (0 to disable; default: %d)\n", DEFAULT_ERROR_TAIL_LINES);
+    printf("  -v, --verbose       Print every file as it is processed instead of a single status line\n");
+    printf("  -q, --quiet         Print only errors and the final summary (per-file details still go to bct.log)\n");
+    printf("  --timeout TIME      Terminate a command (and everything it started) that runs longer than TIME (e.g. 90, 30m, 2h)\n");
+    printf("  --stall-timeout T   Terminate a command that produces no output and does not grow its output file for T\n");
+    printf("  --retries N         Retry failed commands up to N times (default: 0)\n");
+    printf("  --retry-delay TIME  Wait before the first retry, doubled for each further retry up to 60s (default: 1s)\n");
+    printf("  --stream            Start running commands while the input tree is still being scanned\n");
+    printf("  --watch             Keep running: after the existing files, process new and changed files until Ctrl+C\n");
+    printf("  --settle TIME       With --watch: wait until a file has been closed and left alone for TIME (default: 1s)\n");
+    printf("  --incremental       Skip files whose inputs and command are unchanged since the last run\n");
+    printf("  --shard K/N         Only process the files of shard K out of N (assigned by a hash of the relative path)\n");
+    printf("  --serve ADDRESS     Scan and hand out files to --worker instances instead of running commands\n");
+    printf("                      (ADDRESS: [host]:port, or unix:PATH on Linux/macOS; finished files go to the manifest)\n");
+    printf("  --worker ADDRESS    Take files and the command from the --serve instance at ADDRESS and report the results\n");
+    printf("  --shell             Run commands through the shell (needed for pipes and redirection)\n");
+    printf("  --batch-size N      With %%I in the command: pass up to N files of one folder to each command (default: %d)\n", DEFAULT_BATCH_SIZE);
+    printf("  --max-command-length SIZE  Longest command line a batch may produce (default: %d, %d with --shell)\n", DEFAULT_MAX_COMMAND_LENGTH, DEFAULT_MAX_SHELL_COMMAND_LENGTH);
+    printf("  --log-level L       Minimum level written to bct.log: info, warning or error (default: info)\n");
+    printf("  --log-flush P       When log messages reach the disk: always, error or batched (default: error)\n");
+    printf("  --copy-mode M       How unchanged files are copied: auto, copy, reflink, hardlink or symlink (default: auto)\n");
+    printf("  --report FILE       Write a JSON report with per-job timings, CPU and memory use\n");
+    printf("  --report-slowest N  Number of slowest jobs listed in the report (default: %d)\n", DEFAULT_REPORT_SLOWEST);
+}
+
+// 安静模式：只输出错误、警告和最终汇总，横幅、文件树等提示信息只写入日志
+static int quietOutput = 0;
+
+// 辅助函数：输出提示信息（安静模式下不输出，日志由调用方另行记录）
+static void printInfo(const char* format, ...) {
+    if (quietOutput) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+// 辅助函数：显示提示并读取一行输入（去掉换行符），输入结束时得到空字符串
+static void promptLine(const char* prompt, char* buffer, int bufferSize) {
+    printf("%s", prompt);
+    if (fgets(buffer, bufferSize, stdin) == NULL) {
+        buffer[0] = '\0';
+    }
+    buffer[strcspn(buffer, "\r\n")] = 0;
+}
+
+// 辅助函数：把选项值复制到缓冲区，缺少值或过长时返回 -1
+static int copyOptionValue(char* buffer, size_t bufferSize, const char* value, const char* name) {
+    if (value == NULL) {
+        printf("Error: %s requires a value\n", name);
+        return -1;
+    }
+    if (strlen(value) >= bufferSize) {
+        printf("Error: Value of %s is too long\n", name);
+        return -1;
+    }
+    strcpy(buffer, value);
+    return 0;
+}
+
+// 解析 1 到 maximum 之间的整数参数，失败时返回 -1
+static int parsePositiveInt(const char* text, int maximum) {
+    char* end = NULL;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || value < 1 || value > maximum) {
+        return -1;
+    }
+    return (int)value;
+}
+
+// 辅助函数：解析 --min-size/--max-size 的值，失败时打印错误并返回 -1
+static int parseSizeOption(const char* value, const char* name, long long* size) {
+    if (value == NULL || parseSizeValue(value, size) != 0) {
+        printf("Error: %s expects a size such as 500K, 20M or 1G\n", name);
+        return -1;
+    }
+    return 0;
+}
+
+// 辅助函数：解析 --newer-than/--older-than 的值，失败时打印错误并返回 -1
+static int parseTimeOption(const char* value, const char* name, long long* time) {
+    if (value == NULL || parseTimeValue(value, time) != 0) {
+        printf("Error: %s expects YYYY-MM-DD[ HH:MM[:SS]], @epoch or an existing file\n", name);
+        return -1;
+    }
+    return 0;
+}
+
+// 辅助函数：解析时长（秒，可带小数；后缀 ms、s、m、h），转换为毫秒，失败时打印错误并返回 -1
+static int parseDurationOption(const char* value, const char* name, long long* milliseconds) {
+    char* end = NULL;
+    double amount = (value != NULL) ? strtod(value, &end) : -1;
+    double scale = 1000;
+    if (value != NULL && end != value) {
+        if (strcmp(end, "ms") == 0) {
+            scale = 1;
+        } else if (strcmp(end, "m") == 0) {
+            scale = 60 * 1000;
+        } else if (strcmp(end, "h") == 0) {
+            scale = 3600 * 1000;
+        } else if (strcmp(end, "s") != 0 && *end != '\0') {
+            amount = -1;
+        }
+    }
+    if (value == NULL || end == value || amount < 0 || amount * scale > 1e15) {
+        printf("Error: %s expects a duration such as 90, 30s, 10m or 2h\n", name);
+        return -1;
+    }
+    *milliseconds = (long long)(amount * scale + 0.5);
+    return 0;
+}
+
+// 辅助函数：匹配带值的长选项（--name VALUE 或 --name=VALUE）
+// 不匹配返回 0；匹配时 *value 指向选项值，缺少值时 *value 为 NULL
+static int matchOption(int argc, char* argv[], int* index, const char* name, const char** value) {
+    size_t nameLength = strlen(name);
+    const char* arg = argv[*index];
+    if (strncmp(arg, name, nameLength) != 0) {
+        return 0;
+    }
+    if (arg[nameLength] == '=') {
+        *value = arg + nameLength + 1;
+        return 1;
+    }
+    if (arg[nameLength] != '\0') {
+        return 0;
+    }
+    *value = (*index + 1 < argc) ? argv[++*index] : NULL;
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
 #ifdef _WIN32
     // 设置控制台输出为UTF-8编码
     SetConsoleOutputCP(CP_UTF8);
     SetConsoleCP(CP_UTF8);
 #endif
     
-    char inputPath[MAX_PATH_LENGTH];
-    char outputPath[MAX_PATH_LENGTH];
-    char command[MAX_COMMAND_LENGTH];
-    char excludeExtensions[MAX_EXTENSIONS_LENGTH];
+    char inputPath[MAX_PATH_LENGTH] = "";
+    char outputPath[MAX_PATH_LENGTH] = "";
+    char command[MAX_COMMAND_LENGTH] = "";
+    char excludeExtensions[MAX_EXTENSIONS_LENGTH] = "";
     char choice[10];
     int copyOnError = 0;
+    int copyOnErrorGiven = 0;
+    int excludeGiven = 0;
+    int logModeGiven = 0;
+    LogMode logMode = LOG_APPEND;
+    const char* filesFrom = NULL;
+    const char* reportPath = NULL;
+    int reportSlowest = DEFAULT_REPORT_SLOWEST;
+    int nullSeparated = 0;
+    int maxJobs = getProcessorCount();
+    int streaming = 0;
+    int incremental = 0;
+    int useShell = 0;
+    CopyMode copyMode = COPY_AUTO;
+    long long minSize = -1;
+    long long maxSize = -1;
+    long long newerThan = LLONG_MIN;
+    long long olderThan = LLONG_MAX;
+    unsigned int traversalFlags = 0;
+    int scanThreads = 1;
+    int scanIndex = 0;
+    int rescan = 0;
+    int adaptive = 0;
+    long long memoryPerJob = 0;
+    int niceness = 0;
+    PinMode pinMode = PIN_NONE;
+    ScanOrder scanOrder = SCAN_ORDER_COMPLETION;
+    OrderOptions orderOptions = {ORDER_SCAN, NULL, NULL, VERBOSITY_NORMAL};
+    CaptureMode captureMode = CAPTURE_FAILED;
+    const char* jobLogDirectory = DEFAULT_JOB_LOG_DIRECTORY;
+    int errorTailLines = DEFAULT_ERROR_TAIL_LINES;
+    Verbosity verbosity = VERBOSITY_NORMAL;
+    long long timeoutMs = 0;
+    long long stallTimeoutMs = 0;
+    int retries = 0;
+    long long retryDelayMs = 1000;
+    int watching = 0;
+    long long settleMs = DEFAULT_SETTLE_MS;
+    int batchSize = DEFAULT_BATCH_SIZE;
+    int shardIndex = 0;
+    int shardCount = 0;
+    const char* serveAddress = NULL;
+    const char* workerAddress = NULL;
+    long long maxCommandLength = 0;
+    
+    // 包含/忽略模式在解析选项时直接编译进过滤器
+    FileFilter* filter = createFilter();
+    if (filter == NULL) {
+        printf("Error: Out of memory\n");
+        return 1;
+    }
+    
+    // 解析命令行参数
+    for (int i = 1; i < argc; i++) {
+        const char* value = NULL;
+        if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) {
+            if (i + 1 >= argc) {
+                printf("Error: %s requires a value\n", argv[i]);
+                printUsage(argv[0]);
+                return 1;
+            }
+            value = argv[++i];
+        } else if (strncmp(argv[i], "-j", 2) == 0) {
+            value = argv[i] + 2;
+        } else if (strncmp(argv[i], "--jobs=", 7) == 0) {
+            value = argv[i] + 7;
+        } else if (matchOption(argc, argv, &i, "--input", &value)) {
+            if (copyOptionValue(inputPath, sizeof(inputPath), value, "--input") != 0) {
+                return 1;
+            }
+            continue;
+        } else if (matchOption(argc, argv, &i, "--output", &value)) {
+            if (copyOptionValue(outputPath, sizeof(outputPath), value, "--output") != 0) {
+                return 1;
+            }
+            continue;
+        } else if (matchOption(argc, argv, &i, "--command", &value)) {
+            if (copyOptionValue(command, sizeof(command), value, "--command") != 0) {
+                return 1;
+            }
+            continue;
+        } else if (matchOption(argc, argv, &i, "--exclude", &value)) {
+            if (copyOptionValue(excludeExtensions, sizeof(excludeExtensions), value, "--exclude") != 0) {
+                return 1;
+            }
+            excludeGiven = 1;
+            continue;
+        } else if (matchOption(argc, argv, &i, "--include", &value)) {
+            if (value == NULL || addIncludePattern(filter, value) != 0) {
+                printf("Error: --include requires a valid pattern\n");
+                return 1;
+            }
+            continue;
+        } else if (matchOption(argc, argv, &i, "--ignore", &value)) {
+            if (value == NULL || addIgnorePattern(filter, value) != 0) {
+                printf("Error: --ignore requires a valid pattern\n");
+                return 1;
+            }
+            continue;
+        } else if (matchOption(argc, argv, &i, "--prune", &value)) {
+            if (value == NULL || addPrunePattern(filter, value) != 0) {
+                printf("Error: --prune requires a valid pattern\n");
+                return 1;
+            }
+            continue;
+        } else if (matchOption(argc, argv, &i, "--max-depth", &value)) {
+            int maxDepth = (value != NULL) ? parsePositiveInt(value, 65535) : -1;
+            if (maxDepth < 0) {
+                printf("Error: --max-depth expects a positive number\n");
+                return 1;
+            }
+            setMaxDepth(filter, maxDepth);
+            continue;
+        } else if (matchOption(argc, argv, &i, "--scan-threads", &value)) {
+            scanThreads = (value != NULL) ? parsePositiveInt(value, MAX_SCAN_THREADS) : -1;
+            if (scanThreads < 0) {
+                printf("Error: --scan-threads expects a number from 1 to %d\n", MAX_SCAN_THREADS);
+                return 1;
+            }
+            continue;
+        } else if (matchOption(argc, argv, &i, "--scan-order", &value)) {
+            if (value == NULL || parseScanOrder(value, &scanOrder) != 0) {
+                printf("Error: --scan-order expects completion or tree\n");
+                return 1;
+            }
+            continue;
+        } else if (strcmp(argv[i], "--scan-index") == 0) {
+            scanIndex = 1;
+            continue;
+        } else if (strcmp(argv[i], "--rescan") == 0) {
+            scanIndex = 1;
+            rescan = 1;
+            continue;
+        } else if (strcmp(argv[i], "--one-file-system") == 0) {
+            traversalFlags |= TRAVERSE_ONE_FILE_SYSTEM;
+            continue;
+        } else if (strcmp(argv[i], "--no-follow") == 0) {
+            traversalFlags |= TRAVERSE_NO_FOLLOW;
+            continue;
+        } else if (matchOption(argc, argv, &i, "--min-size", &value)) {
+            if (parseSizeOption(value, "--min-size", &minSize) != 0) {
+                return 1;
+            }
+            continue;
+        } else if (matchOption(argc, argv, &i, "--max-size", &value)) {
+            if (parseSizeOption(value, "--max-size", &maxSize) != 0) {
+                return 1;
+            }
+            continue;
+        } else if (matchOption(argc, argv, &i, "--newer-than", &value)) {
+            if (parseTimeOption(value, "--newer-than", &newerThan) != 0) {
+                return 1;
+            }
+            continue;
+        } else if (matchOption(argc, argv, &i, "--older-than", &value)) {
+            if (parseTimeOption(value, "--older-than", &olderThan) != 0) {
+                return 1;
+            }
+            continue;
+        } else if (strcmp(argv[i], "--copy-on-error") == 0) {
+            copyOnError = 1;
+            copyOnErrorGiven = 1;
+            continue;
+        } else if (matchOption(argc, argv, &i, "--log-mode", &value)) {
+            if (value != NULL && strcmp(value, "overwrite") == 0) {
+                logMode = LOG_OVERWRITE;
+            } else if (value != NULL && strcmp(value, "append") == 0) {
+                logMode = LOG_APPEND;
+            } else {
+                printf("Error: --log-mode expects overwrite or append\n");
+                return 1;
+            }
+            logModeGiven = 1;
+            continue;
+        } else if (matchOption(argc, argv, &i, "--files-from", &value)) {
+            if (value == NULL) {
+                printf("Error: --files-from requires a value\n");
+                return 1;
+            }
+            filesFrom = value;
+            continue;
+        } else if (strcmp(argv[i], "-0") == 0 || strcmp(argv[i], "--null") == 0) {
+            nullSeparated = 1;
+            continue;
+        } else if (strcmp(argv[i], "--adaptive") == 0) {
+            adaptive = 1;
+            continue;
+        } else if (matchOption(argc, argv, &i, "--mem-per-job", &value)) {
+            if (parseSizeOption(value, "--mem-per-job", &memoryPerJob) != 0) {
+                return 1;
+            }
+            adaptive = 1;
+            continue;
+        } else if (matchOption(argc, argv, &i, "--nice", &value)) {
+            char* end = NULL;
+            long parsed = (value != NULL) ? strtol(value, &end, 10) : 0;
+            if (value == NULL || end == value || *end != '\0' || parsed < -20 || parsed > 19) {
+                printf("Error: --nice expects a number from -20 to 19\n");
+                return 1;
+            }
+            niceness = (int)parsed;
+            continue;
+        } else if (matchOption(argc, argv, &i, "--pin", &value)) {
+            if (value == NULL || parsePinMode(value, &pinMode) != 0) {
+                printf("Error: --pin expects none, cores or numa\n");
+                return 1;
+            }
+            continue;
+        } else if (matchOption(argc, argv, &i, "--order", &value)) {
+            if (value == NULL || parseJobOrder(value, &orderOptions.order) != 0) {
+                printf("Error: --order expects scan, largest or history\n");
+                return 1;
+            }
+            continue;
+        } else if (matchOption(argc, argv, &i, "--weights", &value)) {
+            if (value == NULL || validateWeights(value) != 0) {
+                printf("Error: --weights expects a list such as mp4=10,mov=8,jpg=0.1\n");
+                return 1;
+            }
+            orderOptions.weights = value;
+            continue;
+        } else if (matchOption(argc, argv, &i, "--history", &value)) {
+            if (value == NULL) {
+                printf("Error: --history requires a value\n");
+                return 1;
+            }
+            orderOptions.historyPath = value;
+            continue;
+        } else if (matchOption(argc, argv, &i, "--capture", &value)) {
+            if (value == NULL || parseCaptureMode(value, &captureMode) != 0) {
+                printf("Error: --capture expects failed, all or none\n");
+                return 1;
+            }
+            continue;
+        } else if (matchOption(argc, argv, &i, "--job-logs", &value)) {
+            if (value == NULL || value[0] == '\0') {
+                printf("Error: --job-logs requires a value\n");
+                return 1;
+            }
+            jobLogDirectory = value;
+            continue;
+        } else if (matchOption(argc, argv, &i, "--error-tail", &value)) {
+            errorTailLines = (value == NULL) ? -1 : (strcmp(value, "0") == 0 ? 0 : parsePositiveInt(value, 10000));
+            if (errorTailLines < 0) {
+                printf("Error: --error-tail expects a number from 0 to 10000\n");
+                return 1;
+            }
+            continue;
+        } else if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verbose") == 0) {
+            verbosity = VERBOSITY_VERBOSE;
+            continue;
+        } else if (strcmp(argv[i], "-q") == 0 || strcmp(argv[i], "--quiet") == 0) {
+            verbosity = VERBOSITY_QUIET;
+            continue;
+        } else if (matchOption(argc, argv, &i, "--timeout", &value)) {
+            if (parseDurationOption(value, "--timeout", &timeoutMs) != 0) {
+                return 1;
+            }
+            continue;
+        } else if (matchOption(argc, argv, &i, "--stall-timeout", &value)) {
+            if (parseDurationOption(value, "--stall-timeout", &stallTimeoutMs) != 0) {
+                return 1;
+            }
+            continue;
+        } else if (matchOption(argc, argv, &i, "--retries", &value)) {
+            retries = (value == NULL) ? -1 : (strcmp(value, "0") == 0 ? 0 : parsePositiveInt(value, 100));
+            if (retries < 0) {
+                printf("Error: --retries expects a number from 0 to 100\n");
+                return 1;
+            }
+            continue;
+        } else if (matchOption(argc, argv, &i, "--retry-delay", &value)) {
+            if (parseDurationOption(value, "--retry-delay", &retryDelayMs) != 0) {
+                return 1;
+            }
+            continue;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            streaming = 1;
+            continue;
+        } else if (strcmp(argv[i], "--watch") == 0) {
+            watching = 1;
+            continue;
+        } else if (matchOption(argc, argv, &i, "--settle", &value)) {
+            if (parseDurationOption(value, "--settle", &settleMs) != 0) {
+                return 1;
+            }
+            if (settleMs > INT_MAX) {
+                settleMs = INT_MAX;
+            }
+            continue;
+        } else if (strcmp(argv[i], "--incremental") == 0) {
+            incremental = 1;
+            continue;
+        } else if (matchOption(argc, argv, &i, "--shard", &value)) {
+            char extra;
+            if (value == NULL || sscanf(value, "%d/%d%c", &shardIndex, &shardCount, &extra) != 2 || shardIndex < 1 || shardIndex > shardCount) {
+                printf("Error: --shard expects K/N with 1 <= K <= N, e.g. 2/4\n");
+                return 1;
+            }
+            continue;
+        } else if (matchOption(argc, argv, &i, "--serve", &value)) {
+            if (value == NULL || value[0] == '\0') {
+                printf("Error: --serve requires an address such as :7070\n");
+                return 1;
+            }
+            serveAddress = value;
+            continue;
+        } else if (matchOption(argc, argv, &i, "--worker", &value)) {
+            if (value == NULL || value[0] == '\0') {
+                printf("Error: --worker requires the address of the --serve instance\n");
+                return 1;
+            }
+            workerAddress = value;
+            continue;
+        } else if (strcmp(argv[i], "--shell") == 0) {
+            useShell = 1;
+            continue;
+        } else if (matchOption(argc, argv, &i, "--batch-size", &value)) {
+            batchSize = (value == NULL) ? -1 : parsePositiveInt(value, 100000);
+            if (batchSize < 0) {
+                printf("Error: --batch-size expects a number from 1 to 100000\n");
+                return 1;
+            }
+            continue;
+        } else if (matchOption(argc, argv, &i, "--max-command-length", &value)) {
+            if (parseSizeOption(value, "--max-command-length", &maxCommandLength) != 0) {
+                return 1;
+            }
+            continue;
+        } else if (matchOption(argc, argv, &i, "--log-level", &value)) {
+            LogLevel level;
+            if (value == NULL || parseLogLevel(value, &level) != 0) {
+                printf("Error: --log-level expects info, warning or error\n");
+                return 1;
+            }
+            setLogLevel(level);
+            continue;
+        } else if (matchOption(argc, argv, &i, "--log-flush", &value)) {
+            LogFlushPolicy policy;
+            if (value == NULL || parseLogFlushPolicy(value, &policy) != 0) {
+                printf("Error: --log-flush expects always, error or batched\n");
+                return 1;
+            }
+            setLogFlushPolicy(policy);
+            continue;
+        } else if (matchOption(argc, argv, &i, "--copy-mode", &value)) {
+            if (value == NULL || parseCopyMode(value, &copyMode) != 0) {
+                printf("Error: --copy-mode expects auto, copy, reflink, hardlink or symlink\n");
+                return 1;
+            }
+            continue;
+        } else if (matchOption(argc, argv, &i, "--report", &value)) {
+            if (value == NULL) {
+                printf("Error: --report requires a value\n");
+                return 1;
+            }
+            reportPath = value;
+            continue;
+        } else if (matchOption(argc, argv, &i, "--report-slowest", &value)) {
+            reportSlowest = (value != NULL) ? parsePositiveInt(value, 1000000) : -1;
+            if (reportSlowest < 0) {
+                printf("Error: --report-slowest expects a positive number\n");
+                return 1;
+            }
+            continue;
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            printUsage(argv[0]);
+            return 0;
+        } else {
+            printf("Error: Unknown option %s\n", argv[i]);
+            printUsage(argv[0]);
+            return 1;
+        }
+        
+        maxJobs = parsePositiveInt(value, MAX_PARALLEL_JOBS);
+        if (maxJobs < 0) {
+            printf("Error: Invalid job count %s (expected 1-%d)\n", value, MAX_PARALLEL_JOBS);
+            return 1;
+        }
+    }
+    if (maxJobs > MAX_PARALLEL_JOBS) {
+        maxJobs = MAX_PARALLEL_JOBS;
+    }
+    if (orderOptions.order == ORDER_HISTORY && orderOptions.historyPath == NULL) {
+        printf("Error: --order history requires --history with the report of a previous run\n");
+        return 1;
+    }
+    if (watching && filesFrom != NULL) {
+        printf("Error: --watch cannot be combined with --files-from\n");
+        return 1;
+    }
+    if (serveAddress != NULL && workerAddress != NULL) {
+        printf("Error: --serve and --worker cannot be combined\n");
+        return 1;
+    }
+    if (workerAddress != NULL) {
+        // 工作者不扫描，文件、命令和增量判断都由协调者负责
+        if (streaming || watching || filesFrom != NULL || shardCount > 0) {
+            printf("Error: --worker takes its files from the coordinator; use --stream, --watch, --files-from and --shard there\n");
+            return 1;
+        }
+        if (command[0] != '\0' || useShell || incremental) {
+            printf("Error: --worker takes the command from the coordinator; use --command, --shell and --incremental there\n");
+            return 1;
+        }
+    }
+    if (scanIndex && (filesFrom != NULL || workerAddress != NULL)) {
+        printf("Warning: --scan-index is ignored with --files-from and --worker\n");
+        scanIndex = 0;
+    }
+    if (scanIndex && scanThreads > 1) {
+        // 使用索引时大部分目录不再列举，每个目录只需 stat 一次
+        printf("Warning: --scan-threads is ignored with --scan-index\n");
+    }
+    if (orderOptions.order != ORDER_SCAN && (streaming || watching || filesFrom != NULL)) {
+        // 流式扫描、监视模式和文件列表在全部文件已知之前就开始执行，无法整体排序
+        printf("Warning: --order is ignored with --stream, --watch and --files-from\n");
+        orderOptions.order = ORDER_SCAN;
+    }
+    
+    // 输入目录、命令和输出目录都已由选项给出时不进行任何交互
+    int interactive = (inputPath[0] == '\0' || (command[0] == '\0' && workerAddress == NULL) || outputPath[0] == '\0');
+    if (interactive && filesFrom != NULL && strcmp(filesFrom, "-") == 0) {
+        printf("Error: --files-from - reads the list from stdin, so --input, --output and --command are required\n");
+        return 1;
+    }
+    setSizeRange(filter, minSize, maxSize);
+    setModifiedRange(filter, newerThan, olderThan);
+    setTraversalFlags(filter, traversalFlags);
+    setShard(filter, shardIndex - 1, shardCount);
+    
+    // 排除扩展名已知时在扫描中一并求值，交互输入的扩展名在扫描之后再补充标记
+    int extensionsCompiled = 0;
+    if (excludeGiven || !interactive) {
+        addExcludedExtensions(filter, excludeExtensions);
+        extensionsCompiled = 1;
+    }
     
     // 询问日志模式
-    printf("Log file mode:\n");
-    printf("1. Overwrite existing log files\n");
-    printf("2. Append to existing log files\n");
-    printf("Choose (1/2): ");
-    fgets(choice, 10, stdin);
-    choice[strcspn(choice, "\n")] = 0;
-    
-    LogMode logMode = (choice[0] == '1') ? LOG_OVERWRITE : LOG_APPEND;
+    if (interactive && !logModeGiven) {
+        printf("Log file mode:\n");
+        printf("1. Overwrite existing log files\n");
+        printf("2. Append to existing log files\n");
+        promptLine("Choose (1/2): ", choice, sizeof(choice));
+        logMode = (choice[0] == '1') ? LOG_OVERWRITE : LOG_APPEND;
+    }
     initLogging(logMode);
+    quietOutput = (verbosity == VERBOSITY_QUIET);
+    orderOptions.verbosity = verbosity;
     
     logMessage(LOG_INFO, "BCT started");
     
-    printf("Batch Command Tree (BCT) - File Processing Utility\n");
+    printInfo("Batch Command Tree (BCT) - File Processing Utility\n");
     logMessage(LOG_INFO, "Batch Command Tree (BCT) - File Processing Utility");
     
-    printf("Enter the folder path to process: ");
-    fgets(inputPath, MAX_PATH_LENGTH, stdin);
-    inputPath[strcspn(inputPath, "\n")] = 0;
+    if (inputPath[0] == '\0') {
+        promptLine("Enter the folder path to process: ", inputPath, MAX_PATH_LENGTH);
+    }
     logMessage(LOG_INFO, "Input path: %s", inputPath);
     
     // 检查路径是否存在
     if (!pathExists(inputPath)) {
         printf("Error: Path does not exist or cannot be accessed\n");
         logMessage(LOG_ERROR, "Path does not exist or cannot be accessed: %s", inputPath);
+        freeFilter(filter);
         closeLogging();
         return 1;
     }
     
-    printf("\nFile tree structure:\n");
-    printf("==========================================\n");
-    logMessage(LOG_INFO, "File tree structure:");
-    logMessage(LOG_INFO, "==========================================");
-    printFileTree(inputPath, 0);
-    logMessage(LOG_INFO, "==========================================");
-    printf("==========================================\n\n");
-    
-    printf("Enter processing command (use %%i for input file, %%o for output file base name):\n");
-    printf("Example: ffmpeg -i %%i -vcodec libx264 %%o.mp4\n");
-    printf("Command: ");
-    fgets(command, MAX_COMMAND_LENGTH, stdin);
-    command[strcspn(command, "\n")] = 0;
-    logMessage(LOG_INFO, "Command: %s", command);
-    
-    printf("Enter output file path: ");
-    fgets(outputPath, MAX_PATH_LENGTH, stdin);
-    outputPath[strcspn(outputPath, "\n")] = 0;
+    // 扫描索引保存在输出目录中，因此使用索引时在扫描之前询问输出目录
+    char indexPath[MAX_PATH_LENGTH];
+    if (scanIndex) {
+        if (outputPath[0] == '\0') {
+            promptLine("Enter output file path: ", outputPath, MAX_PATH_LENGTH);
+        }
+        int written = snprintf(indexPath, sizeof(indexPath), "%s%s%s", outputPath, PATH_SEPARATOR_STRING, SCAN_INDEX_FILE_NAME);
+        if (written < 0 || written >= (int)sizeof(indexPath)) {
+            printf("Error: Output path is too long\n");
+            logMessage(LOG_ERROR, "Output path too long for the scan index: %s", outputPath);
+            freeFilter(filter);
+            closeLogging();
+            return 1;
+        }
+        printInfo("%s scan index %s\n", rescan ? "Rebuilding" : "Using", indexPath);
+        logMessage(LOG_INFO, "%s scan index %s", rescan ? "Rebuilding" : "Using", indexPath);
+    }
+    
+    // 只扫描一次输入目录，文件树打印、文件处理和输出目录创建都使用这份结果
+    // 流式模式下扫描推迟到处理阶段与命令执行同时进行，因此不打印文件树；给出文件列表时完全不扫描
+    FileList fileList;
+    initFileList(&fileList, inputPath);
+    fileList.filter = filter;
+    fileList.scanThreads = scanThreads;
+    fileList.scanOrder = scanOrder;
+    fileList.indexPath = scanIndex ? indexPath : NULL;
+    fileList.rescan = rescan;
+    fileList.statIndexedFiles = incremental;
+    if (workerAddress != NULL) {
+        printInfo("\nWorker mode: files are taken from the coordinator at %s, input folder is not scanned\n\n", workerAddress);
+        logMessage(LOG_INFO, "Worker mode, coordinator at %s", workerAddress);
+    } else if (filesFrom != NULL) {
+        printInfo("\nReading file list from %s, input folder is not scanned\n\n", strcmp(filesFrom, "-") == 0 ? "stdin" : filesFrom);
+        logMessage(LOG_INFO, "Reading file list from %s", filesFrom);
+    } else if (watching) {
+        printInfo("\nWatch mode: file tree display skipped, existing files are processed first, then new and changed files\n\n");
+        logMessage(LOG_INFO, "Watch mode enabled (settle time %lld ms)", settleMs);
+    } else if (streaming) {
+        printInfo("\nStreaming mode: file tree display skipped, commands start while the tree is scanned\n\n");
+        logMessage(LOG_INFO, "Streaming mode enabled");
+    } else {
+        scanDirectoryTree(inputPath, &fileList);
+        
+        printInfo("\nFile tree structure:\n");
+        printInfo("==========================================\n");
+        logMessage(LOG_INFO, "File tree structure:");
+        logMessage(LOG_INFO, "==========================================");
+        if (!quietOutput) {
+            printFileTree(&fileList);
+        }
+        logMessage(LOG_INFO, "==========================================");
+        printInfo("==========================================\n\n");
+    }
+    
+    if (command[0] == '\0' && workerAddress == NULL) {
+        printf("Enter processing command (placeholders: %%i input file, %%o output file base name, %%r relative path,\n");
+        printf("  %%d output directory, %%n file name, %%e extension, %%p parent directory name, %%%% literal %%,\n");
+        printf("  %%I all input files of a batch, see --batch-size):\n");
+        printf("Example: ffmpeg -i %%i -vcodec libx264 %%o.mp4\n");
+        promptLine("Command: ", command, MAX_COMMAND_LENGTH);
+    }
+    if (workerAddress == NULL) {
+        logMessage(LOG_INFO, "Command: %s", command);
+    }
+    
+    if (outputPath[0] == '\0') {
+        promptLine("Enter output file path: ", outputPath, MAX_PATH_LENGTH);
+    }
     logMessage(LOG_INFO, "Output path: %s", outputPath);
     
     // 询问用户是否启用命令失败时复制源文件的功能
-    printf("Enable copy source file on command failure? (y/n): ");
-    fgets(choice, 10, stdin);
-    choice[strcspn(choice, "\n")] = 0;
-    if (strcmp(choice, "y") == 0 || strcmp(choice, "Y") == 0) {
-        copyOnError = 1;
-        printf("Copy on error feature enabled.\n");
+    if (interactive && !copyOnErrorGiven) {
+        promptLine("Enable copy source file on command failure? (y/n): ", choice, sizeof(choice));
+        copyOnError = (strcmp(choice, "y") == 0 || strcmp(choice, "Y") == 0);
+    }
+    if (copyOnError) {
+        printInfo("Copy on error feature enabled.\n");
         logMessage(LOG_INFO, "Copy on error feature enabled");
     } else {
-        printf("Copy on error feature disabled.\n");
+        printInfo("Copy on error feature disabled.\n");
         logMessage(LOG_INFO, "Copy on error feature disabled");
     }
     
     // 询问用户要排除的文件扩展名
-    printf("Enter file extensions to exclude (separated by spaces or commas, e.g., txt log bak): ");
-    fgets(excludeExtensions, MAX_EXTENSIONS_LENGTH, stdin);
-    excludeExtensions[strcspn(excludeExtensions, "\n")] = 0;
+    if (interactive && !excludeGiven) {
+        promptLine("Enter file extensions to exclude (separated by spaces or commas, e.g., txt log bak): ", excludeExtensions, MAX_EXTENSIONS_LENGTH);
+    }
     logMessage(LOG_INFO, "Exclude extensions: %s", excludeExtensions);
+    if (!extensionsCompiled) {
+        addExcludedExtensions(filter, excludeExtensions);
+        markExcludedEntries(&fileList, filter);
+    }
+    
+    // 监视模式下输出目录若就是输入目录或位于其中，命令的输出又会被当作新文件处理
+    // 比较解析后的绝对路径，"./in"、"in/" 和经过符号链接的写法都能识别
+    char absoluteInput[MAX_PATH_LENGTH];
+    char absoluteOutput[MAX_PATH_LENGTH];
+    if (watching && getAbsolutePath(inputPath, absoluteInput, sizeof(absoluteInput)) == 0 && getAbsolutePath(outputPath, absoluteOutput, sizeof(absoluteOutput)) == 0
+        && isSameOrInside(absoluteOutput, absoluteInput)) {
+        printf("Error: With --watch the output folder must not be the input folder or inside it\n");
+        logMessage(LOG_ERROR, "Output folder %s is the watched input folder or inside it", outputPath);
+        freeFileList(&fileList);
+        freeFilter(filter);
+        closeLogging();
+        return 1;
+    }
     
     // 创建输出目录（如果不存在）
     if (createDirectory(outputPath) != 0 && errno != EEXIST) {
         printf("Error: Cannot create output directory\n");
         logMessage(LOG_ERROR, "Cannot create output directory: %s", outputPath);
+        freeFileList(&fileList);
+        freeFilter(filter);
         closeLogging();
         return 1;
     }
     
-    // 构建文件列表并处理
-    FileEntry* fileList = NULL;
-    fileList = buildFileList(inputPath, fileList);
-    
-    // 计算总文件数
-    int totalFiles = countFiles(fileList);
-    printf("\nFound %d files to process\n", totalFiles);
-    logMessage(LOG_INFO, "Found %d files to process", totalFiles);
+    // 计算总文件数，并根据扫描结果创建输出目录树
+    JobSource* source = NULL;
+    if (workerAddress != NULL) {
+        source = createRemoteSource(workerAddress, inputPath, outputPath, command, sizeof(command), &useShell);
+        if (source == NULL) {
+            printf("Error: Cannot connect to the coordinator at %s\n", workerAddress);
+        }
+    } else if (filesFrom != NULL) {
+        source = createFilesFromSource(inputPath, outputPath, filesFrom, nullSeparated, filter);
+    } else if (watching) {
+        // 先安装中断处理再注册监视：Ctrl+C 让监视停止，已在运行的命令结束后正常退出
+        installInterruptHandler();
+        source = createWatchSource(&fileList, outputPath, (int)settleMs);
+    } else if (streaming) {
+        source = createStreamSource(&fileList, outputPath);
+    } else {
+        int totalFiles = countFiles(&fileList);
+        printInfo("\nFound %d files to process\n", totalFiles);
+        logMessage(LOG_INFO, "Found %d files to process", totalFiles);
+        
+        createDirectoryTree(&fileList, outputPath);
+        int sequenceCount = 0;
+        int* sequence = buildJobSequence(&fileList, &orderOptions, &sequenceCount);
+        source = createFileListSource(&fileList, sequence, sequenceCount);
+    }
+    if (source == NULL) {
+        printf("Error: Cannot start processing\n");
+        logMessage(LOG_ERROR, "Cannot create job source");
+        freeFileList(&fileList);
+        freeFilter(filter);
+        closeLogging();
+        return 1;
+    }
     
     if (excludeExtensions[0] != '\0') {
-        printf("Files with extensions %s will be excluded", excludeExtensions);
+        printInfo("Files with extensions %s will be excluded", excludeExtensions);
         if (copyOnError) {
-            printf(" and copied to output directory\n");
+            printInfo(" and copied to output directory\n");
         } else {
-            printf("\n");
+            printInfo("\n");
         }
         logMessage(LOG_INFO, "Files with extensions %s will be excluded%s", 
                   excludeExtensions, copyOnError ? " and copied to output directory" : "");
     }
     
-    printf("\nStarting file processing...\n");
-    logMessage(LOG_INFO, "Starting file processing");
-    processFiles(fileList, inputPath, outputPath, command, copyOnError, excludeExtensions);
+    ProcessOptions options;
+    options.inputPath = inputPath;
+    options.outputPath = outputPath;
+    options.command = command;
+    options.copyOnError = copyOnError;
+    options.maxJobs = maxJobs;
+    options.incremental = incremental;
+    options.useShell = useShell;
+    options.copyMode = copyMode;
+    options.reportPath = reportPath;
+    options.reportSlowest = reportSlowest;
+    options.adaptive = adaptive;
+    options.memoryPerJobKb = memoryPerJob / 1024;
+    options.niceness = niceness;
+    options.pinMode = pinMode;
+    options.captureMode = captureMode;
+    options.jobLogDirectory = jobLogDirectory;
+    options.errorTailLines = errorTailLines;
+    options.verbosity = verbosity;
+    options.timeoutMs = timeoutMs;
+    options.stallTimeoutMs = stallTimeoutMs;
+    options.retries = retries;
+    options.retryDelayMs = retryDelayMs;
+    options.batchSize = batchSize;
+    options.maxCommandLength = maxCommandLength > 0 ? maxCommandLength : (useShell ? DEFAULT_MAX_SHELL_COMMAND_LENGTH : DEFAULT_MAX_COMMAND_LENGTH);
+    
+    // 直接执行模式不支持管道和重定向，提示用户改用 --shell（引号内的字符只是参数的一部分，不提示）
+    if (!useShell) {
+        CommandTemplate commandTemplate;
+        if (compileTemplate(command, 0, &commandTemplate) >= 0 && commandTemplate.hasShellOperator) {
+            printf("Warning: Command contains shell operators; use --shell to run it through the shell\n");
+            logMessage(LOG_WARNING, "Command contains shell operators but --shell is not enabled");
+        }
+        freeTemplate(&commandTemplate);
+    }
+    
+    if (captureMode == CAPTURE_ALL) {
+        printInfo("Command output is written to %s\n", jobLogDirectory);
+        logMessage(LOG_INFO, "Command output is written to %s", jobLogDirectory);
+    } else if (captureMode == CAPTURE_FAILED) {
+        printInfo("Command output is captured; output of failed commands is saved to %s\n", jobLogDirectory);
+        logMessage(LOG_INFO, "Command output is captured; output of failed commands is saved to %s", jobLogDirectory);
+    }
+    
+    if (stallTimeoutMs > 0 && captureMode == CAPTURE_NONE) {
+        printf("Warning: With --capture none, --stall-timeout can only watch the output file\n");
+        logMessage(LOG_WARNING, "Stall detection without captured output only watches output files");
+    }
+    
+    if (incremental) {
+        printInfo("Incremental mode: up-to-date files will be skipped\n");
+        logMessage(LOG_INFO, "Incremental mode enabled");
+    }
+    if (shardCount > 1) {
+        printInfo("Shard %d of %d: only files whose relative path hashes to this shard are processed\n", shardIndex, shardCount);
+        logMessage(LOG_INFO, "Shard %d of %d", shardIndex, shardCount);
+    }
+    
+    if (serveAddress != NULL) {
+        printInfo("\nServing files on %s, start workers with: %s --worker %s --input DIR --output DIR\n", serveAddress, argv[0], serveAddress);
+        logMessage(LOG_INFO, "Serving files on %s", serveAddress);
+    } else if (adaptive) {
+        printInfo("\nStarting file processing (adaptive, up to %d parallel job%s)...\n", maxJobs, maxJobs == 1 ? "" : "s");
+        logMessage(LOG_INFO, "Starting file processing (adaptive, up to %d parallel jobs)", maxJobs);
+    } else {
+        printInfo("\nStarting file processing (%d parallel job%s)...\n", maxJobs, maxJobs == 1 ? "" : "s");
+        logMessage(LOG_INFO, "Starting file processing (%d parallel jobs)", maxJobs);
+    }
+    if (watching) {
+        printInfo("Watching %s for new and changed files, press Ctrl+C to stop\n", inputPath);
+        logMessage(LOG_INFO, "Watching %s for new and changed files", inputPath);
+    }
+    // 有文件失败或列表中有项被拒绝时以非 0 状态退出，便于在脚本和流水线中判断
+    int failed = 0;
+    if (serveAddress != NULL) {
+        // Ctrl+C 时停止分发，等待已分发的文件结束后退出（结果仍会写入清单）
+        installInterruptHandler();
+        failed = serveJobs(source, &options, serveAddress);
+    } else {
+        failed = processFiles(source, &options);
+    }
+    if (source->rejected > 0) {
+        printf("Error: %d listed files were skipped because they do not exist or are outside the input folder (see bct.log)\n", source->rejected);
+        logMessage(LOG_ERROR, "%d listed files were skipped", source->rejected);
+    }
+    int exitCode = (failed != 0 || source->rejected > 0) ? 1 : 0;
     
     // 清理
-    freeFileList(fileList);
+    source->close(source);
+    freeFileList(&fileList);
+    freeFilter(filter);
     
-    printf("Processing completed!\n");
+    printInfo("Processing completed!\n");
     logMessage(LOG_INFO, "Processing completed!");
     closeLogging();
     
-    system("pause");
-    return 0;
+#ifdef _WIN32
+    // 只在交互运行时暂停，作为流水线中的一环运行时直接退出
+    if (interactive) {
+        system("pause");
+    }
+#endif
+    return exitCode;
 }
\ No newline at end of file
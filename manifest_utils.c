@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file_utils.h"
+#include "platform_utils.h"
+#include "log_utils.h"
+#include "manifest_utils.h"
+
+// 清单中的一条记录，路径存放在字符串池中
+typedef struct ManifestEntry {
+    size_t pathOffset;
+    long long size;
+    long long mtime;                // Unix 纪元起的纳秒数
+    unsigned long long commandHash;
+} ManifestEntry;
+
+struct Manifest {
+    char path[MAX_PATH_LENGTH];
+    FILE* journal;              // 以追加方式打开，每条记录写入后立即刷新
+    ManifestEntry* entries;
+    int count;
+    int capacity;
+    int* slots;                 // 开放寻址哈希表，存放 entries 下标，空槽为 -1
+    int slotCount;
+    char* paths;
+    size_t pathsLength;
+    size_t pathsCapacity;
+};
+
+// 辅助函数：查找路径对应的槽位（找不到时返回应插入的空槽）
+static int findSlot(const Manifest* manifest, const char* relativePath) {
+    unsigned int mask = (unsigned int)manifest->slotCount - 1;
+    unsigned int slot = (unsigned int)hashString(relativePath) & mask;
+    
+    while (manifest->slots[slot] >= 0) {
+        const ManifestEntry* entry = &manifest->entries[manifest->slots[slot]];
+        if (strcmp(manifest->paths + entry->pathOffset, relativePath) == 0) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return (int)slot;
+}
+
+// 辅助函数：哈希表扩容（保持装载因子不超过 1/2）
+static int growSlots(Manifest* manifest) {
+    int newSlotCount = manifest->slotCount > 0 ? manifest->slotCount * 2 : 1024;
+    int* newSlots = (int*)malloc(sizeof(int) * (size_t)newSlotCount);
+    if (newSlots == NULL) {
+        return -1;
+    }
+    
+    free(manifest->slots);
+    manifest->slots = newSlots;
+    manifest->slotCount = newSlotCount;
+    for (int i = 0; i < newSlotCount; i++) {
+        manifest->slots[i] = -1;
+    }
+    for (int i = 0; i < manifest->count; i++) {
+        int slot = findSlot(manifest, manifest->paths + manifest->entries[i].pathOffset);
+        manifest->slots[slot] = i;
+    }
+    return 0;
+}
+
+// 辅助函数：插入或更新一条记录（仅更新内存）
+static int storeEntry(Manifest* manifest, const char* relativePath, long long size, long long mtime, unsigned long long commandHash) {
+    if ((manifest->count + 1) * 2 > manifest->slotCount && growSlots(manifest) != 0) {
+        return -1;
+    }
+    
+    int slot = findSlot(manifest, relativePath);
+    if (manifest->slots[slot] >= 0) {
+        ManifestEntry* entry = &manifest->entries[manifest->slots[slot]];
+        entry->size = size;
+        entry->mtime = mtime;
+        entry->commandHash = commandHash;
+        return 0;
+    }
+    
+    if (manifest->count == manifest->capacity) {
+        int newCapacity = manifest->capacity > 0 ? manifest->capacity * 2 : 1024;
+        ManifestEntry* newEntries = (ManifestEntry*)realloc(manifest->entries, sizeof(ManifestEntry) * (size_t)newCapacity);
+        if (newEntries == NULL) {
+            return -1;
+        }
+        manifest->entries = newEntries;
+        manifest->capacity = newCapacity;
+    }
+    
+    size_t pathLength = strlen(relativePath) + 1;
+    if (manifest->pathsLength + pathLength > manifest->pathsCapacity) {
+        size_t newCapacity = manifest->pathsCapacity > 0 ? manifest->pathsCapacity * 2 : 65536;
+        while (newCapacity < manifest->pathsLength + pathLength) {
+            newCapacity *= 2;
+        }
+        char* newPaths = (char*)realloc(manifest->paths, newCapacity);
+        if (newPaths == NULL) {
+            return -1;
+        }
+        manifest->paths = newPaths;
+        manifest->pathsCapacity = newCapacity;
+    }
+    
+    ManifestEntry* entry = &manifest->entries[manifest->count];
+    entry->pathOffset = manifest->pathsLength;
+    entry->size = size;
+    entry->mtime = mtime;
+    entry->commandHash = commandHash;
+    memcpy(manifest->paths + manifest->pathsLength, relativePath, pathLength);
+    manifest->pathsLength += pathLength;
+    manifest->slots[slot] = manifest->count++;
+    return 0;
+}
+
+// 辅助函数：读取已有的清单，后出现的记录覆盖先出现的记录
+// 中断时可能留下不完整的最后一行，解析失败的行直接忽略
+static void loadManifest(Manifest* manifest) {
+    FILE* file = openFile(manifest->path, "r");
+    if (file == NULL) {
+        return;
+    }
+    
+    char line[MAX_PATH_LENGTH + 128];
+    int loaded = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        size_t length = strcspn(line, "\r\n");
+        if (line[length] == '\0' || line[0] == '#') {
+            continue;
+        }
+        line[length] = '\0';
+        
+        long long size = 0;
+        long long mtime = 0;
+        unsigned long long commandHash = 0;
+        int pathStart = 0;
+        if (sscanf(line, "%lld\t%lld\t%llx\t%n", &size, &mtime, &commandHash, &pathStart) != 3 || pathStart == 0) {
+            continue;
+        }
+        
+        if (storeEntry(manifest, line + pathStart, size, mtime, commandHash) == 0) {
+            loaded++;
+        }
+    }
+    fclose(file);
+    
+    logMessage(LOG_INFO, "Loaded %d manifest records from %s", loaded, manifest->path);
+}
+
+// 打开输出目录中的清单
+Manifest* openManifest(const char* outputPath) {
+    Manifest* manifest = (Manifest*)calloc(1, sizeof(Manifest));
+    if (manifest == NULL) {
+        return NULL;
+    }
+    
+    int written = snprintf(manifest->path, MAX_PATH_LENGTH, "%s%s%s", outputPath, PATH_SEPARATOR_STRING, MANIFEST_FILE_NAME);
+    if (written < 0 || written >= MAX_PATH_LENGTH) {
+        logMessage(LOG_ERROR, "Output path too long for the manifest: %s", outputPath);
+        free(manifest);
+        return NULL;
+    }
+    if (growSlots(manifest) != 0) {
+        free(manifest);
+        return NULL;
+    }
+    loadManifest(manifest);
+    
+    manifest->journal = openFile(manifest->path, "a");
+    if (manifest->journal == NULL) {
+        logMessage(LOG_WARNING, "Cannot open manifest for writing: %s", manifest->path);
+    }
+    return manifest;
+}
+
+// 检查文件的记录是否仍与当前输入状态及命令一致
+int isManifestUpToDate(const Manifest* manifest, const char* relativePath, long long size, long long mtime, unsigned long long commandHash) {
+    int slot = findSlot(manifest, relativePath);
+    if (manifest->slots[slot] < 0) {
+        return 0;
+    }
+    
+    const ManifestEntry* entry = &manifest->entries[manifest->slots[slot]];
+    return entry->size == size && entry->mtime == mtime && entry->commandHash == commandHash;
+}
+
+// 记录一个处理成功的文件：先更新内存，再追加到清单文件
+void recordManifestEntry(Manifest* manifest, const char* relativePath, long long size, long long mtime, unsigned long long commandHash) {
+    if (storeEntry(manifest, relativePath, size, mtime, commandHash) != 0) {
+        logMessage(LOG_ERROR, "Out of memory while updating manifest: %s", relativePath);
+        return;
+    }
+    
+    if (manifest->journal != NULL) {
+        fprintf(manifest->journal, "%lld\t%lld\t%016llx\t%s\n", size, mtime, commandHash, relativePath);
+        fflush(manifest->journal);
+    }
+}
+
+// 关闭清单：将追加日志压缩为每个文件一行，写入临时文件后原子替换
+void closeManifest(Manifest* manifest) {
+    if (manifest == NULL) {
+        return;
+    }
+    
+    if (manifest->journal != NULL) {
+        fclose(manifest->journal);
+        
+        // 临时文件路径放不下时保留未压缩的追加日志，下次加载结果相同
+        char tempPath[MAX_PATH_LENGTH];
+        int written = snprintf(tempPath, MAX_PATH_LENGTH, "%s.tmp", manifest->path);
+        FILE* file = NULL;
+        if (written < 0 || written >= MAX_PATH_LENGTH) {
+            logMessage(LOG_ERROR, "Manifest path too long, manifest is not compacted: %s", manifest->path);
+        } else {
+            file = openFile(tempPath, "w");
+        }
+        if (file != NULL) {
+            fprintf(file, "# BCT manifest: size\tmtime (ns)\tcommand hash\trelative path\n");
+            for (int i = 0; i < manifest->count; i++) {
+                const ManifestEntry* entry = &manifest->entries[i];
+                fprintf(file, "%lld\t%lld\t%016llx\t%s\n", entry->size, entry->mtime, entry->commandHash, manifest->paths + entry->pathOffset);
+            }
+            if (fclose(file) == 0) {
+                replaceFile(tempPath, manifest->path);
+            }
+        }
+    }
+    
+    free(manifest->entries);
+    free(manifest->slots);
+    free(manifest->paths);
+    free(manifest);
+}
\ No newline at end of file
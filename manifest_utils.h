@@ -0,0 +1,16 @@
+#ifndef MANIFEST_UTILS_H
+#define MANIFEST_UTILS_H
+
+// 增量运行清单：记录每个已成功处理文件的输入状态和展开后的命令
+// 清单保存在输出目录中，运行过程中逐行追加，因此崩溃或中断后可以从断点继续
+#define MANIFEST_FILE_NAME ".bct_manifest"
+
+typedef struct Manifest Manifest;
+
+// 函数声明
+Manifest* openManifest(const char* outputPath);
+int isManifestUpToDate(const Manifest* manifest, const char* relativePath, long long size, long long mtime, unsigned long long commandHash);
+void recordManifestEntry(Manifest* manifest, const char* relativePath, long long size, long long mtime, unsigned long long commandHash);
+void closeManifest(Manifest* manifest);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,356 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "file_utils.h"
+#include "platform_utils.h"
+#include "log_utils.h"
+#include "order_utils.h"
+
+// 扩展名权重表中的一项
+typedef struct ExtensionWeight {
+    char extension[16];
+    double weight;
+} ExtensionWeight;
+
+// 扩展名权重表（数量很少，线性查找即可）
+typedef struct WeightTable {
+    ExtensionWeight* items;
+    int count;
+} WeightTable;
+
+// 上次运行中一个任务的耗时（路径只保存哈希值：用于排序的估计值，偶尔冲突无妨）
+typedef struct HistorySlot {
+    unsigned long long hash;
+    long long wallTimeMs;       // -1 表示空槽位
+} HistorySlot;
+
+// 上次运行的耗时表
+typedef struct History {
+    HistorySlot* slots;
+    size_t capacity;            // 2 的幂
+    size_t count;
+    double msPerByte;           // 报告中总耗时与总输入字节数之比，用于估算没有记录的文件
+    double meanMs;              // 没有字节数信息时的平均耗时
+} History;
+
+// 排序用的一项
+typedef struct SequenceItem {
+    double cost;
+    int index;
+} SequenceItem;
+
+// 辅助函数：解析扩展名权重，格式为 ext=weight，以逗号、分号或空格分隔，成功返回 0
+static int parseWeights(const char* text, WeightTable* table) {
+    table->items = NULL;
+    table->count = 0;
+    if (text == NULL) {
+        return 0;
+    }
+    
+    const char* p = text;
+    while (*p != '\0') {
+        p += strspn(p, " ,;");
+        if (*p == '\0') {
+            break;
+        }
+        if (*p == '.') {
+            p++;
+        }
+        size_t length = strcspn(p, "=:");
+        if (length == 0 || length >= sizeof(table->items[0].extension) || p[length] == '\0') {
+            free(table->items);
+            return -1;
+        }
+        
+        char* end = NULL;
+        double weight = strtod(p + length + 1, &end);
+        if (end == p + length + 1 || weight < 0 || (*end != '\0' && strchr(" ,;", *end) == NULL)) {
+            free(table->items);
+            return -1;
+        }
+        
+        ExtensionWeight* items = (ExtensionWeight*)realloc(table->items, sizeof(ExtensionWeight) * (size_t)(table->count + 1));
+        if (items == NULL) {
+            free(table->items);
+            return -1;
+        }
+        table->items = items;
+        ExtensionWeight* item = &items[table->count++];
+        for (size_t i = 0; i < length; i++) {
+            item->extension[i] = (char)tolower((unsigned char)p[i]);
+        }
+        item->extension[length] = '\0';
+        item->weight = weight;
+        p = end;
+    }
+    return 0;
+}
+
+// 辅助函数：文件名对应的权重（未列出的扩展名为 1）
+static double lookupWeight(const WeightTable* table, const char* name) {
+    const char* lastDot = strrchr(name, '.');
+    if (table->count == 0 || lastDot == NULL || lastDot == name) {
+        return 1.0;
+    }
+    
+    const char* extension = lastDot + 1;
+    for (int i = 0; i < table->count; i++) {
+        const char* expected = table->items[i].extension;
+        size_t j = 0;
+        while (expected[j] != '\0' && expected[j] == (char)tolower((unsigned char)extension[j])) {
+            j++;
+        }
+        if (expected[j] == '\0' && extension[j] == '\0') {
+            return table->items[i].weight;
+        }
+    }
+    return 1.0;
+}
+
+// 检查扩展名权重的格式，正确返回 0
+int validateWeights(const char* weights) {
+    WeightTable table;
+    if (parseWeights(weights, &table) != 0) {
+        return -1;
+    }
+    free(table.items);
+    return 0;
+}
+
+// 辅助函数：查找路径哈希对应的槽位
+static HistorySlot* findHistorySlot(const History* history, unsigned long long hash) {
+    size_t mask = history->capacity - 1;
+    for (size_t i = (size_t)hash & mask; ; i = (i + 1) & mask) {
+        if (history->slots[i].wallTimeMs < 0 || history->slots[i].hash == hash) {
+            return &history->slots[i];
+        }
+    }
+}
+
+// 辅助函数：记录一个任务的耗时（负载超过一半时扩容）
+static int addHistory(History* history, unsigned long long hash, long long wallTimeMs) {
+    if ((history->count + 1) * 2 > history->capacity) {
+        size_t capacity = history->capacity > 0 ? history->capacity * 2 : 1024;
+        HistorySlot* slots = (HistorySlot*)malloc(sizeof(HistorySlot) * capacity);
+        if (slots == NULL) {
+            return -1;
+        }
+        for (size_t i = 0; i < capacity; i++) {
+            slots[i].wallTimeMs = -1;
+        }
+        History grown = *history;
+        grown.slots = slots;
+        grown.capacity = capacity;
+        for (size_t i = 0; i < history->capacity; i++) {
+            if (history->slots[i].wallTimeMs >= 0) {
+                *findHistorySlot(&grown, history->slots[i].hash) = history->slots[i];
+            }
+        }
+        free(history->slots);
+        *history = grown;
+    }
+    
+    HistorySlot* slot = findHistorySlot(history, hash);
+    if (slot->wallTimeMs < 0) {
+        history->count++;
+    }
+    slot->hash = hash;
+    slot->wallTimeMs = wallTimeMs;
+    return 0;
+}
+
+// 辅助函数：读取 JSON 字符串（text 指向开头的引号），解码到 buffer，返回结束引号之后的位置，失败返回 NULL
+static const char* readJsonString(const char* text, char* buffer, size_t bufferSize) {
+    size_t length = 0;
+    const char* p = text + 1;
+    while (*p != '"') {
+        if (*p == '\0' || length + 1 >= bufferSize) {
+            return NULL;
+        }
+        char c = *p++;
+        if (c == '\\') {
+            c = *p++;
+            if (c == 'u') {
+                unsigned int code = 0;
+                if (sscanf(p, "%4x", &code) != 1) {
+                    return NULL;
+                }
+                p += 4;
+                c = (char)code;
+            } else if (c == 'n') {
+                c = '\n';
+            } else if (c == 't') {
+                c = '\t';
+            } else if (c == 'r') {
+                c = '\r';
+            } else if (c == '\0') {
+                return NULL;
+            }
+        }
+        buffer[length++] = c;
+    }
+    buffer[length] = '\0';
+    return p + 1;
+}
+
+// 辅助函数：读取报告中 jobs 数组的记录（writeReport 每行写出一个任务），失败返回 -1
+static int loadHistory(const char* path, History* history) {
+    memset(history, 0, sizeof(History));
+    FILE* file = openFile(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    
+    char line[MAX_PATH_LENGTH * 2 + 512];
+    char relativePath[MAX_PATH_LENGTH];
+    int inJobs = 0;
+    long long totalMs = 0;
+    long long totalBytes = 0;
+    long long msWithBytes = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (!inJobs) {
+            inJobs = (strstr(line, "\"jobs\": [") != NULL);
+            continue;
+        }
+        
+        const char* start = strstr(line, "{\"path\": \"");
+        if (start == NULL) {
+            continue;
+        }
+        const char* rest = readJsonString(start + 9, relativePath, sizeof(relativePath));
+        const char* wall = rest != NULL ? strstr(rest, "\"wallMs\": ") : NULL;
+        const char* bytes = rest != NULL ? strstr(rest, "\"bytesIn\": ") : NULL;
+        if (wall == NULL) {
+            continue;
+        }
+        
+        long long wallTimeMs = strtoll(wall + 10, NULL, 10);
+        long long inputBytes = bytes != NULL ? strtoll(bytes + 11, NULL, 10) : 0;
+        if (addHistory(history, hashString(relativePath), wallTimeMs) != 0) {
+            break;
+        }
+        totalMs += wallTimeMs;
+        if (inputBytes > 0) {
+            totalBytes += inputBytes;
+            msWithBytes += wallTimeMs;
+        }
+    }
+    fclose(file);
+    
+    history->msPerByte = totalBytes > 0 ? (double)msWithBytes / (double)totalBytes : 0;
+    history->meanMs = history->count > 0 ? (double)totalMs / (double)history->count : 0;
+    return 0;
+}
+
+// 辅助函数：按代价降序，代价相同时保持扫描顺序
+static int compareByCostDesc(const void* a, const void* b) {
+    const SequenceItem* left = (const SequenceItem*)a;
+    const SequenceItem* right = (const SequenceItem*)b;
+    if (left->cost != right->cost) {
+        return left->cost > right->cost ? -1 : 1;
+    }
+    return left->index - right->index;
+}
+
+// 按排序选项生成文件的启动顺序（文件表中文件项的下标数组，由调用方释放）
+// 大小和修改时间在扫描时已记录，排序不需要再访问文件系统；失败时返回 NULL，调用方按扫描顺序处理
+int* buildJobSequence(const FileList* list, const OrderOptions* options, int* count) {
+    *count = 0;
+    if (options->order == ORDER_SCAN) {
+        return NULL;
+    }
+    
+    WeightTable weights;
+    if (parseWeights(options->weights, &weights) != 0) {
+        logMessage(LOG_ERROR, "Invalid extension weights: %s", options->weights);
+        return NULL;
+    }
+    
+    History history;
+    memset(&history, 0, sizeof(history));
+    if (options->order == ORDER_HISTORY) {
+        if (loadHistory(options->historyPath, &history) != 0) {
+            if (options->verbosity != VERBOSITY_QUIET) {
+                printf("Warning: Cannot read run report %s, ordering by size instead\n", options->historyPath);
+            }
+            logMessage(LOG_WARNING, "Cannot read run report %s, ordering by size instead", options->historyPath);
+        } else {
+            logMessage(LOG_INFO, "Loaded %d job durations from %s", (int)history.count, options->historyPath);
+        }
+    }
+    
+    SequenceItem* items = (SequenceItem*)malloc(sizeof(SequenceItem) * (size_t)(list->fileCount > 0 ? list->fileCount : 1));
+    int* sequence = (int*)malloc(sizeof(int) * (size_t)(list->fileCount > 0 ? list->fileCount : 1));
+    if (items == NULL || sequence == NULL) {
+        logMessage(LOG_ERROR, "Out of memory while ordering jobs, using scan order");
+        free(items);
+        free(sequence);
+        free(weights.items);
+        free(history.slots);
+        return NULL;
+    }
+    
+    int itemCount = 0;
+    int matched = 0;
+    char relativePath[MAX_PATH_LENGTH];
+    for (int i = 0; i < list->count; i++) {
+        const FileEntry* entry = &list->entries[i];
+        if (entry->flags & FILE_ENTRY_DIRECTORY) {
+            continue;
+        }
+        
+        double cost = (double)entry->size * lookupWeight(&weights, getEntryName(list, i));
+        if (history.count > 0 && getEntryRelativePath(list, i, relativePath, sizeof(relativePath)) != NULL) {
+            const HistorySlot* slot = findHistorySlot(&history, hashString(relativePath + 1));
+            if (slot->wallTimeMs >= 0) {
+                cost = (double)slot->wallTimeMs;
+                matched++;
+            } else {
+                // 新文件：按上次运行的每字节耗时估算，没有字节数信息时取平均耗时
+                cost = history.msPerByte > 0 ? cost * history.msPerByte : history.meanMs;
+            }
+        }
+        items[itemCount].cost = cost;
+        items[itemCount].index = i;
+        itemCount++;
+    }
+    
+    qsort(items, (size_t)itemCount, sizeof(SequenceItem), compareByCostDesc);
+    for (int i = 0; i < itemCount; i++) {
+        sequence[i] = items[i].index;
+    }
+    
+    int quiet = (options->verbosity == VERBOSITY_QUIET);
+    if (options->order == ORDER_HISTORY && history.count > 0) {
+        if (!quiet) {
+            printf("Ordering jobs by previous durations (%d of %d files found in %s)\n", matched, itemCount, options->historyPath);
+        }
+        logMessage(LOG_INFO, "Ordering jobs by previous durations (%d of %d files found)", matched, itemCount);
+    } else {
+        if (!quiet) {
+            printf("Ordering jobs largest first%s\n", weights.count > 0 ? " (weighted by extension)" : "");
+        }
+        logMessage(LOG_INFO, "Ordering jobs largest first%s", weights.count > 0 ? " (weighted by extension)" : "");
+    }
+    
+    free(items);
+    free(weights.items);
+    free(history.slots);
+    *count = itemCount;
+    return sequence;
+}
+
+// 解析任务启动顺序：scan、largest 或 history，成功返回 0
+int parseJobOrder(const char* text, JobOrder* order) {
+    if (strcmp(text, "scan") == 0) {
+        *order = ORDER_SCAN;
+    } else if (strcmp(text, "largest") == 0) {
+        *order = ORDER_LARGEST;
+    } else if (strcmp(text, "history") == 0) {
+        *order = ORDER_HISTORY;
+    } else {
+        return -1;
+    }
+    return 0;
+}
\ No newline at end of file
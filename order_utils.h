@@ -0,0 +1,24 @@
+#ifndef ORDER_UTILS_H
+#define ORDER_UTILS_H
+
+// 任务启动顺序
+typedef enum {
+    ORDER_SCAN,             // 按扫描顺序
+    ORDER_LARGEST,          // 输入越大越先启动（可用扩展名权重调整），缩短并行运行末尾只剩少数大任务的时间
+    ORDER_HISTORY           // 按上次运行报告中记录的耗时，越慢越先启动；报告中没有的文件按大小估算
+} JobOrder;
+
+// 排序选项
+typedef struct OrderOptions {
+    JobOrder order;
+    const char* weights;        // 扩展名权重，如 "mp4=10,mov=8,jpg=0.1"（未列出的扩展名权重为 1），可为 NULL
+    const char* historyPath;    // ORDER_HISTORY 使用的上次运行报告
+    Verbosity verbosity;        // VERBOSITY_QUIET 时排序说明只写入日志
+} OrderOptions;
+
+// 函数声明
+int* buildJobSequence(const FileList* list, const OrderOptions* options, int* count);
+int parseJobOrder(const char* text, JobOrder* order);
+int validateWeights(const char* weights);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,42 @@
+#include <string.h>
+#include "path_utils.h"
+
+// 判断路径是否为绝对路径（Windows 上以 \ 或 / 开头、或带盘符的路径都算）
+int isAbsolutePath(const char* path) {
+#ifdef _WIN32
+    return path[0] == '\\' || path[0] == '/' || (path[0] != '\0' && path[1] == ':');
+#else
+    return path[0] == '/';
+#endif
+}
+
+// 相对路径中是否有 ".." 组成部分（这样的路径可能指向输入目录之外）
+int hasParentComponent(const char* relativePath) {
+    const char* part = relativePath;
+    for (const char* p = relativePath; ; p++) {
+        if (*p != '/' && *p != '\\' && *p != '\0') {
+            continue;
+        }
+        if (p - part == 2 && part[0] == '.' && part[1] == '.') {
+            return 1;
+        }
+        if (*p == '\0') {
+            return 0;
+        }
+        part = p + 1;
+    }
+}
+
+// 两个绝对路径（已由 getAbsolutePath 解析）中 path 是否就是 folder 或位于其中；Windows 上不区分大小写
+int isSameOrInside(const char* path, const char* folder) {
+    size_t length = strlen(folder);
+    while (length > 0 && (folder[length - 1] == '/' || folder[length - 1] == '\\')) {
+        length--;
+    }
+#ifdef _WIN32
+    int prefix = (_strnicmp(path, folder, length) == 0);
+#else
+    int prefix = (strncmp(path, folder, length) == 0);
+#endif
+    return prefix && (path[length] == '\0' || path[length] == '/' || path[length] == '\\');
+}
\ No newline at end of file
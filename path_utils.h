@@ -0,0 +1,11 @@
+#ifndef PATH_UTILS_H
+#define PATH_UTILS_H
+
+// 与平台无关的路径检查，用于判断来自文件列表或协调者的相对路径是否会指向输入目录之外
+
+// 函数声明
+int isAbsolutePath(const char* path);
+int hasParentComponent(const char* relativePath);
+int isSameOrInside(const char* path, const char* folder);
+
+#endif
\ No newline at end of file
@@ -1,12 +1,140 @@
 #ifndef PLATFORM_UTILS_H
 #define PLATFORM_UTILS_H
 
+#include <stdio.h>
+
+// 路径分隔符
+#ifdef _WIN32
+#define PATH_SEPARATOR '\\'
+#define PATH_SEPARATOR_STRING "\\"
+#else
+#define PATH_SEPARATOR '/'
+#define PATH_SEPARATOR_STRING "/"
+#endif
+
+// 子进程句柄
+typedef struct ProcessHandle {
+#ifdef _WIN32
+    void* process;
+    void* job;              // 包含该进程及其子进程的作业对象，用于统计资源使用（可能为 NULL）
+    void* output;           // 子进程标准输出和标准错误所写管道的读取端（未捕获时为 NULL）
+#else
+    int pid;
+    int output;             // 子进程标准输出和标准错误所写管道的读取端（未捕获时为 -1）
+#endif
+} ProcessHandle;
+
+// 子进程结束时收集的资源使用情况
+typedef struct ProcessStats {
+    long long userTimeMs;       // 用户态 CPU 时间
+    long long systemTimeMs;     // 内核态 CPU 时间
+    long long peakMemoryKb;     // 峰值内存（POSIX 为最大常驻集，Windows 为作业的峰值提交内存）
+} ProcessStats;
+
+// 系统负载采样，无法获取的项为 -1
+typedef struct SystemLoad {
+    double loadAverage;         // 1 分钟平均负载（可运行的任务数）
+    double cpuPressure;         // CPU 压力：最近 10 秒内有任务等待 CPU 的时间百分比（Linux PSI）
+    double memoryPressure;      // 内存压力：最近 10 秒内有任务因内存不足而停顿的时间百分比（Linux PSI）
+    long long availableMemoryKb;    // 无需换页即可使用的内存
+} SystemLoad;
+
+// 可绑定的最大 CPU 数和可识别的最大 NUMA 节点数
+#define MAX_CPUS 1024
+#define MAX_NUMA_NODES 1024
+
+// 文件修改时间以 Unix 纪元起的纳秒数表示，保留文件系统提供的全部精度
+#define NANOSECONDS_PER_SECOND 1000000000LL
+
+// startCommand/startProcess 的选项
+#define START_CAPTURE_OUTPUT 0x01   // 标准输出和标准错误重定向到管道，由 waitForAnyCommand 读出
+#define START_NEW_GROUP 0x02        // 子进程放入新的进程组，以便结束整个进程树（Windows 上总是使用作业对象）
+
+// 目录监视事件
+#define WATCH_FILE_CHANGED 1        // 文件被创建或写入，写入方可能仍未关闭文件
+#define WATCH_FILE_CLOSED 2         // 写入方已关闭文件，或文件被整体移入（新出现的目录中已有的文件也按此报告）
+#define WATCH_FILE_REMOVED 3        // 文件被删除或移出
+#define WATCH_DIRECTORY_ADDED 4     // 发现（或新出现）需要监视的子目录，回调返回非 0 时不监视也不列举该目录
+
+// waitForAnyCommand 在超时时间内没有子进程结束（或被 wakeCommandWait 唤醒）时的返回值
+#define PROCESS_WAIT_TIMEOUT (-2)
+
+// 线程与同步原语（不透明类型，由各平台实现）
+typedef struct PlatformThread PlatformThread;
+typedef struct PlatformMutex PlatformMutex;
+typedef struct PlatformCondition PlatformCondition;
+typedef struct DirectoryWatcher DirectoryWatcher;
+typedef struct NetSocket NetSocket;
+typedef struct MappedFile MappedFile;
+typedef void (*ThreadFunction)(void* argument);
+
+// enumerateDirectory 对每一项调用的回调（flags 为 FILE_ENTRY_* 标志，mtime 为纳秒），返回非 0 时停止列举
+typedef int (*DirectoryEntryCallback)(void* userData, const char* name, unsigned int flags, long long size, long long mtime);
+
+// waitForAnyCommand 读到子进程输出时调用的回调，index 为进程在句柄数组中的下标
+typedef void (*OutputCallback)(void* userData, int index, const char* data, size_t length);
+
+// 目录监视回调，relativePath 为相对于监视根目录的路径，event 为 WATCH_* 事件
+typedef int (*WatchCallback)(void* userData, const char* relativePath, int event);
+
 // 平台相关函数声明
 int pathExists(const char* path);
 int createDirectory(const char* path);
-void printFileTree(const char* path, int depth);
-FileEntry* buildFileList(const char* path, FileEntry* list);
-void createDirectoryTree(const char* inputPath, const char* outputPath);
-int copyFileWithPath(const char* source, const char* destination);
+int buildFileList(const char* path, FileList* list);
+int enumerateDirectory(const char* path, unsigned int traversalFlags, unsigned long long fileSystem, DirectoryEntryCallback callback, void* userData);
+unsigned long long getFileSystemId(const char* path);
+int copyFileWithPath(const char* source, const char* destination, CopyMode mode);
+int getFileInfo(const char* path, long long* size, long long* mtime);
+int getAbsolutePath(const char* path, char* buffer, size_t bufferSize);
+FILE* openFile(const char* path, const char* mode);
+int isTerminal(FILE* stream);
+int replaceFile(const char* source, const char* destination);
+MappedFile* mapFile(const char* path, const void** data, size_t* size);
+void unmapFile(MappedFile* mapped);
+
+// 目录监视相关函数声明（创建时在整个目录树上注册监视，之后新出现的子目录自动加入）
+DirectoryWatcher* createDirectoryWatcher(const char* root, unsigned int traversalFlags, WatchCallback callback, void* userData);
+int readWatchEvents(DirectoryWatcher* watcher, int timeoutMs);
+void freeDirectoryWatcher(DirectoryWatcher* watcher);
+void installInterruptHandler(void);
+int interruptRequested(void);
+
+// 网络相关函数声明（地址为 host:port、:port 或 unix:路径；省略主机时使用本机回环地址）
+NetSocket* listenOnAddress(const char* address);
+NetSocket* acceptConnection(NetSocket* listener);
+NetSocket* connectToAddress(const char* address);
+int sendData(NetSocket* connection, const char* data, size_t length);
+int receiveData(NetSocket* connection, char* buffer, size_t size);
+int waitForSockets(NetSocket** sockets, int count, int* ready, int timeoutMs);
+void closeSocket(NetSocket* connection);
+
+// 进程相关函数声明
+int getProcessorCount(void);
+int startCommand(const char* command, ProcessHandle* handle, unsigned int startFlags);
+int startProcess(char* const* argv, ProcessHandle* handle, unsigned int startFlags);
+int terminateProcessTree(ProcessHandle* handle, int force);
+int waitForAnyCommand(ProcessHandle* handles, int count, int* exitCode, ProcessStats* stats, int timeoutMs, OutputCallback onOutput, void* userData);
+void wakeCommandWait(void);
+long long getMonotonicTime(void);      // 单调时钟，单位为毫秒
+void sleepMilliseconds(int milliseconds);
+int getSystemLoad(SystemLoad* load);
+int getAvailableCpus(int* cpus, int maxCpus);
+int getNumaNodes(int* nodes, int maxNodes);
+int getNumaNodeCpus(int node, int* cpus, int maxCpus);
+int setChildPriority(int niceness);
+int setChildAffinity(const int* cpus, int count);
+
+// 线程相关函数声明（timeoutMs 小于 0 表示无限等待）
+PlatformThread* startThread(ThreadFunction function, void* argument);
+void joinThread(PlatformThread* thread);
+PlatformMutex* createMutex(void);
+void lockMutex(PlatformMutex* mutex);
+void unlockMutex(PlatformMutex* mutex);
+void destroyMutex(PlatformMutex* mutex);
+PlatformCondition* createCondition(void);
+int waitCondition(PlatformCondition* condition, PlatformMutex* mutex, int timeoutMs);
+void signalCondition(PlatformCondition* condition);
+void broadcastCondition(PlatformCondition* condition);
+void destroyCondition(PlatformCondition* condition);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,1780 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <spawn.h>
+#include <pthread.h>
+#include <time.h>
+#include <sched.h>
+#include <signal.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/inotify.h>
+#endif
+#include "file_utils.h"
+#include "platform_utils.h"
+#include "log_utils.h"
+#include "filter_utils.h"
+
+extern char** environ;
+
+// 辅助函数：以 dirfd 为基准打开子目录，返回新的目录流（失败返回 NULL）
+static DIR* openDirectoryAt(int directoryFd, const char* name) {
+    int fd = openat(directoryFd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    
+    DIR* dir = fdopendir(fd);
+    if (dir == NULL) {
+        close(fd);
+    }
+    return dir;
+}
+
+// 辅助函数：跳过 "." 和 ".."
+static int isDotEntry(const char* name) {
+    return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+// 辅助函数：文件的修改时间（Unix 纪元起的纳秒数），秒级时间戳无法区分同一秒内的两次写入
+static long long getModifiedTime(const struct stat* st) {
+#ifdef __APPLE__
+    return (long long)st->st_mtimespec.tv_sec * NANOSECONDS_PER_SECOND + st->st_mtimespec.tv_nsec;
+#else
+    return (long long)st->st_mtim.tv_sec * NANOSECONDS_PER_SECOND + st->st_mtim.tv_nsec;
+#endif
+}
+
+// 检查路径是否存在
+int pathExists(const char* path) {
+    if (access(path, F_OK) != 0) {
+        logMessage(LOG_WARNING, "Path does not exist: %s", path);
+        return 0;
+    }
+    return 1;
+}
+
+// 创建目录
+int createDirectory(const char* path) {
+    int result = mkdir(path, 0777);
+    if (result != 0 && errno != EEXIST) {
+        logMessage(LOG_ERROR, "Cannot create directory: %s", path);
+    }
+    return result;
+}
+
+// 辅助函数：记录无法访问的表项（仅在出错时才拼接完整路径）
+static void logEntryWarning(const char* message, const FileList* list, int index) {
+    char entryPath[MAX_PATH_LENGTH];
+    if (getEntryPath(list, index, entryPath, MAX_PATH_LENGTH) == NULL) {
+        snprintf(entryPath, MAX_PATH_LENGTH, "%s", getEntryName(list, index));
+    }
+    logMessage(LOG_WARNING, "%s: %s", message, entryPath);
+}
+
+// 一次扫描中不变的遍历设置
+typedef struct TraversalState {
+    unsigned int flags;         // TRAVERSE_* 标志
+    dev_t rootDevice;           // 输入目录所在的文件系统
+} TraversalState;
+
+// 辅助函数：目录是否应按遍历选项跳过（挂载点或符号链接），只在启用相应选项时才额外 stat
+static int skipDirectoryByTraversal(int directoryFd, const struct dirent* entry, const struct stat* target, const TraversalState* state) {
+    if (state->flags == 0) {
+        return 0;
+    }
+    
+    struct stat st;
+    if (fstatat(directoryFd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        return 0;
+    }
+    if ((state->flags & TRAVERSE_NO_FOLLOW) && S_ISLNK(st.st_mode)) {
+        return 1;
+    }
+    if (state->flags & TRAVERSE_ONE_FILE_SYSTEM) {
+        dev_t device = (target != NULL) ? target->st_dev : st.st_dev;
+        return device != state->rootDevice;
+    }
+    return 0;
+}
+
+// 辅助函数：读取目录项的类型、大小和修改时间
+// 目录类型直接取自 d_type；普通文件通过 fstatat 相对当前目录获取大小和修改时间
+// 返回 1 表示正常，0 表示按遍历选项跳过，-1 表示无法 stat（仍按大小为 0 的文件处理）
+static int readEntryInfo(int directoryFd, const struct dirent* entry, const TraversalState* state, unsigned int* flags, long long* size, long long* mtime) {
+    *flags = 0;
+    *size = 0;
+    *mtime = 0;
+    
+    if (entry->d_type == DT_DIR) {
+        if (skipDirectoryByTraversal(directoryFd, entry, NULL, state)) {
+            return 0;
+        }
+        *flags = FILE_ENTRY_DIRECTORY;
+        return 1;
+    }
+    
+    // 符号链接默认按其目标处理，与 Windows 端跟随目录联接的行为一致
+    struct stat st;
+    if (fstatat(directoryFd, entry->d_name, &st, 0) != 0) {
+        return -1;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        if (skipDirectoryByTraversal(directoryFd, entry, &st, state)) {
+            return 0;
+        }
+        *flags = FILE_ENTRY_DIRECTORY;
+    } else {
+        *size = (long long)st.st_size;
+    }
+    *mtime = getModifiedTime(&st);
+    return 1;
+}
+
+// 构建文件列表（基于目录文件描述符递归）
+static void buildFileListAt(DIR* dir, int parent, FileList* list, const TraversalState* state) {
+    int directoryFd = dirfd(dir);
+    struct dirent* entry;
+    
+    while ((entry = readdir(dir)) != NULL) {
+        // 跳过 "." 和 ".."
+        if (isDotEntry(entry->d_name)) {
+            continue;
+        }
+        
+        unsigned int flags;
+        long long size;
+        long long mtime;
+        int info = readEntryInfo(directoryFd, entry, state, &flags, &size, &mtime);
+        if (info == 0) {
+            continue;
+        }
+        int statFailed = (info < 0);
+        
+        int index = addFileEntry(list, parent, entry->d_name, strlen(entry->d_name), flags, size, mtime);
+        if (index == FILE_ENTRY_FILTERED) {
+            continue;
+        }
+        if (index < 0) {
+            return;
+        }
+        if (statFailed) {
+            logEntryWarning("Cannot stat file", list, index);
+        }
+        
+        if (flags & FILE_ENTRY_DIRECTORY) {
+            // 递归处理子目录
+            DIR* subDir = openDirectoryAt(directoryFd, entry->d_name);
+            if (subDir == NULL) {
+                logEntryWarning("Cannot open directory for building file list", list, index);
+            } else {
+                buildFileListAt(subDir, index, list, state);
+                closedir(subDir);
+            }
+        }
+    }
+}
+
+// 构建文件列表（一次扫描同时供打印文件树、处理文件和创建输出目录使用）
+int buildFileList(const char* path, FileList* list) {
+    DIR* dir = openDirectoryAt(AT_FDCWD, path);
+    if (dir == NULL) {
+        logMessage(LOG_WARNING, "Cannot open directory for building file list: %s", path);
+        return -1;
+    }
+    
+    TraversalState state;
+    state.flags = (list->filter != NULL) ? getTraversalFlags(list->filter) : 0;
+    state.rootDevice = 0;
+    struct stat st;
+    if (fstat(dirfd(dir), &st) == 0) {
+        state.rootDevice = st.st_dev;
+    }
+    
+    buildFileListAt(dir, -1, list, &state);
+    closedir(dir);
+    return 0;
+}
+
+// 获取路径所在文件系统的标识（用于 --one-file-system），失败时返回 0
+unsigned long long getFileSystemId(const char* path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return 0;
+    }
+    return (unsigned long long)st.st_dev;
+}
+
+// 列举单个目录中的各项（不递归），每项调用一次 callback，callback 返回非 0 时停止
+// 供并行扫描的工作线程使用；fileSystem 为 getFileSystemId 得到的输入目录标识
+int enumerateDirectory(const char* path, unsigned int traversalFlags, unsigned long long fileSystem, DirectoryEntryCallback callback, void* userData) {
+    DIR* dir = openDirectoryAt(AT_FDCWD, path);
+    if (dir == NULL) {
+        logMessage(LOG_WARNING, "Cannot open directory for building file list: %s", path);
+        return -1;
+    }
+    
+    TraversalState state;
+    state.flags = traversalFlags;
+    state.rootDevice = (dev_t)fileSystem;
+    
+    int directoryFd = dirfd(dir);
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (isDotEntry(entry->d_name)) {
+            continue;
+        }
+        
+        unsigned int flags;
+        long long size;
+        long long mtime;
+        int info = readEntryInfo(directoryFd, entry, &state, &flags, &size, &mtime);
+        if (info == 0) {
+            continue;
+        }
+        if (info < 0) {
+            logMessage(LOG_WARNING, "Cannot stat file: %s/%s", path, entry->d_name);
+        }
+        if (callback(userData, entry->d_name, flags, size, mtime) != 0) {
+            break;
+        }
+    }
+    
+    closedir(dir);
+    return 0;
+}
+
+// 辅助函数：确保目标文件所在目录存在
+static int ensureParentDirectory(const char* destination) {
+    char destDir[MAX_PATH_LENGTH];
+    snprintf(destDir, MAX_PATH_LENGTH, "%s", destination);
+    
+    char* lastSlash = strrchr(destDir, '/');
+    if (lastSlash != NULL && lastSlash != destDir) {
+        *lastSlash = '\0';
+        
+        // 创建目录（如果不存在）
+        if (mkdir(destDir, 0777) != 0 && errno != EEXIST) {
+            logMessage(LOG_ERROR, "Cannot create directory %s", destDir);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 辅助函数：创建硬链接或符号链接，已存在的目标文件先删除
+static int linkFile(const char* source, const char* destination, CopyMode mode) {
+    if (unlink(destination) != 0 && errno != ENOENT) {
+        return -1;
+    }
+    if (mode == COPY_HARDLINK) {
+        return link(source, destination);
+    }
+    
+    // 符号链接使用绝对路径，避免链接位置不同导致相对路径失效
+    char absolutePath[PATH_MAX];
+    if (realpath(source, absolutePath) == NULL) {
+        return -1;
+    }
+    return symlink(absolutePath, destination);
+}
+
+// 辅助函数：在内核中复制数据（copy_file_range），不经过用户态缓冲区
+// 返回 1 表示完成；返回 0 表示不支持且尚未复制任何数据；返回 -1 表示出错
+static int copyDataInKernel(int input, int output) {
+#ifdef __linux__
+    int copiedAny = 0;
+    for (;;) {
+        ssize_t copied = copy_file_range(input, NULL, output, NULL, 1 << 30, 0);
+        if (copied == 0) {
+            return 1;
+        }
+        if (copied < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (!copiedAny && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP || errno == EPERM)) {
+                return 0;
+            }
+            return -1;
+        }
+        copiedAny = 1;
+    }
+#else
+    (void)input;
+    (void)output;
+    return 0;
+#endif
+}
+
+// 辅助函数：在用户态读写复制剩余数据
+static int copyDataUserspace(int input, int output) {
+    char buffer[65536];
+    for (;;) {
+        ssize_t bytesRead = read(input, buffer, sizeof(buffer));
+        if (bytesRead == 0) {
+            return 1;
+        }
+        if (bytesRead < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 0;
+        }
+        
+        ssize_t offset = 0;
+        while (offset < bytesRead) {
+            ssize_t bytesWritten = write(output, buffer + offset, (size_t)(bytesRead - offset));
+            if (bytesWritten < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return 0;
+            }
+            offset += bytesWritten;
+        }
+    }
+}
+
+// 复制文件（保留路径结构），按 mode 选择链接、reflink、内核态或用户态复制
+int copyFileWithPath(const char* source, const char* destination, CopyMode mode) {
+    // 确保目标目录存在
+    if (!ensureParentDirectory(destination)) {
+        return 0;
+    }
+    
+    // 链接模式：跨文件系统等原因失败时退回到复制
+    if (mode == COPY_HARDLINK || mode == COPY_SYMLINK) {
+        const char* kind = (mode == COPY_HARDLINK) ? "hard link" : "symbolic link";
+        if (linkFile(source, destination, mode) == 0) {
+            logMessage(LOG_INFO, "Created %s: %s -> %s", kind, source, destination);
+            return 1;
+        }
+        logMessage(LOG_WARNING, "Cannot create %s %s -> %s (%s), copying instead", kind, source, destination, strerror(errno));
+        mode = COPY_AUTO;
+    }
+    
+    int input = open(source, O_RDONLY | O_CLOEXEC);
+    if (input < 0) {
+        logMessage(LOG_ERROR, "Failed to copy file %s -> %s", source, destination);
+        return 0;
+    }
+    
+    struct stat st;
+    mode_t fileMode = (fstat(input, &st) == 0) ? (st.st_mode & 0777) : 0666;
+    int output = open(destination, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, fileMode);
+    if (output < 0) {
+        close(input);
+        logMessage(LOG_ERROR, "Failed to copy file %s -> %s", source, destination);
+        return 0;
+    }
+    
+    // 依次尝试 reflink（btrfs/xfs 等共享数据块，不复制数据）、内核态复制和用户态复制
+    const char* method = NULL;
+    int success = 0;
+#ifdef FICLONE
+    if ((mode == COPY_AUTO || mode == COPY_REFLINK) && ioctl(output, FICLONE, input) == 0) {
+        method = "reflink";
+        success = 1;
+    }
+#endif
+    if (method == NULL && mode == COPY_REFLINK) {
+        logMessage(LOG_ERROR, "Reflink not supported for %s -> %s", source, destination);
+        method = "reflink";
+    }
+    if (method == NULL) {
+        int result = copyDataInKernel(input, output);
+        if (result != 0) {
+            method = "copy_file_range";
+            success = (result > 0);
+        }
+    }
+    if (method == NULL) {
+        method = "read/write";
+        success = copyDataUserspace(input, output);
+    }
+    
+    close(input);
+    if (close(output) != 0) {
+        success = 0;
+    }
+    
+    if (success) {
+        logMessage(LOG_INFO, "Copy successful (%s): %s -> %s", method, source, destination);
+        return 1;
+    } else {
+        // 不保留不完整的目标文件
+        unlink(destination);
+        logMessage(LOG_ERROR, "Failed to copy file %s -> %s", source, destination);
+        return 0;
+    }
+}
+
+// 获取文件大小和修改时间，文件不存在时返回 -1（不记录日志）
+int getFileInfo(const char* path, long long* size, long long* mtime) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return -1;
+    }
+    
+    if (size != NULL) {
+        *size = S_ISDIR(st.st_mode) ? 0 : (long long)st.st_size;
+    }
+    if (mtime != NULL) {
+        *mtime = getModifiedTime(&st);
+    }
+    return 0;
+}
+
+// 把路径转换为绝对路径，解析其中的 .、.. 和符号链接；末尾尚不存在的部分拼接在最近的已存在目录之后
+int getAbsolutePath(const char* path, char* buffer, size_t bufferSize) {
+    char resolved[PATH_MAX];
+    if (realpath(path, resolved) != NULL) {
+        int written = snprintf(buffer, bufferSize, "%s", resolved);
+        return (written < 0 || (size_t)written >= bufferSize) ? -1 : 0;
+    }
+    if (errno != ENOENT) {
+        return -1;
+    }
+    
+    // 去掉末尾的分隔符后拆出最后一级，先解析其上级目录
+    char parent[MAX_PATH_LENGTH];
+    int written = snprintf(parent, sizeof(parent), "%s", path);
+    if (written <= 0 || (size_t)written >= sizeof(parent)) {
+        return -1;
+    }
+    size_t length = (size_t)written;
+    while (length > 1 && parent[length - 1] == '/') {
+        parent[--length] = '\0';
+    }
+    char* lastSeparator = strrchr(parent, '/');
+    const char* name = (lastSeparator != NULL) ? lastSeparator + 1 : parent;
+    const char* parentPath = ".";
+    if (lastSeparator == parent) {
+        parentPath = "/";
+    } else if (lastSeparator != NULL) {
+        *lastSeparator = '\0';
+        parentPath = parent;
+    }
+    if (name[0] == '\0' || getAbsolutePath(parentPath, buffer, bufferSize) != 0) {
+        return -1;
+    }
+    
+    // 上级目录不存在时其中的 . 和 .. 只能按字面处理
+    size_t used = strlen(buffer);
+    if (strcmp(name, ".") == 0) {
+        return 0;
+    }
+    if (strcmp(name, "..") == 0) {
+        char* separator = strrchr(buffer, '/');
+        if (separator != NULL) {
+            separator[separator == buffer ? 1 : 0] = '\0';
+        }
+        return 0;
+    }
+    written = snprintf(buffer + used, bufferSize - used, "%s%s", (used > 0 && buffer[used - 1] == '/') ? "" : "/", name);
+    return (written < 0 || (size_t)written >= bufferSize - used) ? -1 : 0;
+}
+
+// 打开文件（路径为 UTF-8）
+FILE* openFile(const char* path, const char* mode) {
+    return fopen(path, mode);
+}
+
+// 判断流是否连接到终端
+int isTerminal(FILE* stream) {
+    return isatty(fileno(stream));
+}
+
+// 用 source 原子地替换 destination
+int replaceFile(const char* source, const char* destination) {
+    if (rename(source, destination) != 0) {
+        logMessage(LOG_ERROR, "Cannot replace %s with %s: %s", destination, source, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// 只读映射的文件
+struct MappedFile {
+    void* data;
+    size_t size;
+};
+
+// 把整个文件只读映射到内存，文件不存在、为空或无法映射时返回 NULL
+MappedFile* mapFile(const char* path, const void** data, size_t* size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+    
+    MappedFile* mapped = (MappedFile*)malloc(sizeof(MappedFile));
+    if (mapped == NULL) {
+        close(fd);
+        return NULL;
+    }
+    mapped->size = (size_t)st.st_size;
+    mapped->data = mmap(NULL, mapped->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped->data == MAP_FAILED) {
+        logMessage(LOG_WARNING, "Cannot map %s: %s", path, strerror(errno));
+        free(mapped);
+        return NULL;
+    }
+    
+    *data = mapped->data;
+    *size = mapped->size;
+    return mapped;
+}
+
+// 解除文件映射
+void unmapFile(MappedFile* mapped) {
+    if (mapped == NULL) {
+        return;
+    }
+    munmap(mapped->data, mapped->size);
+    free(mapped);
+}
+
+#ifdef __linux__
+// 目录监视器：inotify 实例，以及监视描述符到目录相对路径的映射
+struct DirectoryWatcher {
+    int fd;
+    char root[MAX_PATH_LENGTH];
+    unsigned int traversalFlags;
+    dev_t rootDevice;
+    WatchCallback callback;
+    void* userData;
+    char** directories;         // 以监视描述符为下标，根目录为 ""，已移除的监视为 NULL
+    int directoryCapacity;
+};
+
+// 每个目录关注的事件：IN_CLOSE_WRITE 表示写入完成，IN_CREATE/IN_MODIFY 只推迟处理时间
+#define WATCH_EVENT_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_MODIFY | IN_DELETE | IN_ONLYDIR)
+
+// 列举新目录时传给回调的上下文
+typedef struct WatchEnumeration {
+    DirectoryWatcher* watcher;
+    const char* relativePath;
+    int reportFiles;
+} WatchEnumeration;
+
+static void watchDirectoryTree(DirectoryWatcher* watcher, const char* relativePath, int reportFiles);
+
+// 辅助函数：拼接子项的相对路径
+static int joinRelativePath(char* buffer, size_t bufferSize, const char* directory, const char* name) {
+    int written = (directory[0] == '\0') ? snprintf(buffer, bufferSize, "%s", name) : snprintf(buffer, bufferSize, "%s/%s", directory, name);
+    return (written < 0 || (size_t)written >= bufferSize) ? -1 : 0;
+}
+
+// 辅助函数：记录监视描述符对应的目录（同一目录再次注册时返回原来的描述符，路径随之更新）
+static void setWatchDirectory(DirectoryWatcher* watcher, int wd, const char* relativePath) {
+    if (wd >= watcher->directoryCapacity) {
+        int capacity = watcher->directoryCapacity > 0 ? watcher->directoryCapacity : 64;
+        while (capacity <= wd) {
+            capacity *= 2;
+        }
+        char** directories = (char**)realloc(watcher->directories, (size_t)capacity * sizeof(char*));
+        if (directories == NULL) {
+            logMessage(LOG_ERROR, "Out of memory while watching directory: %s", relativePath);
+            return;
+        }
+        memset(directories + watcher->directoryCapacity, 0, (size_t)(capacity - watcher->directoryCapacity) * sizeof(char*));
+        watcher->directories = directories;
+        watcher->directoryCapacity = capacity;
+    }
+    free(watcher->directories[wd]);
+    watcher->directories[wd] = strdup(relativePath);
+}
+
+// 辅助函数：列举目录时对每一项调用：子目录递归加入监视，需要时把已有文件报告为写入完成
+static int watchEntry(void* userData, const char* name, unsigned int flags, long long size, long long mtime) {
+    (void)size;
+    (void)mtime;
+    WatchEnumeration* context = (WatchEnumeration*)userData;
+    DirectoryWatcher* watcher = context->watcher;
+    char relativePath[MAX_PATH_LENGTH];
+    if (joinRelativePath(relativePath, sizeof(relativePath), context->relativePath, name) != 0) {
+        logMessage(LOG_WARNING, "Path too long, not watched: %s/%s", context->relativePath, name);
+        return 0;
+    }
+    
+    if (flags & FILE_ENTRY_DIRECTORY) {
+        if (watcher->callback(watcher->userData, relativePath, WATCH_DIRECTORY_ADDED) == 0) {
+            watchDirectoryTree(watcher, relativePath, context->reportFiles);
+        }
+    } else if (context->reportFiles) {
+        watcher->callback(watcher->userData, relativePath, WATCH_FILE_CLOSED);
+    }
+    return 0;
+}
+
+// 辅助函数：监视一个目录及其所有子目录
+// 先注册监视再列举，列举期间新写入的文件不会遗漏；reportFiles 为真时目录中已有的文件也报告给回调（用于新出现的目录）
+static void watchDirectoryTree(DirectoryWatcher* watcher, const char* relativePath, int reportFiles) {
+    char path[MAX_PATH_LENGTH];
+    if (relativePath[0] == '\0') {
+        snprintf(path, sizeof(path), "%s", watcher->root);
+    } else if (joinRelativePath(path, sizeof(path), watcher->root, relativePath) != 0) {
+        logMessage(LOG_WARNING, "Path too long, not watched: %s", relativePath);
+        return;
+    }
+    
+    uint32_t mask = WATCH_EVENT_MASK | ((watcher->traversalFlags & TRAVERSE_NO_FOLLOW) ? IN_DONT_FOLLOW : 0);
+    int wd = inotify_add_watch(watcher->fd, path, mask);
+    if (wd < 0) {
+        if (errno == ENOSPC) {
+            logMessage(LOG_ERROR, "inotify watch limit reached (see fs.inotify.max_user_watches), not watched: %s", path);
+        } else if (errno != ENOENT) {
+            logMessage(LOG_WARNING, "Cannot watch directory %s: %s", path, strerror(errno));
+        }
+        return;
+    }
+    setWatchDirectory(watcher, wd, relativePath);
+    
+    WatchEnumeration context;
+    context.watcher = watcher;
+    context.relativePath = relativePath;
+    context.reportFiles = reportFiles;
+    enumerateDirectory(path, watcher->traversalFlags, (unsigned long long)watcher->rootDevice, watchEntry, &context);
+}
+
+// 辅助函数：停止监视移出的目录及其子目录（移动到树内其他位置时会以新路径重新加入）
+static void unwatchDirectoryTree(DirectoryWatcher* watcher, const char* relativePath) {
+    size_t length = strlen(relativePath);
+    for (int wd = 0; wd < watcher->directoryCapacity; wd++) {
+        const char* directory = watcher->directories[wd];
+        if (directory != NULL && strncmp(directory, relativePath, length) == 0 && (directory[length] == '\0' || directory[length] == '/')) {
+            inotify_rm_watch(watcher->fd, wd);
+            free(watcher->directories[wd]);
+            watcher->directories[wd] = NULL;
+        }
+    }
+}
+
+// 辅助函数：判断新出现的项是否为目录：1 为需要监视的目录，0 不是目录，-1 为按遍历选项跳过的目录
+// 指向目录的符号链接不带 IN_ISDIR 标志，因此同样需要 stat
+static int classifyNewEntry(const DirectoryWatcher* watcher, const char* relativePath) {
+    char path[MAX_PATH_LENGTH];
+    if (joinRelativePath(path, sizeof(path), watcher->root, relativePath) != 0) {
+        return 0;
+    }
+    
+    struct stat st;
+    if (lstat(path, &st) != 0) {
+        return 0;
+    }
+    if (S_ISLNK(st.st_mode)) {
+        if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+            return 0;
+        }
+        if (watcher->traversalFlags & TRAVERSE_NO_FOLLOW) {
+            return -1;
+        }
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        return 0;
+    }
+    if ((watcher->traversalFlags & TRAVERSE_ONE_FILE_SYSTEM) && st.st_dev != watcher->rootDevice) {
+        return -1;
+    }
+    return 1;
+}
+
+// 辅助函数：处理一个 inotify 事件
+static void handleWatchEvent(DirectoryWatcher* watcher, const struct inotify_event* event) {
+    // 事件队列溢出时丢失的变更无从得知：重新注册并列举整个目录树，把所有文件报告为写入完成（已注册的目录沿用原来的监视）
+    if (event->mask & IN_Q_OVERFLOW) {
+        logMessage(LOG_WARNING, "Watch event queue overflowed, rescanning %s", watcher->root);
+        watchDirectoryTree(watcher, "", 1);
+        return;
+    }
+    if (event->wd < 0 || event->wd >= watcher->directoryCapacity || watcher->directories[event->wd] == NULL) {
+        return;
+    }
+    if (event->mask & IN_IGNORED) {
+        // 目录被删除或监视已移除
+        free(watcher->directories[event->wd]);
+        watcher->directories[event->wd] = NULL;
+        return;
+    }
+    if (event->len == 0) {
+        return;
+    }
+    
+    char relativePath[MAX_PATH_LENGTH];
+    if (joinRelativePath(relativePath, sizeof(relativePath), watcher->directories[event->wd], event->name) != 0) {
+        logMessage(LOG_WARNING, "Path too long, change ignored: %s", event->name);
+        return;
+    }
+    
+    if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+        int directory = classifyNewEntry(watcher, relativePath);
+        if (directory > 0 && watcher->callback(watcher->userData, relativePath, WATCH_DIRECTORY_ADDED) == 0) {
+            watchDirectoryTree(watcher, relativePath, 1);
+        }
+        if (directory != 0) {
+            return;
+        }
+    }
+    
+    if (event->mask & IN_ISDIR) {
+        if (event->mask & IN_MOVED_FROM) {
+            unwatchDirectoryTree(watcher, relativePath);
+        }
+    } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+        watcher->callback(watcher->userData, relativePath, WATCH_FILE_REMOVED);
+    } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+        watcher->callback(watcher->userData, relativePath, WATCH_FILE_CLOSED);
+    } else if (event->mask & (IN_CREATE | IN_MODIFY)) {
+        watcher->callback(watcher->userData, relativePath, WATCH_FILE_CHANGED);
+    }
+}
+#else
+// 其他 POSIX 系统上没有 inotify，监视模式不可用
+struct DirectoryWatcher {
+    int unused;
+};
+#endif
+
+// 创建目录监视器，在 root 下的整个目录树上注册监视（按 traversalFlags 跳过符号链接或其他文件系统）
+// 事件在 readWatchEvents 中通过 callback 报告；创建时已有的文件不报告
+DirectoryWatcher* createDirectoryWatcher(const char* root, unsigned int traversalFlags, WatchCallback callback, void* userData) {
+#ifdef __linux__
+    DirectoryWatcher* watcher = (DirectoryWatcher*)calloc(1, sizeof(DirectoryWatcher));
+    if (watcher == NULL) {
+        return NULL;
+    }
+    watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watcher->fd < 0) {
+        logMessage(LOG_ERROR, "Cannot initialize inotify: %s", strerror(errno));
+        free(watcher);
+        return NULL;
+    }
+    snprintf(watcher->root, MAX_PATH_LENGTH, "%s", root);
+    watcher->traversalFlags = traversalFlags;
+    watcher->rootDevice = (dev_t)getFileSystemId(root);
+    watcher->callback = callback;
+    watcher->userData = userData;
+    
+    watchDirectoryTree(watcher, "", 0);
+    if (watcher->directoryCapacity == 0) {
+        freeDirectoryWatcher(watcher);
+        return NULL;
+    }
+    return watcher;
+#else
+    (void)root;
+    (void)traversalFlags;
+    (void)callback;
+    (void)userData;
+    logMessage(LOG_ERROR, "Watching directories is not supported on this platform");
+    return NULL;
+#endif
+}
+
+// 等待并处理监视事件，最多等待 timeoutMs 毫秒，返回处理的事件数（出错返回 -1）
+int readWatchEvents(DirectoryWatcher* watcher, int timeoutMs) {
+#ifdef __linux__
+    struct pollfd fd;
+    fd.fd = watcher->fd;
+    fd.events = POLLIN;
+    fd.revents = 0;
+    int ready = poll(&fd, 1, timeoutMs);
+    if (ready <= 0) {
+        return (ready < 0 && errno != EINTR) ? -1 : 0;
+    }
+    
+    // 按 inotify_event 对齐的读取缓冲区
+    union {
+        struct inotify_event event;
+        char bytes[64 * 1024];
+    } buffer;
+    int events = 0;
+    for (;;) {
+        ssize_t bytes = read(watcher->fd, buffer.bytes, sizeof(buffer.bytes));
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            break;
+        }
+        for (ssize_t offset = 0; offset < bytes; ) {
+            const struct inotify_event* event = (const struct inotify_event*)(buffer.bytes + offset);
+            handleWatchEvent(watcher, event);
+            events++;
+            offset += (ssize_t)(sizeof(struct inotify_event) + event->len);
+        }
+    }
+    return events;
+#else
+    (void)watcher;
+    (void)timeoutMs;
+    return -1;
+#endif
+}
+
+// 释放目录监视器
+void freeDirectoryWatcher(DirectoryWatcher* watcher) {
+    if (watcher == NULL) {
+        return;
+    }
+#ifdef __linux__
+    close(watcher->fd);
+    for (int wd = 0; wd < watcher->directoryCapacity; wd++) {
+        free(watcher->directories[wd]);
+    }
+    free(watcher->directories);
+#endif
+    free(watcher);
+}
+
+// Ctrl+C 或 SIGTERM 的标志，由 interruptRequested 查询（信号处理函数和其他线程都会访问，因此使用无锁原子变量）
+static atomic_int interruptReceived = 0;
+
+// 辅助函数：信号处理函数，只设置标志
+static void onInterrupt(int signalNumber) {
+    (void)signalNumber;
+    atomic_store(&interruptReceived, 1);
+}
+
+// 把 Ctrl+C 和 SIGTERM 改为设置标志，让长时间运行的模式有机会在当前任务结束后正常退出
+// 处理函数只生效一次，再次按下 Ctrl+C 时立即终止
+void installInterruptHandler(void) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onInterrupt;
+    action.sa_flags = SA_RESETHAND;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+}
+
+// 是否已收到中断请求
+int interruptRequested(void) {
+    return atomic_load(&interruptReceived) != 0;
+}
+
+// 网络连接（监听套接字或已建立的连接）
+struct NetSocket {
+    int fd;
+    char unixPath[MAX_PATH_LENGTH];     // 监听的 Unix 域套接字路径（关闭时删除），其他情况为空
+};
+
+// 辅助函数：把 host:port 拆成主机和端口；省略主机（:port 或只有端口）时使用本机回环地址，IPv6 地址写在方括号中
+static int splitAddress(const char* address, char* host, size_t hostSize, char* port, size_t portSize) {
+    const char* colon = strrchr(address, ':');
+    const char* portText = (colon != NULL) ? colon + 1 : address;
+    size_t hostLength = (colon != NULL) ? (size_t)(colon - address) : 0;
+    if (hostLength >= 2 && address[0] == '[' && address[hostLength - 1] == ']') {
+        address++;
+        hostLength -= 2;
+    }
+    if (portText[0] == '\0' || strlen(portText) >= portSize || hostLength >= hostSize) {
+        return -1;
+    }
+    if (hostLength == 0) {
+        snprintf(host, hostSize, "127.0.0.1");
+    } else {
+        memcpy(host, address, hostLength);
+        host[hostLength] = '\0';
+    }
+    strcpy(port, portText);
+    return 0;
+}
+
+// 辅助函数：包装已打开的套接字，失败时关闭套接字
+static NetSocket* wrapSocket(int fd) {
+    NetSocket* connection = (NetSocket*)calloc(1, sizeof(NetSocket));
+    if (connection == NULL) {
+        close(fd);
+        return NULL;
+    }
+    connection->fd = fd;
+    return connection;
+}
+
+// 辅助函数：设置连接选项：命令消息都很短，关闭 Nagle 算法以降低往返延迟；启用保活以发现已断开的对端
+static void configureConnection(int fd, int tcp) {
+    int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof(enable));
+    if (tcp) {
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    }
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+#endif
+}
+
+// 辅助函数：填写 Unix 域套接字地址，路径过长返回 -1
+static int makeUnixAddress(const char* path, struct sockaddr_un* unixAddress) {
+    memset(unixAddress, 0, sizeof(*unixAddress));
+    unixAddress->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(unixAddress->sun_path)) {
+        return -1;
+    }
+    strcpy(unixAddress->sun_path, path);
+    return 0;
+}
+
+// 在地址上监听连接：host:port（TCP）或 unix:路径（Unix 域套接字，已存在的旧套接字文件会被替换）
+NetSocket* listenOnAddress(const char* address) {
+    if (strncmp(address, "unix:", 5) == 0) {
+        struct sockaddr_un unixAddress;
+        if (makeUnixAddress(address + 5, &unixAddress) != 0) {
+            logMessage(LOG_ERROR, "Socket path too long: %s", address + 5);
+            return NULL;
+        }
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return NULL;
+        }
+        unlink(unixAddress.sun_path);
+        if (bind(fd, (struct sockaddr*)&unixAddress, sizeof(unixAddress)) != 0 || listen(fd, SOMAXCONN) != 0) {
+            logMessage(LOG_ERROR, "Cannot listen on %s: %s", address, strerror(errno));
+            close(fd);
+            return NULL;
+        }
+        NetSocket* listener = wrapSocket(fd);
+        if (listener != NULL) {
+            strcpy(listener->unixPath, unixAddress.sun_path);
+        }
+        return listener;
+    }
+    
+    char host[256];
+    char port[32];
+    if (splitAddress(address, host, sizeof(host), port, sizeof(port)) != 0) {
+        logMessage(LOG_ERROR, "Invalid address: %s", address);
+        return NULL;
+    }
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    struct addrinfo* results = NULL;
+    int error = getaddrinfo(host, port, &hints, &results);
+    if (error != 0) {
+        logMessage(LOG_ERROR, "Cannot resolve %s: %s", address, gai_strerror(error));
+        return NULL;
+    }
+    
+    int fd = -1;
+    for (struct addrinfo* result = results; result != NULL && fd < 0; result = result->ai_next) {
+        fd = socket(result->ai_family, result->ai_socktype | SOCK_CLOEXEC, result->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        int enable = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        if (bind(fd, result->ai_addr, result->ai_addrlen) != 0 || listen(fd, SOMAXCONN) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(results);
+    if (fd < 0) {
+        logMessage(LOG_ERROR, "Cannot listen on %s: %s", address, strerror(errno));
+        return NULL;
+    }
+    return wrapSocket(fd);
+}
+
+// 接受一个连接（监听套接字可读时调用），失败返回 NULL
+NetSocket* acceptConnection(NetSocket* listener) {
+    int fd = accept(listener->fd, NULL, NULL);
+    if (fd < 0) {
+        return NULL;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    configureConnection(fd, listener->unixPath[0] == '\0');
+    return wrapSocket(fd);
+}
+
+// 连接到地址（格式同 listenOnAddress），失败返回 NULL
+NetSocket* connectToAddress(const char* address) {
+    if (strncmp(address, "unix:", 5) == 0) {
+        struct sockaddr_un unixAddress;
+        if (makeUnixAddress(address + 5, &unixAddress) != 0) {
+            logMessage(LOG_ERROR, "Socket path too long: %s", address + 5);
+            return NULL;
+        }
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return NULL;
+        }
+        if (connect(fd, (struct sockaddr*)&unixAddress, sizeof(unixAddress)) != 0) {
+            logMessage(LOG_ERROR, "Cannot connect to %s: %s", address, strerror(errno));
+            close(fd);
+            return NULL;
+        }
+        configureConnection(fd, 0);
+        return wrapSocket(fd);
+    }
+    
+    char host[256];
+    char port[32];
+    if (splitAddress(address, host, sizeof(host), port, sizeof(port)) != 0) {
+        logMessage(LOG_ERROR, "Invalid address: %s", address);
+        return NULL;
+    }
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* results = NULL;
+    int error = getaddrinfo(host, port, &hints, &results);
+    if (error != 0) {
+        logMessage(LOG_ERROR, "Cannot resolve %s: %s", address, gai_strerror(error));
+        return NULL;
+    }
+    
+    int fd = -1;
+    for (struct addrinfo* result = results; result != NULL && fd < 0; result = result->ai_next) {
+        fd = socket(result->ai_family, result->ai_socktype | SOCK_CLOEXEC, result->ai_protocol);
+        if (fd >= 0 && connect(fd, result->ai_addr, result->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(results);
+    if (fd < 0) {
+        logMessage(LOG_ERROR, "Cannot connect to %s: %s", address, strerror(errno));
+        return NULL;
+    }
+    configureConnection(fd, 1);
+    return wrapSocket(fd);
+}
+
+// 发送全部数据，失败（连接已断开）返回 -1
+int sendData(NetSocket* connection, const char* data, size_t length) {
+#ifdef MSG_NOSIGNAL
+    int flags = MSG_NOSIGNAL;
+#else
+    int flags = 0;
+#endif
+    while (length > 0) {
+        ssize_t sent = send(connection->fd, data, length, flags);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return 0;
+}
+
+// 读取当前可读的数据：返回读到的字节数，连接关闭返回 0，出错返回 -1
+int receiveData(NetSocket* connection, char* buffer, size_t size) {
+    ssize_t received;
+    do {
+        received = recv(connection->fd, buffer, size, 0);
+    } while (received < 0 && errno == EINTR);
+    return received < 0 ? -1 : (int)received;
+}
+
+// 等待任一套接字可读（监听套接字可读表示有新连接），ready[i] 置为对应套接字是否可读（NULL 项忽略）
+// 返回可读的套接字数，超时返回 0，出错返回 -1
+int waitForSockets(NetSocket** sockets, int count, int* ready, int timeoutMs) {
+    struct pollfd stackFds[64];
+    struct pollfd* fds = stackFds;
+    if (count > 64) {
+        fds = (struct pollfd*)malloc(sizeof(struct pollfd) * (size_t)count);
+        if (fds == NULL) {
+            return -1;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        fds[i].fd = (sockets[i] != NULL) ? sockets[i]->fd : -1;
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+    }
+    
+    int result = poll(fds, (nfds_t)count, timeoutMs);
+    if (result < 0 && errno == EINTR) {
+        result = 0;
+    }
+    for (int i = 0; i < count; i++) {
+        ready[i] = (result > 0 && (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0);
+    }
+    if (fds != stackFds) {
+        free(fds);
+    }
+    return result;
+}
+
+// 关闭连接或监听套接字
+void closeSocket(NetSocket* connection) {
+    if (connection == NULL) {
+        return;
+    }
+    close(connection->fd);
+    if (connection->unixPath[0] != '\0') {
+        unlink(connection->unixPath);
+    }
+    free(connection);
+}
+
+// 获取可用的处理器数量
+int getProcessorCount(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
+
+// 辅助函数：读取 PSI 文件（/proc/pressure/*）中 "some" 行的 avg10，失败返回 -1
+static double readPressure(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    double value = -1;
+    if (fscanf(file, "some avg10=%lf", &value) != 1) {
+        value = -1;
+    }
+    fclose(file);
+    return value;
+}
+
+// 采样系统负载：平均负载、PSI 压力和可用内存（Linux 以外的系统只有平均负载）
+int getSystemLoad(SystemLoad* load) {
+    load->loadAverage = -1;
+    load->cpuPressure = -1;
+    load->memoryPressure = -1;
+    load->availableMemoryKb = -1;
+    
+    double averages[1];
+    if (getloadavg(averages, 1) == 1) {
+        load->loadAverage = averages[0];
+    }
+    
+#ifdef __linux__
+    load->cpuPressure = readPressure("/proc/pressure/cpu");
+    load->memoryPressure = readPressure("/proc/pressure/memory");
+    
+    FILE* meminfo = fopen("/proc/meminfo", "r");
+    if (meminfo != NULL) {
+        char line[256];
+        while (fgets(line, sizeof(line), meminfo) != NULL) {
+            long long value;
+            if (sscanf(line, "MemAvailable: %lld kB", &value) == 1) {
+                load->availableMemoryKb = value;
+                break;
+            }
+        }
+        fclose(meminfo);
+    }
+#endif
+    return 0;
+}
+
+#ifdef __linux__
+// 辅助函数：本进程启动时允许使用的 CPU（taskset、cgroup 限制之后）
+static const cpu_set_t* getInitialCpuSet(void) {
+    static cpu_set_t initial;
+    static int loaded = 0;
+    if (!loaded) {
+        CPU_ZERO(&initial);
+        if (sched_getaffinity(0, sizeof(initial), &initial) != 0) {
+            for (int i = 0; i < getProcessorCount() && i < CPU_SETSIZE; i++) {
+                CPU_SET(i, &initial);
+            }
+        }
+        loaded = 1;
+    }
+    return &initial;
+}
+#endif
+
+// 获取本进程可以使用的 CPU 编号，返回个数
+int getAvailableCpus(int* cpus, int maxCpus) {
+    int count = 0;
+#ifdef __linux__
+    const cpu_set_t* set = getInitialCpuSet();
+    for (int i = 0; i < CPU_SETSIZE && count < maxCpus; i++) {
+        if (CPU_ISSET(i, set)) {
+            cpus[count++] = i;
+        }
+    }
+#else
+    int processors = getProcessorCount();
+    for (int i = 0; i < processors && count < maxCpus; i++) {
+        cpus[count++] = i;
+    }
+#endif
+    return count;
+}
+
+#ifdef __linux__
+// 辅助函数：读取 sysfs 中 "0-3,8-11" 格式的编号列表，返回个数；文件无法打开时返回 -1
+static int readIdList(const char* path, int* ids, int maxIds) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    
+    int count = 0;
+    int first;
+    while (fscanf(file, "%d", &first) == 1) {
+        int last = first;
+        int c = fgetc(file);
+        if (c == '-') {
+            if (fscanf(file, "%d", &last) != 1) {
+                break;
+            }
+            c = fgetc(file);
+        }
+        for (int id = first; id <= last && count < maxIds; id++) {
+            ids[count++] = id;
+        }
+        if (c != ',') {
+            break;
+        }
+    }
+    fclose(file);
+    return count;
+}
+#endif
+
+// 获取在线的 NUMA 节点编号，返回个数（编号可能不连续，例如 "0,2"）；没有 NUMA 信息时只有节点 0
+int getNumaNodes(int* nodes, int maxNodes) {
+#ifdef __linux__
+    int count = readIdList("/sys/devices/system/node/online", nodes, maxNodes);
+    if (count > 0) {
+        return count;
+    }
+#endif
+    if (maxNodes < 1) {
+        return 0;
+    }
+    nodes[0] = 0;
+    return 1;
+}
+
+// 获取 NUMA 节点上本进程可以使用的 CPU 编号，返回个数；节点不存在时返回 -1
+int getNumaNodeCpus(int node, int* cpus, int maxCpus) {
+#ifdef __linux__
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    int nodeCpus[MAX_CPUS];
+    int nodeCount = readIdList(path, nodeCpus, MAX_CPUS);
+    if (nodeCount < 0) {
+        return (node == 0 && !pathExists("/sys/devices/system/node")) ? getAvailableCpus(cpus, maxCpus) : -1;
+    }
+    
+    const cpu_set_t* allowed = getInitialCpuSet();
+    int count = 0;
+    for (int i = 0; i < nodeCount && count < maxCpus; i++) {
+        if (nodeCpus[i] < CPU_SETSIZE && CPU_ISSET(nodeCpus[i], allowed)) {
+            cpus[count++] = nodeCpus[i];
+        }
+    }
+    return count;
+#else
+    return node == 0 ? getAvailableCpus(cpus, maxCpus) : -1;
+#endif
+}
+
+// 设置之后启动的子进程的优先级（nice 值）
+// 子进程从启动它的线程继承 nice 值，因此直接设置调用线程（Linux 上 nice 值按线程生效，不影响日志等其他线程）
+int setChildPriority(int niceness) {
+    errno = 0;
+    int current = getpriority(PRIO_PROCESS, 0);
+    if (errno == 0 && current == niceness) {
+        return 0;
+    }
+    if (setpriority(PRIO_PROCESS, 0, niceness) != 0) {
+        logMessage(LOG_WARNING, "Cannot set priority %d for commands (%s)", niceness, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// 设置之后启动的子进程可以使用的 CPU（count 为 0 时恢复为本进程启动时的设置）
+// 子进程从启动它的线程继承 CPU 亲和性，因此直接设置调用线程
+int setChildAffinity(const int* cpus, int count) {
+#ifdef __linux__
+    cpu_set_t set;
+    if (count == 0) {
+        set = *getInitialCpuSet();
+    } else {
+        CPU_ZERO(&set);
+        for (int i = 0; i < count; i++) {
+            if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE) {
+                CPU_SET(cpus[i], &set);
+            }
+        }
+    }
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        logMessage(LOG_WARNING, "Cannot set CPU affinity for commands (%s)", strerror(errno));
+        return -1;
+    }
+    return 0;
+#else
+    (void)cpus;
+    return count == 0 ? 0 : -1;
+#endif
+}
+
+// SIGCHLD 自管道：信号处理函数向写入端写一个字节，等待子进程时 poll 读取端，子进程一结束就被唤醒（创建失败时为 -1）
+static int childSignalPipe[2] = { -1, -1 };
+static pthread_once_t childSignalOnce = PTHREAD_ONCE_INIT;
+
+// 辅助函数：SIGCHLD 处理函数，只写入自管道（管道已满时说明已有未读的通知，忽略即可）
+static void onChildExit(int signalNumber) {
+    (void)signalNumber;
+    int savedErrno = errno;
+    ssize_t written = write(childSignalPipe[1], "", 1);
+    (void)written;
+    errno = savedErrno;
+}
+
+// 辅助函数：创建自管道并安装 SIGCHLD 处理函数（在第一次启动子进程之前调用一次）
+static void installChildSignalHandler(void) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        logMessage(LOG_WARNING, "Cannot create the child signal pipe: %s", strerror(errno));
+        return;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+    }
+    childSignalPipe[0] = fds[0];
+    childSignalPipe[1] = fds[1];
+    
+    // SA_RESTART：其他线程中被打断的系统调用自动重新开始
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onChildExit;
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGCHLD, &action, NULL) != 0) {
+        close(fds[0]);
+        close(fds[1]);
+        childSignalPipe[0] = -1;
+        childSignalPipe[1] = -1;
+    }
+}
+
+// 其他线程调用 wakeCommandWait 后置位，waitForAnyCommand 看到后清零并返回
+static atomic_int commandWaitWoken = 0;
+
+// 辅助函数：读空自管道中的通知
+static void drainChildSignals(void) {
+    char buffer[64];
+    while (read(childSignalPipe[0], buffer, sizeof(buffer)) > 0) {
+        continue;
+    }
+}
+
+// 辅助函数：启动子进程，START_CAPTURE_OUTPUT 时把其标准输出和标准错误重定向到新建管道
+// 管道两端都设置了 close-on-exec，避免被同时运行的其他子进程继承而收不到 EOF
+// START_NEW_GROUP 时子进程成为新进程组的组长，terminateProcessTree 向整个组发送信号
+static int spawnChild(const char* path, char* const* argv, int searchPath, ProcessHandle* handle, unsigned int startFlags) {
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attributes;
+    int captureOutput = (startFlags & START_CAPTURE_OUTPUT) != 0;
+    int newGroup = (startFlags & START_NEW_GROUP) != 0;
+    int pipeFds[2] = { -1, -1 };
+    pid_t pid;
+    
+    pthread_once(&childSignalOnce, installChildSignalHandler);
+    if (captureOutput) {
+#ifdef __linux__
+        if (pipe2(pipeFds, O_CLOEXEC) != 0) {
+#else
+        if (pipe(pipeFds) != 0 || fcntl(pipeFds[0], F_SETFD, FD_CLOEXEC) != 0 || fcntl(pipeFds[1], F_SETFD, FD_CLOEXEC) != 0) {
+#endif
+            logMessage(LOG_WARNING, "Cannot create output pipe (%s), output not captured", strerror(errno));
+            captureOutput = 0;
+        }
+    }
+    if (captureOutput) {
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, pipeFds[1], STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, pipeFds[1], STDERR_FILENO);
+    }
+    if (newGroup) {
+        posix_spawnattr_init(&attributes);
+        posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&attributes, 0);
+    }
+    
+    int result = searchPath ? posix_spawnp(&pid, path, captureOutput ? &actions : NULL, newGroup ? &attributes : NULL, argv, environ)
+                            : posix_spawn(&pid, path, captureOutput ? &actions : NULL, newGroup ? &attributes : NULL, argv, environ);
+    if (newGroup) {
+        posix_spawnattr_destroy(&attributes);
+    }
+    if (captureOutput) {
+        posix_spawn_file_actions_destroy(&actions);
+        close(pipeFds[1]);
+        if (result != 0) {
+            close(pipeFds[0]);
+        } else {
+            fcntl(pipeFds[0], F_SETFL, fcntl(pipeFds[0], F_GETFL) | O_NONBLOCK);
+        }
+    }
+    if (result != 0) {
+        errno = result;
+        return -1;
+    }
+    
+    handle->pid = (int)pid;
+    handle->output = captureOutput ? pipeFds[0] : -1;
+    return 0;
+}
+
+// 启动命令（不等待其结束），与 system() 一样通过 /bin/sh -c 执行
+int startCommand(const char* command, ProcessHandle* handle, unsigned int startFlags) {
+    char* const argv[] = { "sh", "-c", (char*)command, NULL };
+    
+    if (spawnChild("/bin/sh", argv, 0, handle, startFlags) != 0) {
+        logMessage(LOG_ERROR, "Cannot start process (%s): %s", strerror(errno), command);
+        return -1;
+    }
+    return 0;
+}
+
+// 直接启动程序（不经过 Shell），程序名按 PATH 查找
+int startProcess(char* const* argv, ProcessHandle* handle, unsigned int startFlags) {
+    if (spawnChild(argv[0], argv, 1, handle, startFlags) != 0) {
+        logMessage(LOG_ERROR, "Cannot start process (%s): %s", strerror(errno), argv[0]);
+        return -1;
+    }
+    return 0;
+}
+
+// 结束子进程及其创建的所有进程：先发送 SIGTERM 让其清理，force 为真时发送 SIGKILL
+// 子进程不是进程组组长（未使用 START_NEW_GROUP）时只向它本身发送信号
+int terminateProcessTree(ProcessHandle* handle, int force) {
+    int signalNumber = force ? SIGKILL : SIGTERM;
+    if (kill(-(pid_t)handle->pid, signalNumber) == 0) {
+        return 0;
+    }
+    return kill((pid_t)handle->pid, signalNumber) == 0 ? 0 : -1;
+}
+
+// 辅助函数：读出管道中当前可读的全部输出并交给回调；遇到 EOF 或错误时关闭管道
+static void readProcessOutput(ProcessHandle* handle, int index, OutputCallback onOutput, void* userData) {
+    char buffer[16384];
+    while (handle->output >= 0) {
+        ssize_t bytes = read(handle->output, buffer, sizeof(buffer));
+        if (bytes > 0) {
+            onOutput(userData, index, buffer, (size_t)bytes);
+            continue;
+        }
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        close(handle->output);
+        handle->output = -1;
+    }
+}
+
+// 辅助函数：等待最多 timeoutMs 毫秒（小于 0 表示无限等待），期间有输出的管道立即读出
+// SIGCHLD 自管道与输出管道一起 poll，子进程结束时立即返回；自管道不可用时最多等待 5 毫秒，由调用方重试
+static void pollProcessOutput(ProcessHandle* handles, int count, int timeoutMs, OutputCallback onOutput, void* userData) {
+    struct pollfd fds[MAX_PARALLEL_JOBS + 1];
+    int indexes[MAX_PARALLEL_JOBS + 1];
+    int fdCount = 0;
+    if (childSignalPipe[0] >= 0) {
+        fds[fdCount].fd = childSignalPipe[0];
+        fds[fdCount].events = POLLIN;
+        indexes[fdCount++] = -1;
+    } else if (timeoutMs < 0 || timeoutMs > 5) {
+        timeoutMs = 5;
+    }
+    for (int i = 0; onOutput != NULL && i < count && fdCount <= MAX_PARALLEL_JOBS; i++) {
+        if (handles[i].output >= 0) {
+            fds[fdCount].fd = handles[i].output;
+            fds[fdCount].events = POLLIN;
+            indexes[fdCount++] = i;
+        }
+    }
+    
+    if (fdCount == 0) {
+        struct timespec delay;
+        delay.tv_sec = 0;
+        delay.tv_nsec = timeoutMs * 1000000L;
+        nanosleep(&delay, NULL);
+        return;
+    }
+    
+    if (poll(fds, (nfds_t)fdCount, timeoutMs) <= 0) {
+        return;
+    }
+    for (int i = 0; i < fdCount; i++) {
+        if (fds[i].revents == 0) {
+            continue;
+        }
+        if (indexes[i] < 0) {
+            drainChildSignals();
+        } else {
+            readProcessOutput(&handles[indexes[i]], indexes[i], onOutput, userData);
+        }
+    }
+}
+
+// 辅助函数：将 wait4 的状态转换为退出码
+// 与 system() 的约定保持一致：被信号终止时返回 128 + 信号编号
+static int decodeExitStatus(int status) {
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    return -1;
+}
+
+// 等待任意一个子进程结束，返回其在数组中的下标，stats 不为 NULL 时同时返回其资源使用情况
+// timeoutMs 为 0 时只检查不等待，小于 0 时无限等待；超时或被 wakeCommandWait 唤醒时返回 PROCESS_WAIT_TIMEOUT
+// 等待期间捕获的输出交给 onOutput；子进程结束时先读完其管道中剩余的输出再返回
+int waitForAnyCommand(ProcessHandle* handles, int count, int* exitCode, ProcessStats* stats, int timeoutMs, OutputCallback onOutput, void* userData) {
+    if (count <= 0) {
+        return -1;
+    }
+    
+    long long deadline = getMonotonicTime() + timeoutMs;
+    
+    for (;;) {
+        // 仍有管道未关闭时不能阻塞在 wait4 中，否则子进程写满管道后双方会互相等待；管道都关闭后无限等待直接阻塞
+        int capturing = 0;
+        for (int i = 0; i < count; i++) {
+            capturing |= (handles[i].output >= 0);
+        }
+        
+        // 自管道可用时同样不阻塞在 wait4 中，以便 wakeCommandWait 能够唤醒
+        int status = 0;
+        struct rusage usage;
+        pid_t pid = wait4(-1, &status, (timeoutMs < 0 && !capturing && childSignalPipe[0] < 0) ? 0 : WNOHANG, &usage);
+        if (pid < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            logMessage(LOG_ERROR, "Waiting for child processes failed: %s", strerror(errno));
+            return -1;
+        }
+        
+        if (pid == 0) {
+            // 没有子进程结束：等待 SIGCHLD 或输出（期间读取输出）后重试，直到超时
+            // wait4 之后才到达的信号留在自管道中，poll 会立即返回，不会错过
+            long long remaining = timeoutMs < 0 ? -1 : deadline - getMonotonicTime();
+            if (atomic_exchange(&commandWaitWoken, 0) != 0 || (timeoutMs >= 0 && remaining <= 0)) {
+                return PROCESS_WAIT_TIMEOUT;
+            }
+            pollProcessOutput(handles, count, remaining > INT_MAX ? INT_MAX : (int)remaining, onOutput, userData);
+            continue;
+        }
+        
+        for (int i = 0; i < count; i++) {
+            if (handles[i].pid == (int)pid) {
+                *exitCode = decodeExitStatus(status);
+                if (stats != NULL) {
+                    // Linux 上 ru_maxrss 的单位为 KB
+                    stats->userTimeMs = (long long)usage.ru_utime.tv_sec * 1000 + usage.ru_utime.tv_usec / 1000;
+                    stats->systemTimeMs = (long long)usage.ru_stime.tv_sec * 1000 + usage.ru_stime.tv_usec / 1000;
+                    stats->peakMemoryKb = (long long)usage.ru_maxrss;
+                }
+                
+                // 子进程已退出，读完剩余输出后关闭管道（其后台子进程可能仍持有写入端，不再等待）
+                if (handles[i].output >= 0) {
+                    if (onOutput != NULL) {
+                        readProcessOutput(&handles[i], i, onOutput, userData);
+                    }
+                    if (handles[i].output >= 0) {
+                        close(handles[i].output);
+                        handles[i].output = -1;
+                    }
+                }
+                return i;
+            }
+        }
+    }
+}
+
+// 从其他线程唤醒正在（或下一次）等待子进程的 waitForAnyCommand，使其返回 PROCESS_WAIT_TIMEOUT
+// 用于任务来源在后台线程中取得新任务时通知执行循环；已有未处理的唤醒时不再写自管道
+void wakeCommandWait(void) {
+    pthread_once(&childSignalOnce, installChildSignalHandler);
+    if (atomic_exchange(&commandWaitWoken, 1) == 0 && childSignalPipe[1] >= 0) {
+        ssize_t written = write(childSignalPipe[1], "", 1);
+        (void)written;
+    }
+}
+
+// 单调时钟，单位为毫秒
+long long getMonotonicTime(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// 休眠指定的毫秒数
+void sleepMilliseconds(int milliseconds) {
+    struct timespec delay;
+    delay.tv_sec = milliseconds / 1000;
+    delay.tv_nsec = (long)(milliseconds % 1000) * 1000000L;
+    while (nanosleep(&delay, &delay) != 0 && errno == EINTR) {
+        continue;
+    }
+}
+
+// 线程
+struct PlatformThread {
+    pthread_t thread;
+    ThreadFunction function;
+    void* argument;
+};
+
+// 互斥锁
+struct PlatformMutex {
+    pthread_mutex_t mutex;
+};
+
+// 条件变量（使用单调时钟计算超时）
+struct PlatformCondition {
+    pthread_cond_t condition;
+};
+
+// 辅助函数：线程入口
+static void* threadEntry(void* argument) {
+    PlatformThread* thread = (PlatformThread*)argument;
+    thread->function(thread->argument);
+    return NULL;
+}
+
+// 启动线程
+PlatformThread* startThread(ThreadFunction function, void* argument) {
+    PlatformThread* thread = (PlatformThread*)malloc(sizeof(PlatformThread));
+    if (thread == NULL) {
+        return NULL;
+    }
+    
+    thread->function = function;
+    thread->argument = argument;
+    int result = pthread_create(&thread->thread, NULL, threadEntry, thread);
+    if (result != 0) {
+        logMessage(LOG_ERROR, "Cannot start thread: %s", strerror(result));
+        free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+// 等待线程结束并释放
+void joinThread(PlatformThread* thread) {
+    if (thread == NULL) {
+        return;
+    }
+    pthread_join(thread->thread, NULL);
+    free(thread);
+}
+
+// 创建互斥锁
+PlatformMutex* createMutex(void) {
+    PlatformMutex* mutex = (PlatformMutex*)malloc(sizeof(PlatformMutex));
+    if (mutex != NULL) {
+        pthread_mutex_init(&mutex->mutex, NULL);
+    }
+    return mutex;
+}
+
+// 加锁
+void lockMutex(PlatformMutex* mutex) {
+    pthread_mutex_lock(&mutex->mutex);
+}
+
+// 解锁
+void unlockMutex(PlatformMutex* mutex) {
+    pthread_mutex_unlock(&mutex->mutex);
+}
+
+// 销毁互斥锁
+void destroyMutex(PlatformMutex* mutex) {
+    if (mutex != NULL) {
+        pthread_mutex_destroy(&mutex->mutex);
+        free(mutex);
+    }
+}
+
+// 创建条件变量
+PlatformCondition* createCondition(void) {
+    PlatformCondition* condition = (PlatformCondition*)malloc(sizeof(PlatformCondition));
+    if (condition == NULL) {
+        return NULL;
+    }
+    
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&condition->condition, &attributes);
+    pthread_condattr_destroy(&attributes);
+    return condition;
+}
+
+// 等待条件变量，被唤醒返回 0，超时返回 -1
+int waitCondition(PlatformCondition* condition, PlatformMutex* mutex, int timeoutMs) {
+    if (timeoutMs < 0) {
+        pthread_cond_wait(&condition->condition, &mutex->mutex);
+        return 0;
+    }
+    
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeoutMs / 1000;
+    deadline.tv_nsec += (long)(timeoutMs % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return pthread_cond_timedwait(&condition->condition, &mutex->mutex, &deadline) == 0 ? 0 : -1;
+}
+
+// 唤醒一个等待者
+void signalCondition(PlatformCondition* condition) {
+    pthread_cond_signal(&condition->condition);
+}
+
+// 唤醒所有等待者
+void broadcastCondition(PlatformCondition* condition) {
+    pthread_cond_broadcast(&condition->condition);
+}
+
+// 销毁条件变量
+void destroyCondition(PlatformCondition* condition) {
+    if (condition != NULL) {
+        pthread_cond_destroy(&condition->condition);
+        free(condition);
+    }
+}
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "file_utils.h"
+#include "platform_utils.h"
+#include "log_utils.h"
+#include "progress_utils.h"
+
+// 状态行的状态（由 progressMutex 保护：复制线程等后台线程也会通过 printAboveProgress 输出）
+static PlatformMutex* progressMutex = NULL;
+static int progressActive = 0;      // 正在显示状态行（普通模式且标准输出是终端）
+static int lineShown = 0;           // 终端中当前有一行未换行的状态行
+static int lastLength = 0;          // 上次绘制的状态行长度，用于覆盖较长的旧内容
+static long long startTime = 0;
+static long long lastDraw = 0;
+
+// 辅助函数：把字节速率格式化为易读的形式
+static void formatRate(char* buffer, size_t bufferSize, double bytesPerSecond) {
+    const char* units[] = { "B", "KB", "MB", "GB", "TB" };
+    int unit = 0;
+    while (bytesPerSecond >= 1024 && unit < 4) {
+        bytesPerSecond /= 1024;
+        unit++;
+    }
+    snprintf(buffer, bufferSize, "%.1f %s/s", bytesPerSecond, units[unit]);
+}
+
+// 辅助函数：把秒数格式化为 [h:]mm:ss
+static void formatDuration(char* buffer, size_t bufferSize, long long seconds) {
+    if (seconds >= 3600) {
+        snprintf(buffer, bufferSize, "%lld:%02lld:%02lld", seconds / 3600, seconds / 60 % 60, seconds % 60);
+    } else {
+        snprintf(buffer, bufferSize, "%02lld:%02lld", seconds / 60, seconds % 60);
+    }
+}
+
+// 辅助函数：生成状态行：完成/总数、失败、排除、运行中、文件速率、字节速率、已用时间和预计剩余时间
+static int formatStatus(char* buffer, size_t bufferSize, const ProgressCounts* counts, long long now) {
+    double elapsed = (double)(now - startTime) / 1000.0;
+    double filesPerSecond = elapsed > 0 ? counts->completed / elapsed : 0;
+    char bytesRate[32];
+    formatRate(bytesRate, sizeof(bytesRate), elapsed > 0 ? (double)counts->completedBytes / elapsed : 0);
+    
+    // 排除和未变化的文件不需要执行命令，不计入待处理总数
+    int total = counts->total - counts->excluded - counts->upToDate;
+    char elapsedText[32];
+    char etaText[32];
+    formatDuration(elapsedText, sizeof(elapsedText), (long long)elapsed);
+    if (counts->totalComplete && filesPerSecond > 0 && total >= counts->completed) {
+        formatDuration(etaText, sizeof(etaText), (long long)((total - counts->completed) / filesPerSecond + 0.5));
+    } else {
+        snprintf(etaText, sizeof(etaText), "--:--");
+    }
+    
+    // 为零的排除和未变化计数不显示，尽量让状态行不超过一行终端宽度
+    char skipped[64] = "";
+    if (counts->excluded > 0 && counts->upToDate > 0) {
+        snprintf(skipped, sizeof(skipped), ", %d excluded, %d up to date", counts->excluded, counts->upToDate);
+    } else if (counts->excluded > 0) {
+        snprintf(skipped, sizeof(skipped), ", %d excluded", counts->excluded);
+    } else if (counts->upToDate > 0) {
+        snprintf(skipped, sizeof(skipped), ", %d up to date", counts->upToDate);
+    }
+    return snprintf(buffer, bufferSize, "[%d/%d%s] %d failed%s, %d running | %.1f files/s, %s | %s ETA %s",
+                    counts->completed, total, counts->totalComplete ? "" : "+", counts->failed, skipped,
+                    counts->running, filesPerSecond, bytesRate, elapsedText, etaText);
+}
+
+// 辅助函数：擦除终端中的状态行（调用方持有锁）
+static void clearStatusLine(void) {
+    if (lineShown) {
+        printf("\r%*s\r", lastLength, "");
+        lineShown = 0;
+    }
+}
+
+// 开始显示进度：普通模式在终端中显示状态行；详细和安静模式以及输出被重定向时不显示（详细模式仍逐个打印文件）
+void startProgress(Verbosity verbosity) {
+    if (progressMutex == NULL) {
+        progressMutex = createMutex();
+    }
+    progressActive = (verbosity == VERBOSITY_NORMAL && isTerminal(stdout));
+    lineShown = 0;
+    lastLength = 0;
+    startTime = getMonotonicTime();
+    lastDraw = 0;
+}
+
+// 更新状态行；不足刷新间隔时直接返回，force 为真时立即重绘
+void updateProgress(const ProgressCounts* counts, int force) {
+    if (!progressActive) {
+        return;
+    }
+    long long now = getMonotonicTime();
+    
+    if (progressMutex != NULL) {
+        lockMutex(progressMutex);
+    }
+    if (force || lastDraw == 0 || now - lastDraw >= PROGRESS_INTERVAL_MS) {
+        char line[512];
+        int length = formatStatus(line, sizeof(line), counts, now);
+        if (length >= (int)sizeof(line)) {
+            length = (int)sizeof(line) - 1;
+        }
+        if (length < 0) {
+            length = 0;
+            line[0] = '\0';
+        }
+        
+        // 回到行首重绘，用空格覆盖上次较长的部分
+        printf("\r%s%*s", line, lastLength > length ? lastLength - length : 0, "");
+        lastLength = length;
+        lineShown = 1;
+        fflush(stdout);
+        lastDraw = now;
+    }
+    if (progressMutex != NULL) {
+        unlockMutex(progressMutex);
+    }
+}
+
+// 距下次应重绘状态行的毫秒数，供等待任务事件时作为超时；不显示状态行时返回 -1（只等待事件本身）
+int getProgressTimeout(void) {
+    if (!progressActive) {
+        return -1;
+    }
+    if (progressMutex != NULL) {
+        lockMutex(progressMutex);
+    }
+    long long remaining = (lastDraw == 0) ? 0 : lastDraw + PROGRESS_INTERVAL_MS - getMonotonicTime();
+    if (progressMutex != NULL) {
+        unlockMutex(progressMutex);
+    }
+    return remaining > 0 ? (int)remaining : 0;
+}
+
+// 在状态行之上输出一条消息（先擦除状态行，下次更新时重绘），可在任意线程调用
+void printAboveProgress(const char* format, ...) {
+    if (progressMutex != NULL) {
+        lockMutex(progressMutex);
+    }
+    clearStatusLine();
+    
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    
+    if (progressActive) {
+        // 立即重绘，避免消息之后状态行消失一个刷新间隔
+        lastDraw = 0;
+        fflush(stdout);
+    }
+    if (progressMutex != NULL) {
+        unlockMutex(progressMutex);
+    }
+}
+
+// 结束进度显示：绘制最终状态并换行，然后打印并记录汇总
+void finishProgress(const ProgressCounts* counts) {
+    updateProgress(counts, 1);
+    if (progressMutex != NULL) {
+        lockMutex(progressMutex);
+    }
+    if (lineShown) {
+        printf("\n");
+        lineShown = 0;
+    }
+    progressActive = 0;
+    if (progressMutex != NULL) {
+        unlockMutex(progressMutex);
+    }
+    
+    char elapsedText[32];
+    char bytesRate[32];
+    long long elapsedMs = getMonotonicTime() - startTime;
+    formatDuration(elapsedText, sizeof(elapsedText), elapsedMs / 1000);
+    formatRate(bytesRate, sizeof(bytesRate), elapsedMs > 0 ? (double)counts->completedBytes * 1000.0 / (double)elapsedMs : 0);
+    printf("%d commands run (%d failed) in %s, %s\n", counts->completed, counts->failed, elapsedText, bytesRate);
+    logMessage(LOG_INFO, "%d commands run (%d failed) in %s, %s", counts->completed, counts->failed, elapsedText, bytesRate);
+}
\ No newline at end of file
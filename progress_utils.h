@@ -0,0 +1,26 @@
+#ifndef PROGRESS_UTILS_H
+#define PROGRESS_UTILS_H
+
+// 状态行的刷新间隔（毫秒）：状态行只在终端中原地重绘，输出被重定向时只打印最终汇总
+#define PROGRESS_INTERVAL_MS 100
+
+// 状态行显示的计数
+typedef struct ProgressCounts {
+    int completed;              // 已结束的任务（包括失败的任务）
+    int failed;
+    int excluded;
+    int upToDate;
+    int running;
+    int total;                  // 任务来源目前已知的文件总数
+    int totalComplete;          // 文件总数已经确定（扫描已结束）
+    long long completedBytes;   // 已结束任务的输入字节数
+} ProgressCounts;
+
+// 函数声明
+void startProgress(Verbosity verbosity);
+void updateProgress(const ProgressCounts* counts, int force);
+int getProgressTimeout(void);
+void printAboveProgress(const char* format, ...);
+void finishProgress(const ProgressCounts* counts);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "file_utils.h"
+#include "platform_utils.h"
+#include "queue_utils.h"
+
+struct BoundedQueue {
+    void** items;
+    int capacity;
+    int head;
+    int count;
+    int closed;
+    int consumerWaiting;        // 上次出队超时，之后第一次入队或关闭队列时调用 wakeCommandWait
+    PlatformMutex* mutex;
+    PlatformCondition* notEmpty;
+    PlatformCondition* notFull;
+};
+
+// 创建队列
+BoundedQueue* createQueue(int capacity) {
+    BoundedQueue* queue = (BoundedQueue*)calloc(1, sizeof(BoundedQueue));
+    if (queue == NULL) {
+        return NULL;
+    }
+    
+    queue->items = (void**)malloc(sizeof(void*) * (size_t)capacity);
+    queue->capacity = capacity;
+    queue->mutex = createMutex();
+    queue->notEmpty = createCondition();
+    queue->notFull = createCondition();
+    if (queue->items == NULL || queue->mutex == NULL || queue->notEmpty == NULL || queue->notFull == NULL) {
+        destroyQueue(queue);
+        return NULL;
+    }
+    return queue;
+}
+
+// 入队：队列已满时阻塞等待，队列已关闭时返回 -1
+int queuePush(BoundedQueue* queue, void* item) {
+    lockMutex(queue->mutex);
+    while (queue->count == queue->capacity && !queue->closed) {
+        waitCondition(queue->notFull, queue->mutex, -1);
+    }
+    
+    if (queue->closed) {
+        unlockMutex(queue->mutex);
+        return -1;
+    }
+    
+    queue->items[(queue->head + queue->count) % queue->capacity] = item;
+    queue->count++;
+    int wake = queue->consumerWaiting;
+    queue->consumerWaiting = 0;
+    signalCondition(queue->notEmpty);
+    unlockMutex(queue->mutex);
+    if (wake) {
+        wakeCommandWait();
+    }
+    return 0;
+}
+
+// 出队：取到返回 1；队列已关闭且为空返回 0；超时返回 -1（timeoutMs 小于 0 表示无限等待）
+int queuePop(BoundedQueue* queue, void** item, int timeoutMs) {
+    lockMutex(queue->mutex);
+    
+    long long deadline = getMonotonicTime() + timeoutMs;
+    while (queue->count == 0 && !queue->closed) {
+        int remaining = -1;
+        if (timeoutMs >= 0) {
+            long long left = deadline - getMonotonicTime();
+            if (left <= 0) {
+                queue->consumerWaiting = 1;
+                unlockMutex(queue->mutex);
+                return -1;
+            }
+            remaining = (int)left;
+        }
+        waitCondition(queue->notEmpty, queue->mutex, remaining);
+    }
+    
+    if (queue->count == 0) {
+        unlockMutex(queue->mutex);
+        return 0;
+    }
+    
+    *item = queue->items[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+    signalCondition(queue->notFull);
+    unlockMutex(queue->mutex);
+    return 1;
+}
+
+// 关闭队列：不再接受新任务，已入队的任务仍可取出
+void closeQueue(BoundedQueue* queue) {
+    lockMutex(queue->mutex);
+    queue->closed = 1;
+    int wake = queue->consumerWaiting;
+    queue->consumerWaiting = 0;
+    broadcastCondition(queue->notEmpty);
+    broadcastCondition(queue->notFull);
+    unlockMutex(queue->mutex);
+    if (wake) {
+        wakeCommandWait();
+    }
+}
+
+// 销毁队列（调用方负责释放仍在队列中的元素）
+void destroyQueue(BoundedQueue* queue) {
+    if (queue == NULL) {
+        return;
+    }
+    
+    destroyCondition(queue->notFull);
+    destroyCondition(queue->notEmpty);
+    destroyMutex(queue->mutex);
+    free(queue->items);
+    free(queue);
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#ifndef QUEUE_UTILS_H
+#define QUEUE_UTILS_H
+
+// 有界阻塞队列（多生产者/多消费者），用于在线程之间传递任务
+// 出队超时之后的第一次入队或关闭会调用 wakeCommandWait，让等待子进程的执行循环及时取走新任务
+typedef struct BoundedQueue BoundedQueue;
+
+// 函数声明
+BoundedQueue* createQueue(int capacity);
+int queuePush(BoundedQueue* queue, void* item);
+int queuePop(BoundedQueue* queue, void** item, int timeoutMs);
+void closeQueue(BoundedQueue* queue);
+void destroyQueue(BoundedQueue* queue);
+
+#endif
\ No newline at end of file
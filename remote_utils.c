@@ -0,0 +1,869 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "file_utils.h"
+#include "platform_utils.h"
+#include "log_utils.h"
+#include "manifest_utils.h"
+#include "template_utils.h"
+#include "progress_utils.h"
+#include "path_utils.h"
+#include "queue_utils.h"
+#include "remote_utils.h"
+
+// 协调者没有需要立即处理的事件时检查中断和刷新状态行的间隔（毫秒）
+#define COORDINATOR_POLL_MS 100
+// 有工作者在等待任务而任务来源暂时没有文件（流式扫描、监视模式）时再次查看的间隔
+#define COORDINATOR_RETRY_MS 10
+// 工作者连接后等待协调者回应握手的时间
+#define HANDSHAKE_TIMEOUT_MS 30000
+// 发出 END 后等待工作者关闭连接的最长时间
+#define END_LINGER_MS 5000
+// 工作者的接收线程没有消息时检查停止请求的间隔（毫秒）
+#define RECEIVE_POLL_INTERVAL_MS 200
+// 工作者收到、尚未取走的消息数上限（协调者每次只回应一个请求，实际很少超过一条）
+#define RECEIVE_QUEUE_CAPACITY 16
+
+// 连接上的接收缓冲区，按行取出消息
+typedef struct LineBuffer {
+    char data[MAX_MESSAGE_LENGTH];
+    size_t length;
+    size_t consumed;            // 已经取出的字节数
+} LineBuffer;
+
+// 分给工作者、尚未汇报结果的任务
+typedef struct LeasedJob {
+    FileJob file;
+    unsigned long long commandHash;     // 单独处理该文件时的命令哈希值，成功后记录到清单
+} LeasedJob;
+
+// 协调者一侧的工作者连接
+typedef struct Worker {
+    int id;                     // 连接顺序编号，用于日志
+    NetSocket* connection;
+    LineBuffer buffer;
+    int greeted;                // 已完成握手
+    int waiting;                // 已请求任务，尚未分到
+    LeasedJob* leases;
+    int leaseCount;
+    int leaseCapacity;
+} Worker;
+
+// 协调者状态
+typedef struct Coordinator {
+    JobSource* source;
+    const ProcessOptions* options;
+    CommandTemplate commandTemplate;
+    Manifest* manifest;
+    Worker** workers;
+    int workerCount;
+    int workerCapacity;
+    int nextWorkerId;
+    FileJob* requeued;          // 断开的工作者未完成的任务，优先于新文件分发
+    int requeuedCount;
+    int requeuedCapacity;
+    int exhausted;              // 任务来源已没有更多文件
+    int stopping;               // 收到中断请求：不再分发任务，等待已分发的任务结束
+    int leased;                 // 所有工作者持有的任务数
+    ProgressCounts progress;
+} Coordinator;
+
+// 工作者一侧的任务来源：每次向协调者请求一个任务，任务结束后汇报结果
+// 握手之后由接收线程读取协调者的消息放入队列，执行循环等待子进程时也能被新任务唤醒
+typedef struct RemoteSource {
+    JobSource base;
+    NetSocket* connection;
+    LineBuffer buffer;          // 握手之后只由接收线程使用
+    BoundedQueue* messages;     // 收到的消息（逐条分配），连接断开或收到 END 后关闭
+    PlatformThread* receiver;
+    PlatformMutex* mutex;       // 保护 stopping
+    int stopping;               // 任务来源正在关闭，接收线程应当退出
+    char inputPath[MAX_PATH_LENGTH];
+    char outputPath[MAX_PATH_LENGTH];
+    char lastDirectory[MAX_PATH_LENGTH];    // 最近创建的输出目录，避免逐个文件重复检查
+    int requested;              // 已发送请求，尚未收到任务
+    int ended;                  // 协调者已没有任务，或连接已断开
+    int lost;                   // 连接已断开，不再汇报结果
+    int received;
+} RemoteSource;
+
+// 辅助函数：转义消息中的一个字段（反斜杠、换行和回车），结果过长返回 -1
+// 路径中的分隔符统一写成 '/'，不同平台上的协调者和工作者可以互通
+static int encodeField(const char* text, int isPath, char* buffer, size_t bufferSize) {
+    size_t length = 0;
+    for (const char* p = text; *p; p++) {
+        char c = (isPath && *p == PATH_SEPARATOR) ? '/' : *p;
+        char escaped = (c == '\\') ? '\\' : (c == '\n') ? 'n' : (c == '\r') ? 'r' : '\0';
+        if (length + (escaped ? 2 : 1) >= bufferSize) {
+            return -1;
+        }
+        if (escaped) {
+            buffer[length++] = '\\';
+            c = escaped;
+        }
+        buffer[length++] = c;
+    }
+    buffer[length] = '\0';
+    return 0;
+}
+
+// 辅助函数：原地还原转义的字段，路径中的 '/' 换成本平台的分隔符
+static void decodeField(char* text, int isPath) {
+    char* out = text;
+    for (const char* p = text; *p; p++) {
+        char c = *p;
+        if (c == '\\' && p[1] != '\0') {
+            p++;
+            c = (*p == 'n') ? '\n' : (*p == 'r') ? '\r' : *p;
+        } else if (isPath && c == '/') {
+            c = PATH_SEPARATOR;
+        }
+        *out++ = c;
+    }
+    *out = '\0';
+}
+
+// 辅助函数：按格式生成一行消息并发送，失败返回 -1
+static int sendLine(NetSocket* connection, const char* format, ...) {
+    char line[MAX_MESSAGE_LENGTH];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length < 0 || length >= (int)sizeof(line)) {
+        return -1;
+    }
+    return sendData(connection, line, (size_t)length);
+}
+
+// 辅助函数：取出缓冲区中的下一整行（去掉换行符），没有完整的行时返回 NULL，并把剩余的部分移到缓冲区开头
+static char* takeLine(LineBuffer* buffer) {
+    char* start = buffer->data + buffer->consumed;
+    char* end = (char*)memchr(start, '\n', buffer->length - buffer->consumed);
+    if (end == NULL) {
+        memmove(buffer->data, start, buffer->length - buffer->consumed);
+        buffer->length -= buffer->consumed;
+        buffer->consumed = 0;
+        return NULL;
+    }
+    *end = '\0';
+    if (end > start && end[-1] == '\r') {
+        end[-1] = '\0';
+    }
+    buffer->consumed = (size_t)(end - buffer->data) + 1;
+    return start;
+}
+
+// 辅助函数：接收数据追加到缓冲区（先用 takeLine 取完已有的行）；连接断开、出错或一行超过最大长度时返回 -1
+static int fillBuffer(NetSocket* connection, LineBuffer* buffer) {
+    if (buffer->length >= sizeof(buffer->data)) {
+        return -1;
+    }
+    int received = receiveData(connection, buffer->data + buffer->length, sizeof(buffer->data) - buffer->length);
+    if (received <= 0) {
+        return -1;
+    }
+    buffer->length += (size_t)received;
+    return 0;
+}
+
+// 辅助函数：文件相对输入目录的路径（不含开头的分隔符），用于协议中的消息
+static const char* relativeToInput(const char* path, const char* inputPath) {
+    const char* relativePath = path + strlen(inputPath);
+    while (*relativePath == '/' || *relativePath == '\\') {
+        relativePath++;
+    }
+    return relativePath;
+}
+
+// 辅助函数：把任务放回待分发列表，内存不足返回 -1
+static int pushRequeued(Coordinator* coordinator, const FileJob* file) {
+    if (coordinator->requeuedCount == coordinator->requeuedCapacity) {
+        int capacity = coordinator->requeuedCapacity > 0 ? coordinator->requeuedCapacity * 2 : 64;
+        FileJob* grown = (FileJob*)realloc(coordinator->requeued, sizeof(FileJob) * (size_t)capacity);
+        if (grown == NULL) {
+            return -1;
+        }
+        coordinator->requeued = grown;
+        coordinator->requeuedCapacity = capacity;
+    }
+    coordinator->requeued[coordinator->requeuedCount++] = *file;
+    return 0;
+}
+
+// 辅助函数：断开工作者，它持有的任务放回待分发列表，稍后分给其他工作者
+static void dropWorker(Coordinator* coordinator, int index) {
+    Worker* worker = coordinator->workers[index];
+    for (int i = 0; i < worker->leaseCount; i++) {
+        if (pushRequeued(coordinator, &worker->leases[i].file) != 0) {
+            logMessage(LOG_ERROR, "Out of memory, file of disconnected worker is not handed out again: %s", worker->leases[i].file.path);
+            coordinator->progress.completed++;
+            coordinator->progress.failed++;
+        }
+    }
+    coordinator->leased -= worker->leaseCount;
+    
+    if (worker->leaseCount > 0) {
+        printAboveProgress("Warning: Worker %d disconnected, %d unfinished files will be handed out again\n", worker->id, worker->leaseCount);
+        logMessage(LOG_WARNING, "Worker %d disconnected, %d unfinished files will be handed out again", worker->id, worker->leaseCount);
+    } else {
+        if (coordinator->options->verbosity != VERBOSITY_QUIET) {
+            printAboveProgress("Worker %d disconnected\n", worker->id);
+        }
+        logMessage(LOG_INFO, "Worker %d disconnected", worker->id);
+    }
+    
+    closeSocket(worker->connection);
+    free(worker->leases);
+    free(worker);
+    coordinator->workers[index] = coordinator->workers[--coordinator->workerCount];
+}
+
+// 辅助函数：取出下一个要分发的任务，暂时没有时返回 0
+// 增量模式下跳过清单中记录为最新且输出已存在的文件（与 processFiles 中的判断相同）
+static int takeJob(Coordinator* coordinator, FileJob* file, unsigned long long* commandHash) {
+    const ProcessOptions* options = coordinator->options;
+    while (1) {
+        if (coordinator->stopping) {
+            return 0;
+        }
+        if (coordinator->requeuedCount > 0) {
+            *file = coordinator->requeued[--coordinator->requeuedCount];
+        } else if (!coordinator->exhausted) {
+            int result = coordinator->source->next(coordinator->source, file, 0);
+            if (result == 0) {
+                coordinator->exhausted = 1;
+                logMessage(LOG_INFO, "All files handed out, waiting for the remaining results");
+            }
+            if (result <= 0) {
+                return 0;
+            }
+        } else {
+            return 0;
+        }
+        
+        *commandHash = 0;
+        if (file->excluded) {
+            return 1;
+        }
+        char outputFile[MAX_PATH_LENGTH];
+        if (describeJob(&coordinator->commandTemplate, options, file, commandHash, outputFile, sizeof(outputFile)) == 0 &&
+            options->incremental && coordinator->manifest != NULL &&
+            isManifestUpToDate(coordinator->manifest, file->path + strlen(options->inputPath), file->size, file->mtime, *commandHash) &&
+            (outputFile[0] == '\0' || getFileInfo(outputFile, NULL, NULL) == 0)) {
+            coordinator->progress.upToDate++;
+            if (options->verbosity == VERBOSITY_VERBOSE) {
+                printf("Skipping up-to-date file: %s\n", file->path);
+            }
+            logMessage(LOG_INFO, "Skipping up-to-date file: %s", file->path);
+            continue;
+        }
+        return 1;
+    }
+}
+
+// 辅助函数：把任务发给工作者；被排除的文件由工作者原样复制，不等待结果。发送失败返回 -1（任务已放回待分发列表）
+static int sendJob(Coordinator* coordinator, Worker* worker, const FileJob* file, unsigned long long commandHash) {
+    const char* relativePath = relativeToInput(file->path, coordinator->options->inputPath);
+    char encoded[MAX_PATH_LENGTH * 2];
+    if (encodeField(relativePath, 1, encoded, sizeof(encoded)) != 0) {
+        logMessage(LOG_ERROR, "Path too long to send, skipping: %s", file->path);
+        coordinator->progress.completed++;
+        coordinator->progress.failed++;
+        return 0;
+    }
+    
+    if (!file->excluded) {
+        if (worker->leaseCount == worker->leaseCapacity) {
+            int capacity = worker->leaseCapacity > 0 ? worker->leaseCapacity * 2 : 8;
+            LeasedJob* grown = (LeasedJob*)realloc(worker->leases, sizeof(LeasedJob) * (size_t)capacity);
+            if (grown == NULL) {
+                logMessage(LOG_ERROR, "Out of memory while handing out file: %s", file->path);
+                pushRequeued(coordinator, file);
+                return -1;
+            }
+            worker->leases = grown;
+            worker->leaseCapacity = capacity;
+        }
+        worker->leases[worker->leaseCount].file = *file;
+        worker->leases[worker->leaseCount].commandHash = commandHash;
+        worker->leaseCount++;
+        coordinator->leased++;
+    }
+    
+    worker->waiting = 0;
+    if (sendLine(worker->connection, "JOB %d %lld %lld %s\n", file->excluded, file->size, file->mtime, encoded) != 0) {
+        if (file->excluded) {
+            pushRequeued(coordinator, file);
+        }
+        return -1;
+    }
+    
+    if (file->excluded) {
+        coordinator->progress.excluded++;
+    }
+    if (coordinator->options->verbosity == VERBOSITY_VERBOSE) {
+        printf("Sending file to worker %d: %s\n", worker->id, file->path);
+    }
+    logMessage(LOG_INFO, "Sending file to worker %d: %s", worker->id, file->path);
+    return 0;
+}
+
+// 辅助函数：给所有正在等待的工作者分发任务
+static void assignJobs(Coordinator* coordinator) {
+    for (int i = 0; i < coordinator->workerCount; i++) {
+        Worker* worker = coordinator->workers[i];
+        if (!worker->waiting) {
+            continue;
+        }
+        
+        FileJob file;
+        unsigned long long commandHash = 0;
+        if (!takeJob(coordinator, &file, &commandHash)) {
+            return;
+        }
+        if (sendJob(coordinator, worker, &file, commandHash) != 0) {
+            dropWorker(coordinator, i);
+            i--;
+        }
+    }
+}
+
+// 辅助函数：记录工作者汇报的结果，成功的文件写入清单
+static void finishLease(Coordinator* coordinator, Worker* worker, const char* relativePath, int result) {
+    const ProcessOptions* options = coordinator->options;
+    int index = -1;
+    for (int i = 0; i < worker->leaseCount; i++) {
+        if (strcmp(relativeToInput(worker->leases[i].file.path, options->inputPath), relativePath) == 0) {
+            index = i;
+            break;
+        }
+    }
+    if (index < 0) {
+        logMessage(LOG_WARNING, "Worker %d reported a file it was not given: %s", worker->id, relativePath);
+        return;
+    }
+    
+    const LeasedJob* lease = &worker->leases[index];
+    coordinator->progress.completed++;
+    coordinator->progress.completedBytes += lease->file.size;
+    if (result != 0) {
+        coordinator->progress.failed++;
+        printAboveProgress("Error: Command failed on worker %d (code: %d): %s\n", worker->id, result, lease->file.path);
+        logMessage(LOG_ERROR, "Command failed on worker %d (code: %d): %s", worker->id, result, lease->file.path);
+    } else {
+        if (options->verbosity == VERBOSITY_VERBOSE) {
+            printf("Worker %d finished file: %s\n", worker->id, lease->file.path);
+        }
+        logMessage(LOG_INFO, "Worker %d finished file: %s", worker->id, lease->file.path);
+        if (coordinator->manifest != NULL) {
+            recordManifestEntry(coordinator->manifest, lease->file.path + strlen(options->inputPath), lease->file.size, lease->file.mtime, lease->commandHash);
+        }
+    }
+    
+    worker->leases[index] = worker->leases[--worker->leaseCount];
+    coordinator->leased--;
+}
+
+// 辅助函数：处理工作者发来的一行消息，返回 -1 时断开该工作者
+static int handleMessage(Coordinator* coordinator, Worker* worker, char* line) {
+    if (!worker->greeted) {
+        int version = 0;
+        if (sscanf(line, "HELLO %d", &version) != 1 || version != REMOTE_PROTOCOL_VERSION) {
+            sendLine(worker->connection, "ERROR protocol version %d expected\n", REMOTE_PROTOCOL_VERSION);
+            logMessage(LOG_WARNING, "Worker %d rejected, unexpected greeting: %s", worker->id, line);
+            return -1;
+        }
+        
+        // 命令和执行方式由协调者统一下发，保证清单中的命令哈希值与工作者实际执行的命令一致
+        char encoded[MAX_COMMAND_LENGTH * 2];
+        if (encodeField(coordinator->options->command, 0, encoded, sizeof(encoded)) != 0 ||
+            sendLine(worker->connection, "WELCOME %d %s\n", coordinator->options->useShell, encoded) != 0) {
+            return -1;
+        }
+        worker->greeted = 1;
+        if (coordinator->options->verbosity != VERBOSITY_QUIET) {
+            printAboveProgress("Worker %d connected\n", worker->id);
+        }
+        logMessage(LOG_INFO, "Worker %d connected", worker->id);
+        return 0;
+    }
+    
+    if (strcmp(line, "NEXT") == 0) {
+        worker->waiting = 1;
+        return 0;
+    }
+    
+    int result = 0;
+    int pathStart = 0;
+    if (sscanf(line, "DONE %d %n", &result, &pathStart) == 1 && pathStart > 0) {
+        decodeField(line + pathStart, 1);
+        finishLease(coordinator, worker, line + pathStart, result);
+        return 0;
+    }
+    logMessage(LOG_WARNING, "Unknown message from worker %d: %s", worker->id, line);
+    return 0;
+}
+
+// 辅助函数：接受一个新的工作者连接
+static void acceptWorker(Coordinator* coordinator, NetSocket* listener) {
+    NetSocket* connection = acceptConnection(listener);
+    if (connection == NULL) {
+        return;
+    }
+    if (coordinator->workerCount == coordinator->workerCapacity) {
+        int capacity = coordinator->workerCapacity > 0 ? coordinator->workerCapacity * 2 : 16;
+        Worker** grown = (Worker**)realloc(coordinator->workers, sizeof(Worker*) * (size_t)capacity);
+        if (grown == NULL) {
+            closeSocket(connection);
+            return;
+        }
+        coordinator->workers = grown;
+        coordinator->workerCapacity = capacity;
+    }
+    Worker* worker = (Worker*)calloc(1, sizeof(Worker));
+    if (worker == NULL) {
+        logMessage(LOG_ERROR, "Out of memory while accepting worker");
+        closeSocket(connection);
+        return;
+    }
+    worker->id = ++coordinator->nextWorkerId;
+    worker->connection = connection;
+    coordinator->workers[coordinator->workerCount++] = worker;
+}
+
+// 辅助函数：通知所有工作者没有更多任务，等它们关闭连接后再关闭（最多 END_LINGER_MS）
+// 工作者可能在收到 END 之前已经发出了下一个请求，连接中还有未读的数据时关闭会重置连接，工作者就读不到 END
+static void endWorkers(Coordinator* coordinator) {
+    for (int i = 0; i < coordinator->workerCount; i++) {
+        sendLine(coordinator->workers[i]->connection, "END\n");
+    }
+    
+    NetSocket** sockets = (NetSocket**)malloc(sizeof(NetSocket*) * (size_t)(coordinator->workerCount + 1));
+    int* ready = (int*)malloc(sizeof(int) * (size_t)(coordinator->workerCount + 1));
+    long long deadline = getMonotonicTime() + END_LINGER_MS;
+    while (sockets != NULL && ready != NULL && coordinator->workerCount > 0) {
+        long long left = deadline - getMonotonicTime();
+        if (left <= 0) {
+            break;
+        }
+        for (int i = 0; i < coordinator->workerCount; i++) {
+            sockets[i] = coordinator->workers[i]->connection;
+        }
+        if (waitForSockets(sockets, coordinator->workerCount, ready, (int)left) <= 0) {
+            break;
+        }
+        
+        // 之后收到的消息都不再处理；连接关闭的工作者从后往前移除
+        for (int i = coordinator->workerCount - 1; i >= 0; i--) {
+            Worker* worker = coordinator->workers[i];
+            worker->buffer.length = 0;
+            worker->buffer.consumed = 0;
+            if (ready[i] && fillBuffer(worker->connection, &worker->buffer) != 0) {
+                closeSocket(worker->connection);
+                free(worker->leases);
+                free(worker);
+                coordinator->workers[i] = coordinator->workers[--coordinator->workerCount];
+            }
+        }
+    }
+    
+    for (int i = 0; i < coordinator->workerCount; i++) {
+        closeSocket(coordinator->workers[i]->connection);
+        free(coordinator->workers[i]->leases);
+        free(coordinator->workers[i]);
+    }
+    coordinator->workerCount = 0;
+    free(sockets);
+    free(ready);
+}
+
+// 协调者模式：从任务来源取出文件，分发给连接到 address 的工作者，直到所有文件都有了结果
+// 协调者自己不执行命令；成功的文件立即追加到输出目录的清单中，配合 --incremental 重启后从断点继续
+// 返回最终失败的文件数，无法监听或命令模板无效时返回 -1
+int serveJobs(JobSource* source, const ProcessOptions* options, const char* address) {
+    Coordinator coordinator;
+    memset(&coordinator, 0, sizeof(coordinator));
+    coordinator.source = source;
+    coordinator.options = options;
+    
+    if (compileTemplate(options->command, options->useShell, &coordinator.commandTemplate) < 0) {
+        printf("Error: Command template has too many arguments or is too long\n");
+        logMessage(LOG_ERROR, "Cannot compile command template: %s", options->command);
+        freeTemplate(&coordinator.commandTemplate);
+        return -1;
+    }
+    NetSocket* listener = listenOnAddress(address);
+    if (listener == NULL) {
+        printf("Error: Cannot listen on %s\n", address);
+        freeTemplate(&coordinator.commandTemplate);
+        return -1;
+    }
+    
+    // 清单总是打开：即使这次没有启用增量模式，已完成的文件也会被记录，重启时加上 --incremental 即可跳过
+    coordinator.manifest = openManifest(options->outputPath);
+    if (coordinator.manifest == NULL) {
+        logMessage(LOG_ERROR, "Cannot open manifest, finished files are not recorded");
+    }
+    
+    NetSocket** sockets = NULL;
+    int* ready = NULL;
+    int socketCapacity = 0;
+    startProgress(options->verbosity);
+    
+    while (1) {
+        if (!coordinator.stopping && interruptRequested()) {
+            coordinator.stopping = 1;
+            printAboveProgress("Interrupted: no further files are handed out, waiting for %d running files\n", coordinator.leased);
+            logMessage(LOG_WARNING, "Interrupted, waiting for %d files already handed out", coordinator.leased);
+        }
+        assignJobs(&coordinator);
+        if ((coordinator.stopping || (coordinator.exhausted && coordinator.requeuedCount == 0)) && coordinator.leased == 0) {
+            break;
+        }
+        
+        coordinator.progress.running = coordinator.leased;
+        coordinator.progress.total = source->total(source, &coordinator.progress.totalComplete);
+        updateProgress(&coordinator.progress, 0);
+        
+        // 监听套接字放在第 0 项，之后依次是各工作者的连接
+        int count = coordinator.workerCount + 1;
+        if (count > socketCapacity) {
+            int capacity = count * 2;
+            NetSocket** grownSockets = (NetSocket**)realloc(sockets, sizeof(NetSocket*) * (size_t)capacity);
+            if (grownSockets != NULL) {
+                sockets = grownSockets;
+            }
+            int* grownReady = (int*)realloc(ready, sizeof(int) * (size_t)capacity);
+            if (grownReady != NULL) {
+                ready = grownReady;
+            }
+            if (grownSockets == NULL || grownReady == NULL) {
+                logMessage(LOG_ERROR, "Out of memory while waiting for workers");
+                break;
+            }
+            socketCapacity = capacity;
+        }
+        sockets[0] = listener;
+        int anyWaiting = 0;
+        for (int i = 0; i < coordinator.workerCount; i++) {
+            sockets[i + 1] = coordinator.workers[i]->connection;
+            anyWaiting |= coordinator.workers[i]->waiting;
+        }
+        
+        // 有工作者在等待而任务来源暂时没有文件时，稍后再从来源中取
+        int timeout = (anyWaiting && !coordinator.exhausted && !coordinator.stopping) ? COORDINATOR_RETRY_MS : COORDINATOR_POLL_MS;
+        int result = waitForSockets(sockets, count, ready, timeout);
+        if (result < 0) {
+            logMessage(LOG_ERROR, "Waiting for workers failed");
+            break;
+        }
+        if (result == 0) {
+            continue;
+        }
+        
+        // 从后往前处理：断开的工作者由最后一项填补，已处理过的项不会被跳过
+        for (int i = count - 2; i >= 0; i--) {
+            if (!ready[i + 1]) {
+                continue;
+            }
+            Worker* worker = coordinator.workers[i];
+            if (fillBuffer(worker->connection, &worker->buffer) != 0) {
+                dropWorker(&coordinator, i);
+                continue;
+            }
+            char* line;
+            while ((line = takeLine(&worker->buffer)) != NULL) {
+                if (handleMessage(&coordinator, worker, line) != 0) {
+                    dropWorker(&coordinator, i);
+                    break;
+                }
+            }
+        }
+        if (ready[0]) {
+            acceptWorker(&coordinator, listener);
+        }
+    }
+    
+    endWorkers(&coordinator);
+    closeSocket(listener);
+    
+    coordinator.progress.running = 0;
+    coordinator.progress.total = source->total(source, &coordinator.progress.totalComplete);
+    finishProgress(&coordinator.progress);
+    if (coordinator.progress.upToDate > 0) {
+        printf("%d up-to-date files skipped\n", coordinator.progress.upToDate);
+        logMessage(LOG_INFO, "%d up-to-date files skipped", coordinator.progress.upToDate);
+    }
+    
+    closeManifest(coordinator.manifest);
+    freeTemplate(&coordinator.commandTemplate);
+    free(coordinator.workers);
+    free(coordinator.requeued);
+    free(sockets);
+    free(ready);
+    return coordinator.progress.failed;
+}
+
+// 辅助函数：连接断开后不再请求任务，也不再汇报结果（未汇报的任务由协调者重新分发）
+static void markConnectionLost(RemoteSource* source) {
+    if (!source->lost) {
+        source->lost = 1;
+        source->ended = 1;
+        printAboveProgress("Error: Lost connection to the coordinator, no further files are taken\n");
+        logMessage(LOG_ERROR, "Lost connection to the coordinator");
+    }
+}
+
+// 辅助函数：读取协调者的下一行消息；timeoutMs 内没有完整的消息时返回 NULL 并置 *timedOut，连接断开时返回 NULL
+static char* readMessage(RemoteSource* source, int timeoutMs, int* timedOut) {
+    long long deadline = getMonotonicTime() + timeoutMs;
+    *timedOut = 0;
+    while (1) {
+        char* line = takeLine(&source->buffer);
+        if (line != NULL) {
+            return line;
+        }
+        
+        int remaining = -1;
+        if (timeoutMs >= 0) {
+            long long left = deadline - getMonotonicTime();
+            remaining = left > 0 ? (int)left : 0;
+        }
+        int ready = 0;
+        int result = waitForSockets(&source->connection, 1, &ready, remaining);
+        if (result == 0) {
+            *timedOut = 1;
+            return NULL;
+        }
+        if (result < 0 || fillBuffer(source->connection, &source->buffer) != 0) {
+            return NULL;
+        }
+    }
+}
+
+// 辅助函数：向协调者汇报一个文件的结果
+static void sendResult(RemoteSource* source, const char* relativePath, int result) {
+    char encoded[MAX_PATH_LENGTH * 2];
+    if (source->lost || encodeField(relativePath, 1, encoded, sizeof(encoded)) != 0) {
+        return;
+    }
+    if (sendLine(source->connection, "DONE %d %s\n", result, encoded) != 0) {
+        markConnectionLost(source);
+    }
+}
+
+// 辅助函数：接收线程入口，把协调者的每条消息放入队列，直到收到 END、连接断开或任务来源关闭
+static void remoteSourceReceive(void* argument) {
+    RemoteSource* source = (RemoteSource*)argument;
+    
+    while (1) {
+        lockMutex(source->mutex);
+        int stopping = source->stopping;
+        unlockMutex(source->mutex);
+        if (stopping) {
+            break;
+        }
+        
+        int timedOut = 0;
+        char* line = readMessage(source, RECEIVE_POLL_INTERVAL_MS, &timedOut);
+        if (line == NULL) {
+            if (timedOut) {
+                continue;
+            }
+            break;
+        }
+        size_t length = strlen(line);
+        char* message = (char*)malloc(length + 1);
+        if (message == NULL) {
+            logMessage(LOG_ERROR, "Out of memory while receiving from coordinator");
+            break;
+        }
+        memcpy(message, line, length + 1);
+        if (queuePush(source->messages, message) != 0) {
+            free(message);
+            break;
+        }
+        if (strcmp(message, "END") == 0) {
+            break;
+        }
+    }
+    closeQueue(source->messages);
+}
+
+// 辅助函数：处理协调者的一条消息：分到任务返回 1，没有更多任务返回 0，消息无效或文件被拒绝时返回 -1
+static int takeRemoteJob(RemoteSource* source, char* line, FileJob* job) {
+    if (strcmp(line, "END") == 0) {
+        source->ended = 1;
+        logMessage(LOG_INFO, "Coordinator has no more files");
+        return 0;
+    }
+    
+    int excluded = 0;
+    int pathStart = 0;
+    if (sscanf(line, "JOB %d %lld %lld %n", &excluded, &job->size, &job->mtime, &pathStart) != 3 || pathStart == 0) {
+        logMessage(LOG_WARNING, "Unknown message from coordinator: %s", line);
+        return -1;
+    }
+    source->requested = 0;
+    char* relativePath = line + pathStart;
+    decodeField(relativePath, 1);
+    // 路径会拼接到本机的输入和输出目录之后，绝对路径和含 ".." 的路径可能指向这两个目录之外，一律拒绝
+    if (isAbsolutePath(relativePath) || hasParentComponent(relativePath)) {
+        logMessage(LOG_ERROR, "Coordinator sent a path outside the input folder, skipping: %s", relativePath);
+        if (!excluded) {
+            sendResult(source, relativePath, -1);
+        }
+        return -1;
+    }
+    // 协调者的输出目录可能在另一台机器上，按需创建文件所在的输出目录
+    char outputDir[MAX_PATH_LENGTH];
+    int written = snprintf(job->path, MAX_PATH_LENGTH, "%s%s%s", source->inputPath, PATH_SEPARATOR_STRING, relativePath);
+    int outputWritten = snprintf(outputDir, MAX_PATH_LENGTH, "%s%s%s", source->outputPath, PATH_SEPARATOR_STRING, relativePath);
+    if (written < 0 || written >= MAX_PATH_LENGTH || outputWritten < 0 || outputWritten >= MAX_PATH_LENGTH) {
+        logMessage(LOG_ERROR, "Path too long, skipping: %s", relativePath);
+        if (!excluded) {
+            sendResult(source, relativePath, -1);
+        }
+        return -1;
+    }
+    job->excluded = excluded;
+    source->received++;
+    
+    char* lastSeparator = strrchr(outputDir, PATH_SEPARATOR);
+    if (lastSeparator != NULL) {
+        *lastSeparator = '\0';
+    }
+    if (strcmp(outputDir, source->lastDirectory) != 0) {
+        if (createDirectoryPath(outputDir) != 0) {
+            logMessage(LOG_WARNING, "Cannot create directory %s", outputDir);
+        }
+        snprintf(source->lastDirectory, MAX_PATH_LENGTH, "%s", outputDir);
+    }
+    return 1;
+}
+
+// 辅助函数：向协调者请求下一个任务
+static int remoteSourceNext(JobSource* base, FileJob* job, int timeoutMs) {
+    RemoteSource* source = (RemoteSource*)base;
+    while (!source->ended) {
+        // 发送失败时先取完已收到的消息：协调者可能已发出 END 并关闭了连接，这不算连接意外断开
+        int sendFailed = 0;
+        if (!source->requested) {
+            sendFailed = (sendData(source->connection, "NEXT\n", 5) != 0);
+            source->requested = 1;
+        }
+        
+        // 接收线程读到连接断开后关闭队列
+        void* item = NULL;
+        int result = queuePop(source->messages, &item, sendFailed ? -1 : timeoutMs);
+        if (result < 0) {
+            return -1;
+        }
+        if (result == 0) {
+            markConnectionLost(source);
+            return 0;
+        }
+        int taken = takeRemoteJob(source, (char*)item, job);
+        free(item);
+        if (taken >= 0) {
+            return taken;
+        }
+    }
+    return 0;
+}
+
+// 辅助函数：目前收到的任务数；协调者通知没有更多任务后总数才确定
+static int remoteSourceTotal(JobSource* base, int* complete) {
+    RemoteSource* source = (RemoteSource*)base;
+    *complete = source->ended;
+    return source->received;
+}
+
+// 辅助函数：任务最终结束后向协调者汇报
+static void remoteSourceFinish(JobSource* base, const char* path, int result) {
+    RemoteSource* source = (RemoteSource*)base;
+    sendResult(source, relativeToInput(path, source->inputPath), result);
+}
+
+// 辅助函数：停止接收线程并断开与协调者的连接
+static void remoteSourceClose(JobSource* base) {
+    RemoteSource* source = (RemoteSource*)base;
+    
+    // 接收线程在下一次检查时退出（收到 END 或连接断开后已经退出），再丢弃尚未取走的消息
+    lockMutex(source->mutex);
+    source->stopping = 1;
+    unlockMutex(source->mutex);
+    closeQueue(source->messages);
+    joinThread(source->receiver);
+    
+    void* item = NULL;
+    while (queuePop(source->messages, &item, 0) > 0) {
+        free(item);
+    }
+    
+    destroyQueue(source->messages);
+    destroyMutex(source->mutex);
+    closeSocket(source->connection);
+    free(source);
+}
+
+// 工作者模式：连接到协调者，从协调者领取任务并汇报结果，不扫描输入目录
+// 命令和执行方式由协调者下发，写入 command 和 *useShell；连接或握手失败返回 NULL
+JobSource* createRemoteSource(const char* address, const char* inputPath, const char* outputPath, char* command, size_t commandSize, int* useShell) {
+    RemoteSource* source = (RemoteSource*)calloc(1, sizeof(RemoteSource));
+    if (source == NULL) {
+        return NULL;
+    }
+    snprintf(source->inputPath, MAX_PATH_LENGTH, "%s", inputPath);
+    snprintf(source->outputPath, MAX_PATH_LENGTH, "%s", outputPath);
+    source->connection = connectToAddress(address);
+    if (source->connection == NULL) {
+        free(source);
+        return NULL;
+    }
+    
+    int timedOut = 0;
+    char* line = NULL;
+    if (sendLine(source->connection, "HELLO %d\n", REMOTE_PROTOCOL_VERSION) == 0) {
+        line = readMessage(source, HANDSHAKE_TIMEOUT_MS, &timedOut);
+    }
+    int shell = 0;
+    int commandStart = 0;
+    if (line == NULL || sscanf(line, "WELCOME %d %n", &shell, &commandStart) != 1 || commandStart == 0) {
+        logMessage(LOG_ERROR, "Coordinator at %s did not accept this worker: %s", address, line != NULL ? line : (timedOut ? "no answer" : "connection closed"));
+        closeSocket(source->connection);
+        free(source);
+        return NULL;
+    }
+    decodeField(line + commandStart, 0);
+    if (strlen(line + commandStart) >= commandSize) {
+        logMessage(LOG_ERROR, "Command from coordinator is too long");
+        closeSocket(source->connection);
+        free(source);
+        return NULL;
+    }
+    strcpy(command, line + commandStart);
+    *useShell = shell;
+    logMessage(LOG_INFO, "Connected to coordinator %s, command: %s", address, command);
+    
+    source->messages = createQueue(RECEIVE_QUEUE_CAPACITY);
+    source->mutex = createMutex();
+    source->receiver = (source->messages != NULL && source->mutex != NULL) ? startThread(remoteSourceReceive, source) : NULL;
+    if (source->receiver == NULL) {
+        logMessage(LOG_ERROR, "Cannot start receiving from coordinator");
+        destroyQueue(source->messages);
+        destroyMutex(source->mutex);
+        closeSocket(source->connection);
+        free(source);
+        return NULL;
+    }
+    
+    source->base.next = remoteSourceNext;
+    source->base.total = remoteSourceTotal;
+    source->base.close = remoteSourceClose;
+    source->base.finish = remoteSourceFinish;
+    source->base.rejected = 0;
+    return &source->base;
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#ifndef REMOTE_UTILS_H
+#define REMOTE_UTILS_H
+
+// 协调者模式：一个实例扫描输入目录，通过套接字把任务逐个分发给任意数量的工作者实例，工作者执行命令后汇报结果
+// 协调者把成功的文件记录在输出目录的清单中（逐行追加），因此工作者或协调者崩溃都不会丢失已完成的结果；
+// 工作者断开时，分给它但尚未汇报结果的任务重新分发给其他工作者
+
+// 协议版本：协调者拒绝版本不同的工作者
+#define REMOTE_PROTOCOL_VERSION 1
+
+// 协议中单行消息的最大长度（路径和命令在转义后可能变为两倍长）
+#define MAX_MESSAGE_LENGTH (MAX_COMMAND_LENGTH * 2 + 128)
+
+// 函数声明
+int serveJobs(JobSource* source, const ProcessOptions* options, const char* address);
+JobSource* createRemoteSource(const char* address, const char* inputPath, const char* outputPath, char* command, size_t commandSize, int* useShell);
+
+#endif
\ No newline at end of file
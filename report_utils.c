@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "file_utils.h"
+#include "platform_utils.h"
+#include "log_utils.h"
+#include "report_utils.h"
+
+// 单个任务的记录
+typedef struct JobRecord {
+    size_t pathOffset;          // 相对路径在路径池中的偏移
+    int exitCode;
+    long long inputBytes;
+    long long outputBytes;      // 推断出的输出文件大小（无法推断或不存在时为 0）
+    long long wallTimeMs;
+    long long userTimeMs;
+    long long systemTimeMs;
+    long long peakMemoryKb;
+} JobRecord;
+
+struct RunReport {
+    JobRecord* records;
+    int count;
+    int capacity;
+    char* paths;                // 相对路径池（以 '\0' 分隔）
+    size_t pathsLength;
+    size_t pathsCapacity;
+    long long startTime;        // 单调时钟，毫秒
+    time_t startedAt;
+};
+
+// 创建运行报告并开始计时
+RunReport* createReport(void) {
+    RunReport* report = (RunReport*)calloc(1, sizeof(RunReport));
+    if (report == NULL) {
+        return NULL;
+    }
+    report->startTime = getMonotonicTime();
+    report->startedAt = time(NULL);
+    return report;
+}
+
+// 记录一个已结束的任务，stats 为 NULL 表示未能启动，资源使用记为 0
+int addJobRecord(RunReport* report, const char* relativePath, int exitCode, long long inputBytes, long long outputBytes, long long wallTimeMs, const ProcessStats* stats) {
+    if (report->count == report->capacity) {
+        int capacity = report->capacity > 0 ? report->capacity * 2 : 256;
+        JobRecord* records = (JobRecord*)realloc(report->records, sizeof(JobRecord) * capacity);
+        if (records == NULL) {
+            return -1;
+        }
+        report->records = records;
+        report->capacity = capacity;
+    }
+    
+    size_t pathLength = strlen(relativePath) + 1;
+    if (report->pathsLength + pathLength > report->pathsCapacity) {
+        size_t capacity = report->pathsCapacity > 0 ? report->pathsCapacity * 2 : 16384;
+        while (capacity < report->pathsLength + pathLength) {
+            capacity *= 2;
+        }
+        char* paths = (char*)realloc(report->paths, capacity);
+        if (paths == NULL) {
+            return -1;
+        }
+        report->paths = paths;
+        report->pathsCapacity = capacity;
+    }
+    
+    JobRecord* record = &report->records[report->count++];
+    record->pathOffset = report->pathsLength;
+    memcpy(report->paths + report->pathsLength, relativePath, pathLength);
+    report->pathsLength += pathLength;
+    
+    record->exitCode = exitCode;
+    record->inputBytes = inputBytes;
+    record->outputBytes = outputBytes;
+    record->wallTimeMs = wallTimeMs;
+    record->userTimeMs = stats != NULL ? stats->userTimeMs : 0;
+    record->systemTimeMs = stats != NULL ? stats->systemTimeMs : 0;
+    record->peakMemoryKb = stats != NULL ? stats->peakMemoryKb : 0;
+    return 0;
+}
+
+// 辅助函数：按 JSON 规则转义并输出字符串
+static void writeJsonString(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const unsigned char* p = (const unsigned char*)text; *p != '\0'; p++) {
+        if (*p == '"' || *p == '\\') {
+            fputc('\\', file);
+            fputc(*p, file);
+        } else if (*p < 0x20) {
+            fprintf(file, "\\u%04x", *p);
+        } else {
+            fputc(*p, file);
+        }
+    }
+    fputc('"', file);
+}
+
+// 辅助函数：输出单个任务的记录（一行一个对象）
+static void writeJobRecord(FILE* file, const RunReport* report, const JobRecord* record) {
+    fprintf(file, "{\"path\": ");
+    writeJsonString(file, report->paths + record->pathOffset);
+    fprintf(file, ", \"exitCode\": %d, \"wallMs\": %lld, \"userMs\": %lld, \"systemMs\": %lld, \"peakMemoryKb\": %lld, \"bytesIn\": %lld, \"bytesOut\": %lld}",
+            record->exitCode, record->wallTimeMs, record->userTimeMs, record->systemTimeMs, record->peakMemoryKb, record->inputBytes, record->outputBytes);
+}
+
+// 辅助函数：按耗时降序比较任务记录
+static int compareByWallTimeDesc(const void* a, const void* b) {
+    long long left = (*(const JobRecord* const*)a)->wallTimeMs;
+    long long right = (*(const JobRecord* const*)b)->wallTimeMs;
+    return (left < right) - (left > right);
+}
+
+// 辅助函数：取已降序排列的耗时中的分位数（最近秩法）
+static long long percentile(const JobRecord* const* sorted, int count, int percent) {
+    if (count == 0) {
+        return 0;
+    }
+    int rank = (int)(((long long)percent * count + 99) / 100);
+    if (rank < 1) {
+        rank = 1;
+    }
+    return sorted[count - rank]->wallTimeMs;
+}
+
+// 写出 JSON 格式的运行报告，成功返回 0
+int writeReport(const RunReport* report, const char* path, int slowestCount, int excludedFiles, int upToDateFiles) {
+    // 按耗时降序排列记录指针，分位数和最慢任务都从中取得
+    const JobRecord** sorted = (const JobRecord**)malloc(sizeof(JobRecord*) * (report->count > 0 ? report->count : 1));
+    if (sorted == NULL) {
+        return -1;
+    }
+    
+    int succeeded = 0;
+    long long bytesIn = 0;
+    long long bytesOut = 0;
+    long long userTimeMs = 0;
+    long long systemTimeMs = 0;
+    long long peakMemoryKb = 0;
+    long long totalWallTimeMs = 0;
+    for (int i = 0; i < report->count; i++) {
+        const JobRecord* record = &report->records[i];
+        sorted[i] = record;
+        succeeded += (record->exitCode == 0);
+        bytesIn += record->inputBytes;
+        bytesOut += record->outputBytes;
+        userTimeMs += record->userTimeMs;
+        systemTimeMs += record->systemTimeMs;
+        totalWallTimeMs += record->wallTimeMs;
+        if (record->peakMemoryKb > peakMemoryKb) {
+            peakMemoryKb = record->peakMemoryKb;
+        }
+    }
+    qsort(sorted, report->count, sizeof(JobRecord*), compareByWallTimeDesc);
+    
+    FILE* file = openFile(path, "w");
+    if (file == NULL) {
+        logMessage(LOG_ERROR, "Cannot write report: %s", path);
+        free(sorted);
+        return -1;
+    }
+    
+    long long elapsedMs = getMonotonicTime() - report->startTime;
+    double elapsedSeconds = elapsedMs > 0 ? elapsedMs / 1000.0 : 0.001;
+    char startedAt[32];
+    struct tm local;
+#ifdef _WIN32
+    localtime_s(&local, &report->startedAt);
+#else
+    localtime_r(&report->startedAt, &local);
+#endif
+    strftime(startedAt, sizeof(startedAt), "%Y-%m-%dT%H:%M:%S", &local);
+    
+    fprintf(file, "{\n");
+    fprintf(file, "  \"startedAt\": \"%s\",\n", startedAt);
+    fprintf(file, "  \"wallSeconds\": %.3f,\n", elapsedMs / 1000.0);
+    fprintf(file, "  \"processed\": %d,\n", report->count);
+    fprintf(file, "  \"succeeded\": %d,\n", succeeded);
+    fprintf(file, "  \"failed\": %d,\n", report->count - succeeded);
+    fprintf(file, "  \"excluded\": %d,\n", excludedFiles);
+    fprintf(file, "  \"upToDate\": %d,\n", upToDateFiles);
+    fprintf(file, "  \"filesPerSecond\": %.3f,\n", report->count / elapsedSeconds);
+    fprintf(file, "  \"bytesIn\": %lld,\n", bytesIn);
+    fprintf(file, "  \"bytesOut\": %lld,\n", bytesOut);
+    fprintf(file, "  \"cpu\": {\"userSeconds\": %.3f, \"systemSeconds\": %.3f},\n", userTimeMs / 1000.0, systemTimeMs / 1000.0);
+    fprintf(file, "  \"peakMemoryKb\": %lld,\n", peakMemoryKb);
+    fprintf(file, "  \"latencyMs\": {\"min\": %lld, \"mean\": %.1f, \"p50\": %lld, \"p90\": %lld, \"p95\": %lld, \"p99\": %lld, \"max\": %lld},\n",
+            report->count > 0 ? sorted[report->count - 1]->wallTimeMs : 0,
+            report->count > 0 ? (double)totalWallTimeMs / report->count : 0.0,
+            percentile(sorted, report->count, 50), percentile(sorted, report->count, 90),
+            percentile(sorted, report->count, 95), percentile(sorted, report->count, 99),
+            report->count > 0 ? sorted[0]->wallTimeMs : 0);
+    
+    // 最慢的任务
+    int slowest = slowestCount < report->count ? slowestCount : report->count;
+    fprintf(file, "  \"slowest\": [");
+    for (int i = 0; i < slowest; i++) {
+        fprintf(file, "%s\n    ", i > 0 ? "," : "");
+        writeJobRecord(file, report, sorted[i]);
+    }
+    fprintf(file, "%s],\n", slowest > 0 ? "\n  " : "");
+    
+    // 全部任务，按结束顺序一行一个
+    fprintf(file, "  \"jobs\": [");
+    for (int i = 0; i < report->count; i++) {
+        fprintf(file, "%s\n    ", i > 0 ? "," : "");
+        writeJobRecord(file, report, &report->records[i]);
+    }
+    fprintf(file, "%s]\n", report->count > 0 ? "\n  " : "");
+    fprintf(file, "}\n");
+    
+    int result = (fclose(file) == 0) ? 0 : -1;
+    free(sorted);
+    return result;
+}
+
+// 释放运行报告
+void freeReport(RunReport* report) {
+    if (report == NULL) {
+        return;
+    }
+    free(report->records);
+    free(report->paths);
+    free(report);
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#ifndef REPORT_UTILS_H
+#define REPORT_UTILS_H
+
+// 运行报告：收集每个任务的耗时和资源使用情况，运行结束时写出 JSON 汇总
+// 汇总包括耗时分位数、吞吐量、输入输出字节数和最慢的任务，并逐行列出全部任务
+typedef struct RunReport RunReport;
+
+// 报告中默认列出的最慢任务数
+#define DEFAULT_REPORT_SLOWEST 10
+
+// 函数声明
+RunReport* createReport(void);
+int addJobRecord(RunReport* report, const char* relativePath, int exitCode, long long inputBytes, long long outputBytes, long long wallTimeMs, const ProcessStats* stats);
+int writeReport(const RunReport* report, const char* path, int slowestCount, int excludedFiles, int upToDateFiles);
+void freeReport(RunReport* report);
+
+#endif
\ No newline at end of file
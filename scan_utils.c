@@ -0,0 +1,563 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file_utils.h"
+#include "platform_utils.h"
+#include "log_utils.h"
+#include "filter_utils.h"
+#include "scan_utils.h"
+#include "index_utils.h"
+
+// 目录中的一项（名称存放在所属目录的字符串池中）
+typedef struct ScanEntry {
+    long long size;
+    long long mtime;
+    unsigned int nameOffset;
+    unsigned short nameLength;
+    unsigned int flags;
+} ScanEntry;
+
+// 一个目录的列举结果，同时也是工作线程之间传递的任务
+typedef struct ScanNode {
+    char* path;                     // 完整路径
+    int depth;                      // 目录自身的层级（输入目录为 -1）
+    struct ScanNode* parent;
+    int slot;                       // 在父目录的子目录中的序号
+    ScanEntry* entries;
+    int entryCount;
+    int entryCapacity;
+    char* names;
+    size_t namesLength;
+    size_t namesCapacity;
+    struct ScanNode** children;     // 按出现顺序排列的子目录（路径过长的为 NULL）
+    int* childIndexes;              // 子目录合并后在文件表中的下标（-1 表示未加入）
+    int childCount;
+    int done;                       // 列举已完成
+    struct ScanNode* nextReady;     // 按完成顺序合并时的链表
+} ScanNode;
+
+// 工作线程私有的双端队列：本线程从尾部压入和取出（深度优先，局部性好），
+// 空闲线程从头部窃取（取到的是较浅的目录，通常对应较大的子树）
+typedef struct ScanDeque {
+    PlatformMutex* mutex;
+    ScanNode** items;
+    int head;
+    int count;
+    int capacity;
+} ScanDeque;
+
+// 一次并行扫描的共享状态
+typedef struct ParallelScan {
+    FileList* list;                 // 只由合并线程（调用方）访问
+    const FileFilter* filter;       // 在工作线程中求值
+    unsigned int traversalFlags;
+    unsigned long long fileSystem;
+    size_t rootLength;
+    ScanOrder order;
+    int threadCount;
+    ScanDeque* deques;
+    PlatformMutex* mutex;           // 保护下面的状态
+    PlatformCondition* changed;     // 有新任务、目录列举完成或扫描取消时广播
+    int pending;                    // 已入队但尚未列举完成的目录数
+    unsigned long long generation;  // 每次发布新任务时递增，避免空闲线程错过唤醒
+    int cancelled;
+    ScanNode* readyHead;
+    ScanNode* readyTail;
+} ParallelScan;
+
+// 工作线程参数
+typedef struct ScanWorker {
+    ParallelScan* scan;
+    int id;
+} ScanWorker;
+
+// 列举单个目录时的回调参数
+typedef struct CollectContext {
+    ParallelScan* scan;
+    ScanNode* node;
+} CollectContext;
+
+// 辅助函数：创建目录任务，path 为完整路径
+static ScanNode* createScanNode(const char* path, size_t pathLength, ScanNode* parent, int slot) {
+    ScanNode* node = (ScanNode*)calloc(1, sizeof(ScanNode));
+    if (node == NULL) {
+        return NULL;
+    }
+    node->path = (char*)malloc(pathLength + 1);
+    if (node->path == NULL) {
+        free(node);
+        return NULL;
+    }
+    memcpy(node->path, path, pathLength);
+    node->path[pathLength] = '\0';
+    node->parent = parent;
+    node->slot = slot;
+    node->depth = (parent != NULL) ? parent->depth + 1 : -1;
+    return node;
+}
+
+// 辅助函数：释放目录的列举结果（合并之后即可释放，子目录信息保留）
+static void freeScanEntries(ScanNode* node) {
+    free(node->entries);
+    free(node->names);
+    node->entries = NULL;
+    node->names = NULL;
+}
+
+// 辅助函数：释放目录任务及其整个子树
+static void freeScanTree(ScanNode* node) {
+    if (node == NULL) {
+        return;
+    }
+    for (int i = 0; i < node->childCount; i++) {
+        freeScanTree(node->children[i]);
+    }
+    freeScanEntries(node);
+    free(node->children);
+    free(node->childIndexes);
+    free(node->path);
+    free(node);
+}
+
+// 辅助函数：压入队列尾部，失败返回 -1
+static int dequePush(ScanDeque* deque, ScanNode* node) {
+    lockMutex(deque->mutex);
+    if (deque->count == deque->capacity) {
+        int capacity = deque->capacity > 0 ? deque->capacity * 2 : 256;
+        ScanNode** items = (ScanNode**)malloc(sizeof(ScanNode*) * (size_t)capacity);
+        if (items == NULL) {
+            unlockMutex(deque->mutex);
+            return -1;
+        }
+        for (int i = 0; i < deque->count; i++) {
+            items[i] = deque->items[(deque->head + i) % deque->capacity];
+        }
+        free(deque->items);
+        deque->items = items;
+        deque->capacity = capacity;
+        deque->head = 0;
+    }
+    deque->items[(deque->head + deque->count) % deque->capacity] = node;
+    deque->count++;
+    unlockMutex(deque->mutex);
+    return 0;
+}
+
+// 辅助函数：本线程从尾部取出
+static ScanNode* dequePop(ScanDeque* deque) {
+    ScanNode* node = NULL;
+    lockMutex(deque->mutex);
+    if (deque->count > 0) {
+        deque->count--;
+        node = deque->items[(deque->head + deque->count) % deque->capacity];
+    }
+    unlockMutex(deque->mutex);
+    return node;
+}
+
+// 辅助函数：其他线程从头部窃取
+static ScanNode* dequeSteal(ScanDeque* deque) {
+    ScanNode* node = NULL;
+    lockMutex(deque->mutex);
+    if (deque->count > 0) {
+        node = deque->items[deque->head];
+        deque->head = (deque->head + 1) % deque->capacity;
+        deque->count--;
+    }
+    unlockMutex(deque->mutex);
+    return node;
+}
+
+// 辅助函数：把目录列举完成的结果加入待合并链表（调用时持有 scan->mutex）
+static void appendReady(ParallelScan* scan, ScanNode* node) {
+    node->done = 1;
+    if (scan->order != SCAN_ORDER_COMPLETION) {
+        return;
+    }
+    node->nextReady = NULL;
+    if (scan->readyTail != NULL) {
+        scan->readyTail->nextReady = node;
+    } else {
+        scan->readyHead = node;
+    }
+    scan->readyTail = node;
+}
+
+// 辅助函数：enumerateDirectory 的回调，在工作线程中求值过滤器并记录一项
+static int collectEntry(void* userData, const char* name, unsigned int flags, long long size, long long mtime) {
+    CollectContext* context = (CollectContext*)userData;
+    ScanNode* node = context->node;
+    const FileFilter* filter = context->scan->filter;
+    size_t nameLength = strlen(name);
+    if (nameLength > 0xFFFF) {
+        logMessage(LOG_ERROR, "File name too long: %s", name);
+        return 0;
+    }
+    
+    // 过滤器在这里求值，合并时不再重复
+    if (filter != NULL) {
+        char pathBuffer[MAX_PATH_LENGTH];
+        const char* relativePath = NULL;
+        if (filterNeedsPath(filter)) {
+            const char* nodePath = node->path + context->scan->rootLength;
+            while (*nodePath == PATH_SEPARATOR) {
+                nodePath++;
+            }
+            int written = (*nodePath != '\0') ? snprintf(pathBuffer, sizeof(pathBuffer), "%s%c%s", nodePath, PATH_SEPARATOR, name) : snprintf(pathBuffer, sizeof(pathBuffer), "%s", name);
+            if (written > 0 && written < (int)sizeof(pathBuffer)) {
+                relativePath = pathBuffer;
+            }
+        }
+        
+        if (flags & FILE_ENTRY_DIRECTORY) {
+            if (evaluateDirectory(filter, name, relativePath, node->depth + 1) == FILTER_SKIP) {
+                return 0;
+            }
+        } else {
+            FilterResult result = evaluateFilter(filter, name, relativePath, size, mtime);
+            if (result == FILTER_SKIP) {
+                return 0;
+            }
+            if (result == FILTER_EXCLUDE) {
+                flags |= FILE_ENTRY_EXCLUDED;
+            }
+        }
+    }
+    
+    if (node->entryCount == node->entryCapacity) {
+        int capacity = node->entryCapacity > 0 ? node->entryCapacity * 2 : 64;
+        ScanEntry* entries = (ScanEntry*)realloc(node->entries, sizeof(ScanEntry) * (size_t)capacity);
+        if (entries == NULL) {
+            logMessage(LOG_ERROR, "Out of memory while scanning: %s", node->path);
+            return -1;
+        }
+        node->entries = entries;
+        node->entryCapacity = capacity;
+    }
+    if (node->namesLength + nameLength + 1 > node->namesCapacity) {
+        size_t capacity = node->namesCapacity > 0 ? node->namesCapacity * 2 : 4096;
+        while (capacity < node->namesLength + nameLength + 1) {
+            capacity *= 2;
+        }
+        char* names = (char*)realloc(node->names, capacity);
+        if (names == NULL) {
+            logMessage(LOG_ERROR, "Out of memory while scanning: %s", node->path);
+            return -1;
+        }
+        node->names = names;
+        node->namesCapacity = capacity;
+    }
+    
+    ScanEntry* entry = &node->entries[node->entryCount++];
+    entry->size = size;
+    entry->mtime = mtime;
+    entry->nameOffset = (unsigned int)node->namesLength;
+    entry->nameLength = (unsigned short)nameLength;
+    entry->flags = flags;
+    memcpy(node->names + node->namesLength, name, nameLength + 1);
+    node->namesLength += nameLength + 1;
+    return 0;
+}
+
+// 辅助函数：列举一个目录，为其中的子目录创建任务并发布结果
+static void scanNode(ParallelScan* scan, int workerId, ScanNode* node) {
+    CollectContext context;
+    context.scan = scan;
+    context.node = node;
+    enumerateDirectory(node->path, scan->traversalFlags, scan->fileSystem, collectEntry, &context);
+    
+    int directories = 0;
+    for (int i = 0; i < node->entryCount; i++) {
+        if (node->entries[i].flags & FILE_ENTRY_DIRECTORY) {
+            directories++;
+        }
+    }
+    if (directories > 0) {
+        node->children = (ScanNode**)calloc((size_t)directories, sizeof(ScanNode*));
+        node->childIndexes = (int*)malloc(sizeof(int) * (size_t)directories);
+        if (node->children == NULL || node->childIndexes == NULL) {
+            logMessage(LOG_ERROR, "Out of memory while scanning: %s", node->path);
+            free(node->children);
+            free(node->childIndexes);
+            node->children = NULL;
+            node->childIndexes = NULL;
+            directories = 0;
+        }
+    }
+    
+    size_t pathLength = strlen(node->path);
+    int slot = 0;
+    for (int i = 0; i < node->entryCount && slot < directories; i++) {
+        const ScanEntry* entry = &node->entries[i];
+        if (!(entry->flags & FILE_ENTRY_DIRECTORY)) {
+            continue;
+        }
+        
+        char childPath[MAX_PATH_LENGTH];
+        if (pathLength + 1 + entry->nameLength >= MAX_PATH_LENGTH) {
+            logMessage(LOG_WARNING, "Path too long for building file list: %s%c%s", node->path, PATH_SEPARATOR, node->names + entry->nameOffset);
+        } else {
+            memcpy(childPath, node->path, pathLength);
+            childPath[pathLength] = PATH_SEPARATOR;
+            memcpy(childPath + pathLength + 1, node->names + entry->nameOffset, entry->nameLength);
+            node->children[slot] = createScanNode(childPath, pathLength + 1 + entry->nameLength, node, slot);
+        }
+        node->childIndexes[slot] = -1;
+        slot++;
+    }
+    node->childCount = directories;
+    
+    // 在同一临界区内发布本目录并压入子目录，保证按完成顺序合并时父目录总在子目录之前
+    lockMutex(scan->mutex);
+    appendReady(scan, node);
+    scan->pending--;
+    for (int i = node->childCount - 1; i >= 0; i--) {
+        ScanNode* child = node->children[i];
+        if (child == NULL) {
+            continue;
+        }
+        if (dequePush(&scan->deques[workerId], child) != 0) {
+            logMessage(LOG_ERROR, "Out of memory while scanning: %s", child->path);
+            appendReady(scan, child);
+            continue;
+        }
+        scan->pending++;
+    }
+    scan->generation++;
+    broadcastCondition(scan->changed);
+    unlockMutex(scan->mutex);
+}
+
+// 辅助函数：工作线程入口，先取自己队列中的目录，空闲时从其他线程窃取
+static void scanWorkerMain(void* argument) {
+    ScanWorker* worker = (ScanWorker*)argument;
+    ParallelScan* scan = worker->scan;
+    
+    for (;;) {
+        lockMutex(scan->mutex);
+        unsigned long long generation = scan->generation;
+        int finished = (scan->pending == 0 || scan->cancelled);
+        unlockMutex(scan->mutex);
+        if (finished) {
+            break;
+        }
+        
+        ScanNode* node = dequePop(&scan->deques[worker->id]);
+        for (int i = 1; node == NULL && i < scan->threadCount; i++) {
+            node = dequeSteal(&scan->deques[(worker->id + i) % scan->threadCount]);
+        }
+        if (node != NULL) {
+            scanNode(scan, worker->id, node);
+            continue;
+        }
+        
+        // 没有可取的目录：等待其他线程发布新任务或扫描结束
+        lockMutex(scan->mutex);
+        while (scan->generation == generation && scan->pending > 0 && !scan->cancelled) {
+            waitCondition(scan->changed, scan->mutex, -1);
+        }
+        unlockMutex(scan->mutex);
+    }
+}
+
+// 辅助函数：把一个目录的列举结果加入文件表，返回 -1 表示停止扫描
+static int mergeScanNode(ParallelScan* scan, ScanNode* node) {
+    int parentIndex = -1;
+    if (node->parent != NULL) {
+        parentIndex = node->parent->childIndexes[node->slot];
+        if (parentIndex < 0) {
+            // 父目录没有加入文件表，整个子树都不合并（其子目录的下标保持为 -1）
+            freeScanEntries(node);
+            return 0;
+        }
+    }
+    
+    int slot = 0;
+    for (int i = 0; i < node->entryCount; i++) {
+        const ScanEntry* entry = &node->entries[i];
+        int index = addFileEntry(scan->list, parentIndex, node->names + entry->nameOffset, entry->nameLength, entry->flags, entry->size, entry->mtime);
+        if (index == -1) {
+            return -1;
+        }
+        if ((entry->flags & FILE_ENTRY_DIRECTORY) && slot < node->childCount) {
+            node->childIndexes[slot++] = index;
+        }
+    }
+    freeScanEntries(node);
+    return 0;
+}
+
+// 辅助函数：按目录先序合并（与单线程扫描相同：每遇到一个子目录就先合并其整个子树），合并完的子树立即释放
+static int mergeInTreeOrder(ParallelScan* scan, ScanNode* node, int parentIndex) {
+    lockMutex(scan->mutex);
+    while (!node->done && !scan->cancelled) {
+        waitCondition(scan->changed, scan->mutex, -1);
+    }
+    unlockMutex(scan->mutex);
+    
+    int slot = 0;
+    for (int i = 0; i < node->entryCount; i++) {
+        const ScanEntry* entry = &node->entries[i];
+        int index = addFileEntry(scan->list, parentIndex, node->names + entry->nameOffset, entry->nameLength, entry->flags, entry->size, entry->mtime);
+        if (index == -1) {
+            return -1;
+        }
+        if (!(entry->flags & FILE_ENTRY_DIRECTORY) || slot >= node->childCount) {
+            continue;
+        }
+        
+        ScanNode* child = node->children[slot++];
+        if (child == NULL) {
+            continue;
+        }
+        int result = mergeInTreeOrder(scan, child, index);
+        freeScanTree(child);
+        node->children[slot - 1] = NULL;
+        if (result != 0) {
+            return -1;
+        }
+    }
+    freeScanEntries(node);
+    return 0;
+}
+
+// 辅助函数：按完成顺序合并，直到所有目录都已列举完成
+static int mergeInCompletionOrder(ParallelScan* scan) {
+    for (;;) {
+        lockMutex(scan->mutex);
+        while (scan->readyHead == NULL && scan->pending > 0 && !scan->cancelled) {
+            waitCondition(scan->changed, scan->mutex, -1);
+        }
+        ScanNode* ready = scan->readyHead;
+        scan->readyHead = NULL;
+        scan->readyTail = NULL;
+        unlockMutex(scan->mutex);
+        
+        if (ready == NULL) {
+            return 0;
+        }
+        for (; ready != NULL; ready = ready->nextReady) {
+            if (mergeScanNode(scan, ready) != 0) {
+                return -1;
+            }
+        }
+    }
+}
+
+// 辅助函数：释放共享状态
+static void destroyParallelScan(ParallelScan* scan) {
+    if (scan->deques != NULL) {
+        for (int i = 0; i < scan->threadCount; i++) {
+            destroyMutex(scan->deques[i].mutex);
+            free(scan->deques[i].items);
+        }
+        free(scan->deques);
+    }
+    destroyCondition(scan->changed);
+    destroyMutex(scan->mutex);
+}
+
+// 辅助函数：并行扫描，失败（无法创建线程等）时返回 -1，调用方退回单线程扫描
+static int scanParallel(const char* path, FileList* list) {
+    ParallelScan scan;
+    memset(&scan, 0, sizeof(scan));
+    scan.list = list;
+    scan.filter = list->filter;
+    scan.traversalFlags = (list->filter != NULL) ? getTraversalFlags(list->filter) : 0;
+    scan.fileSystem = getFileSystemId(path);
+    scan.rootLength = strlen(path);
+    scan.order = list->scanOrder;
+    scan.threadCount = list->scanThreads < MAX_SCAN_THREADS ? list->scanThreads : MAX_SCAN_THREADS;
+    
+    scan.mutex = createMutex();
+    scan.changed = createCondition();
+    scan.deques = (ScanDeque*)calloc((size_t)scan.threadCount, sizeof(ScanDeque));
+    int ready = (scan.mutex != NULL && scan.changed != NULL && scan.deques != NULL);
+    for (int i = 0; ready && i < scan.threadCount; i++) {
+        scan.deques[i].mutex = createMutex();
+        ready = (scan.deques[i].mutex != NULL);
+    }
+    
+    ScanNode* root = ready ? createScanNode(path, strlen(path), NULL, 0) : NULL;
+    if (root == NULL || dequePush(&scan.deques[0], root) != 0) {
+        freeScanTree(root);
+        destroyParallelScan(&scan);
+        return -1;
+    }
+    scan.pending = 1;
+    
+    ScanWorker workers[MAX_SCAN_THREADS];
+    PlatformThread* threads[MAX_SCAN_THREADS];
+    int started = 0;
+    for (int i = 0; i < scan.threadCount; i++) {
+        workers[i].scan = &scan;
+        workers[i].id = i;
+        threads[i] = startThread(scanWorkerMain, &workers[i]);
+        if (threads[i] != NULL) {
+            started++;
+        }
+    }
+    if (started == 0) {
+        freeScanTree(root);
+        destroyParallelScan(&scan);
+        return -1;
+    }
+    if (started < scan.threadCount) {
+        logMessage(LOG_WARNING, "Only %d of %d scan threads could be started", started, scan.threadCount);
+    }
+    
+    // 过滤器已在工作线程中求值，合并期间暂时取下，避免 addFileEntry 重复求值
+    list->filter = NULL;
+    int result = (scan.order == SCAN_ORDER_TREE) ? mergeInTreeOrder(&scan, root, -1) : mergeInCompletionOrder(&scan);
+    list->filter = scan.filter;
+    
+    // 合并提前停止（如流式处理已结束）时通知工作线程退出
+    lockMutex(scan.mutex);
+    if (result != 0) {
+        scan.cancelled = 1;
+    }
+    broadcastCondition(scan.changed);
+    unlockMutex(scan.mutex);
+    
+    for (int i = 0; i < scan.threadCount; i++) {
+        if (threads[i] != NULL) {
+            joinThread(threads[i]);
+        }
+    }
+    
+    freeScanTree(root);
+    destroyParallelScan(&scan);
+    logMessage(LOG_INFO, "Parallel scan with %d threads: %d files, %d directories", started, list->fileCount, list->directoryCount);
+    return 0;
+}
+
+// 扫描输入目录并填充文件表
+// 给出 list->indexPath 时使用扫描索引，只重新列举有变化的目录；
+// 否则 list->scanThreads 大于 1 时由多个工作线程并行列举目录（适合高延迟的网络文件系统），否则逐个目录递归扫描
+int scanDirectoryTree(const char* path, FileList* list) {
+    if (list->indexPath != NULL) {
+        return scanWithIndex(path, list);
+    }
+    if (list->scanThreads > 1) {
+        if (!pathExists(path)) {
+            return -1;
+        }
+        if (scanParallel(path, list) == 0) {
+            return 0;
+        }
+        logMessage(LOG_WARNING, "Cannot start parallel scan, scanning with a single thread");
+    }
+    return buildFileList(path, list);
+}
+
+// 解析扫描结果的合并顺序：completion 或 tree，成功返回 0
+int parseScanOrder(const char* text, ScanOrder* order) {
+    if (strcmp(text, "completion") == 0) {
+        *order = SCAN_ORDER_COMPLETION;
+    } else if (strcmp(text, "tree") == 0) {
+        *order = SCAN_ORDER_TREE;
+    } else {
+        return -1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#ifndef SCAN_UTILS_H
+#define SCAN_UTILS_H
+
+#define MAX_SCAN_THREADS 64
+
+// 函数声明
+int scanDirectoryTree(const char* path, FileList* list);
+int parseScanOrder(const char* text, ScanOrder* order);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file_utils.h"
+#include "platform_utils.h"
+#include "log_utils.h"
+#include "sched_utils.h"
+#include "progress_utils.h"
+
+// 内存压力（PSI avg10，百分比）超过该值时减少并发
+#define MEMORY_PRESSURE_SHRINK 10.0
+// CPU 或内存压力超过这些值时不再增加并发
+#define CPU_PRESSURE_HOLD 40.0
+#define MEMORY_PRESSURE_HOLD 2.0
+
+struct AdaptiveLimit {
+    int maxJobs;                // 上限（-j）
+    int cpuCount;
+    long long memoryPerJobKb;   // 用户给出的每个任务的内存预算（0 表示使用观测值）
+    long long observedPeakKb;   // 已完成任务中最大的峰值内存
+    int limit;                  // 当前允许同时运行的任务数
+    long long lastSample;       // 上次采样的时间（0 表示尚未采样）
+    Verbosity verbosity;        // VERBOSITY_QUIET 时并发的变化只写入日志
+};
+
+// 创建自适应并发控制，memoryPerJobKb 为 0 时以已完成任务的峰值内存作为预算
+AdaptiveLimit* createAdaptiveLimit(int maxJobs, long long memoryPerJobKb, Verbosity verbosity) {
+    AdaptiveLimit* limit = (AdaptiveLimit*)calloc(1, sizeof(AdaptiveLimit));
+    if (limit == NULL) {
+        return NULL;
+    }
+    limit->maxJobs = maxJobs > 0 ? maxJobs : 1;
+    limit->cpuCount = getProcessorCount();
+    limit->memoryPerJobKb = memoryPerJobKb > 0 ? memoryPerJobKb : 0;
+    limit->limit = 1;
+    limit->verbosity = verbosity;
+    return limit;
+}
+
+// 记录一个已完成任务的峰值内存（用于没有给出 --mem-per-job 时估算预算）
+void noteJobMemory(AdaptiveLimit* limit, long long peakMemoryKb) {
+    if (peakMemoryKb > limit->observedPeakKb) {
+        limit->observedPeakKb = peakMemoryKb;
+    }
+}
+
+// 根据当前系统负载计算允许同时运行的任务数（每 ADAPTIVE_INTERVAL_MS 最多采样一次）
+// 减少立即生效（已在运行的任务不受影响，只是暂不启动新任务）；增加时每次最多增加四分之一，避免负载指标滞后导致过冲
+int updateAdaptiveLimit(AdaptiveLimit* limit, int runningJobs) {
+    long long now = getMonotonicTime();
+    if (limit->lastSample != 0 && now - limit->lastSample < ADAPTIVE_INTERVAL_MS) {
+        return limit->limit;
+    }
+    int firstSample = (limit->lastSample == 0);
+    limit->lastSample = now;
+    
+    SystemLoad load;
+    getSystemLoad(&load);
+    int target = limit->maxJobs;
+    
+    // CPU：平均负载中包含本程序的任务，扣除后即其他进程占用的 CPU，剩余部分留给本程序
+    if (load.loadAverage >= 0) {
+        double others = load.loadAverage - runningJobs;
+        if (others < 0) {
+            others = 0;
+        }
+        int room = (int)(limit->cpuCount - others + 0.5);
+        if (room < target) {
+            target = room;
+        }
+    }
+    
+    // 内存：可用内存按每个任务的预算折算为还能再启动的任务数
+    long long budgetKb = limit->memoryPerJobKb > 0 ? limit->memoryPerJobKb : limit->observedPeakKb;
+    if (load.availableMemoryKb >= 0 && budgetKb > 0) {
+        long long extra = load.availableMemoryKb / budgetKb;
+        if (runningJobs + extra < target) {
+            target = runningJobs + (int)extra;
+        }
+    }
+    
+    // 压力：内存停顿明显时比当前运行数少一个，以便逐步退出换页
+    if (load.memoryPressure >= MEMORY_PRESSURE_SHRINK && target >= runningJobs) {
+        target = runningJobs - 1;
+    }
+    int mayGrow = !(load.cpuPressure >= CPU_PRESSURE_HOLD || load.memoryPressure >= MEMORY_PRESSURE_HOLD);
+    
+    if (!firstSample && target > limit->limit) {
+        int step = limit->limit / 4 > 1 ? limit->limit / 4 : 1;
+        target = mayGrow ? (target < limit->limit + step ? target : limit->limit + step) : limit->limit;
+    }
+    if (target < 1) {
+        target = 1;
+    } else if (target > limit->maxJobs) {
+        target = limit->maxJobs;
+    }
+    
+    if (target != limit->limit || firstSample) {
+        if (limit->verbosity != VERBOSITY_QUIET) {
+            printAboveProgress("Concurrency: %d job%s (load %.2f, available memory %lld MB, memory pressure %.1f%%)\n",
+                               target, target == 1 ? "" : "s", load.loadAverage, load.availableMemoryKb >= 0 ? load.availableMemoryKb / 1024 : -1, load.memoryPressure);
+        }
+        logMessage(LOG_INFO, "Concurrency limit %d -> %d (load %.2f, cpu pressure %.1f%%, memory pressure %.1f%%, available memory %lld KB, budget %lld KB per job)",
+                   limit->limit, target, load.loadAverage, load.cpuPressure, load.memoryPressure, load.availableMemoryKb, budgetKb);
+        limit->limit = target;
+    }
+    return limit->limit;
+}
+
+// 释放自适应并发控制
+void freeAdaptiveLimit(AdaptiveLimit* limit) {
+    free(limit);
+}
+
+// 一组 CPU（一个核心或一个 NUMA 节点上的全部核心）
+typedef struct CpuGroup {
+    int* cpus;
+    int count;
+    int runningJobs;            // 当前绑定到该组的任务数
+} CpuGroup;
+
+struct CpuPlacement {
+    CpuGroup* groups;
+    int groupCount;
+    int next;                   // 任务数相同时从该组开始轮询，使分配依次推进
+};
+
+// 辅助函数：向分配表加入一组 CPU
+static int addCpuGroup(CpuPlacement* placement, const int* cpus, int count) {
+    CpuGroup* groups = (CpuGroup*)realloc(placement->groups, sizeof(CpuGroup) * (size_t)(placement->groupCount + 1));
+    if (groups == NULL) {
+        return -1;
+    }
+    placement->groups = groups;
+    
+    CpuGroup* group = &groups[placement->groupCount];
+    group->cpus = (int*)malloc(sizeof(int) * (size_t)count);
+    if (group->cpus == NULL) {
+        return -1;
+    }
+    memcpy(group->cpus, cpus, sizeof(int) * (size_t)count);
+    group->count = count;
+    group->runningJobs = 0;
+    placement->groupCount++;
+    return 0;
+}
+
+// 创建 CPU 分配表：PIN_CORES 每个可用核心一组，PIN_NUMA 每个 NUMA 节点一组；无法分组时返回 NULL
+CpuPlacement* createCpuPlacement(PinMode mode) {
+    if (mode == PIN_NONE) {
+        return NULL;
+    }
+    CpuPlacement* placement = (CpuPlacement*)calloc(1, sizeof(CpuPlacement));
+    int* cpus = (int*)malloc(sizeof(int) * MAX_CPUS);
+    if (placement == NULL || cpus == NULL) {
+        free(placement);
+        free(cpus);
+        return NULL;
+    }
+    
+    if (mode == PIN_CORES) {
+        int count = getAvailableCpus(cpus, MAX_CPUS);
+        for (int i = 0; i < count; i++) {
+            addCpuGroup(placement, &cpus[i], 1);
+        }
+    } else {
+        // 节点编号可能不连续（例如只有 0 和 2 在线），按系统列出的在线节点逐个取
+        int* nodes = (int*)malloc(sizeof(int) * MAX_NUMA_NODES);
+        int nodeCount = (nodes != NULL) ? getNumaNodes(nodes, MAX_NUMA_NODES) : 0;
+        for (int i = 0; i < nodeCount; i++) {
+            int count = getNumaNodeCpus(nodes[i], cpus, MAX_CPUS);
+            if (count > 0) {
+                addCpuGroup(placement, cpus, count);
+            }
+        }
+        free(nodes);
+    }
+    free(cpus);
+    
+    if (placement->groupCount == 0) {
+        logMessage(LOG_WARNING, "No CPUs available for pinning, commands are not pinned");
+        freeCpuPlacement(placement);
+        return NULL;
+    }
+    logMessage(LOG_INFO, "Pinning commands round-robin across %d %s", placement->groupCount, mode == PIN_CORES ? "cores" : "NUMA nodes");
+    return placement;
+}
+
+// 为下一个启动的子进程选择运行任务最少的组并设置其 CPU 亲和性，返回组号（之后交给 releasePlacement）
+// 亲和性设置在调用线程上，调用方启动子进程后应立即用 setChildAffinity(NULL, 0) 恢复
+int acquirePlacement(CpuPlacement* placement) {
+    int best = placement->next;
+    for (int i = 1; i < placement->groupCount; i++) {
+        int candidate = (placement->next + i) % placement->groupCount;
+        if (placement->groups[candidate].runningJobs < placement->groups[best].runningJobs) {
+            best = candidate;
+        }
+    }
+    placement->next = (best + 1) % placement->groupCount;
+    
+    CpuGroup* group = &placement->groups[best];
+    group->runningJobs++;
+    setChildAffinity(group->cpus, group->count);
+    return best;
+}
+
+// 绑定到该组的任务已结束
+void releasePlacement(CpuPlacement* placement, int group) {
+    if (group >= 0 && group < placement->groupCount && placement->groups[group].runningJobs > 0) {
+        placement->groups[group].runningJobs--;
+    }
+}
+
+// 释放 CPU 分配表并恢复之后启动的子进程的亲和性
+void freeCpuPlacement(CpuPlacement* placement) {
+    if (placement == NULL) {
+        return;
+    }
+    for (int i = 0; i < placement->groupCount; i++) {
+        free(placement->groups[i].cpus);
+    }
+    free(placement->groups);
+    free(placement);
+    setChildAffinity(NULL, 0);
+}
+
+// 解析 CPU 绑定方式：none、cores 或 numa，成功返回 0
+int parsePinMode(const char* text, PinMode* mode) {
+    if (strcmp(text, "none") == 0) {
+        *mode = PIN_NONE;
+    } else if (strcmp(text, "cores") == 0) {
+        *mode = PIN_CORES;
+    } else if (strcmp(text, "numa") == 0) {
+        *mode = PIN_NUMA;
+    } else {
+        return -1;
+    }
+    return 0;
+}
\ No newline at end of file
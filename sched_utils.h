@@ -0,0 +1,24 @@
+#ifndef SCHED_UTILS_H
+#define SCHED_UTILS_H
+
+// 自适应并发：根据系统负载和内存情况调整同时运行的任务数
+typedef struct AdaptiveLimit AdaptiveLimit;
+
+// 子进程的 CPU 绑定：按核心或 NUMA 节点轮流分配
+typedef struct CpuPlacement CpuPlacement;
+
+// 两次采样系统负载之间的最短间隔（毫秒）
+#define ADAPTIVE_INTERVAL_MS 1000
+
+// 函数声明
+AdaptiveLimit* createAdaptiveLimit(int maxJobs, long long memoryPerJobKb, Verbosity verbosity);
+int updateAdaptiveLimit(AdaptiveLimit* limit, int runningJobs);
+void noteJobMemory(AdaptiveLimit* limit, long long peakMemoryKb);
+void freeAdaptiveLimit(AdaptiveLimit* limit);
+CpuPlacement* createCpuPlacement(PinMode mode);
+int acquirePlacement(CpuPlacement* placement);
+void releasePlacement(CpuPlacement* placement, int group);
+void freeCpuPlacement(CpuPlacement* placement);
+int parsePinMode(const char* text, PinMode* mode);
+
+#endif
\ No newline at end of file
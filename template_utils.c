@@ -0,0 +1,469 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file_utils.h"
+#include "platform_utils.h"
+#include "template_utils.h"
+
+// 辅助函数：占位符字母对应的段类型，不是占位符时返回 SEGMENT_LITERAL
+static SegmentType placeholderType(char letter) {
+    switch (letter) {
+        case 'i': return SEGMENT_INPUT;
+        case 'o': return SEGMENT_OUTPUT;
+        case 'r': return SEGMENT_RELATIVE;
+        case 'd': return SEGMENT_OUTPUT_DIR;
+        case 'n': return SEGMENT_NAME;
+        case 'e': return SEGMENT_EXTENSION;
+        case 'p': return SEGMENT_PARENT;
+        case 'I': return SEGMENT_INPUT_LIST;
+        default: return SEGMENT_LITERAL;
+    }
+}
+
+// 辅助函数：追加一个字面量字符，与前一个字面量段相邻时直接合并
+static void appendLiteral(CommandTemplate* commandTemplate, size_t* textLength, int argumentStart, char c) {
+    TemplateSegment* last = commandTemplate->segmentCount > argumentStart ? &commandTemplate->segments[commandTemplate->segmentCount - 1] : NULL;
+    
+    if (last == NULL || last->type != SEGMENT_LITERAL || last->offset + last->length != *textLength) {
+        last = &commandTemplate->segments[commandTemplate->segmentCount++];
+        last->type = SEGMENT_LITERAL;
+        last->quote = QUOTE_RAW;
+        last->offset = (unsigned int)*textLength;
+        last->length = 0;
+    }
+    
+    commandTemplate->text[(*textLength)++] = c;
+    last->length++;
+}
+
+// 编译命令模板
+// 直接执行模式：按空白拆分参数，引号只用于分组并被去掉
+// Shell 模式：整条命令作为一个参数原样保留，同时记录每个占位符所处的引号环境
+int compileTemplate(const char* command, int useShell, CommandTemplate* commandTemplate) {
+    size_t commandLength = strlen(command);
+    memset(commandTemplate, 0, sizeof(CommandTemplate));
+    commandTemplate->useShell = useShell;
+    
+    // 段数和参数数都不会超过模板长度 + 1
+    commandTemplate->text = (char*)malloc(commandLength + 1);
+    commandTemplate->segments = (TemplateSegment*)malloc(sizeof(TemplateSegment) * (commandLength + 1));
+    commandTemplate->argumentStarts = (int*)malloc(sizeof(int) * (commandLength + 2));
+    if (commandTemplate->text == NULL || commandTemplate->segments == NULL || commandTemplate->argumentStarts == NULL) {
+        freeTemplate(commandTemplate);
+        return -1;
+    }
+    
+    size_t textLength = 0;
+    int inArgument = 0;
+    char quote = '\0';
+    
+    for (const char* p = command; *p != '\0'; p++) {
+        char c = *p;
+        
+        if (!useShell) {
+            if (quote == '\0' && (c == ' ' || c == '\t')) {
+                inArgument = 0;
+                continue;
+            }
+            if (!inArgument) {
+                commandTemplate->argumentStarts[commandTemplate->argumentCount++] = commandTemplate->segmentCount;
+                inArgument = 1;
+            }
+            if (quote == '\0' && (c == '"' || c == '\'')) {
+                quote = c;
+                continue;
+            }
+            if (c == quote) {
+                quote = '\0';
+                continue;
+            }
+            if (quote == '\0' && strchr("|<>&", c) != NULL) {
+                commandTemplate->hasShellOperator = 1;
+            }
+        } else {
+            if (!inArgument) {
+                commandTemplate->argumentStarts[commandTemplate->argumentCount++] = 0;
+                inArgument = 1;
+            }
+#ifdef _WIN32
+            // cmd.exe 只把双引号当作引号
+            if (quote == '\0' && c == '"') {
+#else
+            if (quote == '\0' && (c == '"' || c == '\'')) {
+#endif
+                quote = c;
+            } else if (c == quote) {
+                quote = '\0';
+            }
+        }
+        
+        // %% 表示字面量 %
+        if (c == '%' && p[1] == '%') {
+            appendLiteral(commandTemplate, &textLength, commandTemplate->argumentStarts[commandTemplate->argumentCount - 1], '%');
+            p++;
+            continue;
+        }
+        
+        SegmentType type = (c == '%') ? placeholderType(p[1]) : SEGMENT_LITERAL;
+        if (type == SEGMENT_LITERAL) {
+            appendLiteral(commandTemplate, &textLength, commandTemplate->argumentStarts[commandTemplate->argumentCount - 1], c);
+            continue;
+        }
+        
+        TemplateSegment* segment = &commandTemplate->segments[commandTemplate->segmentCount++];
+        segment->type = (unsigned char)type;
+        if (type == SEGMENT_INPUT_LIST) {
+            commandTemplate->hasInputList = 1;
+        }
+        segment->offset = 0;
+        segment->length = 0;
+        if (!useShell) {
+            segment->quote = QUOTE_RAW;
+        } else if (quote == '"') {
+            segment->quote = QUOTE_DOUBLE;
+        } else if (quote == '\'') {
+            segment->quote = QUOTE_SINGLE;
+        } else {
+            segment->quote = QUOTE_ADD;
+        }
+        p++;
+    }
+    
+    commandTemplate->argumentStarts[commandTemplate->argumentCount] = commandTemplate->segmentCount;
+    return commandTemplate->argumentCount;
+}
+
+// 释放模板
+void freeTemplate(CommandTemplate* commandTemplate) {
+    free(commandTemplate->text);
+    free(commandTemplate->segments);
+    free(commandTemplate->argumentStarts);
+    memset(commandTemplate, 0, sizeof(CommandTemplate));
+}
+
+// 辅助函数：设置占位符的值
+static void setValue(TemplateContext* context, SegmentType type, const char* text, size_t length) {
+    context->values[type].text = text;
+    context->values[type].length = length;
+}
+
+// 辅助函数：判断字符是否为路径分隔符（两种分隔符都接受）
+static int isSeparator(char c) {
+    return c == '/' || c == '\\';
+}
+
+// 计算单个文件的全部占位符值
+// 除输出目录和输出路径需要拼接外，其余值都直接指向 inputPath 中的片段
+int setTemplateContext(TemplateContext* context, const char* inputPath, size_t inputRootLength, const char* outputPath) {
+    size_t inputLength = strlen(inputPath);
+    const char* relativeWithSeparator = inputPath + inputRootLength;
+    const char* relative = relativeWithSeparator;
+    while (isSeparator(*relative)) {
+        relative++;
+    }
+    
+    // 文件名及其所在目录
+    const char* baseName = inputPath + inputLength;
+    while (baseName > inputPath && !isSeparator(baseName[-1])) {
+        baseName--;
+    }
+    const char* parentEnd = baseName > inputPath ? baseName - 1 : inputPath;
+    const char* parent = parentEnd;
+    while (parent > inputPath && !isSeparator(parent[-1])) {
+        parent--;
+    }
+    
+    // 以点开头的文件名（如 .gitignore）不视为扩展名
+    const char* lastDot = strrchr(baseName, '.');
+    if (lastDot == baseName) {
+        lastDot = NULL;
+    }
+    size_t nameLength = lastDot != NULL ? (size_t)(lastDot - baseName) : strlen(baseName);
+    
+    setValue(context, SEGMENT_INPUT, inputPath, inputLength);
+    setValue(context, SEGMENT_INPUT_LIST, inputPath, inputLength);
+    context->inputs = NULL;
+    context->inputCount = 0;
+    setValue(context, SEGMENT_RELATIVE, relative, strlen(relative));
+    setValue(context, SEGMENT_NAME, baseName, nameLength);
+    setValue(context, SEGMENT_EXTENSION, lastDot != NULL ? lastDot + 1 : baseName + nameLength, lastDot != NULL ? strlen(lastDot + 1) : 0);
+    setValue(context, SEGMENT_PARENT, parent, (size_t)(parentEnd - parent));
+    
+    // 输出目录 = 输出根目录 + 相对路径中的目录部分
+    size_t relativeDirLength = baseName > relativeWithSeparator ? (size_t)(baseName - 1 - relativeWithSeparator) : 0;
+    int written = snprintf(context->outputDir, MAX_PATH_LENGTH, "%s%.*s", outputPath, (int)relativeDirLength, relativeWithSeparator);
+    if (written < 0 || written >= MAX_PATH_LENGTH) {
+        return -1;
+    }
+    setValue(context, SEGMENT_OUTPUT_DIR, context->outputDir, (size_t)written);
+    
+    written = snprintf(context->outputBase, MAX_PATH_LENGTH, "%s%s%.*s", context->outputDir, PATH_SEPARATOR_STRING, (int)nameLength, baseName);
+    if (written < 0 || written >= MAX_PATH_LENGTH) {
+        return -1;
+    }
+    setValue(context, SEGMENT_OUTPUT, context->outputBase, (size_t)written);
+    return 0;
+}
+
+// 辅助函数：按引号环境写入占位符的值，空间不足返回 -1
+static int appendValue(char* buffer, size_t bufferSize, size_t* position, const TemplateValue* value, QuoteMode quote) {
+    size_t pos = *position;
+    
+    if (quote == QUOTE_RAW) {
+        if (pos + value->length >= bufferSize) {
+            return -1;
+        }
+        memcpy(buffer + pos, value->text, value->length);
+        *position = pos + value->length;
+        return 0;
+    }
+    
+#ifdef _WIN32
+    // Windows 路径中不会出现双引号，只需在引号外补上引号
+    size_t needed = value->length + (quote == QUOTE_ADD ? 2 : 0);
+    if (pos + needed >= bufferSize) {
+        return -1;
+    }
+    if (quote == QUOTE_ADD) {
+        buffer[pos++] = '"';
+    }
+    memcpy(buffer + pos, value->text, value->length);
+    pos += value->length;
+    if (quote == QUOTE_ADD) {
+        buffer[pos++] = '"';
+    }
+#else
+    // POSIX Shell：引号外用单引号包裹；单引号内把 ' 写成 '\''；双引号内转义 " $ ` 和反斜杠
+    if (quote == QUOTE_ADD) {
+        if (pos + 1 >= bufferSize) {
+            return -1;
+        }
+        buffer[pos++] = '\'';
+    }
+    for (size_t i = 0; i < value->length; i++) {
+        char c = value->text[i];
+        if (c == '\'' && quote != QUOTE_DOUBLE) {
+            if (pos + 4 >= bufferSize) {
+                return -1;
+            }
+            memcpy(buffer + pos, "'\\''", 4);
+            pos += 4;
+            continue;
+        }
+        if (quote == QUOTE_DOUBLE && (c == '"' || c == '$' || c == '`' || c == '\\')) {
+            if (pos + 1 >= bufferSize) {
+                return -1;
+            }
+            buffer[pos++] = '\\';
+        }
+        if (pos + 1 >= bufferSize) {
+            return -1;
+        }
+        buffer[pos++] = c;
+    }
+    if (quote == QUOTE_ADD) {
+        if (pos + 1 >= bufferSize) {
+            return -1;
+        }
+        buffer[pos++] = '\'';
+    }
+#endif
+    
+    *position = pos;
+    return 0;
+}
+
+// 辅助函数：按引号环境写入占位符值所需的字节数（与 appendValue 的转义规则一致）
+static size_t quotedLength(const char* text, size_t length, QuoteMode quote) {
+    if (quote == QUOTE_RAW) {
+        return length;
+    }
+#ifdef _WIN32
+    return length + (quote == QUOTE_ADD ? 2 : 0);
+#else
+    size_t needed = (quote == QUOTE_ADD) ? 2 : 0;
+    for (size_t i = 0; i < length; i++) {
+        char c = text[i];
+        if (c == '\'' && quote != QUOTE_DOUBLE) {
+            needed += 4;
+        } else if (quote == QUOTE_DOUBLE && (c == '"' || c == '$' || c == '`' || c == '\\')) {
+            needed += 2;
+        } else {
+            needed++;
+        }
+    }
+    return needed;
+#endif
+}
+
+// 辅助函数：Shell 模式下 %I 相邻两项之间的分隔：引号内先闭合引号再重新打开，使每个路径仍是单独的参数
+static const char* listSeparator(QuoteMode quote) {
+    switch (quote) {
+        case QUOTE_DOUBLE: return "\" \"";
+        case QUOTE_SINGLE: return "' '";
+        default: return " ";
+    }
+}
+
+// 辅助函数：%I 的第 index 项（没有设置输入列表时只有当前文件一项）
+static TemplateValue listItem(const TemplateContext* context, int index) {
+    TemplateValue value = context->values[SEGMENT_INPUT];
+    if (context->inputs != NULL) {
+        value.text = context->inputs[index];
+        value.length = strlen(value.text);
+    }
+    return value;
+}
+
+// 辅助函数：%I 的项数
+static int listItemCount(const TemplateContext* context) {
+    return context->inputs != NULL ? context->inputCount : 1;
+}
+
+// 辅助函数：展开 [start, end) 范围内的段；item 不为 NULL 时 %I 只展开为这一项（直接执行模式），否则展开为整个列表
+static int expandSegments(const CommandTemplate* commandTemplate, const TemplateContext* context, int start, int end, const TemplateValue* item, char* buffer, size_t bufferSize, size_t* position) {
+    for (int i = start; i < end; i++) {
+        const TemplateSegment* segment = &commandTemplate->segments[i];
+        if (segment->type == SEGMENT_LITERAL) {
+            if (*position + segment->length >= bufferSize) {
+                return -1;
+            }
+            memcpy(buffer + *position, commandTemplate->text + segment->offset, segment->length);
+            *position += segment->length;
+        } else if (segment->type == SEGMENT_INPUT_LIST && item == NULL) {
+            const char* separator = listSeparator((QuoteMode)segment->quote);
+            size_t separatorLength = strlen(separator);
+            int count = listItemCount(context);
+            for (int k = 0; k < count; k++) {
+                if (k > 0) {
+                    if (*position + separatorLength >= bufferSize) {
+                        return -1;
+                    }
+                    memcpy(buffer + *position, separator, separatorLength);
+                    *position += separatorLength;
+                }
+                TemplateValue value = listItem(context, k);
+                if (appendValue(buffer, bufferSize, position, &value, (QuoteMode)segment->quote) != 0) {
+                    return -1;
+                }
+            }
+        } else {
+            const TemplateValue* value = (segment->type == SEGMENT_INPUT_LIST) ? item : &context->values[segment->type];
+            if (appendValue(buffer, bufferSize, position, value, (QuoteMode)segment->quote) != 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// 辅助函数：参数中是否含有 %I
+static int argumentHasList(const CommandTemplate* commandTemplate, int argument) {
+    int end = commandTemplate->argumentStarts[argument + 1];
+    for (int i = commandTemplate->argumentStarts[argument]; i < end; i++) {
+        if (commandTemplate->segments[i].type == SEGMENT_INPUT_LIST) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 展开模板：单次遍历所有段，结果写入调用方提供的缓冲区
+// 直接执行模式下每个参数以 '\0' 结尾依次存放，含 %I 的参数对每个输入文件重复一次；Shell 模式下只有一个字符串
+// 返回写入的总字节数（含结尾的 '\0'），空间不足返回 -1
+int expandTemplate(const CommandTemplate* commandTemplate, const TemplateContext* context, char* buffer, size_t bufferSize) {
+    size_t position = 0;
+    
+    for (int argument = 0; argument < commandTemplate->argumentCount; argument++) {
+        int start = commandTemplate->argumentStarts[argument];
+        int end = commandTemplate->argumentStarts[argument + 1];
+        int repeat = (!commandTemplate->useShell && argumentHasList(commandTemplate, argument)) ? listItemCount(context) : 1;
+        
+        for (int k = 0; k < repeat; k++) {
+            TemplateValue item = listItem(context, k);
+            if (expandSegments(commandTemplate, context, start, end, commandTemplate->useShell ? NULL : &item, buffer, bufferSize, &position) != 0) {
+                return -1;
+            }
+            if (position + 1 > bufferSize) {
+                return -1;
+            }
+            buffer[position++] = '\0';
+        }
+    }
+    return (int)position;
+}
+
+// 估算在 %I 中再加入一个输入文件会使展开结果增加的字节数（按最长的分隔计算，结果不会偏小）
+// 直接执行模式下为含 %I 的各参数再重复一次的长度，Shell 模式下为各处 %I 增加的转义后路径和分隔
+size_t measureInputItem(const CommandTemplate* commandTemplate, const TemplateContext* context, const char* input) {
+    size_t inputLength = strlen(input);
+    size_t total = 0;
+    
+    for (int argument = 0; argument < commandTemplate->argumentCount; argument++) {
+        int start = commandTemplate->argumentStarts[argument];
+        int end = commandTemplate->argumentStarts[argument + 1];
+        if (!commandTemplate->useShell && !argumentHasList(commandTemplate, argument)) {
+            continue;
+        }
+        
+        size_t argumentLength = 0;
+        for (int i = start; i < end; i++) {
+            const TemplateSegment* segment = &commandTemplate->segments[i];
+            if (segment->type == SEGMENT_INPUT_LIST) {
+                argumentLength += quotedLength(input, inputLength, (QuoteMode)segment->quote);
+                argumentLength += strlen(listSeparator((QuoteMode)segment->quote));
+            } else if (!commandTemplate->useShell) {
+                argumentLength += (segment->type == SEGMENT_LITERAL) ? segment->length : context->values[segment->type].length;
+            }
+        }
+        total += argumentLength;
+    }
+    return total;
+}
+
+// 推断输出文件路径：从第一个 %o 开始展开，直到所在参数结束或遇到空白、引号及 Shell 元字符
+// 例如 %o.mp4 或 %o.%e.bak，占位符的值不加引号；模板中没有 %o 时返回 0
+int expandOutputPath(const CommandTemplate* commandTemplate, const TemplateContext* context, char* buffer, size_t bufferSize) {
+    for (int argument = 0; argument < commandTemplate->argumentCount; argument++) {
+        int end = commandTemplate->argumentStarts[argument + 1];
+        int i = commandTemplate->argumentStarts[argument];
+        while (i < end && commandTemplate->segments[i].type != SEGMENT_OUTPUT) {
+            i++;
+        }
+        if (i == end) {
+            continue;
+        }
+        
+        size_t position = 0;
+        for (; i < end; i++) {
+            const TemplateSegment* segment = &commandTemplate->segments[i];
+            const char* text = commandTemplate->text + segment->offset;
+            size_t length = segment->length;
+            int stop = 0;
+            
+            if (segment->type == SEGMENT_LITERAL) {
+                for (length = 0; length < segment->length; length++) {
+                    if (strchr(" \t\"';|&<>", text[length]) != NULL) {
+                        stop = 1;
+                        break;
+                    }
+                }
+            } else {
+                text = context->values[segment->type].text;
+                length = context->values[segment->type].length;
+            }
+            
+            if (position + length >= bufferSize) {
+                return 0;
+            }
+            memcpy(buffer + position, text, length);
+            position += length;
+            if (stop) {
+                break;
+            }
+        }
+        buffer[position] = '\0';
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
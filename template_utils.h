@@ -0,0 +1,70 @@
+#ifndef TEMPLATE_UTILS_H
+#define TEMPLATE_UTILS_H
+
+#include <stddef.h>
+
+// 命令模板中的段类型（字面量或占位符）
+typedef enum {
+    SEGMENT_LITERAL,
+    SEGMENT_INPUT,          // %i 输入文件完整路径
+    SEGMENT_OUTPUT,         // %o 输出文件路径（输出目录 + 不带扩展名的文件名）
+    SEGMENT_RELATIVE,       // %r 相对输入目录的路径
+    SEGMENT_OUTPUT_DIR,     // %d 输出目录
+    SEGMENT_NAME,           // %n 不带扩展名的文件名
+    SEGMENT_EXTENSION,      // %e 扩展名（不含点）
+    SEGMENT_PARENT,         // %p 父目录名
+    SEGMENT_INPUT_LIST,     // %I 批处理中所有输入文件的完整路径（每个路径单独加引号）
+    SEGMENT_TYPE_COUNT
+} SegmentType;
+
+// 占位符展开时的引号处理方式
+typedef enum {
+    QUOTE_RAW,              // 直接执行模式：参数原样传递，无需转义
+    QUOTE_ADD,              // Shell 模式且不在引号内：展开时补上引号
+    QUOTE_DOUBLE,           // Shell 模式且位于 "..." 内
+    QUOTE_SINGLE            // Shell 模式且位于 '...' 内
+} QuoteMode;
+
+typedef struct TemplateSegment {
+    unsigned char type;     // SegmentType
+    unsigned char quote;    // QuoteMode
+    unsigned int offset;    // 字面量在 text 中的偏移
+    unsigned int length;    // 字面量长度
+} TemplateSegment;
+
+// 预编译的命令模板：只解析一次，之后每个文件单次遍历展开
+typedef struct CommandTemplate {
+    char* text;                 // 字面量文本（直接执行模式下已去掉引号）
+    TemplateSegment* segments;
+    int segmentCount;
+    int* argumentStarts;        // 每个参数的第一个段下标，末尾额外存放 segmentCount
+    int argumentCount;
+    int useShell;
+    int hasInputList;           // 模板中含有 %I，可以一次处理多个文件
+    int hasShellOperator;       // 直接执行模式下引号外有 | < > &，它们会作为普通参数传给程序
+} CommandTemplate;
+
+// 占位符的值（指向已有字符串的片段，不复制）
+typedef struct TemplateValue {
+    const char* text;
+    size_t length;
+} TemplateValue;
+
+// 单个文件的展开上下文，派生路径存放在内部缓冲区中，避免动态分配
+typedef struct TemplateContext {
+    TemplateValue values[SEGMENT_TYPE_COUNT];
+    char outputDir[MAX_PATH_LENGTH];
+    char outputBase[MAX_PATH_LENGTH];
+    const char* const* inputs;  // %I 展开的输入文件（为 NULL 时只展开为当前文件）
+    int inputCount;
+} TemplateContext;
+
+// 函数声明
+int compileTemplate(const char* command, int useShell, CommandTemplate* commandTemplate);
+void freeTemplate(CommandTemplate* commandTemplate);
+int setTemplateContext(TemplateContext* context, const char* inputPath, size_t inputRootLength, const char* outputPath);
+int expandTemplate(const CommandTemplate* commandTemplate, const TemplateContext* context, char* buffer, size_t bufferSize);
+size_t measureInputItem(const CommandTemplate* commandTemplate, const TemplateContext* context, const char* input);
+int expandOutputPath(const CommandTemplate* commandTemplate, const TemplateContext* context, char* buffer, size_t bufferSize);
+
+#endif
\ No newline at end of file
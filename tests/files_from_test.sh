@@ -0,0 +1,41 @@
+#!/bin/sh
+# --files-from 的路径检查：列表中指向输入目录之外的项（绝对路径、含 ".." 的路径）必须被拒绝，
+# 输出不得写到输出目录之外；有项被拒绝或命令失败时以非 0 状态退出
+# 用法：sh tests/files_from_test.sh ./bct
+BCT=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+mkdir -p in/sub out
+echo inside > in/sub/a.txt
+echo secret > secret.txt
+printf '%s\n' sub/a.txt ../secret.txt in/../secret.txt sub/../../secret.txt "$WORK/secret.txt" > list.txt
+
+"$BCT" --input in --output out --files-from list.txt --command "cp %i %d/%n.out" -q --log-mode overwrite > run.txt 2>&1
+rejectedStatus=$?
+echo sub/a.txt | "$BCT" --input in --output out --files-from - --command "cp %i %d/%n.out" -q --log-mode append >> run.txt 2>&1
+cleanStatus=$?
+echo sub/a.txt | "$BCT" --input in --output out --files-from - --command "false" -q --log-mode append >> run.txt 2>&1
+failedStatus=$?
+
+failures=0
+check() {
+    if ! eval "$2"; then
+        echo "FAIL: $1"
+        failures=$((failures + 1))
+    fi
+}
+check "file inside the input folder is processed" '[ -f out/sub/a.out ]'
+check "nothing is written next to the input folder" '[ ! -e secret.out ]'
+check "no output outside the output folder" '[ -z "$(find "$WORK" -name "*.out" ! -path "$WORK/out/*")" ]'
+check "rejected entries make the run fail" '[ "$rejectedStatus" -ne 0 ]'
+check "a clean run exits with 0" '[ "$cleanStatus" -eq 0 ]'
+check "a failed command makes the run fail" '[ "$failedStatus" -ne 0 ]'
+check "rejected entries are logged" '[ "$(grep -c "outside the input directory" bct.log)" -eq 4 ]'
+
+if [ "$failures" -ne 0 ]; then
+    cat run.txt
+    exit 1
+fi
+echo "files_from_test: OK"
\ No newline at end of file
@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file_utils.h"
+#include "watch_utils.h"
+
+// 一个等待稳定的文件
+typedef struct PendingChange {
+    struct PendingChange* hashNext;     // 同一散列桶中的下一项
+    struct PendingChange* previous;     // 按最近事件时间排列的链表
+    struct PendingChange* next;
+    unsigned long long hash;
+    long long lastEvent;                // 最近一次事件的时间（单调时钟，毫秒）
+    int closed;                         // 最近一次写入之后写入方已关闭文件（或文件被整体移入）
+    char relativePath[];
+} PendingChange;
+
+struct PendingChanges {
+    PendingChange** buckets;
+    int bucketCount;                    // 2 的幂
+    int count;
+    PendingChange* oldest;              // 链表头：最早一次事件距今最久
+    PendingChange* newest;
+};
+
+// 初始散列桶数
+#define INITIAL_BUCKET_COUNT 256
+
+// 辅助函数：从按时间排列的链表中摘下一项
+static void unlinkChange(PendingChanges* changes, PendingChange* change) {
+    if (change->previous != NULL) {
+        change->previous->next = change->next;
+    } else {
+        changes->oldest = change->next;
+    }
+    if (change->next != NULL) {
+        change->next->previous = change->previous;
+    } else {
+        changes->newest = change->previous;
+    }
+    change->previous = NULL;
+    change->next = NULL;
+}
+
+// 辅助函数：把一项放到链表末尾（最新）
+static void appendChange(PendingChanges* changes, PendingChange* change) {
+    change->previous = changes->newest;
+    change->next = NULL;
+    if (changes->newest != NULL) {
+        changes->newest->next = change;
+    } else {
+        changes->oldest = change;
+    }
+    changes->newest = change;
+}
+
+// 辅助函数：查找路径对应的项，同时返回指向它的散列链指针以便删除
+static PendingChange** findChange(const PendingChanges* changes, const char* relativePath, unsigned long long hash) {
+    PendingChange** link = &changes->buckets[hash & (unsigned long long)(changes->bucketCount - 1)];
+    while (*link != NULL) {
+        if ((*link)->hash == hash && strcmp((*link)->relativePath, relativePath) == 0) {
+            return link;
+        }
+        link = &(*link)->hashNext;
+    }
+    return link;
+}
+
+// 辅助函数：项数超过桶数时把散列桶扩大一倍
+static void growBuckets(PendingChanges* changes) {
+    int bucketCount = changes->bucketCount * 2;
+    PendingChange** buckets = (PendingChange**)calloc((size_t)bucketCount, sizeof(PendingChange*));
+    if (buckets == NULL) {
+        return;
+    }
+    for (PendingChange* change = changes->oldest; change != NULL; change = change->next) {
+        PendingChange** bucket = &buckets[change->hash & (unsigned long long)(bucketCount - 1)];
+        change->hashNext = *bucket;
+        *bucket = change;
+    }
+    free(changes->buckets);
+    changes->buckets = buckets;
+    changes->bucketCount = bucketCount;
+}
+
+// 辅助函数：删除一项
+static void removeChange(PendingChanges* changes, PendingChange** link) {
+    PendingChange* change = *link;
+    *link = change->hashNext;
+    unlinkChange(changes, change);
+    free(change);
+    changes->count--;
+}
+
+// 创建空的变更集合
+PendingChanges* createPendingChanges(void) {
+    PendingChanges* changes = (PendingChanges*)calloc(1, sizeof(PendingChanges));
+    if (changes == NULL) {
+        return NULL;
+    }
+    changes->buckets = (PendingChange**)calloc(INITIAL_BUCKET_COUNT, sizeof(PendingChange*));
+    if (changes->buckets == NULL) {
+        free(changes);
+        return NULL;
+    }
+    changes->bucketCount = INITIAL_BUCKET_COUNT;
+    return changes;
+}
+
+// 记录一个文件事件：同一文件的多次事件合并为一项，并重新开始计算稳定时间
+// closed 为真表示写入方已关闭文件，为假表示文件仍可能在写入（此后收到关闭事件才按正常的稳定时间处理）
+int recordChange(PendingChanges* changes, const char* relativePath, int closed, long long now) {
+    unsigned long long hash = hashString(relativePath);
+    PendingChange** link = findChange(changes, relativePath, hash);
+    PendingChange* change = *link;
+    
+    if (change == NULL) {
+        size_t length = strlen(relativePath);
+        change = (PendingChange*)malloc(sizeof(PendingChange) + length + 1);
+        if (change == NULL) {
+            return -1;
+        }
+        memcpy(change->relativePath, relativePath, length + 1);
+        change->hash = hash;
+        change->hashNext = NULL;
+        *link = change;
+        changes->count++;
+    } else {
+        unlinkChange(changes, change);
+    }
+    
+    change->lastEvent = now;
+    change->closed = closed;
+    appendChange(changes, change);
+    
+    if (changes->count > changes->bucketCount) {
+        growBuckets(changes);
+    }
+    return 0;
+}
+
+// 文件被删除或移出时放弃等待
+void forgetChange(PendingChanges* changes, const char* relativePath) {
+    PendingChange** link = findChange(changes, relativePath, hashString(relativePath));
+    if (*link != NULL) {
+        removeChange(changes, link);
+    }
+}
+
+// 辅助函数：一项稳定所需的静默时间
+static long long settleTimeOf(const PendingChange* change, int settleMs) {
+    return change->closed ? settleMs : (settleMs > UNCLOSED_SETTLE_MS ? settleMs : UNCLOSED_SETTLE_MS);
+}
+
+// 按最早事件的顺序取出所有写入已稳定的文件，作为一批交给回调，返回取出的文件数
+int takeSettledChanges(PendingChanges* changes, long long now, int settleMs, SettledCallback callback, void* userData) {
+    int taken = 0;
+    PendingChange* change = changes->oldest;
+    while (change != NULL) {
+        // 链表按最近事件时间排列，之后的项都更新，任何一项都还不可能稳定
+        if (now - change->lastEvent < settleMs) {
+            break;
+        }
+        PendingChange* next = change->next;
+        if (now - change->lastEvent >= settleTimeOf(change, settleMs)) {
+            int stop = callback(userData, change->relativePath);
+            removeChange(changes, findChange(changes, change->relativePath, change->hash));
+            taken++;
+            if (stop) {
+                break;
+            }
+        }
+        change = next;
+    }
+    return taken;
+}
+
+// 距离下一项可能稳定还有多少毫秒，没有等待中的文件时返回 -1
+int nextSettleDelay(const PendingChanges* changes, long long now, int settleMs) {
+    long long delay = -1;
+    for (const PendingChange* change = changes->oldest; change != NULL; change = change->next) {
+        long long remaining = change->lastEvent + settleTimeOf(change, settleMs) - now;
+        if (remaining < 0) {
+            remaining = 0;
+        }
+        if (delay < 0 || remaining < delay) {
+            delay = remaining;
+        }
+        // 之后的项事件更新，按正常稳定时间也不会早于当前的最小值
+        if (change->lastEvent + settleMs - now >= delay) {
+            break;
+        }
+    }
+    return (int)delay;
+}
+
+// 等待稳定的文件数
+int getPendingCount(const PendingChanges* changes) {
+    return changes->count;
+}
+
+// 释放变更集合
+void freePendingChanges(PendingChanges* changes) {
+    if (changes == NULL) {
+        return;
+    }
+    PendingChange* change = changes->oldest;
+    while (change != NULL) {
+        PendingChange* next = change->next;
+        free(change);
+        change = next;
+    }
+    free(changes->buckets);
+    free(changes);
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef WATCH_UTILS_H
+#define WATCH_UTILS_H
+
+// 监视模式下等待处理的变更：按相对路径合并同一文件的多次事件，写入稳定后成批取出
+typedef struct PendingChanges PendingChanges;
+
+// 默认的稳定时间：写入方关闭文件后这段时间内没有新的事件才开始处理
+#define DEFAULT_SETTLE_MS 1000
+
+// 只有创建或写入事件、始终没有收到关闭事件的文件（如硬链接，或写入方一直打开文件）在静默这么久之后才处理
+#define UNCLOSED_SETTLE_MS 30000
+
+// takeSettledChanges 对每个写入已稳定的文件调用的回调，返回非 0 时停止取出
+typedef int (*SettledCallback)(void* userData, const char* relativePath);
+
+// 函数声明
+PendingChanges* createPendingChanges(void);
+int recordChange(PendingChanges* changes, const char* relativePath, int closed, long long now);
+void forgetChange(PendingChanges* changes, const char* relativePath);
+int takeSettledChanges(PendingChanges* changes, long long now, int settleMs, SettledCallback callback, void* userData);
+int nextSettleDelay(const PendingChanges* changes, long long now, int settleMs);
+int getPendingCount(const PendingChanges* changes);
+void freePendingChanges(PendingChanges* changes);
+
+#endif
\ No newline at end of file
@@ -1,12 +1,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
 #include <windows.h>
 #include <direct.h>
+#include <io.h>
 #include <errno.h>
 #include "file_utils.h"
 #include "platform_utils.h"
 #include "log_utils.h"
+#include "filter_utils.h"
+
+// 旧版 SDK 头文件中可能没有该标志（Windows 10 1703 起支持非管理员创建符号链接）
+#ifndef SYMBOLIC_LINK_FLAG_ALLOW_UNPRIVILEGED_CREATE
+#define SYMBOLIC_LINK_FLAG_ALLOW_UNPRIVILEGED_CREATE 0x2
+#endif
 
 // 辅助函数：将UTF-8字符串转换为宽字符串
 static void utf8_to_wchar(const char* utf8, wchar_t* wstr, size_t wstr_size) {
@@ -41,20 +50,45 @@ int createDirectory(const char* path) {
     return result;
 }
 
-// 递归打印文件树
-void printFileTree(const char* path, int depth) {
+// 辅助函数：将 FILETIME 转换为 Unix 纪元起的纳秒数
+static long long fileTimeToUnixTime(const FILETIME* fileTime) {
+    ULARGE_INTEGER value;
+    value.LowPart = fileTime->dwLowDateTime;
+    value.HighPart = fileTime->dwHighDateTime;
+    // FILETIME 以 1601-01-01 为起点，单位为 100 纳秒
+    return ((long long)value.QuadPart - 116444736000000000LL) * 100;
+}
+
+// 辅助函数：目录是否应按遍历选项跳过
+// 目录联接、符号链接和卷挂载点都是重解析点：--no-follow 时全部跳过，--one-file-system 时跳过挂载点标记
+static int skipReparsePoint(const WIN32_FIND_DATAW* findData, unsigned int traversalFlags) {
+    if (traversalFlags == 0 || !(findData->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || !(findData->dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+        return 0;
+    }
+    return (traversalFlags & TRAVERSE_NO_FOLLOW) || findData->dwReserved0 == IO_REPARSE_TAG_MOUNT_POINT;
+}
+
+// 构建文件列表（递归），同时记录大小和修改时间，后续阶段无需再次查询
+// wpath 是可复用的宽字符路径缓冲区，进入子目录时在末尾追加名称，返回时截断，避免反复转换完整路径
+static void buildFileListRecursive(wchar_t* wpath, size_t wpathLength, int parent, FileList* list) {
     WIN32_FIND_DATAW findFileData;
-    wchar_t searchPath[MAX_PATH_LENGTH];
     HANDLE hFind;
     
-    wchar_t wpath[MAX_PATH_LENGTH];
-    utf8_to_wchar(path, wpath, MAX_PATH_LENGTH);
+    if (wpathLength + 3 >= MAX_PATH_LENGTH) {
+        logMessage(LOG_WARNING, "Path too long for building file list");
+        return;
+    }
+    wcscpy(wpath + wpathLength, L"\\*");
     
-    snwprintf(searchPath, MAX_PATH_LENGTH, L"%s\\*", wpath);
+    unsigned int traversalFlags = (list->filter != NULL) ? getTraversalFlags(list->filter) : 0;
     
-    hFind = FindFirstFileW(searchPath, &findFileData);
+    // 不需要 8.3 短文件名，并使用更大的目录缓冲区减少往返
+    hFind = FindFirstFileExW(wpath, FindExInfoBasic, &findFileData, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+    wpath[wpathLength] = L'\0';
     if (hFind == INVALID_HANDLE_VALUE) {
-        logMessage(LOG_WARNING, "Cannot open directory: %s", path);
+        char utf8Path[MAX_PATH_LENGTH];
+        wchar_to_utf8(wpath, utf8Path, MAX_PATH_LENGTH);
+        logMessage(LOG_WARNING, "Cannot open directory for building file list: %s", utf8Path);
         return;
     }
     
@@ -64,127 +98,105 @@ void printFileTree(const char* path, int depth) {
             continue;
         }
         
-        // 缩进
-        for (int i = 0; i < depth; i++) {
-            printf("  ");
-        }
-        
-        // 将宽字符文件名转换为UTF-8以便打印
+        // 将宽字符文件名转换为UTF-8
         char utf8FileName[MAX_PATH_LENGTH];
         wchar_to_utf8(findFileData.cFileName, utf8FileName, MAX_PATH_LENGTH);
         
-        if (findFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-            printf("[%s]\\\n", utf8FileName);
+        int isDirectory = (findFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+        if (skipReparsePoint(&findFileData, traversalFlags)) {
+            continue;
+        }
+        long long size = isDirectory ? 0 : (((long long)findFileData.nFileSizeHigh << 32) | findFileData.nFileSizeLow);
+        long long mtime = fileTimeToUnixTime(&findFileData.ftLastWriteTime);
+        
+        int index = addFileEntry(list, parent, utf8FileName, strlen(utf8FileName), isDirectory ? FILE_ENTRY_DIRECTORY : 0, size, mtime);
+        if (index == FILE_ENTRY_FILTERED) {
+            continue;
+        }
+        if (index < 0) {
+            break;
+        }
+        
+        if (isDirectory) {
             // 递归处理子目录
-            char subPath[MAX_PATH_LENGTH];
-            snprintf(subPath, MAX_PATH_LENGTH, "%s\\%s", path, utf8FileName);
-            printFileTree(subPath, depth + 1);
-        } else {
-            printf("%s\n", utf8FileName);
+            size_t nameLength = wcslen(findFileData.cFileName);
+            if (wpathLength + 1 + nameLength >= MAX_PATH_LENGTH) {
+                logMessage(LOG_WARNING, "Path too long for building file list: %s", utf8FileName);
+                continue;
+            }
+            wpath[wpathLength] = L'\\';
+            wcscpy(wpath + wpathLength + 1, findFileData.cFileName);
+            buildFileListRecursive(wpath, wpathLength + 1 + nameLength, index, list);
+            wpath[wpathLength] = L'\0';
         }
     } while (FindNextFileW(hFind, &findFileData) != 0);
     
     FindClose(hFind);
 }
 
-// 构建文件列表（递归）
-FileEntry* buildFileList(const char* path, FileEntry* list) {
-    WIN32_FIND_DATAW findFileData;
-    wchar_t searchPath[MAX_PATH_LENGTH];
-    HANDLE hFind;
+// 构建文件列表（一次扫描同时供打印文件树、处理文件和创建输出目录使用）
+int buildFileList(const char* path, FileList* list) {
+    if (!pathExists(path)) {
+        return -1;
+    }
     
     wchar_t wpath[MAX_PATH_LENGTH];
     utf8_to_wchar(path, wpath, MAX_PATH_LENGTH);
+    buildFileListRecursive(wpath, wcslen(wpath), -1, list);
+    return 0;
+}
+
+// 获取路径所在文件系统的标识：Windows 端以重解析点标记判断挂载点，不需要该值
+unsigned long long getFileSystemId(const char* path) {
+    (void)path;
+    return 0;
+}
+
+// 列举单个目录中的各项（不递归），每项调用一次 callback，callback 返回非 0 时停止
+// 供并行扫描的工作线程使用
+int enumerateDirectory(const char* path, unsigned int traversalFlags, unsigned long long fileSystem, DirectoryEntryCallback callback, void* userData) {
+    (void)fileSystem;
+    wchar_t wpath[MAX_PATH_LENGTH];
+    utf8_to_wchar(path, wpath, MAX_PATH_LENGTH);
+    size_t wpathLength = wcslen(wpath);
+    if (wpathLength + 3 >= MAX_PATH_LENGTH) {
+        logMessage(LOG_WARNING, "Path too long for building file list: %s", path);
+        return -1;
+    }
+    wcscpy(wpath + wpathLength, L"\\*");
     
-    snwprintf(searchPath, MAX_PATH_LENGTH, L"%s\\*", wpath);
-    
-    hFind = FindFirstFileW(searchPath, &findFileData);
+    WIN32_FIND_DATAW findFileData;
+    HANDLE hFind = FindFirstFileExW(wpath, FindExInfoBasic, &findFileData, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
     if (hFind == INVALID_HANDLE_VALUE) {
         logMessage(LOG_WARNING, "Cannot open directory for building file list: %s", path);
-        return list;
+        return -1;
     }
     
     do {
-        // 跳过 "." 和 ".."
         if (wcscmp(findFileData.cFileName, L".") == 0 || wcscmp(findFileData.cFileName, L"..") == 0) {
             continue;
         }
+        if (skipReparsePoint(&findFileData, traversalFlags)) {
+            continue;
+        }
         
-        // 创建新节点
-        FileEntry* newEntry = (FileEntry*)malloc(sizeof(FileEntry));
-        
-        // 将宽字符文件名转换为UTF-8
         char utf8FileName[MAX_PATH_LENGTH];
         wchar_to_utf8(findFileData.cFileName, utf8FileName, MAX_PATH_LENGTH);
         
-        snprintf(newEntry->path, MAX_PATH_LENGTH, "%s\\%s", path, utf8FileName);
-        
-        if (findFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-            newEntry->is_directory = 1;
-            // 递归处理子目录
-            list = buildFileList(newEntry->path, list);
-        } else {
-            newEntry->is_directory = 0;
-        }
-        
-        // 添加到链表
-        newEntry->next = list;
-        list = newEntry;
-    } while (FindNextFileW(hFind, &findFileData) != 0);
-    
-    FindClose(hFind);
-    return list;
-}
-
-// 创建目录树
-void createDirectoryTree(const char* inputPath, const char* outputPath) {
-    WIN32_FIND_DATAW findFileData;
-    wchar_t searchPath[MAX_PATH_LENGTH];
-    HANDLE hFind;
-    
-    wchar_t winputPath[MAX_PATH_LENGTH];
-    utf8_to_wchar(inputPath, winputPath, MAX_PATH_LENGTH);
-    
-    snwprintf(searchPath, MAX_PATH_LENGTH, L"%s\\*", winputPath);
-    
-    hFind = FindFirstFileW(searchPath, &findFileData);
-    if (hFind == INVALID_HANDLE_VALUE) {
-        logMessage(LOG_WARNING, "Cannot open directory for creating directory tree: %s", inputPath);
-        return;
-    }
-    
-    do {
-        // 跳过 "." 和 ".."
-        if (wcscmp(findFileData.cFileName, L".") == 0 || wcscmp(findFileData.cFileName, L"..") == 0) {
-            continue;
-        }
-        
-        if (findFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-            // 将宽字符文件名转换为UTF-8
-            char utf8FileName[MAX_PATH_LENGTH];
-            wchar_to_utf8(findFileData.cFileName, utf8FileName, MAX_PATH_LENGTH);
-            
-            // 创建输出目录
-            char outputDir[MAX_PATH_LENGTH];
-            snprintf(outputDir, MAX_PATH_LENGTH, "%s\\%s", outputPath, utf8FileName);
-            
-            // 使用createDirectory函数创建目录（该函数已经支持UTF-8）
-            if (createDirectory(outputDir) != 0 && errno != EEXIST) {
-                logMessage(LOG_WARNING, "Cannot create directory %s", outputDir);
-            }
-            
-            // 递归处理子目录
-            char subInputPath[MAX_PATH_LENGTH];
-            snprintf(subInputPath, MAX_PATH_LENGTH, "%s\\%s", inputPath, utf8FileName);
-            createDirectoryTree(subInputPath, outputDir);
+        int isDirectory = (findFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+        long long size = isDirectory ? 0 : (((long long)findFileData.nFileSizeHigh << 32) | findFileData.nFileSizeLow);
+        long long mtime = fileTimeToUnixTime(&findFileData.ftLastWriteTime);
+        if (callback(userData, utf8FileName, isDirectory ? FILE_ENTRY_DIRECTORY : 0, size, mtime) != 0) {
+            break;
         }
     } while (FindNextFileW(hFind, &findFileData) != 0);
     
     FindClose(hFind);
+    return 0;
 }
 
-// 复制文件（保留路径结构）
-int copyFileWithPath(const char* source, const char* destination) {
+// 复制文件（保留路径结构），按 mode 选择链接或复制
+int copyFileWithPath(const char* source, const char* destination, CopyMode mode) {
     // 将源路径和目标路径转换为宽字符
     wchar_t wsource[MAX_PATH_LENGTH];
     wchar_t wdestination[MAX_PATH_LENGTH];
@@ -209,7 +221,28 @@ int copyFileWithPath(const char* source, const char* destination) {
         }
     }
     
-    // 复制文件
+    // 链接模式：权限不足或跨卷等原因失败时退回到复制
+    if (mode == COPY_HARDLINK || mode == COPY_SYMLINK) {
+        const char* kind = (mode == COPY_HARDLINK) ? "hard link" : "symbolic link";
+        BOOL linked = FALSE;
+        DeleteFileW(wdestination);
+        if (mode == COPY_HARDLINK) {
+            linked = CreateHardLinkW(wdestination, wsource, NULL);
+        } else {
+            // 符号链接使用绝对路径，避免链接位置不同导致相对路径失效
+            wchar_t absolutePath[MAX_PATH_LENGTH];
+            if (GetFullPathNameW(wsource, MAX_PATH_LENGTH, absolutePath, NULL) != 0) {
+                linked = CreateSymbolicLinkW(wdestination, absolutePath, SYMBOLIC_LINK_FLAG_ALLOW_UNPRIVILEGED_CREATE);
+            }
+        }
+        if (linked) {
+            logMessage(LOG_INFO, "Created %s: %s -> %s", kind, source, destination);
+            return 1;
+        }
+        logMessage(LOG_WARNING, "Cannot create %s %s -> %s (error %lu), copying instead", kind, source, destination, GetLastError());
+    }
+    
+    // 复制文件（CopyFileW 在支持块克隆的卷上由系统自动使用克隆，因此 reflink 与自动模式相同）
     if (CopyFileW(wsource, wdestination, FALSE)) {
         logMessage(LOG_INFO, "Copy successful: %s -> %s", source, destination);
         return 1;
@@ -217,4 +250,1129 @@ int copyFileWithPath(const char* source, const char* destination) {
         logMessage(LOG_ERROR, "Failed to copy file %s -> %s", source, destination);
         return 0;
     }
-}
\ No newline at end of file
+}
+
+// 获取文件大小和修改时间，文件不存在时返回 -1（不记录日志）
+int getFileInfo(const char* path, long long* size, long long* mtime) {
+    wchar_t wpath[MAX_PATH_LENGTH];
+    utf8_to_wchar(path, wpath, MAX_PATH_LENGTH);
+    
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(wpath, GetFileExInfoStandard, &data)) {
+        return -1;
+    }
+    
+    if (size != NULL) {
+        *size = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? 0 : (((long long)data.nFileSizeHigh << 32) | data.nFileSizeLow);
+    }
+    if (mtime != NULL) {
+        *mtime = fileTimeToUnixTime(&data.ftLastWriteTime);
+    }
+    return 0;
+}
+
+// 把路径转换为绝对路径，解析其中的 . 和 ..（按字面处理，不要求路径存在，也不解析符号链接和联接点）
+int getAbsolutePath(const char* path, char* buffer, size_t bufferSize) {
+    wchar_t wpath[MAX_PATH_LENGTH];
+    wchar_t wfull[MAX_PATH_LENGTH];
+    utf8_to_wchar(path, wpath, MAX_PATH_LENGTH);
+    DWORD length = GetFullPathNameW(wpath, MAX_PATH_LENGTH, wfull, NULL);
+    if (length == 0 || length >= MAX_PATH_LENGTH) {
+        return -1;
+    }
+    wchar_to_utf8(wfull, buffer, bufferSize);
+    return 0;
+}
+
+// 打开文件（路径为 UTF-8，转换为宽字符以支持非 ASCII 路径）
+FILE* openFile(const char* path, const char* mode) {
+    wchar_t wpath[MAX_PATH_LENGTH];
+    wchar_t wmode[16];
+    utf8_to_wchar(path, wpath, MAX_PATH_LENGTH);
+    utf8_to_wchar(mode, wmode, 16);
+    return _wfopen(wpath, wmode);
+}
+
+// 判断流是否连接到控制台
+int isTerminal(FILE* stream) {
+    return _isatty(_fileno(stream));
+}
+
+// 用 source 原子地替换 destination
+int replaceFile(const char* source, const char* destination) {
+    wchar_t wsource[MAX_PATH_LENGTH];
+    wchar_t wdestination[MAX_PATH_LENGTH];
+    utf8_to_wchar(source, wsource, MAX_PATH_LENGTH);
+    utf8_to_wchar(destination, wdestination, MAX_PATH_LENGTH);
+    
+    if (!MoveFileExW(wsource, wdestination, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        logMessage(LOG_ERROR, "Cannot replace %s with %s (error %lu)", destination, source, GetLastError());
+        return -1;
+    }
+    return 0;
+}
+
+// 只读映射的文件（映射视图在文件和映射对象的句柄关闭后仍然有效）
+struct MappedFile {
+    void* view;
+};
+
+// 把整个文件只读映射到内存，文件不存在、为空或无法映射时返回 NULL
+MappedFile* mapFile(const char* path, const void** data, size_t* size) {
+    wchar_t wpath[MAX_PATH_LENGTH];
+    utf8_to_wchar(path, wpath, MAX_PATH_LENGTH);
+    HANDLE file = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0 || (unsigned long long)fileSize.QuadPart > (size_t)-1) {
+        CloseHandle(file);
+        return NULL;
+    }
+    
+    HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) {
+        logMessage(LOG_WARNING, "Cannot map %s (error %lu)", path, GetLastError());
+        return NULL;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == NULL) {
+        logMessage(LOG_WARNING, "Cannot map %s (error %lu)", path, GetLastError());
+        return NULL;
+    }
+    
+    MappedFile* mapped = (MappedFile*)malloc(sizeof(MappedFile));
+    if (mapped == NULL) {
+        UnmapViewOfFile(view);
+        return NULL;
+    }
+    mapped->view = view;
+    *data = view;
+    *size = (size_t)fileSize.QuadPart;
+    return mapped;
+}
+
+// 解除文件映射
+void unmapFile(MappedFile* mapped) {
+    if (mapped == NULL) {
+        return;
+    }
+    UnmapViewOfFile(mapped->view);
+    free(mapped);
+}
+
+// 目录监视器：在根目录上以子树方式调用 ReadDirectoryChangesW，之后新建的子目录自动包含在内
+struct DirectoryWatcher {
+    HANDLE directory;
+    OVERLAPPED overlapped;
+    char root[MAX_PATH_LENGTH];
+    unsigned int traversalFlags;
+    WatchCallback callback;
+    void* userData;
+    DWORD buffer[16 * 1024];    // 64 KB 且按 DWORD 对齐（网络共享上不能超过 64 KB）
+};
+
+// 关注文件和目录的创建、删除、重命名，以及大小和修改时间的变化
+#define WATCH_NOTIFY_FILTER (FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE)
+
+// 列举新目录时传给回调的上下文
+typedef struct WatchEnumeration {
+    DirectoryWatcher* watcher;
+    const char* relativePath;
+} WatchEnumeration;
+
+// 辅助函数：列举新出现的目录，已有的文件报告为写入完成（整体移入的目录不会为其中的文件产生事件）
+static int reportDirectoryEntry(void* userData, const char* name, unsigned int flags, long long size, long long mtime) {
+    (void)size;
+    (void)mtime;
+    WatchEnumeration* context = (WatchEnumeration*)userData;
+    DirectoryWatcher* watcher = context->watcher;
+    char relativePath[MAX_PATH_LENGTH];
+    int written = (context->relativePath[0] == '\0') ? snprintf(relativePath, sizeof(relativePath), "%s", name)
+                                                      : snprintf(relativePath, sizeof(relativePath), "%s\\%s", context->relativePath, name);
+    if (written < 0 || written >= (int)sizeof(relativePath)) {
+        logMessage(LOG_WARNING, "Path too long, change ignored: %s\\%s", context->relativePath, name);
+        return 0;
+    }
+    
+    if (flags & FILE_ENTRY_DIRECTORY) {
+        if (watcher->callback(watcher->userData, relativePath, WATCH_DIRECTORY_ADDED) == 0) {
+            char path[MAX_PATH_LENGTH];
+            snprintf(path, sizeof(path), "%s\\%s", watcher->root, relativePath);
+            WatchEnumeration child;
+            child.watcher = watcher;
+            child.relativePath = relativePath;
+            enumerateDirectory(path, watcher->traversalFlags, 0, reportDirectoryEntry, &child);
+        }
+    } else {
+        watcher->callback(watcher->userData, relativePath, WATCH_FILE_CLOSED);
+    }
+    return 0;
+}
+
+// 辅助函数：发起下一次异步读取
+static int issueWatchRead(DirectoryWatcher* watcher) {
+    ResetEvent(watcher->overlapped.hEvent);
+    if (!ReadDirectoryChangesW(watcher->directory, watcher->buffer, sizeof(watcher->buffer), TRUE, WATCH_NOTIFY_FILTER, NULL, &watcher->overlapped, NULL)) {
+        logMessage(LOG_ERROR, "Cannot watch directory %s (error %lu)", watcher->root, GetLastError());
+        return -1;
+    }
+    return 0;
+}
+
+// 辅助函数：处理一条变更记录
+// Windows 没有“写入方关闭文件”的通知，新建、写入和移入都报告为写入完成，由调用方的稳定时间等待写入停止
+static void handleWatchRecord(DirectoryWatcher* watcher, const FILE_NOTIFY_INFORMATION* record) {
+    wchar_t wname[MAX_PATH_LENGTH];
+    size_t nameLength = record->FileNameLength / sizeof(wchar_t);
+    if (nameLength >= MAX_PATH_LENGTH) {
+        return;
+    }
+    memcpy(wname, record->FileName, nameLength * sizeof(wchar_t));
+    wname[nameLength] = L'\0';
+    char relativePath[MAX_PATH_LENGTH];
+    wchar_to_utf8(wname, relativePath, MAX_PATH_LENGTH);
+    
+    if (record->Action == FILE_ACTION_REMOVED || record->Action == FILE_ACTION_RENAMED_OLD_NAME) {
+        watcher->callback(watcher->userData, relativePath, WATCH_FILE_REMOVED);
+        return;
+    }
+    
+    char path[MAX_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s\\%s", watcher->root, relativePath);
+    wchar_t wpath[MAX_PATH_LENGTH];
+    utf8_to_wchar(path, wpath, MAX_PATH_LENGTH);
+    DWORD attributes = GetFileAttributesW(wpath);
+    if (attributes == INVALID_FILE_ATTRIBUTES) {
+        return;
+    }
+    if (attributes & FILE_ATTRIBUTE_DIRECTORY) {
+        // 目录本身的修改（其中的项增删）无需处理；新目录中的文件在列举时报告
+        if (record->Action == FILE_ACTION_MODIFIED) {
+            return;
+        }
+        if ((attributes & FILE_ATTRIBUTE_REPARSE_POINT) && (watcher->traversalFlags & TRAVERSE_NO_FOLLOW)) {
+            return;
+        }
+        if (watcher->callback(watcher->userData, relativePath, WATCH_DIRECTORY_ADDED) == 0) {
+            WatchEnumeration context;
+            context.watcher = watcher;
+            context.relativePath = relativePath;
+            enumerateDirectory(path, watcher->traversalFlags, 0, reportDirectoryEntry, &context);
+        }
+        return;
+    }
+    watcher->callback(watcher->userData, relativePath, WATCH_FILE_CLOSED);
+}
+
+// 创建目录监视器，在 root 下的整个目录树上注册监视
+// 事件在 readWatchEvents 中通过 callback 报告；创建时已有的文件不报告
+DirectoryWatcher* createDirectoryWatcher(const char* root, unsigned int traversalFlags, WatchCallback callback, void* userData) {
+    DirectoryWatcher* watcher = (DirectoryWatcher*)calloc(1, sizeof(DirectoryWatcher));
+    if (watcher == NULL) {
+        return NULL;
+    }
+    snprintf(watcher->root, MAX_PATH_LENGTH, "%s", root);
+    watcher->traversalFlags = traversalFlags;
+    watcher->callback = callback;
+    watcher->userData = userData;
+    
+    wchar_t wroot[MAX_PATH_LENGTH];
+    utf8_to_wchar(root, wroot, MAX_PATH_LENGTH);
+    watcher->directory = CreateFileW(wroot, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, 
+                                     OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+    if (watcher->directory == INVALID_HANDLE_VALUE) {
+        logMessage(LOG_ERROR, "Cannot open directory for watching: %s (error %lu)", root, GetLastError());
+        free(watcher);
+        return NULL;
+    }
+    watcher->overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (watcher->overlapped.hEvent == NULL || issueWatchRead(watcher) != 0) {
+        if (watcher->overlapped.hEvent != NULL) {
+            CloseHandle(watcher->overlapped.hEvent);
+        }
+        CloseHandle(watcher->directory);
+        free(watcher);
+        return NULL;
+    }
+    return watcher;
+}
+
+// 等待并处理监视事件，最多等待 timeoutMs 毫秒，返回处理的事件数（出错返回 -1）
+int readWatchEvents(DirectoryWatcher* watcher, int timeoutMs) {
+    DWORD wait = WaitForSingleObject(watcher->overlapped.hEvent, timeoutMs < 0 ? INFINITE : (DWORD)timeoutMs);
+    if (wait == WAIT_TIMEOUT) {
+        return 0;
+    }
+    
+    DWORD bytes = 0;
+    if (wait != WAIT_OBJECT_0 || !GetOverlappedResult(watcher->directory, &watcher->overlapped, &bytes, FALSE)) {
+        logMessage(LOG_ERROR, "Watching directory %s failed (error %lu)", watcher->root, GetLastError());
+        return -1;
+    }
+    
+    // 缓冲区溢出时系统丢弃这批记录并返回 0 字节：重新列举整个目录树，把所有文件报告为写入完成，不遗漏变更
+    int events = 0;
+    if (bytes == 0) {
+        logMessage(LOG_WARNING, "Watch event buffer overflowed, rescanning %s", watcher->root);
+        WatchEnumeration context;
+        context.watcher = watcher;
+        context.relativePath = "";
+        enumerateDirectory(watcher->root, watcher->traversalFlags, 0, reportDirectoryEntry, &context);
+        events++;
+    } else {
+        const BYTE* offset = (const BYTE*)watcher->buffer;
+        for (;;) {
+            const FILE_NOTIFY_INFORMATION* record = (const FILE_NOTIFY_INFORMATION*)offset;
+            handleWatchRecord(watcher, record);
+            events++;
+            if (record->NextEntryOffset == 0) {
+                break;
+            }
+            offset += record->NextEntryOffset;
+        }
+    }
+    
+    // 处理期间发生的变更由系统暂存在目录句柄上，下一次读取时返回
+    return issueWatchRead(watcher) == 0 ? events : -1;
+}
+
+// 释放目录监视器
+void freeDirectoryWatcher(DirectoryWatcher* watcher) {
+    if (watcher == NULL) {
+        return;
+    }
+    DWORD bytes = 0;
+    CancelIo(watcher->directory);
+    GetOverlappedResult(watcher->directory, &watcher->overlapped, &bytes, TRUE);
+    CloseHandle(watcher->overlapped.hEvent);
+    CloseHandle(watcher->directory);
+    free(watcher);
+}
+
+// Ctrl+C 或 Ctrl+Break 的标志，由 interruptRequested 查询
+static volatile LONG interruptReceived = 0;
+
+// 辅助函数：控制台事件处理函数，第一次按下时只设置标志，再次按下时交给默认处理（终止进程）
+static BOOL WINAPI onConsoleControl(DWORD controlType) {
+    if (controlType != CTRL_C_EVENT && controlType != CTRL_BREAK_EVENT) {
+        return FALSE;
+    }
+    return InterlockedExchange(&interruptReceived, 1) == 0;
+}
+
+// 把 Ctrl+C 和 Ctrl+Break 改为设置标志，让长时间运行的模式有机会在当前任务结束后正常退出
+void installInterruptHandler(void) {
+    SetConsoleCtrlHandler(onConsoleControl, TRUE);
+}
+
+// 是否已收到中断请求
+int interruptRequested(void) {
+    return interruptReceived != 0;
+}
+
+// 网络连接（监听套接字或已建立的连接）
+struct NetSocket {
+    SOCKET socket;
+};
+
+// 辅助函数：首次使用网络时初始化 Winsock，失败返回 -1
+static int startWinsock(void) {
+    static int started = 0;
+    if (!started) {
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+            return -1;
+        }
+        started = 1;
+    }
+    return 0;
+}
+
+// 辅助函数：把 host:port 拆成主机和端口；省略主机（:port 或只有端口）时使用本机回环地址，IPv6 地址写在方括号中
+static int splitAddress(const char* address, char* host, size_t hostSize, char* port, size_t portSize) {
+    const char* colon = strrchr(address, ':');
+    const char* portText = (colon != NULL) ? colon + 1 : address;
+    size_t hostLength = (colon != NULL) ? (size_t)(colon - address) : 0;
+    if (hostLength >= 2 && address[0] == '[' && address[hostLength - 1] == ']') {
+        address++;
+        hostLength -= 2;
+    }
+    if (portText[0] == '\0' || strlen(portText) >= portSize || hostLength >= hostSize) {
+        return -1;
+    }
+    if (hostLength == 0) {
+        snprintf(host, hostSize, "127.0.0.1");
+    } else {
+        memcpy(host, address, hostLength);
+        host[hostLength] = '\0';
+    }
+    strcpy(port, portText);
+    return 0;
+}
+
+// 辅助函数：解析地址，Unix 域套接字在 Windows 上不支持，失败返回 NULL
+static struct addrinfo* resolveAddress(const char* address, int passive) {
+    if (strncmp(address, "unix:", 5) == 0) {
+        logMessage(LOG_ERROR, "Unix domain sockets are not supported on Windows, use host:port: %s", address);
+        return NULL;
+    }
+    char host[256];
+    char port[32];
+    if (startWinsock() != 0 || splitAddress(address, host, sizeof(host), port, sizeof(port)) != 0) {
+        logMessage(LOG_ERROR, "Invalid address: %s", address);
+        return NULL;
+    }
+    struct addrinfo hints;
+    ZeroMemory(&hints, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    struct addrinfo* results = NULL;
+    if (getaddrinfo(host, port, &hints, &results) != 0) {
+        logMessage(LOG_ERROR, "Cannot resolve %s (error %d)", address, WSAGetLastError());
+        return NULL;
+    }
+    return results;
+}
+
+// 辅助函数：包装已打开的套接字，失败时关闭套接字
+static NetSocket* wrapSocket(SOCKET socketHandle) {
+    NetSocket* connection = (NetSocket*)calloc(1, sizeof(NetSocket));
+    if (connection == NULL) {
+        closesocket(socketHandle);
+        return NULL;
+    }
+    connection->socket = socketHandle;
+    return connection;
+}
+
+// 辅助函数：设置连接选项：命令消息都很短，关闭 Nagle 算法以降低往返延迟；启用保活以发现已断开的对端
+static void configureConnection(SOCKET socketHandle) {
+    BOOL enable = TRUE;
+    setsockopt(socketHandle, SOL_SOCKET, SO_KEEPALIVE, (const char*)&enable, sizeof(enable));
+    setsockopt(socketHandle, IPPROTO_TCP, TCP_NODELAY, (const char*)&enable, sizeof(enable));
+}
+
+// 在地址上监听连接：host:port（Windows 上只支持 TCP）
+NetSocket* listenOnAddress(const char* address) {
+    struct addrinfo* results = resolveAddress(address, 1);
+    if (results == NULL) {
+        return NULL;
+    }
+    SOCKET socketHandle = INVALID_SOCKET;
+    for (struct addrinfo* result = results; result != NULL && socketHandle == INVALID_SOCKET; result = result->ai_next) {
+        socketHandle = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+        if (socketHandle == INVALID_SOCKET) {
+            continue;
+        }
+        // 子进程不继承监听套接字
+        SetHandleInformation((HANDLE)socketHandle, HANDLE_FLAG_INHERIT, 0);
+        if (bind(socketHandle, result->ai_addr, (int)result->ai_addrlen) != 0 || listen(socketHandle, SOMAXCONN) != 0) {
+            closesocket(socketHandle);
+            socketHandle = INVALID_SOCKET;
+        }
+    }
+    freeaddrinfo(results);
+    if (socketHandle == INVALID_SOCKET) {
+        logMessage(LOG_ERROR, "Cannot listen on %s (error %d)", address, WSAGetLastError());
+        return NULL;
+    }
+    return wrapSocket(socketHandle);
+}
+
+// 接受一个连接（监听套接字可读时调用），失败返回 NULL
+NetSocket* acceptConnection(NetSocket* listener) {
+    SOCKET socketHandle = accept(listener->socket, NULL, NULL);
+    if (socketHandle == INVALID_SOCKET) {
+        return NULL;
+    }
+    SetHandleInformation((HANDLE)socketHandle, HANDLE_FLAG_INHERIT, 0);
+    configureConnection(socketHandle);
+    return wrapSocket(socketHandle);
+}
+
+// 连接到地址（格式同 listenOnAddress），失败返回 NULL
+NetSocket* connectToAddress(const char* address) {
+    struct addrinfo* results = resolveAddress(address, 0);
+    if (results == NULL) {
+        return NULL;
+    }
+    SOCKET socketHandle = INVALID_SOCKET;
+    for (struct addrinfo* result = results; result != NULL && socketHandle == INVALID_SOCKET; result = result->ai_next) {
+        socketHandle = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+        if (socketHandle != INVALID_SOCKET && connect(socketHandle, result->ai_addr, (int)result->ai_addrlen) != 0) {
+            closesocket(socketHandle);
+            socketHandle = INVALID_SOCKET;
+        }
+    }
+    freeaddrinfo(results);
+    if (socketHandle == INVALID_SOCKET) {
+        logMessage(LOG_ERROR, "Cannot connect to %s (error %d)", address, WSAGetLastError());
+        return NULL;
+    }
+    SetHandleInformation((HANDLE)socketHandle, HANDLE_FLAG_INHERIT, 0);
+    configureConnection(socketHandle);
+    return wrapSocket(socketHandle);
+}
+
+// 发送全部数据，失败（连接已断开）返回 -1
+int sendData(NetSocket* connection, const char* data, size_t length) {
+    while (length > 0) {
+        int chunk = length > 65536 ? 65536 : (int)length;
+        int sent = send(connection->socket, data, chunk, 0);
+        if (sent == SOCKET_ERROR) {
+            return -1;
+        }
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return 0;
+}
+
+// 读取当前可读的数据：返回读到的字节数，连接关闭返回 0，出错返回 -1
+int receiveData(NetSocket* connection, char* buffer, size_t size) {
+    int received = recv(connection->socket, buffer, size > 65536 ? 65536 : (int)size, 0);
+    return received == SOCKET_ERROR ? -1 : received;
+}
+
+// 等待任一套接字可读（监听套接字可读表示有新连接），ready[i] 置为对应套接字是否可读（NULL 项忽略）
+// 返回可读的套接字数，超时返回 0，出错返回 -1
+int waitForSockets(NetSocket** sockets, int count, int* ready, int timeoutMs) {
+    WSAPOLLFD stackFds[64];
+    WSAPOLLFD* fds = stackFds;
+    if (count > 64) {
+        fds = (WSAPOLLFD*)malloc(sizeof(WSAPOLLFD) * (size_t)count);
+        if (fds == NULL) {
+            return -1;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        // WSAPoll 忽略为负数的句柄
+        fds[i].fd = (sockets[i] != NULL) ? sockets[i]->socket : INVALID_SOCKET;
+        fds[i].events = POLLRDNORM;
+        fds[i].revents = 0;
+    }
+    
+    int result = WSAPoll(fds, (ULONG)count, timeoutMs);
+    for (int i = 0; i < count; i++) {
+        ready[i] = (result > 0 && (fds[i].revents & (POLLRDNORM | POLLHUP | POLLERR)) != 0);
+    }
+    if (fds != stackFds) {
+        free(fds);
+    }
+    return result == SOCKET_ERROR ? -1 : result;
+}
+
+// 关闭连接或监听套接字
+void closeSocket(NetSocket* connection) {
+    if (connection == NULL) {
+        return;
+    }
+    closesocket(connection->socket);
+    free(connection);
+}
+
+// 获取可用的处理器数量
+int getProcessorCount(void) {
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    return systemInfo.dwNumberOfProcessors > 0 ? (int)systemInfo.dwNumberOfProcessors : 1;
+}
+
+// 之后启动的子进程使用的优先级类和 CPU 亲和性（0 表示保持默认），由 setChildPriority/setChildAffinity 设置
+static DWORD childPriorityClass = 0;
+static DWORD_PTR childAffinityMask = 0;
+
+// 采样系统负载：Windows 没有平均负载，以两次采样之间的 CPU 忙碌比例乘以处理器数近似；没有 PSI
+int getSystemLoad(SystemLoad* load) {
+    static ULONGLONG lastIdle = 0;
+    static ULONGLONG lastTotal = 0;
+    load->loadAverage = -1;
+    load->cpuPressure = -1;
+    load->memoryPressure = -1;
+    load->availableMemoryKb = -1;
+    
+    FILETIME idleTime, kernelTime, userTime;
+    if (GetSystemTimes(&idleTime, &kernelTime, &userTime)) {
+        ULONGLONG idle = ((ULONGLONG)idleTime.dwHighDateTime << 32) | idleTime.dwLowDateTime;
+        // 内核时间中已包含空闲时间
+        ULONGLONG total = (((ULONGLONG)kernelTime.dwHighDateTime << 32) | kernelTime.dwLowDateTime) + (((ULONGLONG)userTime.dwHighDateTime << 32) | userTime.dwLowDateTime);
+        if (lastTotal != 0 && total > lastTotal) {
+            double busy = 1.0 - (double)(idle - lastIdle) / (double)(total - lastTotal);
+            load->loadAverage = busy * getProcessorCount();
+        }
+        lastIdle = idle;
+        lastTotal = total;
+    }
+    
+    MEMORYSTATUSEX memoryStatus;
+    memoryStatus.dwLength = sizeof(memoryStatus);
+    if (GlobalMemoryStatusEx(&memoryStatus)) {
+        load->availableMemoryKb = (long long)(memoryStatus.ullAvailPhys / 1024);
+    }
+    return 0;
+}
+
+// 获取本进程可以使用的 CPU 编号（仅当前处理器组），返回个数
+int getAvailableCpus(int* cpus, int maxCpus) {
+    DWORD_PTR processMask = 0;
+    DWORD_PTR systemMask = 0;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask)) {
+        processMask = ~(DWORD_PTR)0;
+    }
+    
+    int count = 0;
+    int processors = getProcessorCount();
+    for (int i = 0; i < processors && i < (int)(sizeof(DWORD_PTR) * 8) && count < maxCpus; i++) {
+        if (processMask & ((DWORD_PTR)1 << i)) {
+            cpus[count++] = i;
+        }
+    }
+    return count;
+}
+
+// 获取存在的 NUMA 节点编号，返回个数（编号可能不连续）；没有 NUMA 信息时只有节点 0
+int getNumaNodes(int* nodes, int maxNodes) {
+    ULONG highestNode = 0;
+    int count = 0;
+    if (GetNumaHighestNodeNumber(&highestNode)) {
+        for (ULONG node = 0; node <= highestNode && count < maxNodes; node++) {
+            ULONGLONG nodeMask = 0;
+            if (GetNumaNodeProcessorMask((UCHAR)node, &nodeMask) && nodeMask != 0) {
+                nodes[count++] = (int)node;
+            }
+        }
+    }
+    if (count == 0 && maxNodes > 0) {
+        nodes[count++] = 0;
+    }
+    return count;
+}
+
+// 获取 NUMA 节点上本进程可以使用的 CPU 编号，返回个数；节点不存在时返回 -1
+int getNumaNodeCpus(int node, int* cpus, int maxCpus) {
+    ULONG highestNode = 0;
+    ULONGLONG nodeMask = 0;
+    if (!GetNumaHighestNodeNumber(&highestNode) || node < 0 || (ULONG)node > highestNode || !GetNumaNodeProcessorMask((UCHAR)node, &nodeMask)) {
+        return -1;
+    }
+    
+    int available[MAX_CPUS];
+    int availableCount = getAvailableCpus(available, MAX_CPUS);
+    int count = 0;
+    for (int i = 0; i < availableCount && count < maxCpus; i++) {
+        if (available[i] < 64 && (nodeMask & (1ULL << available[i]))) {
+            cpus[count++] = available[i];
+        }
+    }
+    return count;
+}
+
+// 设置之后启动的子进程的优先级：把类 Unix 的 nice 值映射为优先级类
+int setChildPriority(int niceness) {
+    if (niceness >= 10) {
+        childPriorityClass = IDLE_PRIORITY_CLASS;
+    } else if (niceness > 0) {
+        childPriorityClass = BELOW_NORMAL_PRIORITY_CLASS;
+    } else if (niceness < 0) {
+        childPriorityClass = ABOVE_NORMAL_PRIORITY_CLASS;
+    } else {
+        childPriorityClass = 0;
+    }
+    return 0;
+}
+
+// 设置之后启动的子进程可以使用的 CPU（count 为 0 时不限制）
+int setChildAffinity(const int* cpus, int count) {
+    DWORD_PTR mask = 0;
+    for (int i = 0; i < count; i++) {
+        if (cpus[i] >= 0 && cpus[i] < (int)(sizeof(DWORD_PTR) * 8)) {
+            mask |= (DWORD_PTR)1 << cpus[i];
+        }
+    }
+    childAffinityMask = mask;
+    return 0;
+}
+
+// 辅助函数：以挂起状态创建进程，放入新的作业对象后再恢复运行
+// 作业对象统计进程及其所有子进程的 CPU 时间和峰值内存；无法创建作业对象时进程照常运行
+// 优先级和 CPU 亲和性也在恢复运行之前设置，由该进程创建的子进程会继承
+// START_CAPTURE_OUTPUT 时标准输出和标准错误重定向到匿名管道；子进程只在这里创建，
+// 写入端在创建后立即关闭，因此之后启动的子进程不会继承它
+static int launchProcess(const wchar_t* application, wchar_t* commandLine, ProcessHandle* handle, unsigned int startFlags) {
+    STARTUPINFOW startupInfo;
+    PROCESS_INFORMATION processInfo;
+    ZeroMemory(&startupInfo, sizeof(startupInfo));
+    ZeroMemory(&processInfo, sizeof(processInfo));
+    startupInfo.cb = sizeof(startupInfo);
+    
+    HANDLE readPipe = NULL;
+    HANDLE writePipe = NULL;
+    if (startFlags & START_CAPTURE_OUTPUT) {
+        SECURITY_ATTRIBUTES attributes;
+        attributes.nLength = sizeof(attributes);
+        attributes.lpSecurityDescriptor = NULL;
+        attributes.bInheritHandle = TRUE;
+        if (CreatePipe(&readPipe, &writePipe, &attributes, 0)) {
+            SetHandleInformation(readPipe, HANDLE_FLAG_INHERIT, 0);
+            startupInfo.dwFlags = STARTF_USESTDHANDLES;
+            startupInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+            startupInfo.hStdOutput = writePipe;
+            startupInfo.hStdError = writePipe;
+        } else {
+            logMessage(LOG_WARNING, "Cannot create output pipe (error %lu), output not captured", GetLastError());
+            readPipe = NULL;
+            writePipe = NULL;
+        }
+    }
+    
+    BOOL created = CreateProcessW(application, commandLine, NULL, NULL, TRUE, CREATE_SUSPENDED, NULL, NULL, &startupInfo, &processInfo);
+    if (writePipe != NULL) {
+        CloseHandle(writePipe);
+    }
+    if (!created) {
+        DWORD error = GetLastError();
+        if (readPipe != NULL) {
+            CloseHandle(readPipe);
+        }
+        SetLastError(error);
+        return -1;
+    }
+    
+    if (childPriorityClass != 0) {
+        SetPriorityClass(processInfo.hProcess, childPriorityClass);
+    }
+    if (childAffinityMask != 0) {
+        SetProcessAffinityMask(processInfo.hProcess, childAffinityMask);
+    }
+    
+    HANDLE job = CreateJobObjectW(NULL, NULL);
+    if (job != NULL && !AssignProcessToJobObject(job, processInfo.hProcess)) {
+        CloseHandle(job);
+        job = NULL;
+    }
+    
+    ResumeThread(processInfo.hThread);
+    CloseHandle(processInfo.hThread);
+    handle->process = processInfo.hProcess;
+    handle->job = job;
+    handle->output = readPipe;
+    return 0;
+}
+
+// CreateProcessW 命令行的最大长度（字符数，含结尾的 '\0'）
+#define PROCESS_COMMAND_LINE_LENGTH 32768
+
+// 启动命令（不等待其结束），与 _wsystem 一样通过 %ComSpec% /c 执行
+// 批处理的命令行可能很长，缓冲区在堆上分配
+int startCommand(const char* command, ProcessHandle* handle, unsigned int startFlags) {
+    wchar_t comspec[MAX_PATH_LENGTH];
+    DWORD comspecLength = GetEnvironmentVariableW(L"ComSpec", comspec, MAX_PATH_LENGTH);
+    if (comspecLength == 0 || comspecLength >= MAX_PATH_LENGTH) {
+        wcscpy(comspec, L"cmd.exe");
+    }
+    
+    // CreateProcessW 可能会修改命令行缓冲区，因此必须使用可写副本
+    wchar_t* wcommand = (wchar_t*)malloc(sizeof(wchar_t) * PROCESS_COMMAND_LINE_LENGTH);
+    wchar_t* commandLine = (wchar_t*)malloc(sizeof(wchar_t) * PROCESS_COMMAND_LINE_LENGTH);
+    if (wcommand == NULL || commandLine == NULL) {
+        logMessage(LOG_ERROR, "Out of memory while starting command: %s", command);
+        free(wcommand);
+        free(commandLine);
+        return -1;
+    }
+    
+    int result = -1;
+    if (MultiByteToWideChar(CP_UTF8, 0, command, -1, wcommand, PROCESS_COMMAND_LINE_LENGTH) == 0) {
+        logMessage(LOG_ERROR, "Cannot convert command to UTF-16: %s", command);
+    } else if (snwprintf(commandLine, PROCESS_COMMAND_LINE_LENGTH, L"\"%s\" /c %s", comspec, wcommand) < 0) {
+        logMessage(LOG_ERROR, "Command line too long: %s", command);
+    } else if (launchProcess(comspec, commandLine, handle, startFlags) != 0) {
+        logMessage(LOG_ERROR, "Cannot start process (error %lu): %s", GetLastError(), command);
+    } else {
+        result = 0;
+    }
+    free(wcommand);
+    free(commandLine);
+    return result;
+}
+
+// 辅助函数：按照 CommandLineToArgvW / MSVCRT 的规则给单个参数加引号
+// 引号前的反斜杠需要加倍，参数末尾的反斜杠在闭合引号前同样需要加倍
+static int appendQuotedArgument(wchar_t* commandLine, size_t* length, size_t capacity, const wchar_t* argument) {
+    size_t position = *length;
+    int needsQuotes = argument[0] == L'\0' || wcspbrk(argument, L" \t\n\v\"") != NULL;
+    
+    if (position > 0) {
+        if (position + 1 >= capacity) {
+            return -1;
+        }
+        commandLine[position++] = L' ';
+    }
+    
+    if (!needsQuotes) {
+        size_t argumentLength = wcslen(argument);
+        if (position + argumentLength >= capacity) {
+            return -1;
+        }
+        wcscpy(commandLine + position, argument);
+        *length = position + argumentLength;
+        return 0;
+    }
+    
+    if (position + 1 >= capacity) {
+        return -1;
+    }
+    commandLine[position++] = L'"';
+    
+    for (const wchar_t* p = argument; ; p++) {
+        size_t backslashes = 0;
+        while (*p == L'\\') {
+            backslashes++;
+            p++;
+        }
+        
+        // 末尾或引号前的反斜杠加倍，引号本身再转义；其余反斜杠原样保留
+        size_t repeat = (*p == L'\0') ? backslashes * 2 : (*p == L'"' ? backslashes * 2 + 1 : backslashes);
+        if (position + repeat + 2 >= capacity) {
+            return -1;
+        }
+        for (size_t i = 0; i < repeat; i++) {
+            commandLine[position++] = L'\\';
+        }
+        
+        if (*p == L'\0') {
+            break;
+        }
+        commandLine[position++] = *p;
+    }
+    
+    commandLine[position++] = L'"';
+    commandLine[position] = L'\0';
+    *length = position;
+    return 0;
+}
+
+// 直接启动程序（不经过 cmd.exe），程序名按 CreateProcessW 的规则在 PATH 中查找
+int startProcess(char* const* argv, ProcessHandle* handle, unsigned int startFlags) {
+    // CreateProcessW 可能会修改命令行缓冲区，因此必须使用可写副本
+    wchar_t* commandLine = (wchar_t*)malloc(sizeof(wchar_t) * PROCESS_COMMAND_LINE_LENGTH);
+    wchar_t* wargument = (wchar_t*)malloc(sizeof(wchar_t) * PROCESS_COMMAND_LINE_LENGTH);
+    if (commandLine == NULL || wargument == NULL) {
+        logMessage(LOG_ERROR, "Out of memory while starting process: %s", argv[0]);
+        free(commandLine);
+        free(wargument);
+        return -1;
+    }
+    size_t length = 0;
+    commandLine[0] = L'\0';
+    
+    int result = 0;
+    for (int i = 0; argv[i] != NULL; i++) {
+        if (MultiByteToWideChar(CP_UTF8, 0, argv[i], -1, wargument, PROCESS_COMMAND_LINE_LENGTH) == 0 ||
+            appendQuotedArgument(commandLine, &length, PROCESS_COMMAND_LINE_LENGTH, wargument) != 0) {
+            logMessage(LOG_ERROR, "Command line too long: %s", argv[0]);
+            result = -1;
+            break;
+        }
+    }
+    
+    if (result == 0 && launchProcess(NULL, commandLine, handle, startFlags) != 0) {
+        logMessage(LOG_ERROR, "Cannot start process (error %lu): %s", GetLastError(), argv[0]);
+        result = -1;
+    }
+    free(commandLine);
+    free(wargument);
+    return result;
+}
+
+// 结束子进程及其创建的所有进程（作业对象中的全部进程）
+// Windows 没有可以发给任意控制台程序的 SIGTERM，因此无论 force 与否都直接结束
+int terminateProcessTree(ProcessHandle* handle, int force) {
+    (void)force;
+    if (handle->job != NULL && TerminateJobObject((HANDLE)handle->job, 1)) {
+        return 0;
+    }
+    return TerminateProcess((HANDLE)handle->process, 1) ? 0 : -1;
+}
+
+// 辅助函数：从作业对象读取资源使用情况并关闭作业对象
+static void collectJobStats(ProcessHandle* handle, ProcessStats* stats) {
+    if (stats != NULL) {
+        ZeroMemory(stats, sizeof(ProcessStats));
+    }
+    if (handle->job == NULL) {
+        return;
+    }
+    
+    if (stats != NULL) {
+        // 时间单位为 100 纳秒
+        JOBOBJECT_BASIC_ACCOUNTING_INFORMATION accounting;
+        if (QueryInformationJobObject(handle->job, JobObjectBasicAccountingInformation, &accounting, sizeof(accounting), NULL)) {
+            stats->userTimeMs = accounting.TotalUserTime.QuadPart / 10000;
+            stats->systemTimeMs = accounting.TotalKernelTime.QuadPart / 10000;
+        }
+        JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits;
+        if (QueryInformationJobObject(handle->job, JobObjectExtendedLimitInformation, &limits, sizeof(limits), NULL)) {
+            stats->peakMemoryKb = (long long)(limits.PeakJobMemoryUsed / 1024);
+        }
+    }
+    
+    CloseHandle(handle->job);
+    handle->job = NULL;
+}
+
+// 辅助函数：读出管道中当前可读的全部输出并交给回调（匿名管道不支持重叠 I/O，先用 PeekNamedPipe 查询可读字节数，读取不会阻塞）
+// 管道已断开或出错时关闭管道
+static void readProcessOutput(ProcessHandle* handle, int index, OutputCallback onOutput, void* userData) {
+    char buffer[16384];
+    while (handle->output != NULL) {
+        DWORD available = 0;
+        if (!PeekNamedPipe((HANDLE)handle->output, NULL, 0, NULL, &available, NULL)) {
+            CloseHandle((HANDLE)handle->output);
+            handle->output = NULL;
+            return;
+        }
+        if (available == 0) {
+            return;
+        }
+        
+        DWORD bytes = 0;
+        if (!ReadFile((HANDLE)handle->output, buffer, available < sizeof(buffer) ? available : (DWORD)sizeof(buffer), &bytes, NULL) || bytes == 0) {
+            CloseHandle((HANDLE)handle->output);
+            handle->output = NULL;
+            return;
+        }
+        onOutput(userData, index, buffer, (size_t)bytes);
+    }
+}
+
+// 唤醒 waitForAnyCommand 的自动重置事件，第一次使用时创建
+static HANDLE commandWakeEvent = NULL;
+
+// 辅助函数：取得唤醒事件（多个线程同时创建时只保留一个），创建失败时返回 NULL
+static HANDLE getCommandWakeEvent(void) {
+    if (commandWakeEvent == NULL) {
+        HANDLE event = CreateEventW(NULL, FALSE, FALSE, NULL);
+        if (event != NULL && InterlockedCompareExchangePointer((PVOID volatile*)&commandWakeEvent, event, NULL) != NULL) {
+            CloseHandle(event);
+        }
+    }
+    return commandWakeEvent;
+}
+
+// 等待任意一个子进程结束，返回其在数组中的下标，stats 不为 NULL 时同时返回其资源使用情况
+// timeoutMs 为 0 时只检查不等待，小于 0 时无限等待；超时或被 wakeCommandWait 唤醒时返回 PROCESS_WAIT_TIMEOUT
+// 等待期间捕获的输出交给 onOutput；子进程结束时先读完其管道中剩余的输出再返回
+int waitForAnyCommand(ProcessHandle* handles, int count, int* exitCode, ProcessStats* stats, int timeoutMs, OutputCallback onOutput, void* userData) {
+    HANDLE waitHandles[MAXIMUM_WAIT_OBJECTS];
+    
+    if (count <= 0) {
+        return -1;
+    }
+    
+    // WaitForMultipleObjects 一次最多等待 MAXIMUM_WAIT_OBJECTS 个句柄（其中一个留给唤醒事件），超出时分组轮询
+    // 捕获输出时同样以短间隔轮询，每轮读出各管道中的输出，避免子进程写满管道后阻塞
+    int capturing = 0;
+    for (int i = 0; i < count && onOutput != NULL; i++) {
+        capturing |= (handles[i].output != NULL);
+    }
+    HANDLE wakeEvent = getCommandWakeEvent();
+    int groupLimit = (wakeEvent != NULL) ? MAXIMUM_WAIT_OBJECTS - 1 : MAXIMUM_WAIT_OBJECTS;
+    int polling = count > groupLimit || capturing;
+    DWORD groupTimeout = polling ? (timeoutMs == 0 ? 0 : 10) : (timeoutMs < 0 ? INFINITE : (DWORD)timeoutMs);
+    long long deadline = getMonotonicTime() + timeoutMs;
+    
+    for (;;) {
+        if (capturing) {
+            for (int i = 0; i < count; i++) {
+                readProcessOutput(&handles[i], i, onOutput, userData);
+            }
+        }
+        
+        for (int base = 0; base < count; base += groupLimit) {
+            int groupSize = count - base;
+            if (groupSize > groupLimit) {
+                groupSize = groupLimit;
+            }
+            
+            // 唤醒事件放在进程句柄之后：同时就绪时优先返回结束的子进程
+            for (int i = 0; i < groupSize; i++) {
+                waitHandles[i] = (HANDLE)handles[base + i].process;
+            }
+            DWORD handleCount = (DWORD)groupSize;
+            if (wakeEvent != NULL) {
+                waitHandles[handleCount++] = wakeEvent;
+            }
+            
+            DWORD result = WaitForMultipleObjects(handleCount, waitHandles, FALSE, groupTimeout);
+            if (result < WAIT_OBJECT_0 + (DWORD)groupSize) {
+                int index = base + (int)(result - WAIT_OBJECT_0);
+                DWORD code = 0;
+                if (!GetExitCodeProcess(waitHandles[result - WAIT_OBJECT_0], &code)) {
+                    code = (DWORD)-1;
+                }
+                CloseHandle(waitHandles[result - WAIT_OBJECT_0]);
+                *exitCode = (int)code;
+                collectJobStats(&handles[index], stats);
+                
+                // 进程已退出，读完剩余输出后关闭管道（其后台子进程可能仍持有写入端，不再等待）
+                if (handles[index].output != NULL) {
+                    if (onOutput != NULL) {
+                        readProcessOutput(&handles[index], index, onOutput, userData);
+                    }
+                    if (handles[index].output != NULL) {
+                        CloseHandle((HANDLE)handles[index].output);
+                        handles[index].output = NULL;
+                    }
+                }
+                return index;
+            }
+            if (wakeEvent != NULL && result == WAIT_OBJECT_0 + (DWORD)groupSize) {
+                return PROCESS_WAIT_TIMEOUT;
+            }
+            
+            if (result == WAIT_FAILED) {
+                logMessage(LOG_ERROR, "Waiting for child processes failed (error %lu)", GetLastError());
+                return -1;
+            }
+        }
+        
+        if (!polling || (timeoutMs >= 0 && getMonotonicTime() >= deadline)) {
+            return PROCESS_WAIT_TIMEOUT;
+        }
+    }
+}
+
+// 从其他线程唤醒正在（或下一次）等待子进程的 waitForAnyCommand，使其返回 PROCESS_WAIT_TIMEOUT
+// 用于任务来源在后台线程中取得新任务时通知执行循环
+void wakeCommandWait(void) {
+    HANDLE wakeEvent = getCommandWakeEvent();
+    if (wakeEvent != NULL) {
+        SetEvent(wakeEvent);
+    }
+}
+
+// 单调时钟，单位为毫秒
+long long getMonotonicTime(void) {
+    return (long long)GetTickCount64();
+}
+
+// 休眠指定的毫秒数
+void sleepMilliseconds(int milliseconds) {
+    Sleep((DWORD)milliseconds);
+}
+
+// 线程
+struct PlatformThread {
+    HANDLE thread;
+    ThreadFunction function;
+    void* argument;
+};
+
+// 互斥锁
+struct PlatformMutex {
+    CRITICAL_SECTION section;
+};
+
+// 条件变量
+struct PlatformCondition {
+    CONDITION_VARIABLE condition;
+};
+
+// 辅助函数：线程入口
+static DWORD WINAPI threadEntry(LPVOID argument) {
+    PlatformThread* thread = (PlatformThread*)argument;
+    thread->function(thread->argument);
+    return 0;
+}
+
+// 启动线程
+PlatformThread* startThread(ThreadFunction function, void* argument) {
+    PlatformThread* thread = (PlatformThread*)malloc(sizeof(PlatformThread));
+    if (thread == NULL) {
+        return NULL;
+    }
+    
+    thread->function = function;
+    thread->argument = argument;
+    thread->thread = CreateThread(NULL, 0, threadEntry, thread, 0, NULL);
+    if (thread->thread == NULL) {
+        logMessage(LOG_ERROR, "Cannot start thread (error %lu)", GetLastError());
+        free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+// 等待线程结束并释放
+void joinThread(PlatformThread* thread) {
+    if (thread == NULL) {
+        return;
+    }
+    WaitForSingleObject(thread->thread, INFINITE);
+    CloseHandle(thread->thread);
+    free(thread);
+}
+
+// 创建互斥锁
+PlatformMutex* createMutex(void) {
+    PlatformMutex* mutex = (PlatformMutex*)malloc(sizeof(PlatformMutex));
+    if (mutex != NULL) {
+        InitializeCriticalSection(&mutex->section);
+    }
+    return mutex;
+}
+
+// 加锁
+void lockMutex(PlatformMutex* mutex) {
+    EnterCriticalSection(&mutex->section);
+}
+
+// 解锁
+void unlockMutex(PlatformMutex* mutex) {
+    LeaveCriticalSection(&mutex->section);
+}
+
+// 销毁互斥锁
+void destroyMutex(PlatformMutex* mutex) {
+    if (mutex != NULL) {
+        DeleteCriticalSection(&mutex->section);
+        free(mutex);
+    }
+}
+
+// 创建条件变量
+PlatformCondition* createCondition(void) {
+    PlatformCondition* condition = (PlatformCondition*)malloc(sizeof(PlatformCondition));
+    if (condition != NULL) {
+        InitializeConditionVariable(&condition->condition);
+    }
+    return condition;
+}
+
+// 等待条件变量，被唤醒返回 0，超时返回 -1
+int waitCondition(PlatformCondition* condition, PlatformMutex* mutex, int timeoutMs) {
+    DWORD timeout = timeoutMs < 0 ? INFINITE : (DWORD)timeoutMs;
+    return SleepConditionVariableCS(&condition->condition, &mutex->section, timeout) ? 0 : -1;
+}
+
+// 唤醒一个等待者
+void signalCondition(PlatformCondition* condition) {
+    WakeConditionVariable(&condition->condition);
+}
+
+// 唤醒所有等待者
+void broadcastCondition(PlatformCondition* condition) {
+    WakeAllConditionVariable(&condition->condition);
+}
+
+// 销毁条件变量（Windows 条件变量无需显式释放）
+void destroyCondition(PlatformCondition* condition) {
+    free(condition);
+}